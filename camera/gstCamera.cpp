@@ -43,7 +43,7 @@ gstCamera::gstCamera( const videoOptions& options ) : videoSource(options)
 	mPipeline  = NULL;	
 	mFormatYUV = IMAGE_UNKNOWN;
 	
-	mBufferManager = new gstBufferManager(&mOptions);
+	mBufferManager = new gstBufferManager(&mOptions, mSourceID);
 }
 
 
@@ -696,10 +696,16 @@ void gstCamera::checkBuffer()
 		release_return;
 	}
 
+	// timestamp the frame with when it was captured (rather than when it arrived here)
+	const uint64_t timestamp = gst_pts_to_monotonic(mPipeline, gstBuffer, gst_sample_get_segment(gstSample));
+
 	// enqueue the buffer for color conversion
-	if( !mBufferManager->Enqueue(gstBuffer, gstCaps) )
+	recordReceived();
+
+	if( !mBufferManager->Enqueue(gstBuffer, gstCaps, timestamp) )
 	{
 		LogError(LOG_GSTREAMER "gstCamera -- failed to handle incoming buffer\n");
+		recordDropped(DROP_FAILED);
 		release_return;
 	}
 	
@@ -718,6 +724,24 @@ bool gstCamera::Capture( void** output, imageFormat format, uint64_t timeout, in
 	if( !output )
 		RETURN_STATUS(ERROR);
 
+	return capture(output, NULL, format, timeout, status, stream);
+}
+
+
+// Capture
+bool gstCamera::Capture( videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
+{
+	// verify the output frame exists
+	if( !frame )
+		RETURN_STATUS(ERROR);
+
+	return capture(NULL, frame, format, timeout, status, stream);
+}
+
+
+// capture
+bool gstCamera::capture( void** output, videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
+{
 	// confirm the camera is streaming
 	if( !mStreaming )
 	{
@@ -726,22 +750,31 @@ bool gstCamera::Capture( void** output, imageFormat format, uint64_t timeout, in
 	}
 
 	// wait until a new frame is recieved
-	const int result = mBufferManager->Dequeue(output, format, timeout, stream);
+	const uint64_t dropped = mBufferManager->GetDroppedCount();
+	const int result = (frame != NULL) ? mBufferManager->Dequeue(frame, format, timeout, stream)
+								: mBufferManager->Dequeue(output, format, timeout, stream);
 	
+	recordDropped(DROP_SKIPPED, mBufferManager->GetDroppedCount() - dropped);
+
 	if( result < 0 )
 	{
 		LogError(LOG_GSTREAMER "gstCamera::Capture() -- an error occurred retrieving the next image buffer\n");
+		recordCapture(ERROR);
 		RETURN_STATUS(ERROR);
 	}
 	else if( result == 0 )
 	{
 		LogWarning(LOG_GSTREAMER "gstCamera::Capture() -- a timeout occurred waiting for the next image buffer\n");
+		recordCapture(TIMEOUT);
 		RETURN_STATUS(TIMEOUT);
 	}
 
 	mLastTimestamp = mBufferManager->GetLastTimestamp();
+	mLastPTS = mBufferManager->GetLastPTS();
 	mRawFormat = mBufferManager->GetRawFormat();
 
+	recordCapture(OK, mLastTimestamp);
+
 	RETURN_STATUS(OK);
 }
 
@@ -137,6 +137,12 @@ public:
 	 */
 	virtual bool Capture( void** image, imageFormat format, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
 
+	/**
+	 * Capture the next image frame from the camera into a reference-counted videoFrame.
+	 * @see videoSource::Capture
+	 */
+	virtual bool Capture( videoFrame* frame, imageFormat format=IMAGE_RGB8, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
+
 	/**
 	 * Capture the next image frame from the camera and convert it to float4 RGBA format,
 	 * with pixel intensities ranging between 0.0 and 255.0.
@@ -178,6 +184,20 @@ public:
 	 */
 	void SetZeroCopy(bool zeroCopy)     { mOptions.zeroCopy = zeroCopy; }
 
+	/**
+	 * Attach another consumer of the frames, which dequeues them independently of Capture()
+	 * with its own policy (for example, from a different thread).  Conversions of the same
+	 * frame to the same format are shared with the other consumers and with Capture(videoFrame*).
+	 * The stream should be opened first, and the consumer gets freed with Detach().
+	 * @see gstBufferManager::Consumer
+	 */
+	inline gstBufferManager::Consumer* Attach( gstBufferManager::ConsumerPolicy policy=gstBufferManager::ReadLatest )	{ return mBufferManager->Attach(policy); }
+
+	/**
+	 * Detach a consumer that was returned by Attach().
+	 */
+	inline void Detach( gstBufferManager::Consumer* consumer )	{ mBufferManager->Detach(consumer); }
+
 	/**
 	 * Return the interface type (gstCamera::Type)
 	 */
@@ -208,6 +228,7 @@ private:
 	bool init();
 	bool discover();
 	bool buildLaunchStr();
+	bool capture( void** image, videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream );
 
 	void checkMsgBus();
 	void checkBuffer();
@@ -25,6 +25,9 @@
 #include "timespec.h"
 #include "logging.h"
 
+#include <limits.h>
+#include <inttypes.h>
+
 
 #ifdef ENABLE_NVMM
 #include <nvbuf_utils.h>
@@ -38,13 +41,24 @@
 
 
 // constructor
-gstBufferManager::gstBufferManager( videoOptions* options )
+gstBufferManager::gstBufferManager( videoOptions* options, uint32_t sourceID )
 {	
 	mOptions    = options;
+	mSourceID   = sourceID;
+	mFramePool  = NULL;
 	mFormatYUV  = IMAGE_UNKNOWN;
 	mFrameCount = 0;
+	mDroppedCount = 0;
+	mDequeueSequence = 0;
 	mLastTimestamp = 0;
+	mLastPTS       = 0;
 	mNvmmUsed   = false;
+	mRetainFailed = false;
+	mRetainedCount = 0;
+	mDefaultConsumer = NULL;
+	mLatestSequence  = 0;
+	mFrameSignal     = 0;
+	mUnpinSignal     = 0;
 	
 #ifdef ENABLE_NVMM
 	mNvmmFD        = -1;
@@ -52,26 +66,67 @@ gstBufferManager::gstBufferManager( videoOptions* options )
 	mNvmmCUDA      = NULL;
 	mNvmmSize      = 0;
 	mNvmmReleaseFD = false;
+	mNvmmSequence  = 0;
+	mNvmmPending   = 0;
+	mNvmmPins      = 0;
 #endif
 	
 	mBufferRGB.SetThreaded(false);
+
+	// the appsink thread is the only writer, and Dequeue() is the only reader
+	mFramesYUV.SetFlags(RingBuffer::LockFree);
+	mBufferYUV.SetFlags(RingBuffer::LockFree);
+	mTimestamps.SetFlags(RingBuffer::LockFree);
 }
 
 
 // destructor
 gstBufferManager::~gstBufferManager()
 {
-	
+	// the pool gets freed after the application releases its frames
+	if( mFramePool != NULL )
+		mFramePool->Release();
+
+	for( size_t n=0; n < mConsumers.size(); n++ )
+		delete mConsumers[n];
+
+	mConsumers.clear();
+	mConverted.clear();
+
+	// release the retained GstBuffers
+	for( uint32_t n=0; n < mFramesYUV.GetNumBuffers(); n++ )
+		releaseFrame((FrameYUV*)mFramesYUV.GetBuffer(n));
+
+#if GST_CHECK_VERSION(1,0,0)
+	// unregister memory that's still alive in upstream buffer pools
+	mRegisterMutex.Lock();
+
+	for( size_t n=0; n < mRegistered.size(); n++ )
+	{
+		gst_mini_object_weak_unref(GST_MINI_OBJECT(mRegistered[n].memory), onMemoryFreed, this);
+		CUDA(cudaHostUnregister(mRegistered[n].host));
+	}
+
+	mRegistered.clear();
+	mRegisterMutex.Unlock();
+#endif
 }
 
 
 // Enqueue
-bool gstBufferManager::Enqueue( GstBuffer* gstBuffer, GstCaps* gstCaps )
+bool gstBufferManager::Enqueue( GstBuffer* gstBuffer, GstCaps* gstCaps, uint64_t timestamp )
 {
 	if( !gstBuffer || !gstCaps )
 		return false;
 
-	uint64_t timestamp = apptime_nano();
+	if( timestamp == 0 )
+		timestamp = timeNs();
+
+	// the stream time is kept alongside, because for file:// it's the position in the video
+	uint64_t pts = 0;
+
+	if( GST_BUFFER_DTS_IS_VALID(gstBuffer) || GST_BUFFER_PTS_IS_VALID(gstBuffer) )
+		pts = GST_BUFFER_DTS_OR_PTS(gstBuffer);
 
 #if GST_CHECK_VERSION(1,0,0)	
 	// map the buffer memory for read access
@@ -225,6 +280,7 @@ bool gstBufferManager::Enqueue( GstBuffer* gstBuffer, GstCaps* gstCaps )
 		mNvmmFD = nvmmFD;
 		mNvmmEGL = eglImage;
 		mNvmmReleaseFD = nvmmReleaseFD;
+		mNvmmPending = mFrameCount + 1;
 		
 		mNvmmMutex.Unlock();
 	}
@@ -237,28 +293,18 @@ bool gstBufferManager::Enqueue( GstBuffer* gstBuffer, GstCaps* gstCaps )
 	// handle CPU path (non-NVMM)
 	if( !mNvmmUsed )
 	{
-		// allocate image ringbuffer
-		if( !mBufferYUV.Alloc(mOptions->numBuffers, gstSize, RingBuffer::ZeroCopy) )
-		{
-			LogError(LOG_GSTREAMER "gstBufferManager -- failed to allocate %u image buffers (%zu bytes each)\n", mOptions->numBuffers, gstSize);
-			return false;
-		}
+		// consumers could be reading the frame that gets replaced
+		mConsumerMutex.Lock();
+		const bool enqueued = enqueueFrame(gstBuffer, gstData, gstSize, timestamp, pts);
+		mConsumerMutex.Unlock();
 
-		// copy to next image ringbuffer
-		void* nextBuffer = mBufferYUV.Peek(RingBuffer::Write);
-
-		if( !nextBuffer )
-		{
-			LogError(LOG_GSTREAMER "gstBufferManager -- failed to retrieve next image ringbuffer for writing\n");
+		if( !enqueued )
 			return false;
-		}
-
-		memcpy(nextBuffer, gstData, gstSize);
-		mBufferYUV.Next(RingBuffer::Write);
 	}
 
 	// handle timestamps in either case (CPU or NVMM path)
-	size_t timestamp_size = sizeof(uint64_t);
+	const uint64_t timestamps[] = { timestamp, pts };
+	const size_t timestamp_size = sizeof(timestamps);
 
 	// allocate timestamp ringbuffer (GPU only if not ZeroCopy)
 	if( !mTimestamps.Alloc(mOptions->numBuffers, timestamp_size, RingBuffer::ZeroCopy) )
@@ -276,16 +322,17 @@ bool gstBufferManager::Enqueue( GstBuffer* gstBuffer, GstCaps* gstCaps )
 		return false;
 	}
 
-	if( GST_BUFFER_DTS_IS_VALID(gstBuffer) || GST_BUFFER_PTS_IS_VALID(gstBuffer) )
-	{
-		timestamp = GST_BUFFER_DTS_OR_PTS(gstBuffer);
-	}
-
-	memcpy(nextTimestamp, (void*)&timestamp, timestamp_size);
+	memcpy(nextTimestamp, (void*)timestamps, timestamp_size);
 	mTimestamps.Next(RingBuffer::Write);
 
 	mWaitEvent.Wake();
 	mFrameCount++;
+
+	// wake up the consumers
+	mLatestSequence.store(mNvmmUsed ? mFrameCount : mFramesYUV.GetWriteSequence(), std::memory_order_release);
+	mFrameSignal.fetch_add(1, std::memory_order_release);
+
+	Event::futexWake(&mFrameSignal, INT_MAX);
 	
 #if GST_CHECK_VERSION(1,0,0)
 	gst_buffer_unmap(gstBuffer, &map);
@@ -295,120 +342,386 @@ bool gstBufferManager::Enqueue( GstBuffer* gstBuffer, GstCaps* gstCaps )
 }
 
 
-// Dequeue
-int gstBufferManager::Dequeue( void** output, imageFormat format, uint64_t timeout, cudaStream_t stream )
+// enqueueFrame (with mConsumerMutex locked)
+bool gstBufferManager::enqueueFrame( GstBuffer* gstBuffer, const void* gstData, size_t gstSize, uint64_t timestamp, uint64_t pts )
 {
-	// wait until a new frame is recieved
-	if( !mWaitEvent.Wait(timeout) )
-		return 0;
+	// allocate the frame ringbuffer
+	if( mFramesYUV.GetNumBuffers() == 0 )
+	{
+		if( !mFramesYUV.Alloc(mOptions->numBuffers, sizeof(FrameYUV), &mFrameAllocator) )
+		{
+			LogError(LOG_GSTREAMER "gstBufferManager -- failed to allocate %u frame buffers\n", mOptions->numBuffers);
+			return false;
+		}
 
-	void* latestYUV = NULL;
-	
-#ifdef ENABLE_NVMM
-	if( mNvmmUsed )
+		for( uint32_t n=0; n < mFramesYUV.GetNumBuffers(); n++ )
+			memset(mFramesYUV.GetBuffer(n), 0, sizeof(FrameYUV));
+	}
+
+	FrameYUV* nextFrame = (FrameYUV*)mFramesYUV.Peek(RingBuffer::Write);
+
+	if( !nextFrame )
 	{
-		mNvmmMutex.Lock();
-		
-		const int nvmmFD = mNvmmFD;
-		const bool nvmmReleaseFD = mNvmmReleaseFD;
-		EGLImageKHR eglImage = (EGLImageKHR)mNvmmEGL;
-		
-		mNvmmFD = -1;
-		mNvmmEGL = NULL;
-		mNvmmReleaseFD = false;
-		
-		mNvmmMutex.Unlock();
-		
-		if( !eglImage )
-			return -1;
-		
-		// map EGLImage into CUDA array
-		cudaGraphicsResource* eglResource = NULL;
-		cudaEglFrame eglFrame;
-		
-		if( CUDA_FAILED(cudaGraphicsEGLRegisterImage(&eglResource, eglImage, cudaGraphicsRegisterFlagsReadOnly)) )
-			return -1;
-		
-		if( CUDA_FAILED(cudaGraphicsResourceGetMappedEglFrame(&eglFrame, eglResource, 0, 0)) )
-			return -1;
+		LogError(LOG_GSTREAMER "gstBufferManager -- failed to retrieve next frame ringbuffer for writing\n");
+		return false;
+	}
 
-		if( eglFrame.planeCount != 2 )
-			LogWarning(LOG_GSTREAMER "gstBufferManager -- unexpected number of planes in NVMM buffer (%u vs 2 expected)\n", eglFrame.planeCount);
+	// consumers could still be converting the frame that was previously in this slot
+	waitPinned(nextFrame);
 
-		if( eglFrame.planeDesc[0].width != mOptions->width || eglFrame.planeDesc[0].height != mOptions->height )
-		{
-			LogError(LOG_GSTREAMER "gstBufferManager -- NVMM EGLImage dimensions mismatch (%ux%u when expected %ux%u)", eglFrame.planeDesc[0].width, eglFrame.planeDesc[0].height, mOptions->width, mOptions->height);
-			return -1;
-		}
-		
-		if( eglFrame.frameType != cudaEglFrameTypeArray )  // cudaEglFrameTypePitch
+	// release the GstBuffer that was previously in this slot
+	releaseFrame(nextFrame);
+
+	nextFrame->timestamp = timestamp;
+	nextFrame->pts = pts;
+
+	// keep the buffer mapped if CUDA can access it, otherwise copy it
+	if( !retainBuffer(gstBuffer, nextFrame) )
+	{
+		// if the image ringbuffer gets reallocated, the frames that were copied into it are lost
+		if( mBufferYUV.GetBufferSize() != 0 && mBufferYUV.GetBufferSize() < gstSize )
 		{
-			LogError(LOG_GSTREAMER "gstBufferManager -- NVMM had unexpected frame type (was pitched pointer, expected CUDA array)\n");
-			return -1;
+			waitPinned(NULL);
+
+			for( uint32_t n=0; n < mFramesYUV.GetNumBuffers(); n++ )
+			{
+				FrameYUV* frameYUV = (FrameYUV*)mFramesYUV.GetBuffer(n);
+
+				if( !frameYUV->buffer )
+					frameYUV->image = NULL;
+			}
 		}
-		
-		// NV12 buffers have multiple planes (Y @ full res and UV @ half res)
-		const size_t maxPlanes = 16;
-		size_t planePitch[maxPlanes];
-		size_t planeSize[maxPlanes];
-		size_t sizeYUV = 0;
-		
-		for( uint32_t n=0; n < eglFrame.planeCount && n < maxPlanes; n++ )
+
+		// allocate image ringbuffer
+		if( !mBufferYUV.Alloc(mOptions->numBuffers, gstSize, RingBuffer::ZeroCopy) )
 		{
-			cudaChannelFormatDesc arrayDesc;
-			cudaExtent arrayExtent;
-			
-			CUDA(cudaArrayGetInfo(&arrayDesc, &arrayExtent, NULL, eglFrame.frame.pArray[n]));
-			
-			const size_t bpp = arrayDesc.x + arrayDesc.y + arrayDesc.z;
-			
-			planePitch[n] = (bpp * arrayExtent.width) / 8;
-			planeSize[n] = planePitch[n] * arrayExtent.height;
-			
-			sizeYUV += planeSize[n];
-			
-		#ifdef DEBUG
-			LogDebug(LOG_GSTREAMER "gstBufferManager -- plane=%u x=%i y=%i z=%i  w=%zu h=%zu d=%zu  pitch=%zu size=%zu\n", n, arrayDesc.x, arrayDesc.y, arrayDesc.z, arrayExtent.width, arrayExtent.height, arrayExtent.depth, planePitch[n], planeSize[n]);
-		#endif
+			LogError(LOG_GSTREAMER "gstBufferManager -- failed to allocate %u image buffers (%zu bytes each)\n", mOptions->numBuffers, gstSize);
+			return false;
 		}
 
-		// allocate CUDA memory for the image
-		if( !mNvmmCUDA || mNvmmSize != sizeYUV )
+		// copy to next image ringbuffer
+		void* nextBuffer = mBufferYUV.Next(RingBuffer::Write);
+
+		if( !nextBuffer )
 		{
-			CUDA_FREE(mNvmmCUDA);
-			
-			if( CUDA_FAILED(cudaMalloc(&mNvmmCUDA, sizeYUV)) )
-				return -1;
+			LogError(LOG_GSTREAMER "gstBufferManager -- failed to retrieve next image ringbuffer for writing\n");
+			return false;
 		}
+
+		memcpy(nextBuffer, gstData, gstSize);
+		nextFrame->image = nextBuffer;
+	}
+
+	mFramesYUV.Next(RingBuffer::Write);
+	return true;
+}
+
+
+// retainBuffer
+bool gstBufferManager::retainBuffer( GstBuffer* gstBuffer, FrameYUV* frame )
+{
+#if GST_CHECK_VERSION(1,0,0)
+	if( mOptions->retainBuffers == 0 || mRetainFailed )
+		return false;
+
+	// holding too many buffers would starve the upstream buffer pool, so copy the rest
+	if( mRetainedCount >= mOptions->retainBuffers )
+		return false;
+
+	// buffers with multiple memory blocks get merged into a temporary copy when they're mapped
+	if( gst_buffer_n_memory(gstBuffer) != 1 )
+		return false;
+
+	if( !gst_buffer_map(gstBuffer, &frame->map, GST_MAP_READ) )
+		return false;
+
+	void* image = registerMemory(frame->map.memory, frame->map.data, frame->map.maxsize);
+
+	if( !image )
+	{
+		gst_buffer_unmap(gstBuffer, &frame->map);
+		return false;
+	}
+
+	frame->buffer = gst_buffer_ref(gstBuffer);
+	frame->image  = image;
+
+	mRetainedCount++;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+// releaseFrame
+void gstBufferManager::releaseFrame( FrameYUV* frame )
+{
+	if( !frame )
+		return;
+
+#if GST_CHECK_VERSION(1,0,0)
+	if( frame->buffer != NULL )
+	{
+		gst_buffer_unmap(frame->buffer, &frame->map);
+		gst_buffer_unref(frame->buffer);
+		mRetainedCount--;
+	}
+#endif
+
+	frame->buffer = NULL;
+	frame->image  = NULL;
+}
+
+
+#if GST_CHECK_VERSION(1,0,0)
+// registerMemory
+void* gstBufferManager::registerMemory( GstMemory* memory, void* host, size_t size )
+{
+	uint8_t* device = NULL;
+
+	mRegisterMutex.Lock();
+
+	// upstream buffer pools recycle their memory, so it only gets registered the first time
+	for( size_t n=0; n < mRegistered.size(); n++ )
+	{
+		const RegisteredMemory& reg = mRegistered[n];
+
+		if( reg.memory != memory )
+			continue;
+
+		// the memory could have been resized since it was registered
+		if( (uint8_t*)host >= reg.host && (uint8_t*)host + size <= reg.host + reg.size )
+			device = reg.device + ((uint8_t*)host - reg.host);
+
+		mRegisterMutex.Unlock();
+		return device;
+	}
+
+	if( mRegistered.size() >= MaxRegistered )
+	{
+		mRegisterMutex.Unlock();
+		return NULL;
+	}
+
+	uint32_t flags = cudaHostRegisterMapped;
+
+#if CUDART_VERSION >= 11010
+	flags |= cudaHostRegisterReadOnly;	// the buffers are only read from, and may be mapped read-only
+#endif
+
+	if( cudaHostRegister(host, size, flags) != cudaSuccess )
+	{
+		cudaGetLastError();
+		mRetainFailed = true;
+		mRegisterMutex.Unlock();
+
+		LogWarning(LOG_GSTREAMER "gstBufferManager -- failed to register GstBuffer memory with CUDA, buffers will be copied\n");
+		return NULL;
+	}
+
+	if( CUDA_FAILED(cudaHostGetDevicePointer((void**)&device, host, 0)) )
+	{
+		cudaHostUnregister(host);
+		mRetainFailed = true;
+		mRegisterMutex.Unlock();
+		return NULL;
+	}
+
+	// get notified when the memory is freed, so it can be unregistered before then
+	gst_mini_object_weak_ref(GST_MINI_OBJECT(memory), onMemoryFreed, this);
+
+	const bool first = mRegistered.empty();
+	RegisteredMemory reg;
+
+	reg.memory = memory;
+	reg.host   = (uint8_t*)host;
+	reg.device = device;
+	reg.size   = size;
+
+	mRegistered.push_back(reg);
+	mRegisterMutex.Unlock();
+
+	if( first )
+		LogVerbose(LOG_GSTREAMER "gstBufferManager -- mapping GstBuffer memory into CUDA without copying (%s allocator)\n", memory->allocator != NULL ? memory->allocator->mem_type : "unknown");
+
+	return device;
+}
+
+
+// onMemoryFreed
+void gstBufferManager::onMemoryFreed( gpointer user, GstMiniObject* memory )
+{
+	gstBufferManager* mgr = (gstBufferManager*)user;
+
+	mgr->mRegisterMutex.Lock();
+
+	for( size_t n=0; n < mgr->mRegistered.size(); n++ )
+	{
+		if( mgr->mRegistered[n].memory != (GstMemory*)memory )
+			continue;
+
+		CUDA(cudaHostUnregister(mgr->mRegistered[n].host));
+		mgr->mRegistered.erase(mgr->mRegistered.begin() + n);
+		break;
+	}
+
+	mgr->mRegisterMutex.Unlock();
+}
+#endif
+
+
+#ifdef ENABLE_NVMM
+// mapNvmm (with mConsumerMutex locked)
+void* gstBufferManager::mapNvmm()
+{
+	// keep the frame that consumers are still converting
+	if( mNvmmPins > 0 )
+		return mNvmmCUDA;
+
+	mNvmmMutex.Lock();
+	
+	const int nvmmFD = mNvmmFD;
+	const bool nvmmReleaseFD = mNvmmReleaseFD;
+	const uint64_t nvmmSequence = mNvmmPending;
+	EGLImageKHR eglImage = (EGLImageKHR)mNvmmEGL;
+	
+	mNvmmFD = -1;
+	mNvmmEGL = NULL;
+	mNvmmReleaseFD = false;
+	
+	mNvmmMutex.Unlock();
+	
+	// if there isn't a new frame, keep the one that was already mapped
+	if( !eglImage )
+		return (mNvmmSequence > 0) ? mNvmmCUDA : NULL;
+	
+	// map EGLImage into CUDA array
+	cudaGraphicsResource* eglResource = NULL;
+	cudaEglFrame eglFrame;
+	
+	if( CUDA_FAILED(cudaGraphicsEGLRegisterImage(&eglResource, eglImage, cudaGraphicsRegisterFlagsReadOnly)) )
+		return NULL;
+	
+	if( CUDA_FAILED(cudaGraphicsResourceGetMappedEglFrame(&eglFrame, eglResource, 0, 0)) )
+		return NULL;
+
+	if( eglFrame.planeCount != 2 )
+		LogWarning(LOG_GSTREAMER "gstBufferManager -- unexpected number of planes in NVMM buffer (%u vs 2 expected)\n", eglFrame.planeCount);
+
+	if( eglFrame.planeDesc[0].width != mOptions->width || eglFrame.planeDesc[0].height != mOptions->height )
+	{
+		LogError(LOG_GSTREAMER "gstBufferManager -- NVMM EGLImage dimensions mismatch (%ux%u when expected %ux%u)", eglFrame.planeDesc[0].width, eglFrame.planeDesc[0].height, mOptions->width, mOptions->height);
+		return NULL;
+	}
+	
+	if( eglFrame.frameType != cudaEglFrameTypeArray )  // cudaEglFrameTypePitch
+	{
+		LogError(LOG_GSTREAMER "gstBufferManager -- NVMM had unexpected frame type (was pitched pointer, expected CUDA array)\n");
+		return NULL;
+	}
+	
+	// NV12 buffers have multiple planes (Y @ full res and UV @ half res)
+	const size_t maxPlanes = 16;
+	size_t planePitch[maxPlanes];
+	size_t planeSize[maxPlanes];
+	size_t sizeYUV = 0;
+	
+	for( uint32_t n=0; n < eglFrame.planeCount && n < maxPlanes; n++ )
+	{
+		cudaChannelFormatDesc arrayDesc;
+		cudaExtent arrayExtent;
 		
-		// copy arrays into linear memory (so our CUDA kernels can use it)
-		size_t planeOffset = 0;
+		CUDA(cudaArrayGetInfo(&arrayDesc, &arrayExtent, NULL, eglFrame.frame.pArray[n]));
 		
-		for( uint32_t n=0; n < eglFrame.planeCount && n < maxPlanes; n++ )
-		{
-			if( CUDA_FAILED(cudaMemcpy2DFromArrayAsync(((uint8_t*)mNvmmCUDA) + planeOffset, planePitch[n], eglFrame.frame.pArray[n], 0, 0, planePitch[n], eglFrame.planeDesc[n].height, cudaMemcpyDeviceToDevice)) )
-				return -1;
+		const size_t bpp = arrayDesc.x + arrayDesc.y + arrayDesc.z;
 		
-			planeOffset += planeSize[n];
-		}
-
-		latestYUV = mNvmmCUDA;
+		planePitch[n] = (bpp * arrayExtent.width) / 8;
+		planeSize[n] = planePitch[n] * arrayExtent.height;
 		
-		CUDA(cudaGraphicsUnregisterResource(eglResource));
-		NvDestroyEGLImage(NULL, eglImage);
+		sizeYUV += planeSize[n];
+		
+	#ifdef DEBUG
+		LogDebug(LOG_GSTREAMER "gstBufferManager -- plane=%u x=%i y=%i z=%i  w=%zu h=%zu d=%zu  pitch=%zu size=%zu\n", n, arrayDesc.x, arrayDesc.y, arrayDesc.z, arrayExtent.width, arrayExtent.height, arrayExtent.depth, planePitch[n], planeSize[n]);
+	#endif
+	}
+
+	// allocate CUDA memory for the image
+	if( !mNvmmCUDA || mNvmmSize != sizeYUV )
+	{
+		CUDA_FREE(mNvmmCUDA);
 		
-		if( nvmmReleaseFD )
-			NvReleaseFd(nvmmFD);
+		if( CUDA_FAILED(cudaMalloc(&mNvmmCUDA, sizeYUV)) )
+			return NULL;
+	}
+	
+	// copy arrays into linear memory (so our CUDA kernels can use it)
+	size_t planeOffset = 0;
+	
+	for( uint32_t n=0; n < eglFrame.planeCount && n < maxPlanes; n++ )
+	{
+		if( CUDA_FAILED(cudaMemcpy2DFromArrayAsync(((uint8_t*)mNvmmCUDA) + planeOffset, planePitch[n], eglFrame.frame.pArray[n], 0, 0, planePitch[n], eglFrame.planeDesc[n].height, cudaMemcpyDeviceToDevice)) )
+			return NULL;
+	
+		planeOffset += planeSize[n];
+	}
+
+	mNvmmSequence = nvmmSequence;
+	
+	CUDA(cudaGraphicsUnregisterResource(eglResource));
+	NvDestroyEGLImage(NULL, eglImage);
+	
+	if( nvmmReleaseFD )
+		NvReleaseFd(nvmmFD);
+
+	return mNvmmCUDA;
+}
+#endif
+
+
+// dequeue
+int gstBufferManager::dequeue( void** output, uint64_t* sequence, uint64_t timeout )
+{
+	// wait until a new frame is recieved
+	if( !mWaitEvent.Wait(timeout) )
+		return 0;
+
+	void* latestYUV = NULL;
+	uint64_t latestSequence = 0;
+	
+#ifdef ENABLE_NVMM
+	if( mNvmmUsed )
+	{
+		// the NVMM frame gets copied into mNvmmCUDA, which consumers also use
+		mConsumerMutex.Lock();
+		latestYUV = mapNvmm();
+		latestSequence = mNvmmSequence;
+		mConsumerMutex.Unlock();
 	}
 #endif
 
 	// handle the CPU path (non-NVMM)
 	if( !mNvmmUsed )
-		latestYUV = mBufferYUV.Next(RingBuffer::ReadLatestOnce);
+	{
+		FrameYUV* latestFrame = (FrameYUV*)mFramesYUV.Next(RingBuffer::ReadLatestOnce, &latestSequence);
+
+		if( latestFrame != NULL )
+			latestYUV = latestFrame->image;
+	}
 
 	if( !latestYUV )
 		return -1;
 
+	// count the frames that were skipped over to get to the latest one
+	if( mDequeueSequence > 0 && latestSequence > mDequeueSequence + 1 )
+		mDroppedCount += latestSequence - mDequeueSequence - 1;
+
+	if( latestSequence > 0 )
+		mDequeueSequence = latestSequence;
+
+	if( sequence != NULL )
+		*sequence = latestSequence;
+
 	// handle timestamp (both paths)
 	void* pLastTimestamp = NULL;
 	pLastTimestamp = mTimestamps.Next(RingBuffer::ReadLatestOnce);
@@ -417,12 +730,47 @@ int gstBufferManager::Dequeue( void** output, imageFormat format, uint64_t timeo
 	{
 		LogWarning(LOG_GSTREAMER "gstBufferManager -- failed to retrieve timestamp buffer (default to 0)\n");
 		mLastTimestamp = 0;
+		mLastPTS = 0;
 	}
 	else
 	{
-		mLastTimestamp = *((uint64_t*)pLastTimestamp);
+		mLastTimestamp = ((uint64_t*)pLastTimestamp)[0];
+		mLastPTS = ((uint64_t*)pLastTimestamp)[1];
+	}
+
+	*output = latestYUV;
+	return 1;
+}
+
+
+// convert
+bool gstBufferManager::convert( void* latestYUV, void* output, imageFormat format, cudaStream_t stream )
+{
+	if( CUDA_FAILED(cudaConvertColor(latestYUV, mFormatYUV, output, format, mOptions->width, mOptions->height, stream)) )
+	{
+		LogError(LOG_GSTREAMER "gstBufferManager -- unsupported image format (%s)\n", imageFormatToStr(format));
+		LogError(LOG_GSTREAMER "                    supported formats are:\n");
+		LogError(LOG_GSTREAMER "                       * rgb8\n");		
+		LogError(LOG_GSTREAMER "                       * rgba8\n");		
+		LogError(LOG_GSTREAMER "                       * rgb32f\n");		
+		LogError(LOG_GSTREAMER "                       * rgba32f\n");
+
+		return false;
 	}
 
+	return true;
+}
+
+
+// Dequeue
+int gstBufferManager::Dequeue( void** output, imageFormat format, uint64_t timeout, cudaStream_t stream )
+{
+	void* latestYUV = NULL;
+	const int result = dequeue(&latestYUV, NULL, timeout);
+
+	if( result <= 0 )
+		return result;
+
 	// output raw image if conversion format is unknown
 	if ( format == IMAGE_UNKNOWN )
 	{
@@ -442,19 +790,431 @@ int gstBufferManager::Dequeue( void** output, imageFormat format, uint64_t timeo
 	// perform colorspace conversion
 	void* nextRGB = mBufferRGB.Next(RingBuffer::Write);
 
-	if( CUDA_FAILED(cudaConvertColor(latestYUV, mFormatYUV, nextRGB, format, mOptions->width, mOptions->height, stream)) )
+	if( !convert(latestYUV, nextRGB, format, stream) )
+		return -1;
+
+	*output = nextRGB;
+	return 1;
+}
+
+
+// Dequeue
+int gstBufferManager::Dequeue( videoFrame* frame, imageFormat format, uint64_t timeout, cudaStream_t stream )
+{
+	if( !frame )
+		return -1;
+
+	if( !mDefaultConsumer )
+		mDefaultConsumer = Attach(ReadLatest);
+
+	const uint64_t dropped = mDefaultConsumer->GetDropped();
+	const int result = consume(mDefaultConsumer, frame, format, timeout, stream);
+
+	mDroppedCount += mDefaultConsumer->GetDropped() - dropped;
+
+	if( result > 0 )
 	{
-		LogError(LOG_GSTREAMER "gstBufferManager -- unsupported image format (%s)\n", imageFormatToStr(format));
-		LogError(LOG_GSTREAMER "                    supported formats are:\n");
-		LogError(LOG_GSTREAMER "                       * rgb8\n");		
-		LogError(LOG_GSTREAMER "                       * rgba8\n");		
-		LogError(LOG_GSTREAMER "                       * rgb32f\n");		
-		LogError(LOG_GSTREAMER "                       * rgba32f\n");
+		mLastTimestamp = frame->GetTimestamp();
+		mLastPTS = mDefaultConsumer->GetLastPTS();
+	}
+
+	return result;
+}
+
+
+// Attach
+gstBufferManager::Consumer* gstBufferManager::Attach( ConsumerPolicy policy )
+{
+	Consumer* consumer = new Consumer(this, policy);
+
+	mConsumerMutex.Lock();
+
+	// start with the latest frame (so it can be dequeued right away)
+	const uint64_t latest = mLatestSequence.load(std::memory_order_acquire);
+
+	if( latest > 0 )
+		consumer->mLastSequence = latest - 1;
 
+	mConsumers.push_back(consumer);
+	mConsumerMutex.Unlock();
+
+	return consumer;
+}
+
+
+// Detach
+void gstBufferManager::Detach( Consumer* consumer )
+{
+	if( !consumer )
+		return;
+
+	mConsumerMutex.Lock();
+
+	for( size_t n=0; n < mConsumers.size(); n++ )
+	{
+		if( mConsumers[n] == consumer )
+		{
+			mConsumers.erase(mConsumers.begin() + n);
+			break;
+		}
+	}
+
+	if( mDefaultConsumer == consumer )
+		mDefaultConsumer = NULL;
+
+	evictFrames();
+	mConsumerMutex.Unlock();
+
+	delete consumer;
+}
+
+
+// consume
+int gstBufferManager::consume( Consumer* consumer, videoFrame* frame, imageFormat format, uint64_t timeout, cudaStream_t stream )
+{
+	if( !consumer || !frame )
 		return -1;
+
+	// wait until there's a frame that this consumer hasn't read yet
+	const bool infinite = (timeout == UINT64_MAX);
+	const timespec deadline = infinite ? timeZero() : timeAdd(timeMonotonic(), timeNew(timeout*1000*1000));
+
+	while( true )
+	{
+		const uint32_t signal = mFrameSignal.load(std::memory_order_acquire);
+
+		if( mLatestSequence.load(std::memory_order_acquire) > consumer->mLastSequence )
+			break;
+
+		if( !infinite && timeCmp(timeMonotonic(), deadline) >= 0 )
+			return 0;
+
+		Event::futexWait(&mFrameSignal, signal, infinite ? NULL : &deadline);
 	}
 
-	*output = nextRGB;
-	return 1;
+	mConsumerMutex.Lock();
+
+	const imageFormat outputFormat = (format == IMAGE_UNKNOWN) ? mFormatYUV : format;
+	uint64_t sequence = 0;
+	size_t cached = 0;
+
+	while( true )
+	{
+		// pick the frame according to the consumer's policy
+		const uint64_t latest = mLatestSequence.load(std::memory_order_acquire);
+		sequence = latest;
+
+	#ifdef ENABLE_NVMM
+		if( mNvmmUsed )
+		{
+			// the new frame can't be mapped until the other consumers are done with the old one
+			while( mNvmmPins > 0 && mNvmmSequence <= consumer->mLastSequence )
+				waitUnpinned();
+
+			if( mapNvmm() != NULL )
+				sequence = mNvmmSequence;	// only the latest NVMM frame is kept
+		}
+	#endif
+
+		if( consumer->mPolicy == ReadAll && !mNvmmUsed && consumer->mLastSequence + 1 < latest )
+		{
+			const uint32_t numFrames = mFramesYUV.GetNumBuffers();
+			const uint64_t written = mFramesYUV.GetWriteSequence();	// can be ahead of mLatestSequence
+
+			sequence = consumer->mLastSequence + 1;
+
+			if( sequence + numFrames <= written )
+				sequence = written - numFrames + 1;	// the older frames were already overwritten
+		}
+
+		if( sequence <= consumer->mLastSequence )
+		{
+			mConsumerMutex.Unlock();
+			return -1;
+		}
+
+		// share the conversion if another consumer already did it, or wait for the one that's
+		// in progress (and then pick again, because the frame could be overwritten meanwhile)
+		cached = findConverted(sequence, outputFormat);
+
+		if( cached >= mConverted.size() || !mConverted[cached].converting )
+			break;
+
+		waitUnpinned();
+	}
+
+	if( consumer->mLastSequence > 0 && sequence > consumer->mLastSequence + 1 )
+		consumer->mDropped += sequence - consumer->mLastSequence - 1;
+
+	consumer->mLastSequence = sequence;
+
+	if( cached < mConverted.size() && mConverted[cached].synchronized )
+	{
+		*frame = mConverted[cached].frame;
+		consumer->mLastPTS = mConverted[cached].pts;
+		evictFrames();
+		mConsumerMutex.Unlock();
+		return 1;
+	}
+
+	// pin the YUV frame so it doesn't get replaced while it's converted without the lock
+	uint64_t timestamp = 0;
+	uint64_t pts = 0;
+	void* imageYUV = pinFrame(sequence, &timestamp, &pts);
+
+	if( !imageYUV )
+	{
+		LogError(LOG_GSTREAMER "gstBufferManager -- frame %" PRIu64 " is no longer available\n", sequence);
+		mConsumerMutex.Unlock();
+		return -1;
+	}
+
+	if( !acquireFrame(frame, outputFormat, timestamp, sequence) )
+	{
+		unpinFrame(sequence);
+		mConsumerMutex.Unlock();
+		return -1;
+	}
+
+	consumer->mLastPTS = pts;
+
+	// other consumers that want the same conversion wait for this one
+	if( cached == mConverted.size() )
+	{
+		ConvertedFrame converted;
+
+		converted.sequence = sequence;
+		converted.format = outputFormat;
+		converted.pts = pts;
+		converted.synchronized = false;
+
+		mConverted.push_back(converted);
+	}
+
+	mConverted[cached].converting = true;
+
+	// other consumers could use the frame from different streams, so let the conversion finish
+	const bool shared = (mConsumers.size() > 1);
+
+	mConsumerMutex.Unlock();
+
+	bool converted = convertFrame(imageYUV, frame, format, stream);
+
+	if( converted && shared && CUDA_FAILED(cudaStreamSynchronize(stream)) )
+		converted = false;
+
+	if( !converted )
+		frame->Release();
+
+	mConsumerMutex.Lock();
+
+	unpinFrame(sequence);
+
+	// the entry could have been evicted while the lock was released
+	cached = findConverted(sequence, outputFormat);
+
+	if( cached < mConverted.size() )
+	{
+		if( converted )
+		{
+			mConverted[cached].frame = *frame;
+			mConverted[cached].synchronized = shared;
+			mConverted[cached].converting = false;
+		}
+		else
+		{
+			mConverted.erase(mConverted.begin() + cached);
+		}
+	}
+
+	evictFrames();
+	mConsumerMutex.Unlock();
+
+	return converted ? 1 : -1;
+}
+
+
+// acquireFrame (with mConsumerMutex locked)
+bool gstBufferManager::acquireFrame( videoFrame* frame, imageFormat format, uint64_t timestamp, uint64_t sequence )
+{
+	const size_t outputSize = imageFormatSize(format, mOptions->width, mOptions->height);
+
+	// allocate the pool (frames from a previous pool stay valid until they're released)
+	if( !mFramePool || mFramePool->GetBufferSize() < outputSize )
+	{
+		if( mFramePool != NULL )
+			mFramePool->Release();
+
+		// there's room for the conversions that are shared in multiple formats
+		mFramePool = videoFramePool::Create(mOptions->numBuffers, outputSize, mOptions->zeroCopy, mOptions->numBuffers * 4, mSourceID);
+
+		if( !mFramePool )
+		{
+			LogError(LOG_GSTREAMER "gstBufferManager -- failed to allocate %u frames (%zu bytes each)\n", mOptions->numBuffers, outputSize);
+			return false;
+		}
+	}
+
+	return mFramePool->Acquire(frame, mOptions->width, mOptions->height, format, timestamp, sequence);
+}
+
+
+// convertFrame (without mConsumerMutex locked, the YUV frame is pinned)
+bool gstBufferManager::convertFrame( void* imageYUV, videoFrame* frame, imageFormat format, cudaStream_t stream )
+{
+	// the raw image gets copied out of the ringbuffer if conversion format is unknown
+	if( format == IMAGE_UNKNOWN )
+		return CUDA_SUCCESS(cudaMemcpyAsync(frame->GetImage(), imageYUV, imageFormatSize(mFormatYUV, mOptions->width, mOptions->height), cudaMemcpyDeviceToDevice, stream));
+
+	return convert(imageYUV, frame->GetImage(), format, stream);
+}
+
+
+// pinFrame (with mConsumerMutex locked)
+void* gstBufferManager::pinFrame( uint64_t sequence, uint64_t* timestamp, uint64_t* pts )
+{
+#ifdef ENABLE_NVMM
+	if( mNvmmUsed )
+	{
+		if( sequence != mNvmmSequence )
+			return NULL;
+
+		const uint64_t* latestTimestamp = (uint64_t*)mTimestamps.Peek(RingBuffer::ReadLatest);
+
+		*timestamp = (latestTimestamp != NULL) ? latestTimestamp[0] : 0;
+		*pts = (latestTimestamp != NULL) ? latestTimestamp[1] : 0;
+		mNvmmPins++;
+
+		return mNvmmCUDA;
+	}
+#endif
+
+	// the frames are indexed by sequence number, and don't get replaced while they're pinned
+	const uint32_t numFrames = mFramesYUV.GetNumBuffers();
+	const uint64_t latest = mFramesYUV.GetWriteSequence();
+
+	if( numFrames == 0 || sequence == 0 || sequence > latest || sequence + numFrames <= latest )
+		return NULL;
+
+	FrameYUV* frameYUV = (FrameYUV*)mFramesYUV.GetBuffer(sequence % numFrames);
+
+	if( !frameYUV->image )
+		return NULL;
+
+	*timestamp = frameYUV->timestamp;
+	*pts = frameYUV->pts;
+	frameYUV->pins++;
+
+	return frameYUV->image;
+}
+
+
+// unpinFrame (with mConsumerMutex locked)
+void gstBufferManager::unpinFrame( uint64_t sequence )
+{
+#ifdef ENABLE_NVMM
+	if( mNvmmUsed )
+		mNvmmPins--;
+#endif
+
+	if( !mNvmmUsed )
+		((FrameYUV*)mFramesYUV.GetBuffer(sequence % mFramesYUV.GetNumBuffers()))->pins--;
+
+	// wake up Enqueue() and the consumers that are waiting on the frame
+	mUnpinSignal.fetch_add(1, std::memory_order_release);
+	Event::futexWake(&mUnpinSignal, INT_MAX);
+}
+
+
+// waitPinned (with mConsumerMutex locked)
+void gstBufferManager::waitPinned( const FrameYUV* frame )
+{
+	while( true )
+	{
+		uint32_t pins = 0;
+
+		if( frame != NULL )
+			pins = frame->pins;
+		else
+		{
+			for( uint32_t n=0; n < mFramesYUV.GetNumBuffers(); n++ )
+				pins += ((FrameYUV*)mFramesYUV.GetBuffer(n))->pins;
+		}
+
+		if( pins == 0 )
+			return;
+
+		waitUnpinned();
+	}
+}
+
+
+// waitUnpinned (with mConsumerMutex locked, which gets released while waiting)
+void gstBufferManager::waitUnpinned()
+{
+	const uint32_t signal = mUnpinSignal.load(std::memory_order_acquire);
+
+	mConsumerMutex.Unlock();
+	Event::futexWait(&mUnpinSignal, signal, NULL);
+	mConsumerMutex.Lock();
+}
+
+
+// findConverted (with mConsumerMutex locked)
+size_t gstBufferManager::findConverted( uint64_t sequence, imageFormat format ) const
+{
+	size_t n = 0;
+
+	while( n < mConverted.size() && (mConverted[n].sequence != sequence || mConverted[n].format != format) )
+		n++;
+
+	return n;
+}
+
+
+// evictFrames (with mConsumerMutex locked)
+void gstBufferManager::evictFrames()
+{
+	const uint64_t latest = mLatestSequence.load(std::memory_order_acquire);
+	const uint32_t numFrames = mFramesYUV.GetNumBuffers();
+
+	// find the oldest frame that a consumer could still dequeue
+	uint64_t oldest = latest;
+
+	for( size_t n=0; n < mConsumers.size(); n++ )
+	{
+		if( mConsumers[n]->mPolicy == ReadAll && mConsumers[n]->mLastSequence + 1 < oldest )
+			oldest = mConsumers[n]->mLastSequence + 1;
+	}
+
+	if( oldest + numFrames <= latest )
+		oldest = latest - numFrames + 1;
+
+	// release the conversions that won't be shared anymore
+	for( size_t n=0; n < mConverted.size(); )
+	{
+		if( mConverted[n].sequence < oldest )
+			mConverted.erase(mConverted.begin() + n);
+		else
+			n++;
+	}
+}
+
+
+// Consumer constructor
+gstBufferManager::Consumer::Consumer( gstBufferManager* manager, ConsumerPolicy policy )
+{
+	mManager      = manager;
+	mPolicy       = policy;
+	mLastSequence = 0;
+	mLastPTS      = 0;
+	mDropped      = 0;
+}
+
+
+// Consumer::Dequeue
+int gstBufferManager::Consumer::Dequeue( videoFrame* frame, imageFormat format, uint64_t timeout, cudaStream_t stream )
+{
+	return mManager->consume(this, frame, format, timeout, stream);
 }
 
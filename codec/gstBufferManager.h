@@ -26,10 +26,13 @@
 #include "gstUtility.h"
 #include "imageFormat.h"
 #include "videoOptions.h"
+#include "videoFrame.h"
 #include "Event.h"
 #include "Mutex.h"
 #include "RingBuffer.h"
 
+#include <vector>
+
 
 #ifdef ENABLE_NVMM
 #if !GST_CHECK_VERSION(1,0,0)
@@ -52,6 +55,17 @@
  * It can handle both normal CPU-based GStreamer buffers and NVMM memory which can
  * be mapped directly to the GPU without requiring memory copies using the CPU.
  *
+ * When videoOptions::retainBuffers is set, up to that many CPU-based buffers are also kept
+ * mapped in the ringbuffer (holding a reference to the GstBuffer until its slot gets reused)
+ * instead of being copied.  Their memory gets registered with CUDA the first time it's seen,
+ * so it stays registered as upstream buffer pools recycle it.  Beyond that limit, or if the 
+ * memory can't be registered (or the buffer is split into multiple memory blocks), the 
+ * buffers get copied instead.  Retention is disabled by default, because the upstream
+ * element can't reuse the buffers while they're held.
+ *
+ * Multiple consumers can read the frames independently with Attach(), and conversions of
+ * the same frame to the same format are shared between them (see gstBufferManager::Consumer).
+ *
  * To disable the use of NVMM memory, set -DENABLE_NVMM=OFF when building with CMake:
  *
  *     cmake -DENABLE_NVMM=OFF ../
@@ -61,10 +75,70 @@
 class gstBufferManager
 {
 public:
+	/**
+	 * How a Consumer reads the frames (see Attach()).
+	 */
+	enum ConsumerPolicy
+	{
+		ReadLatest = 0,	/**< Get the latest frame, skipping any that weren't read since the last one. */
+		ReadAll    = 1	/**< Get every frame in order, skipping ahead if the oldest unread frame was already overwritten. */
+	};
+
+	/**
+	 * Handle to one of several consumers of the frames, which is returned by Attach().
+	 *
+	 * Each consumer keeps track of which frames it read, so consumers don't affect each other.
+	 * When multiple consumers dequeue the same frame in the same format, the conversion only 
+	 * happens once and they share the reference-counted videoFrame.  Frames that are shared 
+	 * are synchronized before being returned, so they can be used from any CUDA stream.
+	 *
+	 * With NVMM memory only the latest frame is kept, so ReadAll behaves like ReadLatest.
+	 */
+	class Consumer
+	{
+	public:
+		/**
+		 * Dequeue the next frame for this consumer.  Returns 1 on success, 0 on timeout, -1 on error.
+		 */
+		int Dequeue( videoFrame* frame, imageFormat format, uint64_t timeout=UINT64_MAX, cudaStream_t stream=0 );
+
+		/**
+		 * Get the policy that the consumer reads frames with.
+		 */
+		inline ConsumerPolicy GetPolicy() const		{ return mPolicy; }
+
+		/**
+		 * Get the sequence number of the last frame that this consumer dequeued.
+		 */
+		inline uint64_t GetLastSequence() const		{ return mLastSequence; }
+
+		/**
+		 * Get the presentation timestamp (PTS) of the last frame that this consumer dequeued.
+		 */
+		inline uint64_t GetLastPTS() const			{ return mLastPTS; }
+
+		/**
+		 * Get the number of frames that this consumer skipped.
+		 */
+		inline uint64_t GetDropped() const			{ return mDropped; }
+
+	protected:
+		friend class gstBufferManager;
+
+		Consumer( gstBufferManager* manager, ConsumerPolicy policy );
+
+		gstBufferManager* mManager;
+		ConsumerPolicy    mPolicy;
+		uint64_t          mLastSequence;
+		uint64_t          mLastPTS;
+		uint64_t          mDropped;
+	};
+
 	/**
 	 * Constructor
+	 * @param sourceID the ID of the videoSource, which gets recorded in each videoFrame.
 	 */
-	gstBufferManager( videoOptions* options );
+	gstBufferManager( videoOptions* options, uint32_t sourceID=0 );
 	
 	/**
 	 * Destructor
@@ -73,19 +147,47 @@ public:
 	
 	/**
 	 * Enqueue a GstBuffer from GStreamer.
+	 * @param timestamp the time the frame was captured, in the `CLOCK_MONOTONIC` nanoseconds
+	 *                  of timeNs() (see gst_pts_to_monotonic()).  If 0, the current time is used.
 	 */
-	bool Enqueue( GstBuffer* buffer, GstCaps* caps );
+	bool Enqueue( GstBuffer* buffer, GstCaps* caps, uint64_t timestamp=0 );
 	
 	/**
 	 * Dequeue the next frame.  Returns 1 on success, 0 on timeout, -1 on error.
 	 */
 	int Dequeue( void** output, imageFormat format, uint64_t timeout=UINT64_MAX, cudaStream_t stream=0 );
 
+	/**
+	 * Dequeue the next frame into a reference-counted videoFrame, whose buffer won't be
+	 * reused until the application releases it.  Returns 1 on success, 0 on timeout, -1 on error.
+	 */
+	int Dequeue( videoFrame* frame, imageFormat format, uint64_t timeout=UINT64_MAX, cudaStream_t stream=0 );
+
+	/**
+	 * Attach a new consumer of the frames, which dequeues them independently from the others.
+	 * Dequeue(videoFrame*) also uses its own consumer, so it shares conversions with them.
+	 * The consumer remains valid until it's detached or the gstBufferManager is deleted.
+	 */
+	Consumer* Attach( ConsumerPolicy policy=ReadLatest );
+
+	/**
+	 * Detach a consumer and free it.
+	 */
+	void Detach( Consumer* consumer );
+
 	/**
 	 * Get timestamp of the latest dequeued frame.
 	 */
 	uint64_t GetLastTimestamp() const { return mLastTimestamp; }
 
+	/**
+	 * Get the presentation timestamp (PTS) of the latest dequeued frame, in nanoseconds.
+	 * This is the stream time from the GstBuffer (i.e. the position in a video file),
+	 * as opposed to GetLastTimestamp() which is in `CLOCK_MONOTONIC` time.  It's 0 if
+	 * the buffer had no valid PTS/DTS.
+	 */
+	uint64_t GetLastPTS() const { return mLastPTS; }
+
 	/**
 	 * Get raw image format.
   	 */
@@ -95,21 +197,120 @@ public:
 	 * Get the total number of frames that have been recieved.
 	 */
 	inline uint64_t GetFrameCount() const	{ return mFrameCount; }
+
+	/**
+	 * Get the number of frames that Dequeue() skipped over because a newer frame had already been recieved.
+	 */
+	inline uint64_t GetDroppedCount() const	{ return mDroppedCount; }
 	
 protected:
 
+	/**
+	 * A YUV frame in the mFramesYUV ringbuffer, which either references a GstBuffer
+	 * that's kept mapped until the slot gets reused, or a copy of it in mBufferYUV.
+	 */
+	struct FrameYUV
+	{
+		void*      image;	/**< CUDA pointer to the YUV image */
+		uint64_t   timestamp;	/**< Timestamp of the frame */
+		uint64_t   pts;		/**< Presentation timestamp of the GstBuffer (or 0 if it was invalid) */
+		GstBuffer* buffer;	/**< The retained GstBuffer (or NULL if it was copied) */
+		uint32_t   pins;	/**< Number of consumers converting it (the slot can't be reused until it's zero) */
+	#if GST_CHECK_VERSION(1,0,0)
+		GstMapInfo map;	/**< Mapping of the retained GstBuffer */
+	#endif
+	};
+
+#if GST_CHECK_VERSION(1,0,0)
+	/**
+	 * GstMemory that's been registered with CUDA by registerMemory().
+	 */
+	struct RegisteredMemory
+	{
+		GstMemory* memory;	/**< The memory object (which is weakly referenced) */
+		uint8_t*   host;	/**< The CPU address that was registered */
+		uint8_t*   device;	/**< The CUDA address that it's mapped to */
+		size_t     size;	/**< The number of bytes that were registered */
+	};
+#endif
+
+	/**
+	 * A frame that was converted for a consumer, which can be shared with the others.
+	 */
+	struct ConvertedFrame
+	{
+		uint64_t    sequence;		/**< Sequence number of the frame */
+		imageFormat format;		/**< Format that it was converted to */
+		uint64_t    pts;		/**< Presentation timestamp of the frame */
+		videoFrame  frame;		/**< Reference to the converted frame */
+		bool        synchronized;	/**< True if the conversion finished before it was cached */
+		bool        converting;	/**< True while a consumer is converting it (without mConsumerMutex locked) */
+	};
+
+	int   dequeue( void** output, uint64_t* sequence, uint64_t timeout );
+	int   consume( Consumer* consumer, videoFrame* frame, imageFormat format, uint64_t timeout, cudaStream_t stream );
+	bool  convert( void* latestYUV, void* output, imageFormat format, cudaStream_t stream );
+	bool  acquireFrame( videoFrame* frame, imageFormat format, uint64_t timestamp, uint64_t sequence );
+	bool  convertFrame( void* imageYUV, videoFrame* frame, imageFormat format, cudaStream_t stream );
+	void* pinFrame( uint64_t sequence, uint64_t* timestamp, uint64_t* pts );
+	void  unpinFrame( uint64_t sequence );
+	void  waitPinned( const FrameYUV* frame );
+	void  waitUnpinned();
+	size_t findConverted( uint64_t sequence, imageFormat format ) const;
+	void  evictFrames();
+	bool  enqueueFrame( GstBuffer* buffer, const void* data, size_t size, uint64_t timestamp, uint64_t pts );
+
+#ifdef ENABLE_NVMM
+	void* mapNvmm();
+#endif
+
+	bool  retainBuffer( GstBuffer* buffer, FrameYUV* frame );
+	void  releaseFrame( FrameYUV* frame );
+
+#if GST_CHECK_VERSION(1,0,0)
+	void* registerMemory( GstMemory* memory, void* host, size_t size );
+	static void onMemoryFreed( gpointer user, GstMiniObject* memory );
+#endif
+
+	static const size_t MaxRegistered = 64;	/**< Limit on the number of GstMemory objects that get registered */
+
 	imageFormat   mFormatYUV;  /**< The YUV colorspace format coming from appsink (typically NV12 or YUY2) */
-	RingBuffer    mBufferYUV;  /**< Ringbuffer of CPU-based YUV frames (non-NVMM) that come from appsink */
-	RingBuffer    mTimestamps; /**< Ringbuffer of timestamps that come from appsink */
+	HostAllocator mFrameAllocator; /**< Allocator of the mFramesYUV descriptors (needs to outlive them) */
+	RingBuffer    mFramesYUV;  /**< Ringbuffer of the CPU-based YUV frames (non-NVMM) that come from appsink */
+	RingBuffer    mBufferYUV;  /**< Ringbuffer of copied YUV frames (when they can't be retained) */
+	RingBuffer    mTimestamps; /**< Ringbuffer of the timestamps and PTS that come from appsink */
 	RingBuffer    mBufferRGB;  /**< Ringbuffer of frames that have been converted to RGB colorspace */
+	videoFramePool* mFramePool; /**< Pool of frames that are handed out to consumers */
+	uint32_t      mSourceID;   /**< ID of the videoSource that's recorded in each videoFrame */
 	uint64_t      mLastTimestamp;  /**< Timestamp of the latest dequeued frame */
+	uint64_t      mLastPTS;    /**< Presentation timestamp of the latest dequeued frame */
 	Event	      mWaitEvent;  /**< Event that gets triggered when a new frame is recieved */
+
+	std::vector<Consumer*> mConsumers;  /**< Consumers that were attached (including mDefaultConsumer) */
+	std::vector<ConvertedFrame> mConverted;  /**< Conversions that are shared between consumers */
+	Consumer*     mDefaultConsumer;  /**< Consumer that's used by Dequeue(videoFrame*) */
+	Mutex         mConsumerMutex;  /**< Protects the consumers, conversions, and reuse of YUV frames */
+	std::atomic<uint64_t> mLatestSequence;  /**< Sequence number of the latest frame that was enqueued */
+	std::atomic<uint32_t> mFrameSignal;  /**< Futex word that consumers wait on for new frames */
+	std::atomic<uint32_t> mUnpinSignal;  /**< Futex word that gets signalled when frames are unpinned or conversions finish */
 	
 	videoOptions* mOptions;    /**< Options of the gstDecoder / gstCamera object */			
 	uint64_t	  mFrameCount; /**< Total number of frames that have been recieved */
+	uint64_t      mDroppedCount;  /**< Number of frames that Dequeue() skipped over */
+	uint64_t      mDequeueSequence;  /**< Sequence number of the latest frame from dequeue() */
 	bool 	      mNvmmUsed;   /**< Is NVMM memory actually used by the stream? */
+	bool          mRetainFailed;  /**< Set if registering memory failed, and buffers should be copied */
+	uint32_t      mRetainedCount; /**< Number of GstBuffers that are currently retained in mFramesYUV */
+
+#if GST_CHECK_VERSION(1,0,0)
+	std::vector<RegisteredMemory> mRegistered;  /**< GstMemory objects that are registered with CUDA */
+	Mutex         mRegisterMutex;  /**< Protects mRegistered (memory can be freed from any thread) */
+#endif
 	
 #ifdef ENABLE_NVMM
+	uint64_t mNvmmSequence;  /**< Sequence number of the frame in mNvmmCUDA */
+	uint64_t mNvmmPending;   /**< Sequence number of the frame in mNvmmEGL */
+	uint32_t mNvmmPins;      /**< Number of consumers converting mNvmmCUDA (it doesn't get remapped until it's zero) */
 	Mutex  mNvmmMutex;
 	int    mNvmmFD;
 	void*  mNvmmEGL;
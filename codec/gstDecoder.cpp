@@ -101,7 +101,7 @@ gstDecoder::gstDecoder( const videoOptions& options ) : videoSource(options)
 	mEOS        = false;
 	mLoopCount  = 1;
 	
-	mBufferManager = new gstBufferManager(&mOptions);
+	mBufferManager = new gstBufferManager(&mOptions, mSourceID);
 	
 	mWebRTCServer = NULL;
 	mWebRTCConnected = false;
@@ -858,10 +858,21 @@ void gstDecoder::checkBuffer()
 	const uint32_t width = mOptions.width;
 	const uint32_t height = mOptions.height;
 	
+	// timestamp network streams with when the frame was received (files use the time it was decoded)
+	uint64_t timestamp = 0;
+
+#if GST_CHECK_VERSION(1,0,0)
+	if( mOptions.resource.protocol != "file" )
+		timestamp = gst_pts_to_monotonic(mPipeline, gstBuffer, gst_sample_get_segment(gstSample));
+#endif
+
 	// enqueue the buffer for color conversion
-	if( !mBufferManager->Enqueue(gstBuffer, gstCaps) )
+	recordReceived();
+
+	if( !mBufferManager->Enqueue(gstBuffer, gstCaps, timestamp) )
 	{
 		LogError(LOG_GSTREAMER "gstDecoder -- failed to handle incoming buffer\n");
+		recordDropped(DROP_FAILED);
 		release_return;
 	}
 	
@@ -891,14 +902,32 @@ void gstDecoder::checkBuffer()
 // Capture
 bool gstDecoder::Capture( void** output, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
 {
-	// update the webrtc server if needed
-	if( mWebRTCServer != NULL && !mWebRTCServer->IsThreaded() )
-		mWebRTCServer->ProcessRequests();
-	
 	// verify the output pointer exists
 	if( !output )
 		RETURN_STATUS(ERROR);
 
+	return capture(output, NULL, format, timeout, status, stream);
+}
+
+
+// Capture
+bool gstDecoder::Capture( videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
+{
+	// verify the output frame exists
+	if( !frame )
+		RETURN_STATUS(ERROR);
+
+	return capture(NULL, frame, format, timeout, status, stream);
+}
+
+
+// capture
+bool gstDecoder::capture( void** output, videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
+{
+	// update the webrtc server if needed
+	if( mWebRTCServer != NULL && !mWebRTCServer->IsThreaded() )
+		mWebRTCServer->ProcessRequests();
+
 	// confirm the stream is open
 	if( !mStreaming || mEOS )
 	{
@@ -907,21 +936,30 @@ bool gstDecoder::Capture( void** output, imageFormat format, uint64_t timeout, i
 	}
 
 	// wait until a new frame is recieved
-	const int result = mBufferManager->Dequeue(output, format, timeout, stream);
+	const uint64_t dropped = mBufferManager->GetDroppedCount();
+	const int result = (frame != NULL) ? mBufferManager->Dequeue(frame, format, timeout, stream)
+								: mBufferManager->Dequeue(output, format, timeout, stream);
 	
+	recordDropped(DROP_SKIPPED, mBufferManager->GetDroppedCount() - dropped);
+
 	if( result < 0 )
 	{
 		LogError(LOG_GSTREAMER "gstDecoder::Capture() -- an error occurred retrieving the next image buffer\n");
+		recordCapture(ERROR);
 		RETURN_STATUS(ERROR);
 	}
 	else if( result == 0 )
 	{
 		LogWarning(LOG_GSTREAMER "gstDecoder::Capture() -- a timeout occurred waiting for the next image buffer\n");
+		recordCapture(TIMEOUT);
 		RETURN_STATUS(TIMEOUT);
 	}
 		
 	mLastTimestamp = mBufferManager->GetLastTimestamp();
+	mLastPTS = mBufferManager->GetLastPTS();
 	mRawFormat = mBufferManager->GetRawFormat();
+
+	recordCapture(OK, mLastTimestamp);
 	
 	RETURN_STATUS(OK);
 }
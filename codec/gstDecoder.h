@@ -73,6 +73,12 @@ public:
 	 */
 	virtual bool Capture( void** image, imageFormat format, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
 
+	/**
+	 * Capture the next decoded frame into a reference-counted videoFrame.
+	 * @see videoSource::Capture()
+	 */
+	virtual bool Capture( videoFrame* frame, imageFormat format=IMAGE_RGB8, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
+
 	/**
 	 * Open the stream.
 	 * @see videoSource::Open()
@@ -94,6 +100,20 @@ public:
 	 */
 	inline bool IsEOS() const				{ return mEOS; }
 
+	/**
+	 * Attach another consumer of the frames, which dequeues them independently of Capture()
+	 * with its own policy (for example, from a different thread).  Conversions of the same
+	 * frame to the same format are shared with the other consumers and with Capture(videoFrame*).
+	 * The stream should be opened first, and the consumer gets freed with Detach().
+	 * @see gstBufferManager::Consumer
+	 */
+	inline gstBufferManager::Consumer* Attach( gstBufferManager::ConsumerPolicy policy=gstBufferManager::ReadLatest )	{ return mBufferManager->Attach(policy); }
+
+	/**
+	 * Detach a consumer that was returned by Attach().
+	 */
+	inline void Detach( gstBufferManager::Consumer* consumer )	{ mBufferManager->Detach(consumer); }
+
 	/**
 	 * Return the interface type (gstDecoder::Type)
 	 */
@@ -135,6 +155,8 @@ protected:
 	bool init();
 	bool initPipeline();
 	void destroyPipeline();
+
+	bool capture( void** image, videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream );
 	
 	inline bool isLooping() const { return (mOptions.loop < 0) || ((mOptions.loop > 0) && (mLoopCount < mOptions.loop)); }
 
@@ -37,6 +37,7 @@
 #include <gst/app/gstappsrc.h>
 
 #include <sstream>
+#include <inttypes.h>
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
@@ -79,6 +80,7 @@ gstEncoder::gstEncoder( const videoOptions& options ) : videoOutput(options)
 	mRTSPServer   = NULL;
 	mWebRTCServer = NULL;
 	mNeedData     = false;
+	mFramePool    = NULL;
 
 	mBufferYUV.SetThreaded(false);
 }
@@ -102,6 +104,13 @@ gstEncoder::~gstEncoder()
 	}
 	
 	destroyPipeline();
+
+	// the pool gets freed after gstreamer releases the buffers that wrap its frames
+	if( mFramePool != NULL )
+	{
+		mFramePool->Release();
+		mFramePool = NULL;
+	}
 }
 
 
@@ -498,8 +507,16 @@ void gstEncoder::onEnoughData( GstElement* pipeline, gpointer user_data )
 }
 
 
+// onBufferReleased
+void gstEncoder::onBufferReleased( void* user_data )
+{
+	// return the frame to the pool once gstreamer is done with the buffer that wraps it
+	delete (videoFrame*)user_data;
+}
+
+
 // encodeYUV
-bool gstEncoder::encodeYUV( void* buffer, size_t size )
+bool gstEncoder::encodeYUV( void* buffer, size_t size, videoFrame* frame )
 {
 	if( !buffer || size == 0 )
 		return false;
@@ -516,7 +533,7 @@ bool gstEncoder::encodeYUV( void* buffer, size_t size )
 	/*if( !mNeedData )
 	{
 		if( mOptions.frameCount % 25 == 0 )
-			LogVerbose(LOG_GSTREAMER "gstEncoder -- pipeline full, skipping frame %zu (%ux%u, %zu bytes)\n", mOptions.frameCount, mOptions.width, mOptions.height, size);
+			LogVerbose(LOG_GSTREAMER "gstEncoder -- pipeline full, skipping frame %" PRIu64 " (%ux%u, %zu bytes)\n", mOptions.frameCount, mOptions.width, mOptions.height, size);
 		
 		return true;
 	}*/
@@ -545,29 +562,46 @@ bool gstEncoder::encodeYUV( void* buffer, size_t size )
 	}
 
 #if GST_CHECK_VERSION(1,0,0)
-	// allocate gstreamer buffer memory
-	GstBuffer* gstBuffer = gst_buffer_new_allocate(NULL, size, NULL);
-	
-	// map the buffer for write access
-	GstMapInfo map; 
+	GstBuffer* gstBuffer = NULL;
 
-	if( gst_buffer_map(gstBuffer, &map, GST_MAP_WRITE) ) 
-	{ 
-		if( map.size != size )
+	if( frame != NULL && frame->GetImage() == buffer )
+	{
+		// wrap the pooled frame without copying it (the buffer holds a reference to the frame)
+		gstBuffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, buffer, size, 0, size, new videoFrame(*frame), onBufferReleased);
+
+		if( !gstBuffer )
 		{
-			LogError(LOG_GSTREAMER "gstEncoder -- gst_buffer_map() size mismatch, got %zu bytes, expected %zu bytes\n", map.size, size);
-			gst_buffer_unref(gstBuffer);
+			LogError(LOG_GSTREAMER "gstEncoder -- failed to wrap gstreamer buffer memory (%zu bytes)\n", size);
 			return false;
 		}
-		
-		memcpy(map.data, buffer, size);
-		gst_buffer_unmap(gstBuffer, &map); 
-	} 
+	}
 	else
 	{
-		LogError(LOG_GSTREAMER "gstEncoder -- failed to map gstreamer buffer memory (%zu bytes)\n", size);
-		gst_buffer_unref(gstBuffer);
-		return false;
+		// allocate gstreamer buffer memory
+		gstBuffer = gst_buffer_new_allocate(NULL, size, NULL);
+		
+		// map the buffer for write access
+		GstMapInfo map; 
+
+		if( gst_buffer_map(gstBuffer, &map, GST_MAP_WRITE) ) 
+		{ 
+			if( map.size != size )
+			{
+				LogError(LOG_GSTREAMER "gstEncoder -- gst_buffer_map() size mismatch, got %zu bytes, expected %zu bytes\n", map.size, size);
+				gst_buffer_unmap(gstBuffer, &map);
+				gst_buffer_unref(gstBuffer);
+				return false;
+			}
+			
+			memcpy(map.data, buffer, size);
+			gst_buffer_unmap(gstBuffer, &map); 
+		} 
+		else
+		{
+			LogError(LOG_GSTREAMER "gstEncoder -- failed to map gstreamer buffer memory (%zu bytes)\n", size);
+			gst_buffer_unref(gstBuffer);
+			return false;
+		}
 	}
 #else
 	// convert memory to GstBuffer
@@ -587,20 +621,25 @@ bool gstEncoder::encodeYUV( void* buffer, size_t size )
 	memcpy(GST_BUFFER_DATA(gstBuffer), buffer, size);
 #endif
 
-	// queue buffer to gstreamer
-	while( true )
+	// queue buffer to gstreamer (with a limited number of retries, so errors don't spin forever)
+	bool pushed = false;
+
+	for( uint32_t retry=0; retry <= MaxPushRetries; retry++ )
 	{
 		GstFlowReturn ret;	
 		g_signal_emit_by_name(mAppSrc, "push-buffer", gstBuffer, &ret);
 		
 		if( ret >= 0 )
 		{
-			gst_buffer_unref(gstBuffer);
+			pushed = true;
 			break;
 		}
 		
 		LogError(LOG_GSTREAMER "gstEncoder -- an error occurred pushing appsrc buffer (result=%i '%s')\n", (int)ret, gst_flow_get_name(ret));
 		
+		if( retry == MaxPushRetries )
+			break;
+
 		// check to make sure the pipeline is still playing (some pipelines like RTSP server may disconnect)
 		GstState state = GST_STATE_VOID_PENDING;
 		gst_element_get_state(mPipeline, &state, NULL, GST_CLOCK_TIME_NONE);
@@ -612,13 +651,24 @@ bool gstEncoder::encodeYUV( void* buffer, size_t size )
 			mStreaming = false;
 			
 			if( !Open() )
-			{
-				gst_buffer_unref(gstBuffer);
-				return false;
-			}
+				break;
+		}
+		else
+		{
+			// back off before trying again (10ms, 20ms, 40ms...)
+			usleep((10 << retry) * 1000);
 		}
 	}
 	
+	// the pooled frame is released once gstreamer is done with the buffer
+	gst_buffer_unref(gstBuffer);
+
+	if( !pushed )
+	{
+		LogError(LOG_GSTREAMER "gstEncoder -- failed to push frame %" PRIu64 " to appsrc, dropping it\n", mOptions.frameCount);
+		return false;
+	}
+
 	checkMsgBus();
 	return true;
 }
@@ -688,18 +738,46 @@ bool gstEncoder::Render( void* image, uint32_t width, uint32_t height, imageForm
 		const bool substreams_success = videoOutput::Render(image, width, height, format); \
 		return enc_success & substreams_success;
 
-	// allocate color conversion buffer
+	// allocate the pool of color conversion frames (frames from a previous pool stay valid until they're released)
 	const size_t i420Size = imageFormatSize(IMAGE_I420, width, height);
 
-	if( !mBufferYUV.Alloc(2, i420Size, RingBuffer::ZeroCopy) )
+	if( !mFramePool || mFramePool->GetBufferSize() < i420Size )
 	{
-		LogError(LOG_GSTREAMER "gstEncoder -- failed to allocate buffers (%zu bytes each)\n", i420Size);
-		enc_success = false;
-		render_end();
+		if( mFramePool != NULL )
+			mFramePool->Release();
+
+		mFramePool = videoFramePool::Create(mOptions.numBuffers, i420Size, true);
+
+		if( !mFramePool )
+		{
+			LogError(LOG_GSTREAMER "gstEncoder -- failed to allocate %u frames (%zu bytes each)\n", mOptions.numBuffers, i420Size);
+			enc_success = false;
+			render_end();
+		}
+	}
+
+	// the frames are wrapped in the GstBuffers, so they can't be reused until gstreamer is done with them
+	videoFrame frameYUV;
+	void* nextYUV = NULL;
+
+	if( mFramePool->TryAcquire(&frameYUV, width, height, IMAGE_I420) )
+	{
+		nextYUV = frameYUV.GetImage();
+	}
+	else
+	{
+		// all of the frames are still queued in the pipeline, so this one gets copied instead
+		if( !mBufferYUV.Alloc(2, i420Size, RingBuffer::ZeroCopy) )
+		{
+			LogError(LOG_GSTREAMER "gstEncoder -- failed to allocate buffers (%zu bytes each)\n", i420Size);
+			enc_success = false;
+			render_end();
+		}
+
+		nextYUV = mBufferYUV.Next(RingBuffer::Write);
 	}
 
 	// perform colorspace conversion
-	void* nextYUV = mBufferYUV.Next(RingBuffer::Write);
 
 	if( CUDA_FAILED(cudaConvertColor(image, format, nextYUV, IMAGE_I420, width, height, stream)) )
 	{
@@ -720,7 +798,7 @@ bool gstEncoder::Render( void* image, uint32_t width, uint32_t height, imageForm
 	    CUDA(cudaDeviceSynchronize());
 	
 	// encode YUV buffer
-	enc_success = encodeYUV(nextYUV, i420Size);
+	enc_success = encodeYUV(nextYUV, i420Size, frameYUV.IsValid() ? &frameYUV : NULL);
 
 	// render sub-streams
 	render_end();	
@@ -25,6 +25,7 @@
 
 #include "gstUtility.h"
 #include "videoOutput.h"
+#include "videoFrame.h"
 #include "RingBuffer.h"
 
 
@@ -140,11 +141,14 @@ protected:
 	void checkMsgBus();
 	bool buildCapsStr();
 	bool buildLaunchStr();
-	bool encodeYUV( void* buffer, size_t size );
+	bool encodeYUV( void* buffer, size_t size, videoFrame* frame=NULL );
 	
 	// appsrc callbacks
 	static void onNeedData( GstElement* pipeline, uint32_t size, void* user_data );
 	static void onEnoughData( GstElement* pipeline, void* user_data );
+	static void onBufferReleased( void* user_data );
+
+	static const uint32_t MaxPushRetries = 3;	/**< Number of times that pushing a buffer to appsrc gets retried */
 
 	// WebRTC callbacks
 	static void onWebsocketMessage( WebRTCPeer* peer, const char* message, size_t message_size, void* user_data );
@@ -158,7 +162,8 @@ protected:
 	std::string  mCapsStr;
 	std::string  mLaunchStr;
 
-	RingBuffer mBufferYUV;
+	videoFramePool* mFramePool;	/**< Pool of YUV frames that get wrapped in GstBuffers (returned when they're released) */
+	RingBuffer      mBufferYUV;	/**< YUV buffers that get copied if all the pooled frames are still in the pipeline */
 	
 	RTSPServer*   mRTSPServer;
 	WebRTCServer* mWebRTCServer;
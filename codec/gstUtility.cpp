@@ -24,6 +24,7 @@
 #include "filesystem.h"
 
 #include "NvInfer.h"
+#include "timespec.h"
 #include "logging.h"
 
 #include <stdint.h>
@@ -633,3 +634,47 @@ videoOptions::CodecType gst_default_codec()
 #endif
 }
 
+
+// gst_pts_to_monotonic
+uint64_t gst_pts_to_monotonic( GstElement* pipeline, GstBuffer* buffer, const GstSegment* segment )
+{
+#if GST_CHECK_VERSION(1,0,0)
+	if( !pipeline || !buffer || !segment || !GST_BUFFER_PTS_IS_VALID(buffer) )
+		return 0;
+
+	// running time is relative to the base time of the pipeline clock
+	const GstClockTime runningTime = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+
+	if( !GST_CLOCK_TIME_IS_VALID(runningTime) )
+		return 0;
+
+	GstClock* clock = gst_element_get_clock(pipeline);
+
+	if( !clock )
+		return 0;
+
+	const GstClockTime baseTime = gst_element_get_base_time(pipeline);
+	const GstClockTime clockNow = gst_clock_get_time(clock);
+	const uint64_t monotonicNow = timeNs();
+
+	gst_object_unref(clock);
+
+	if( !GST_CLOCK_TIME_IS_VALID(baseTime) || !GST_CLOCK_TIME_IS_VALID(clockNow) )
+		return 0;
+
+	// the pipeline clock may not be CLOCK_MONOTONIC (e.g. a network clock),
+	// so translate it by how long ago the buffer was on the pipeline clock
+	const int64_t age = (int64_t)clockNow - (int64_t)(baseTime + runningTime);
+
+	if( age <= 0 )
+		return monotonicNow;	// buffers with a PTS in the future (e.g. non-live sources with sync=false)
+
+	if( (uint64_t)age > monotonicNow )
+		return 0;
+
+	return monotonicNow - age;
+#else
+	return 0;
+#endif
+}
+
@@ -107,5 +107,16 @@ const char* gst_select_encoder( videoOptions::Codec codec, videoOptions::CodecTy
  */
 videoOptions::CodecType gst_default_codec();
 
+/**
+ * Convert the PTS of a buffer into the `CLOCK_MONOTONIC` timebase of timeNs(),
+ * by mapping its running time onto the pipeline clock.  For live sources this is
+ * when the frame was captured, which is earlier than when it reaches the appsink.
+ * @returns the timestamp in nanoseconds, or 0 if the buffer has no valid PTS
+ *          or the pipeline doesn't have a clock yet.
+ * @internal
+ * @ingroup codec
+ */
+uint64_t gst_pts_to_monotonic( GstElement* pipeline, GstBuffer* buffer, const GstSegment* segment );
+
 
 #endif
@@ -22,6 +22,7 @@
 
 #include "cudaColormap.h"
 #include "cudaFilterMode.cuh"
+#include "cudaReduce.h"
 #include "cudaVector.h"
 
 
@@ -1708,7 +1709,7 @@ float4* cudaColormapPalette( cudaColormapType colormap )
 template<typename T, cudaFilterMode filter>
 __global__ void gpuColormapPalette( float4* palette, float* input, int input_width, int input_height,
 							 T* output, int output_width, int output_height, 
-							 float multiplier, float min_value )
+							 float multiplier, float min_value, const cudaImageStats* stats )
 {
 	const int x = blockIdx.x * blockDim.x + threadIdx.x;
 	const int y = blockIdx.y * blockDim.y + threadIdx.y;
@@ -1716,6 +1717,12 @@ __global__ void gpuColormapPalette( float4* palette, float* input, int input_wid
 	if( x >= output_width || y >= output_height )
 		return;
 
+	if( stats != NULL )	// auto-range mode
+	{
+		min_value  = stats->min.x;
+		multiplier = 255.0f / fmaxf(stats->max.x - stats->min.x, 1e-6f);
+	}
+
 	const float pixel = cudaFilterPixel<filter>(input, x, y, input_width, input_height, output_width, output_height);
 	const float value = fmaxf(fminf((pixel - min_value) * multiplier, 255.0f), 0.0f); // __saturatef(pixel - min_value) * 255.0f; 
 
@@ -1727,7 +1734,7 @@ __global__ void gpuColormapPalette( float4* palette, float* input, int input_wid
 template<typename T, cudaFilterMode filter, cudaDataFormat format>
 __global__ void gpuColormapFlow( float2* input, int input_width, int input_height,
 						   T* output, int output_width, int output_height, 
-						   float max_value )
+						   float max_value, const cudaImageStats* stats )
 {
 	const int x = blockIdx.x * blockDim.x + threadIdx.x;
 	const int y = blockIdx.y * blockDim.y + threadIdx.y;
@@ -1735,6 +1742,9 @@ __global__ void gpuColormapFlow( float2* input, int input_width, int input_heigh
 	if( x >= output_width || y >= output_height )
 		return;
 
+	if( stats != NULL )	// auto-range mode
+		max_value = fmaxf(fmaxf(fabs(stats->min.x), fabs(stats->max.x)), 1e-6f);
+
 	const float2 pixel = cudaFilterPixel<filter, format>(input, x, y, input_width, input_height, output_width, output_height);
 	const float2 value = pixel / max_value;
 
@@ -1789,6 +1799,22 @@ cudaError_t cudaColormap( float* input, size_t input_width, size_t input_height,
 	if( input_width == output_width && input_height == output_height )
 		filter = FILTER_POINT;
 
+	// compute the range on the GPU if needed
+	cudaImageStats* stats = NULL;
+
+	if( input_range.x == input_range.y && colormap != COLORMAP_NONE )
+	{
+		stats = cudaReduceStream(stream);
+
+		if( !stats )
+			return cudaErrorMemoryAllocation;
+
+		// flow fields have 2 channels, which share the same range
+		const size_t channels = (colormap == COLORMAP_FLOW) ? 2 : 1;
+
+		CUDA_ASSERT(cudaReduceMinMax(input, input_width * channels, input_height, IMAGE_GRAY32F, stats, stream));
+	}
+
 	// palettized colormaps
 	if( colormap <= COLORMAP_VIRIDIS_INVERTED )
 	{
@@ -1809,7 +1835,7 @@ cudaError_t cudaColormap( float* input, size_t input_width, size_t input_height,
 			gpuColormapPalette<type, filterMode><<<gridDim, blockDim, 0, stream>>>( \
 								palette, input, input_width, input_height, \
 								(type*)output, output_width, output_height, \
-								multiplier, input_range.x);
+								multiplier, input_range.x, stats);
 
 		#define colormapKernel(type) \
 		{ \
@@ -1846,7 +1872,7 @@ cudaError_t cudaColormap( float* input, size_t input_width, size_t input_height,
 			gpuColormapFlow<type, filterMode, layout><<<gridDim, blockDim, 0, stream>>>( \
 										 (float2*)input, input_width, input_height, \
 										 (type*)output, output_width, output_height, \
-										 max_value);
+										 max_value, stats);
 
 		#define flowKernel(type) \
 		{ \
@@ -78,6 +78,8 @@ const char* cudaColormapToStr( cudaColormapType colormap );
  * If the input and output dimensions differ, this function will rescale the image
  * using bilinear or nearest-point interpolation as set by the `filter` mode.
  * @param input_range the minimum and maximum values of the input image.
+ *                    If `input_range.x == input_range.y`, the range is computed
+ *                    automatically on the GPU with cudaReduceMinMax().
  * @param colormap the colormap to apply (@see cudaColormapType)
  * @param format layout of multi-channel input data (HWC or CHW). 
  * @ingroup colormap
@@ -95,6 +97,8 @@ cudaError_t cudaColormap( float* input, T* output,
  * If the input and output dimensions differ, this function will rescale the image
  * using bilinear or nearest-point interpolation as set by the `filter` mode.
  * @param input_range the minimum and maximum values of the input image.
+ *                    If `input_range.x == input_range.y`, the range is computed
+ *                    automatically on the GPU with cudaReduceMinMax().
  * @param colormap the colormap to apply (@see cudaColormapType)
  * @param format layout of multi-channel input data (HWC or CHW). 
  * @ingroup colormap
@@ -112,6 +116,8 @@ cudaError_t cudaColormap( float* input, void* output,
  * If the input and output dimensions differ, this function will rescale the image
  * using bilinear or nearest-point interpolation as set by the `filter` mode.
  * @param input_range the minimum and maximum values of the input image.
+ *                    If `input_range.x == input_range.y`, the range is computed
+ *                    automatically on the GPU with cudaReduceMinMax().
  * @param colormap the colormap to apply (@see cudaColormapType)
  * @param filter the interpolation mode used for rescaling.
  * @param format layout of multi-channel input data (HWC or CHW).
@@ -131,6 +137,8 @@ cudaError_t cudaColormap( float* input, size_t input_width, size_t input_height,
  * If the input and output dimensions differ, this function will rescale the image
  * using bilinear or nearest-point interpolation as set by the `filter` mode.
  * @param input_range the minimum and maximum values of the input image.
+ *                    If `input_range.x == input_range.y`, the range is computed
+ *                    automatically on the GPU with cudaReduceMinMax().
  * @param colormap the colormap to apply (@see cudaColormapType)
  * @param filter the interpolation mode used for rescaling.
  * @param format layout of multi-channel input data (HWC or CHW).
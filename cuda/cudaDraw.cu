@@ -22,6 +22,7 @@
 
 #include "cudaDraw.h"
 #include "cudaAlphaBlend.cuh"
+#include "cudaMappedMemory.h"
 
 
 // TODO for rect/fill/line
@@ -282,3 +283,429 @@ cudaError_t cudaDrawRect( void* input, void* output, size_t width, size_t height
 	
 	return cudaGetLastError();
 }
+
+
+
+//----------------------------------------------------------------------------
+// Draw lists (batched primitives binned into tiles, rasterized in one launch)
+//----------------------------------------------------------------------------
+enum DrawCommandType
+{
+	DRAW_CIRCLE = 0,
+	DRAW_LINE,
+	DRAW_RECT
+};
+
+// Struct for one primitive to render
+struct __align__(16) DrawCommand
+{
+	float4 coords;		// circle (cx, cy, 0, 0)   line (x1, y1, x2, y2)   rect (left, top, right, bottom)
+	float4 color;		// fill color of the primitive
+	int    type;		// DrawCommandType
+	float  param;		// circle radius^2   line width^2
+};
+
+// test if a pixel is covered by the primitive
+inline __device__ bool drawCommandCoverage( const DrawCommand& cmd, float x, float y )
+{
+	if( cmd.type == DRAW_CIRCLE )
+		return dist2(x, y, cmd.coords.x, cmd.coords.y) < cmd.param;
+	else if( cmd.type == DRAW_LINE )
+		return lineDistanceSquared(x, y, cmd.coords.x, cmd.coords.y, cmd.coords.z, cmd.coords.w) <= cmd.param;
+	else if( cmd.type == DRAW_RECT )
+		return (x >= cmd.coords.x && x < cmd.coords.z && y >= cmd.coords.y && y < cmd.coords.w);
+
+	return false;
+}
+
+// each thread block processes one tile, and stages the tile's commands in shared memory
+template<typename T>
+__global__ void gpuDrawList( T* img, int imgWidth, int imgHeight, const DrawCommand* commands, 
+                             const uint32_t* tileOffsets, const uint32_t* tileIndices ) 
+{
+	__shared__ DrawCommand cmds[cudaDrawList::TileSize * cudaDrawList::TileSize];
+
+	const uint32_t tile  = blockIdx.y * gridDim.x + blockIdx.x;
+	const uint32_t first = tileOffsets[tile];
+	const uint32_t last  = tileOffsets[tile+1];
+
+	if( first == last )
+		return;
+
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	const bool inside = (x < imgWidth && y < imgHeight);
+	const int idx = y * imgWidth + x;
+	
+	const uint32_t tid = threadIdx.y * blockDim.x + threadIdx.x;
+	const uint32_t numThreads = blockDim.x * blockDim.y;
+
+	T px;
+
+	if( inside )
+		px = img[idx];
+
+	for( uint32_t base=first; base < last; base += numThreads )
+	{
+		const uint32_t count = MIN(last - base, numThreads);
+
+		if( tid < count )
+			cmds[tid] = commands[tileIndices[base + tid]];
+
+		__syncthreads();
+
+		if( inside )
+		{
+			for( uint32_t n=0; n < count; n++ )
+			{
+				if( drawCommandCoverage(cmds[n], x, y) )
+					px = cudaAlphaBlend(px, cmds[n].color);
+			}
+		}
+
+		__syncthreads();
+	}
+
+	if( inside )
+		img[idx] = px;
+}
+
+
+// constructor
+cudaDrawList::cudaDrawList()
+{
+	mCommandCPU  = NULL;
+	mCommandGPU  = NULL;
+	mNumCommands = 0;
+	mMaxCommands = 0;
+
+	mTileOffsetsCPU = NULL;
+	mTileOffsetsGPU = NULL;
+	mMaxTiles = 0;
+
+	mTileIndicesCPU = NULL;
+	mTileIndicesGPU = NULL;
+	mMaxTileIndices = 0;
+
+	mEvent   = NULL;
+	mPending = false;
+}
+
+
+// destructor
+cudaDrawList::~cudaDrawList()
+{
+	wait();
+
+	CUDA_FREE_HOST(mCommandCPU);
+	CUDA_FREE_HOST(mTileOffsetsCPU);
+	CUDA_FREE_HOST(mTileIndicesCPU);
+
+	if( mEvent != NULL )
+	{
+		CUDA(cudaEventDestroy(mEvent));
+		mEvent = NULL;
+	}
+}
+
+
+// Create
+cudaDrawList* cudaDrawList::Create( uint32_t maxPrimitives )
+{
+	cudaDrawList* list = new cudaDrawList();
+
+	if( !list )
+		return NULL;
+
+	if( !list->init(maxPrimitives) )
+	{
+		delete list;
+		return NULL;
+	}
+
+	return list;
+}
+
+
+// init
+bool cudaDrawList::init( uint32_t maxPrimitives )
+{
+	if( maxPrimitives == 0 )
+		return false;
+
+	if( !cudaAllocMapped(&mCommandCPU, &mCommandGPU, sizeof(DrawCommand) * maxPrimitives) )
+		return false;
+
+	if( CUDA_FAILED(cudaEventCreateWithFlags(&mEvent, cudaEventDisableTiming)) )
+		return false;
+
+	mBounds.resize(maxPrimitives);
+	mMaxCommands = maxPrimitives;
+
+	return true;
+}
+
+
+// wait
+void cudaDrawList::wait()
+{
+	if( !mPending )
+		return;
+
+	CUDA(cudaEventSynchronize(mEvent));
+	mPending = false;
+}
+
+
+// Clear
+void cudaDrawList::Clear()
+{
+	mNumCommands = 0;
+}
+
+
+// append
+bool cudaDrawList::append( int type, const float4& coords, float param, const float4& color, const int4& bounds )
+{
+	if( mNumCommands >= mMaxCommands )
+	{
+		LogError(LOG_CUDA "cudaDrawList -- exceeded the max number of primitives (%u)\n", mMaxCommands);
+		return false;
+	}
+
+	// the previous draw could still be reading the command buffer
+	wait();
+
+	DrawCommand* cmd = ((DrawCommand*)mCommandCPU) + mNumCommands;
+
+	cmd->coords = coords;
+	cmd->color  = color;
+	cmd->type   = type;
+	cmd->param  = param;
+
+	mBounds[mNumCommands] = bounds;
+	mNumCommands++;
+
+	return true;
+}
+
+
+// Circle
+bool cudaDrawList::Circle( int cx, int cy, float radius, const float4& color )
+{
+	if( radius <= 0 )
+		return false;
+
+	const int r = ceilf(radius);
+
+	return append(DRAW_CIRCLE, make_float4(cx, cy, 0, 0), radius * radius, color,
+			    make_int4(cx - r, cy - r, cx + r, cy + r));
+}
+
+
+// Line
+bool cudaDrawList::Line( int x1, int y1, int x2, int y2, const float4& color, float line_width )
+{
+	if( line_width <= 0 )
+		return false;
+
+	// check for lines < 2 pixels in length
+	if( dist(x1,y1,x2,y2) < 2.0 )
+	{
+		LogDebug(LOG_CUDA "cudaDrawList::Line() - line has length < 2, skipping (%i,%i) (%i,%i)\n", x1, y1, x2, y2);
+		return true;
+	}
+
+	const int w = ceilf(line_width);
+
+	return append(DRAW_LINE, make_float4(x1, y1, x2, y2), line_width * line_width, color,
+			    make_int4(MIN(x1,x2) - w, MIN(y1,y2) - w, MAX(x1,x2) + w, MAX(y1,y2) + w));
+}
+
+
+// Rect
+bool cudaDrawList::Rect( int left, int top, int right, int bottom, const float4& color, const float4& line_color, float line_width )
+{
+	// make sure the coordinates are ordered
+	if( left > right )
+	{
+		const int swap = left;
+		left = right;
+		right = swap;
+	}
+	
+	if( top > bottom )
+	{
+		const int swap = top;
+		top = bottom;
+		bottom = swap;
+	}
+
+	if( right - left <= 0 || bottom - top <= 0 )
+	{
+		LogError(LOG_CUDA "cudaDrawList::Rect() -- rect had width/height <= 0  left=%i top=%i right=%i bottom=%i\n", left, top, right, bottom);
+		return false;
+	}
+
+	// rect fill
+	if( color.w > 0 )
+	{
+		if( !append(DRAW_RECT, make_float4(left, top, right, bottom), 0.0f, color,
+				  make_int4(left, top, right - 1, bottom - 1)) )
+			return false;
+	}
+
+	// rect outline
+	if( line_color.w > 0 && line_width > 0 )
+	{
+		if( !Line(left, top, right, top, line_color, line_width) ||
+		    !Line(right, top, right, bottom, line_color, line_width) ||
+		    !Line(right, bottom, left, bottom, line_color, line_width) ||
+		    !Line(left, bottom, left, top, line_color, line_width) )
+			return false;
+	}
+
+	return true;
+}
+
+
+// bin
+bool cudaDrawList::bin( size_t width, size_t height )
+{
+	const uint32_t tilesX = iDivUp(width, TileSize);
+	const uint32_t tilesY = iDivUp(height, TileSize);
+	const uint32_t numTiles = tilesX * tilesY;
+
+	// allocate the tile offsets (with one extra entry for the end of the last tile)
+	if( numTiles + 1 > mMaxTiles )
+	{
+		CUDA_FREE_HOST(mTileOffsetsCPU);
+
+		if( !cudaAllocMapped((void**)&mTileOffsetsCPU, (void**)&mTileOffsetsGPU, (numTiles + 1) * sizeof(uint32_t)) )
+		{
+			mMaxTiles = 0;
+			return false;
+		}
+
+		mMaxTiles = numTiles + 1;
+		mTileCursor.resize(numTiles);
+	}
+
+	// count the primitives overlapping each tile
+	memset(mTileOffsetsCPU, 0, (numTiles + 1) * sizeof(uint32_t));
+
+	#define FOR_EACH_TILE(bounds, code) \
+	{ \
+		const int x0 = MAX(bounds.x, 0) / TileSize;  \
+		const int y0 = MAX(bounds.y, 0) / TileSize;  \
+		const int x1 = MIN(bounds.z, (int)width - 1) / TileSize;  \
+		const int y1 = MIN(bounds.w, (int)height - 1) / TileSize; \
+		for( int ty=y0; ty <= y1; ty++ ) \
+			for( int tx=x0; tx <= x1; tx++ ) \
+			{ \
+				const uint32_t tile = ty * tilesX + tx; \
+				code; \
+			} \
+	}
+
+	for( uint32_t n=0; n < mNumCommands; n++ )
+	{
+		const int4 bounds = mBounds[n];
+
+		if( bounds.z < 0 || bounds.w < 0 || bounds.x >= (int)width || bounds.y >= (int)height )
+			continue;
+
+		FOR_EACH_TILE(bounds, mTileOffsetsCPU[tile+1]++);
+	}
+
+	// prefix sum the counts into offsets
+	for( uint32_t n=0; n < numTiles; n++ )
+	{
+		mTileCursor[n] = mTileOffsetsCPU[n];
+		mTileOffsetsCPU[n+1] += mTileOffsetsCPU[n];
+	}
+
+	const uint32_t numIndices = mTileOffsetsCPU[numTiles];
+
+	if( numIndices == 0 )
+		return true;
+
+	// allocate the per-tile primitive lists
+	if( numIndices > mMaxTileIndices )
+	{
+		const uint32_t maxIndices = MAX(numIndices, mMaxTileIndices * 2);
+
+		CUDA_FREE_HOST(mTileIndicesCPU);
+
+		if( !cudaAllocMapped((void**)&mTileIndicesCPU, (void**)&mTileIndicesGPU, maxIndices * sizeof(uint32_t), false) )
+		{
+			mMaxTileIndices = 0;
+			return false;
+		}
+
+		mMaxTileIndices = maxIndices;
+	}
+
+	// fill the per-tile lists, preserving the order the primitives were added in
+	for( uint32_t n=0; n < mNumCommands; n++ )
+	{
+		const int4 bounds = mBounds[n];
+
+		if( bounds.z < 0 || bounds.w < 0 || bounds.x >= (int)width || bounds.y >= (int)height )
+			continue;
+
+		FOR_EACH_TILE(bounds, mTileIndicesCPU[mTileCursor[tile]++] = n);
+	}
+
+	return true;
+}
+
+
+// Draw
+cudaError_t cudaDrawList::Draw( void* input, void* output, size_t width, size_t height, imageFormat format, cudaStream_t stream )
+{
+	if( !input || !output || width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
+
+	if( format != IMAGE_RGB8 && format != IMAGE_RGBA8 && format != IMAGE_RGB32F && format != IMAGE_RGBA32F )
+	{
+		imageFormatErrorMsg(LOG_CUDA, "cudaDrawList::Draw()", format);
+		return cudaErrorInvalidValue;
+	}
+
+	// if the input and output images are different, copy the input to the output
+	// this is because tiles without any primitives in them are skipped
+	if( input != output )
+		CUDA_ASSERT(cudaMemcpyAsync(output, input, imageFormatSize(format, width, height), cudaMemcpyDeviceToDevice, stream));
+
+	if( mNumCommands == 0 )
+		return cudaSuccess;
+
+	// the previous draw could still be reading the tile buffers
+	wait();
+
+	if( !bin(width, height) )
+		return cudaErrorMemoryAllocation;
+
+	// launch one thread block per tile
+	const dim3 blockDim(TileSize, TileSize);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	#define LAUNCH_DRAW_LIST(type) \
+		gpuDrawList<type><<<gridDim, blockDim, 0, stream>>>((type*)output, width, height, (DrawCommand*)mCommandGPU, mTileOffsetsGPU, mTileIndicesGPU)
+	
+	if( format == IMAGE_RGB8 )
+		LAUNCH_DRAW_LIST(uchar3);
+	else if( format == IMAGE_RGBA8 )
+		LAUNCH_DRAW_LIST(uchar4);
+	else if( format == IMAGE_RGB32F )
+		LAUNCH_DRAW_LIST(float3); 
+	else if( format == IMAGE_RGBA32F )
+		LAUNCH_DRAW_LIST(float4);
+
+	CUDA_ASSERT(cudaEventRecord(mEvent, stream));
+	mPending = true;
+
+	return cudaGetLastError();
+}
@@ -27,6 +27,8 @@
 #include "cudaUtility.h"
 #include "imageFormat.h"
 
+#include <vector>
+
 
 /**
  * cudaDrawCircle
@@ -160,4 +162,128 @@ cudaError_t cudaDrawRect( T* image, size_t width, size_t height,
 	return cudaDrawRect(image, image, width, height, imageFormatFromType<T>(), left, top, right, bottom, color, line_color, line_width, stream); 
 }
 
+
+/**
+ * Batched drawing of circles, lines, and rects using a command buffer.
+ *
+ * Primitives are appended on the host with Circle(), Line(), and Rect(), and
+ * then all of them are rasterized by Draw() in a single kernel launch.  Before
+ * launching, the primitives are binned into screen-space tiles on the CPU, so
+ * each tile only tests the primitives that overlap it.  This is much faster
+ * than the individual cudaDrawCircle(), cudaDrawLine(), and cudaDrawRect()
+ * functions when many shapes are drawn per frame (i.e. tracking overlays).
+ *
+ * The primitives are blended in the order that they were appended, so the
+ * results are the same as calling the individual draw functions in sequence.
+ *
+ * The command buffer can be reused across frames by calling Clear() - it is
+ * safe to start appending new primitives before the previous Draw() finished,
+ * as the draw list will wait for the GPU to release the buffers first.
+ *
+ * @ingroup drawing
+ */
+class cudaDrawList
+{
+public:
+	/**
+	 * Create a new draw list.
+	 * @param maxPrimitives the maximum number of primitives that can be
+	 *                      appended between calls to Clear().  Rect outlines
+	 *                      count as 4 additional line primitives.
+	 */
+	static cudaDrawList* Create( uint32_t maxPrimitives=4096 );
+
+	/**
+	 * Destructor
+	 */
+	~cudaDrawList();
+
+	/**
+	 * Append a filled circle.
+	 * @returns true on success, or false if the command buffer is full.
+	 */
+	bool Circle( int cx, int cy, float radius, const float4& color );
+
+	/**
+	 * Append a line segment.
+	 * @returns true on success, or false if the command buffer is full.
+	 */
+	bool Line( int x1, int y1, int x2, int y2, const float4& color, float line_width=1.0f );
+
+	/**
+	 * Append a rect, with optional fill and outline colors.
+	 * @returns true on success, or false if the command buffer is full.
+	 */
+	bool Rect( int left, int top, int right, int bottom, const float4& color,
+	           const float4& line_color=make_float4(0,0,0,0), float line_width=1.0f );
+
+	/**
+	 * Rasterize all of the primitives in the list onto the image.
+	 * The list isn't cleared afterwards, so it can be drawn again.
+	 */
+	cudaError_t Draw( void* input, void* output, size_t width, size_t height, 
+	                  imageFormat format, cudaStream_t stream=0 );
+
+	/**
+	 * Rasterize all of the primitives in the list onto the image (in-place).
+	 */
+	inline cudaError_t Draw( void* image, size_t width, size_t height, 
+	                         imageFormat format, cudaStream_t stream=0 )		{ return Draw(image, image, width, height, format, stream); }
+
+	/**
+	 * Rasterize all of the primitives in the list onto the image (in-place).
+	 */
+	template<typename T> cudaError_t Draw( T* image, size_t width, size_t height, cudaStream_t stream=0 )
+	{
+		return Draw(image, image, width, height, imageFormatFromType<T>(), stream);
+	}
+
+	/**
+	 * Remove all of the primitives from the list.
+	 */
+	void Clear();
+
+	/**
+	 * Return the number of primitives currently in the list.
+	 */
+	inline uint32_t GetCount() const			{ return mNumCommands; }
+
+	/**
+	 * Return the maximum number of primitives the list can hold.
+	 */
+	inline uint32_t GetMaxCount() const		{ return mMaxCommands; }
+
+	/**
+	 * The width/height of the tiles that primitives are binned into.
+	 */
+	static const uint32_t TileSize = 16;
+
+protected:
+	cudaDrawList();
+
+	bool init( uint32_t maxPrimitives );
+	bool append( int type, const float4& coords, float param, const float4& color, const int4& bounds );
+	bool bin( size_t width, size_t height );
+	void wait();
+
+	void*     mCommandCPU;
+	void*     mCommandGPU;
+	uint32_t  mNumCommands;
+	uint32_t  mMaxCommands;
+
+	uint32_t* mTileOffsetsCPU;
+	uint32_t* mTileOffsetsGPU;
+	uint32_t  mMaxTiles;
+
+	uint32_t* mTileIndicesCPU;
+	uint32_t* mTileIndicesGPU;
+	uint32_t  mMaxTileIndices;
+
+	std::vector<int4> mBounds;
+	std::vector<uint32_t> mTileCursor;
+
+	cudaEvent_t mEvent;
+	bool mPending;
+};
+
 #endif
@@ -0,0 +1,593 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cudaFilter.h"
+#include "cudaSIMD.h"
+
+#include "ParallelFor.h"
+
+#include <math.h>
+
+
+// min/max overloads shared by the scalar and SIMD median paths
+static inline float filterMin( float a, float b )	{ return (a < b) ? a : b; }
+static inline float filterMax( float a, float b )	{ return (a > b) ? a : b; }
+
+static inline simd4f filterMin( simd4f a, simd4f b )	{ return simdMin(a, b); }
+static inline simd4f filterMax( simd4f a, simd4f b )	{ return simdMax(a, b); }
+
+// rows are processed 4 floats at a time, so the buffers get padded to a multiple of 4
+static inline size_t simdAlign( size_t n )
+{
+	return (n + 3) & ~size_t(3);
+}
+
+static inline int clampIndex( int value, int size )
+{
+	return (value < 0) ? 0 : ((value >= size) ? size - 1 : value);
+}
+
+
+// cudaFilterGaussianKernel
+int cudaFilterGaussianKernel( float* kernel, float sigma, int radius )
+{
+	if( !kernel || sigma <= 0.0f || radius < 0 || radius > FILTER_MAX_RADIUS )
+		return -1;
+
+	if( radius == 0 )
+	{
+		radius = (int)ceilf(sigma * 3.0f);
+
+		if( radius > FILTER_MAX_RADIUS )
+			radius = FILTER_MAX_RADIUS;
+	}
+
+	const float denom = 1.0f / (2.0f * sigma * sigma);
+	float sum = 0.0f;
+
+	for( int k=-radius; k <= radius; k++ )
+	{
+		kernel[k + radius] = expf(-float(k * k) * denom);
+		sum += kernel[k + radius];
+	}
+
+	for( int k=0; k <= radius * 2; k++ )
+		kernel[k] /= sum;
+
+	return radius;
+}
+
+
+// loadRow (convert a row to float, replicating the edge pixels into the border)
+template<typename T, int C>
+static void loadRow( const T* input, size_t width, int radius, float* output )
+{
+	for( int x=0; x < radius; x++ )
+	{
+		for( int c=0; c < C; c++ )
+			output[x * C + c] = input[c];
+	}
+
+	output += radius * C;
+
+	for( size_t n=0; n < width * C; n++ )
+		output[n] = input[n];
+
+	output += width * C;
+	input += (width - 1) * C;
+
+	for( int x=0; x < radius; x++ )
+	{
+		for( int c=0; c < C; c++ )
+			output[x * C + c] = input[c];
+	}
+}
+
+// loadPadded (convert the image to float with a border of clamped pixels)
+template<typename T, int C>
+static float* loadPadded( const T* input, size_t width, size_t height, int radius, size_t* stride )
+{
+	const size_t paddedWidth = (width + radius * 2) * C;
+	const size_t paddedHeight = height + radius * 2;
+
+	// the extra vector at the end is for loads that run past the last row
+	float* padded = new float[paddedWidth * paddedHeight + 4];
+
+	ParallelFor(paddedHeight, [&](uint32_t y0, uint32_t y1)
+	{
+		for( uint32_t y=y0; y < y1; y++ )
+			loadRow<T,C>(input + clampIndex(int(y) - radius, height) * width * C, width, radius, padded + y * paddedWidth);
+	}, 16);
+
+	*stride = paddedWidth;
+	return padded;
+}
+
+// storeRow (convert a row back to the pixel type with saturation)
+static void storeRow( const float* input, float* output, size_t count )
+{
+	memcpy(output, input, count * sizeof(float));
+}
+
+static void storeRow( const float* input, uint8_t* output, size_t count )
+{
+	for( size_t n=0; n < count; n++ )
+	{
+		const float v = input[n] + 0.5f;
+		output[n] = (v <= 0.0f) ? 0 : ((v >= 255.0f) ? 255 : (uint8_t)v);
+	}
+}
+
+
+//----------------------------------------------------------------------------
+// Separable convolution
+//----------------------------------------------------------------------------
+template<typename T, int C>
+static void filterSeparable( const T* input, T* output, size_t width, size_t height, 
+                             const float* kernelX, const float* kernelY, int radius )
+{
+	const size_t rowSize = width * C;
+	const size_t stride = simdAlign(rowSize);
+	const int taps = radius * 2 + 1;
+
+	float* tmp = new float[stride * height];
+
+	// horizontal pass (the interleaved channels are vectorized together, because the 
+	// neighbors of each element are always a multiple of C elements away)
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		float* row = new float[(width + radius * 2) * C + 4];
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			loadRow<T,C>(input + y * rowSize, width, radius, row);
+
+			float* dst = tmp + y * stride;
+
+			for( size_t i=0; i < rowSize; i += 4 )
+			{
+				simd4f sum = simdSet(0.0f);
+
+				for( int k=0; k < taps; k++ )
+					sum += simdSet(kernelX[k]) * simdLoad(row + i + k * C);
+
+				simdStore(dst + i, sum);
+			}
+		}
+
+		delete[] row;
+	}, 16);
+
+	// vertical pass
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		float* row = new float[stride];
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			for( size_t i=0; i < rowSize; i += 4 )
+			{
+				simd4f sum = simdSet(0.0f);
+
+				for( int k=0; k < taps; k++ )
+					sum += simdSet(kernelY[k]) * simdLoad(tmp + clampIndex(int(y) + k - radius, height) * stride + i);
+
+				simdStore(row + i, sum);
+			}
+
+			storeRow(row, output + y * rowSize, rowSize);
+		}
+
+		delete[] row;
+	}, 16);
+
+	delete[] tmp;
+}
+
+
+//----------------------------------------------------------------------------
+// Box filter (running sums, so the cost doesn't depend on the radius)
+//----------------------------------------------------------------------------
+template<typename T, int C>
+static void filterBox( const T* input, T* output, size_t width, size_t height, int radius )
+{
+	const size_t rowSize = width * C;
+	const size_t stride = simdAlign(rowSize);
+	const float scale = 1.0f / float((radius * 2 + 1) * (radius * 2 + 1));
+
+	float* tmp = new float[stride * height];
+
+	// horizontal running sums
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			const T* src = input + y * rowSize;
+			float* dst = tmp + y * stride;
+
+			float sum[C] = {0};
+
+			for( int k=-radius; k <= radius; k++ )
+			{
+				for( int c=0; c < C; c++ )
+					sum[c] += src[clampIndex(k, width) * C + c];
+			}
+
+			for( size_t x=0; x < width; x++ )
+			{
+				const T* add = src + clampIndex(x + radius + 1, width) * C;
+				const T* sub = src + clampIndex(int(x) - radius, width) * C;
+
+				for( int c=0; c < C; c++ )
+				{
+					dst[x * C + c] = sum[c];
+					sum[c] += float(add[c]) - float(sub[c]);
+				}
+			}
+		}
+	}, 16);
+
+	// vertical running sums (vectorized across the row)
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		float* sum = new float[stride];
+		float* row = new float[stride];
+
+		memset(sum, 0, stride * sizeof(float));
+
+		for( int k=-radius; k <= radius; k++ )
+		{
+			const float* src = tmp + clampIndex(int(y0) + k, height) * stride;
+
+			for( size_t i=0; i < rowSize; i += 4 )
+				simdStore(sum + i, simdLoad(sum + i) + simdLoad(src + i));
+		}
+
+		const simd4f vscale = simdSet(scale);
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			const float* add = tmp + clampIndex(int(y) + radius + 1, height) * stride;
+			const float* sub = tmp + clampIndex(int(y) - radius, height) * stride;
+
+			for( size_t i=0; i < rowSize; i += 4 )
+			{
+				const simd4f s = simdLoad(sum + i);
+
+				simdStore(row + i, s * vscale);
+				simdStore(sum + i, s + simdLoad(add + i) - simdLoad(sub + i));
+			}
+
+			storeRow(row, output + y * rowSize, rowSize);
+		}
+
+		delete[] row;
+		delete[] sum;
+	}, 16);
+
+	delete[] tmp;
+}
+
+
+//----------------------------------------------------------------------------
+// 2D convolution
+//----------------------------------------------------------------------------
+template<typename T, int C>
+static void filter2D( const T* input, T* output, size_t width, size_t height, const float* kernel, int radius )
+{
+	size_t stride = 0;
+	float* padded = loadPadded<T,C>(input, width, height, radius, &stride);
+
+	const size_t rowSize = width * C;
+	const int taps = radius * 2 + 1;
+
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		float* row = new float[simdAlign(rowSize)];
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			for( size_t i=0; i < rowSize; i += 4 )
+			{
+				simd4f sum = simdSet(0.0f);
+
+				for( int ky=0; ky < taps; ky++ )
+				{
+					const float* src = padded + (y + ky) * stride + i;
+
+					for( int kx=0; kx < taps; kx++ )
+						sum += simdSet(kernel[ky * taps + kx]) * simdLoad(src + kx * C);
+				}
+
+				simdStore(row + i, sum);
+			}
+
+			storeRow(row, output + y * rowSize, rowSize);
+		}
+
+		delete[] row;
+	}, 16);
+
+	delete[] padded;
+}
+
+
+//----------------------------------------------------------------------------
+// Gradients
+//----------------------------------------------------------------------------
+template<typename T, int C>
+static void filterGradient( const T* input, T* output, size_t width, size_t height, 
+                            cudaGradientOperator op, cudaGradientMode mode, float scale )
+{
+	size_t stride = 0;
+	float* padded = loadPadded<T,C>(input, width, height, 1, &stride);
+
+	const size_t rowSize = width * C;
+
+	const simd4f outer  = simdSet((op == FILTER_SCHARR) ? 3.0f : 1.0f);
+	const simd4f center = simdSet((op == FILTER_SCHARR) ? 10.0f : 2.0f);
+
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		float* row = new float[simdAlign(rowSize)];
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			const float* r0 = padded + y * stride;
+			const float* r1 = r0 + stride;
+			const float* r2 = r1 + stride;
+
+			for( size_t i=0; i < rowSize; i += 4 )
+			{
+				const simd4f dx = outer * (simdLoad(r0 + i + C * 2) - simdLoad(r0 + i))
+				                + center * (simdLoad(r1 + i + C * 2) - simdLoad(r1 + i))
+				                + outer * (simdLoad(r2 + i + C * 2) - simdLoad(r2 + i));
+
+				const simd4f dy = outer * (simdLoad(r2 + i) - simdLoad(r0 + i))
+				                + center * (simdLoad(r2 + i + C) - simdLoad(r0 + i + C))
+				                + outer * (simdLoad(r2 + i + C * 2) - simdLoad(r0 + i + C * 2));
+
+				if( mode == GRADIENT_X )
+					simdStore(row + i, dx);
+				else if( mode == GRADIENT_Y )
+					simdStore(row + i, dy);
+				else
+					simdStore(row + i, dx * dx + dy * dy);
+			}
+
+			for( size_t i=0; i < rowSize; i++ )
+			{
+				float value = row[i];
+
+				if( mode == GRADIENT_MAGNITUDE )
+					value = sqrtf(value);
+
+				value *= scale;
+
+				if( sizeof(T) == 1 )
+					value = fabsf(value);
+
+				row[i] = value;
+			}
+
+			// pass through alpha
+			if( C == 4 )
+			{
+				for( size_t x=0; x < width; x++ )
+					row[x * C + 3] = r1[(x + 1) * C + 3];
+			}
+
+			storeRow(row, output + y * rowSize, rowSize);
+		}
+
+		delete[] row;
+	}, 16);
+
+	delete[] padded;
+}
+
+
+//----------------------------------------------------------------------------
+// Median
+//----------------------------------------------------------------------------
+
+// medianSelect (partial selection sort with min/max, leaves the median in the middle element)
+template<int N, typename V>
+static inline V medianSelect( V* v )
+{
+	for( int i=0; i <= N/2; i++ )
+	{
+		for( int j=i+1; j < N; j++ )
+		{
+			const V a = v[i];
+			const V b = v[j];
+
+			v[i] = filterMin(a, b);
+			v[j] = filterMax(a, b);
+		}
+	}
+
+	return v[N/2];
+}
+
+template<typename T, int C, int R>
+static void filterMedian( const T* input, T* output, size_t width, size_t height )
+{
+	size_t stride = 0;
+	float* padded = loadPadded<T,C>(input, width, height, R, &stride);
+
+	const size_t rowSize = width * C;
+	const int N = (R*2+1) * (R*2+1);
+
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		float* row = new float[simdAlign(rowSize)];
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			for( size_t i=0; i < rowSize; i += 4 )
+			{
+				simd4f v[N];
+
+				for( int ky=0; ky <= R * 2; ky++ )
+				{
+					const float* src = padded + (y + ky) * stride + i;
+
+					for( int kx=0; kx <= R * 2; kx++ )
+						v[ky * (R*2+1) + kx] = simdLoad(src + kx * C);
+				}
+
+				simdStore(row + i, medianSelect<N>(v));
+			}
+
+			storeRow(row, output + y * rowSize, rowSize);
+		}
+
+		delete[] row;
+	}, 16);
+
+	delete[] padded;
+}
+
+
+//----------------------------------------------------------------------------
+// Format dispatch
+//----------------------------------------------------------------------------
+static bool validateFilterArgs( const void* input, const void* output, size_t width, size_t height, imageFormat format, const char* function )
+{
+	if( !input || !output || width == 0 || height == 0 )
+		return false;
+
+	if( imageFormatIsRGB(format) || imageFormatIsBGR(format) || imageFormatIsGray(format) )
+		return true;
+
+	LogError(LOG_CUDA "%s -- unsupported image format (%s)\n", function, imageFormatToStr(format));
+	return false;
+}
+
+// dispatch a templated filter function by base type and number of channels
+#define FILTER_DISPATCH(format, filter, ...) \
+{ \
+	const size_t channels = imageFormatChannels(format); \
+	\
+	if( imageFormatBaseType(format) == IMAGE_FLOAT ) \
+	{ \
+		if( channels == 1 )      filter<float,1>((const float*)input, (float*)output, __VA_ARGS__); \
+		else if( channels == 3 ) filter<float,3>((const float*)input, (float*)output, __VA_ARGS__); \
+		else if( channels == 4 ) filter<float,4>((const float*)input, (float*)output, __VA_ARGS__); \
+		else return false; \
+	} \
+	else \
+	{ \
+		if( channels == 1 )      filter<uint8_t,1>((const uint8_t*)input, (uint8_t*)output, __VA_ARGS__); \
+		else if( channels == 3 ) filter<uint8_t,3>((const uint8_t*)input, (uint8_t*)output, __VA_ARGS__); \
+		else if( channels == 4 ) filter<uint8_t,4>((const uint8_t*)input, (uint8_t*)output, __VA_ARGS__); \
+		else return false; \
+	} \
+	\
+	return true; \
+}
+
+
+// cpuFilterSeparable
+bool cpuFilterSeparable( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                         const float* kernelX, const float* kernelY, int radius )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cpuFilterSeparable()") )
+		return false;
+
+	if( !kernelX || radius < 0 || radius > FILTER_MAX_RADIUS )
+		return false;
+
+	if( !kernelY )
+		kernelY = kernelX;
+
+	FILTER_DISPATCH(format, filterSeparable, width, height, kernelX, kernelY, radius);
+}
+
+// cpuFilter2D
+bool cpuFilter2D( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                  const float* kernel, int radius )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cpuFilter2D()") )
+		return false;
+
+	if( !kernel || radius < 0 || radius > FILTER_MAX_RADIUS_2D )
+		return false;
+
+	FILTER_DISPATCH(format, filter2D, width, height, kernel, radius);
+}
+
+// cpuFilterGaussian
+bool cpuFilterGaussian( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                        float sigma, int radius )
+{
+	float kernel[FILTER_MAX_RADIUS * 2 + 1];
+
+	radius = cudaFilterGaussianKernel(kernel, sigma, radius);
+
+	if( radius < 0 )
+		return false;
+
+	return cpuFilterSeparable(input, output, width, height, format, kernel, kernel, radius);
+}
+
+// cpuFilterBox
+bool cpuFilterBox( const void* input, void* output, size_t width, size_t height, imageFormat format, int radius )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cpuFilterBox()") || radius < 0 )
+		return false;
+
+	FILTER_DISPATCH(format, filterBox, width, height, radius);
+}
+
+// cpuFilterGradient
+bool cpuFilterGradient( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                        cudaGradientOperator op, cudaGradientMode mode, float scale )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cpuFilterGradient()") )
+		return false;
+
+	FILTER_DISPATCH(format, filterGradient, width, height, op, mode, scale);
+}
+
+// filterMedian3/5 (the radius is a template parameter so the selection network gets unrolled)
+template<typename T, int C> 
+static void filterMedian3( const T* input, T* output, size_t width, size_t height )	{ filterMedian<T,C,1>(input, output, width, height); }
+
+template<typename T, int C> 
+static void filterMedian5( const T* input, T* output, size_t width, size_t height )	{ filterMedian<T,C,2>(input, output, width, height); }
+
+// cpuFilterMedian
+bool cpuFilterMedian( const void* input, void* output, size_t width, size_t height, imageFormat format, int size )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cpuFilterMedian()") )
+		return false;
+
+	if( size == 3 )
+		FILTER_DISPATCH(format, filterMedian3, width, height)
+	else if( size == 5 )
+		FILTER_DISPATCH(format, filterMedian5, width, height)
+
+	LogError(LOG_CUDA "cpuFilterMedian() -- invalid size %i (must be 3 or 5)\n", size);
+	return false;
+}
@@ -0,0 +1,735 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cudaFilter.h"
+#include "cudaMath.h"
+
+#include "Mutex.h"
+
+#include <map>
+
+
+#define FILTER_BLOCK_X 32		// block size of the separable passes
+#define FILTER_BLOCK_Y 8
+#define FILTER_TILE_SIZE 16		// block size of the 2D tiled kernels
+#define FILTER_BOX_SEGMENT 64	// minimum pixels processed by each thread of the box filter
+
+
+// kernel weights are passed by value, so they're in constant memory without 
+// needing cudaMemcpyToSymbol() (which would race between streams)
+struct filterKernel
+{
+	float taps[FILTER_MAX_RADIUS * 2 + 1];
+};
+
+struct filterKernel2D
+{
+	float taps[(FILTER_MAX_RADIUS_2D * 2 + 1) * (FILTER_MAX_RADIUS_2D * 2 + 1)];
+};
+
+
+// filterCast (convert results back to the pixel type with saturation)
+template<typename T> inline __device__ T filterCast( float value );
+
+template<> inline __device__ uint8_t filterCast( float value )	{ return (uint8_t)fminf(fmaxf(value + 0.5f, 0.0f), 255.0f); }
+template<> inline __device__ float filterCast( float value )		{ return value; }
+
+
+// filterClamp (clamp coordinates to the edge of the image)
+inline __device__ int filterClamp( int value, int size )
+{
+	return min(max(value, 0), size - 1);
+}
+
+
+//----------------------------------------------------------------------------
+// Per-stream intermediate buffers used by the separable passes
+//----------------------------------------------------------------------------
+struct filterScratch
+{
+	float* ptr;
+	size_t size;
+};
+
+static std::map<cudaStream_t, filterScratch> filterScratchBuffers;
+static Mutex filterScratchMutex;
+
+static float* filterScratchBuffer( cudaStream_t stream, size_t size )
+{
+	float* ptr = NULL;
+
+	filterScratchMutex.Lock();
+
+	filterScratch& scratch = filterScratchBuffers[stream];
+
+	if( scratch.size >= size )
+	{
+		ptr = scratch.ptr;
+	}
+	else
+	{
+		// cudaFree() synchronizes the device, so the old buffer is no longer in use
+		if( scratch.ptr != NULL )
+			CUDA(cudaFree(scratch.ptr));
+
+		scratch.ptr  = NULL;
+		scratch.size = 0;
+
+		if( CUDA_SUCCESS(cudaMalloc((void**)&scratch.ptr, size)) )
+		{
+			scratch.size = size;
+			ptr = scratch.ptr;
+		}
+	}
+
+	filterScratchMutex.Unlock();
+	return ptr;
+}
+
+// the tiled kernels read a halo around each block while other blocks are writing
+// their output, so filtering in-place reads from a copy in the scratch buffer instead
+static void* filterStageInput( void* input, void* output, size_t width, size_t height, imageFormat format, cudaStream_t stream )
+{
+	if( input != output )
+		return input;
+
+	const size_t size = imageFormatSize(format, width, height);
+	void* copy = filterScratchBuffer(stream, size);
+
+	if( !copy )
+		return NULL;
+
+	if( CUDA_FAILED(cudaMemcpyAsync(copy, input, size, cudaMemcpyDeviceToDevice, stream)) )
+		return NULL;
+
+	return copy;
+}
+
+
+//----------------------------------------------------------------------------
+// Separable convolution (rows into the float scratch buffer, then columns)
+//----------------------------------------------------------------------------
+template<typename T, int C>
+__global__ void gpuFilterRows( const T* input, float* output, int width, int height, int radius, filterKernel kernel )
+{
+	extern __shared__ float tile[];	// FILTER_BLOCK_Y rows of (FILTER_BLOCK_X + radius * 2) pixels
+
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+	
+	const int tileWidth = blockDim.x + radius * 2;
+	const int tileX = blockIdx.x * blockDim.x - radius;
+
+	float* row = tile + threadIdx.y * tileWidth * C;
+	const T* src = input + filterClamp(y, height) * width * C;
+
+	for( int i=threadIdx.x; i < tileWidth; i += blockDim.x )
+	{
+		const T* px = src + filterClamp(tileX + i, width) * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+			row[i * C + c] = px[c];
+	}
+
+	__syncthreads();
+
+	if( x >= width || y >= height )
+		return;
+
+	float sum[C] = {0};
+
+	for( int k=0; k <= radius * 2; k++ )
+	{
+		const float weight = kernel.taps[k];
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+			sum[c] += weight * row[(threadIdx.x + k) * C + c];
+	}
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+		output[(y * width + x) * C + c] = sum[c];
+}
+
+template<typename T, int C>
+__global__ void gpuFilterColumns( const float* input, T* output, int width, int height, int radius, filterKernel kernel )
+{
+	extern __shared__ float tile[];	// (FILTER_BLOCK_Y + radius * 2) rows of FILTER_BLOCK_X pixels
+
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	const int tileHeight = blockDim.y + radius * 2;
+	const int tileY = blockIdx.y * blockDim.y - radius;
+
+	const float* src = input + filterClamp(x, width) * C;
+
+	for( int j=threadIdx.y; j < tileHeight; j += blockDim.y )
+	{
+		const float* px = src + filterClamp(tileY + j, height) * width * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+			tile[(j * blockDim.x + threadIdx.x) * C + c] = px[c];
+	}
+
+	__syncthreads();
+
+	if( x >= width || y >= height )
+		return;
+
+	float sum[C] = {0};
+
+	for( int k=0; k <= radius * 2; k++ )
+	{
+		const float weight = kernel.taps[k];
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+			sum[c] += weight * tile[((threadIdx.y + k) * blockDim.x + threadIdx.x) * C + c];
+	}
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+		output[(y * width + x) * C + c] = filterCast<T>(sum[c]);
+}
+
+template<typename T, int C>
+static cudaError_t launchFilterSeparable( T* input, T* output, int width, int height, float* scratch,
+                                          const filterKernel& kernelX, const filterKernel& kernelY, 
+                                          int radius, cudaStream_t stream )
+{
+	const dim3 blockDim(FILTER_BLOCK_X, FILTER_BLOCK_Y);
+	const dim3 gridDim(iDivUp(width, blockDim.x), iDivUp(height, blockDim.y));
+
+	const size_t rowsMem = FILTER_BLOCK_Y * (FILTER_BLOCK_X + radius * 2) * C * sizeof(float);
+	const size_t colsMem = FILTER_BLOCK_X * (FILTER_BLOCK_Y + radius * 2) * C * sizeof(float);
+
+	gpuFilterRows<T,C><<<gridDim, blockDim, rowsMem, stream>>>(input, scratch, width, height, radius, kernelX);
+	gpuFilterColumns<T,C><<<gridDim, blockDim, colsMem, stream>>>(scratch, output, width, height, radius, kernelY);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+//----------------------------------------------------------------------------
+// Box filter (running sums along segments of the rows, then the columns)
+//----------------------------------------------------------------------------
+template<typename T, int C>
+__global__ void gpuBoxRows( const T* input, float* output, int width, int height, int radius, int segment )
+{
+	const int x0 = (blockIdx.x * blockDim.x + threadIdx.x) * segment;
+	const int y  = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x0 >= width || y >= height )
+		return;
+
+	const int x1 = min(x0 + segment, width);
+
+	const T* src = input + y * width * C;
+	float* dst = output + y * width * C;
+
+	float sum[C] = {0};
+
+	for( int k=-radius; k <= radius; k++ )
+	{
+		const T* px = src + filterClamp(x0 + k, width) * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+			sum[c] += px[c];
+	}
+
+	for( int x=x0; x < x1; x++ )
+	{
+		const T* add = src + filterClamp(x + radius + 1, width) * C;
+		const T* sub = src + filterClamp(x - radius, width) * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+		{
+			dst[x * C + c] = sum[c];
+			sum[c] += float(add[c]) - float(sub[c]);
+		}
+	}
+}
+
+template<typename T, int C>
+__global__ void gpuBoxColumns( const float* input, T* output, int width, int height, int radius, int segment, float scale )
+{
+	const int x  = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y0 = (blockIdx.y * blockDim.y + threadIdx.y) * segment;
+
+	if( x >= width || y0 >= height )
+		return;
+
+	const int y1 = min(y0 + segment, height);
+
+	const float* src = input + x * C;
+	T* dst = output + x * C;
+
+	float sum[C] = {0};
+
+	for( int k=-radius; k <= radius; k++ )
+	{
+		const float* px = src + filterClamp(y0 + k, height) * width * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+			sum[c] += px[c];
+	}
+
+	for( int y=y0; y < y1; y++ )
+	{
+		const float* add = src + filterClamp(y + radius + 1, height) * width * C;
+		const float* sub = src + filterClamp(y - radius, height) * width * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+		{
+			dst[y * width * C + c] = filterCast<T>(sum[c] * scale);
+			sum[c] += add[c] - sub[c];
+		}
+	}
+}
+
+template<typename T, int C>
+static cudaError_t launchFilterBox( T* input, T* output, int width, int height, float* scratch, int radius, cudaStream_t stream )
+{
+	// the segments are at least as long as the window, so initializing the 
+	// running sums costs at most one extra read per pixel for any radius
+	const int segment = max(FILTER_BOX_SEGMENT, radius * 2 + 1);
+	const float scale = 1.0f / float((radius * 2 + 1) * (radius * 2 + 1));
+
+	const dim3 rowsBlock(FILTER_BLOCK_Y, FILTER_BLOCK_X);
+	const dim3 rowsGrid(iDivUp(iDivUp(width, segment), rowsBlock.x), iDivUp(height, rowsBlock.y));
+
+	const dim3 colsBlock(FILTER_BLOCK_X, FILTER_BLOCK_Y);
+	const dim3 colsGrid(iDivUp(width, colsBlock.x), iDivUp(iDivUp(height, segment), colsBlock.y));
+
+	gpuBoxRows<T,C><<<rowsGrid, rowsBlock, 0, stream>>>(input, scratch, width, height, radius, segment);
+	gpuBoxColumns<T,C><<<colsGrid, colsBlock, 0, stream>>>(scratch, output, width, height, radius, segment, scale);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+//----------------------------------------------------------------------------
+// 2D tiled kernels (2D convolution, gradients, and median)
+//----------------------------------------------------------------------------
+template<typename T, int C>
+inline __device__ void filterLoadTile( const T* input, int width, int height, int radius, float* tile )
+{
+	const int tileWidth  = blockDim.x + radius * 2;
+	const int tileHeight = blockDim.y + radius * 2;
+
+	const int tileX = blockIdx.x * blockDim.x - radius;
+	const int tileY = blockIdx.y * blockDim.y - radius;
+
+	for( int i=threadIdx.y * blockDim.x + threadIdx.x; i < tileWidth * tileHeight; i += blockDim.x * blockDim.y )
+	{
+		const int x = filterClamp(tileX + i % tileWidth, width);
+		const int y = filterClamp(tileY + i / tileWidth, height);
+
+		const T* px = input + (y * width + x) * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+			tile[i * C + c] = px[c];
+	}
+
+	__syncthreads();
+}
+
+template<typename T, int C>
+__global__ void gpuFilter2D( const T* input, T* output, int width, int height, int radius, filterKernel2D kernel )
+{
+	extern __shared__ float tile[];
+
+	filterLoadTile<T,C>(input, width, height, radius, tile);
+
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int tileWidth = blockDim.x + radius * 2;
+	const int kernelWidth = radius * 2 + 1;
+
+	float sum[C] = {0};
+
+	for( int ky=0; ky < kernelWidth; ky++ )
+	{
+		const float* row = tile + ((threadIdx.y + ky) * tileWidth + threadIdx.x) * C;
+
+		for( int kx=0; kx < kernelWidth; kx++ )
+		{
+			const float weight = kernel.taps[ky * kernelWidth + kx];
+
+			#pragma unroll
+			for( int c=0; c < C; c++ )
+				sum[c] += weight * row[kx * C + c];
+		}
+	}
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+		output[(y * width + x) * C + c] = filterCast<T>(sum[c]);
+}
+
+template<typename T, int C>
+__global__ void gpuFilterGradient( const T* input, T* output, int width, int height, 
+                                   float outer, float center, cudaGradientMode mode, float scale )
+{
+	extern __shared__ float tile[];
+
+	filterLoadTile<T,C>(input, width, height, 1, tile);
+
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int tileWidth = blockDim.x + 2;
+	const float* px = tile + (threadIdx.y * tileWidth + threadIdx.x) * C;
+
+	#define TILE(i,j,c) px[((j) * tileWidth + (i)) * C + (c)]
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+	{
+		if( C == 4 && c == 3 )
+		{
+			output[(y * width + x) * C + c] = filterCast<T>(TILE(1,1,c));	// pass through alpha
+			continue;
+		}
+
+		const float dx = outer * (TILE(2,0,c) - TILE(0,0,c)) + center * (TILE(2,1,c) - TILE(0,1,c)) + outer * (TILE(2,2,c) - TILE(0,2,c));
+		const float dy = outer * (TILE(0,2,c) - TILE(0,0,c)) + center * (TILE(1,2,c) - TILE(1,0,c)) + outer * (TILE(2,2,c) - TILE(2,0,c));
+
+		float value;
+
+		if( mode == GRADIENT_X )
+			value = dx;
+		else if( mode == GRADIENT_Y )
+			value = dy;
+		else
+			value = sqrtf(dx * dx + dy * dy);
+
+		value *= scale;
+
+		if( sizeof(T) == 1 )
+			value = fabsf(value);
+
+		output[(y * width + x) * C + c] = filterCast<T>(value);
+	}
+
+	#undef TILE
+}
+
+// medianSelect (partial selection sort with min/max, leaves the median in the middle element)
+template<int N>
+inline __device__ float medianSelect( float* v )
+{
+	#pragma unroll
+	for( int i=0; i <= N/2; i++ )
+	{
+		#pragma unroll
+		for( int j=i+1; j < N; j++ )
+		{
+			const float a = v[i];
+			const float b = v[j];
+
+			v[i] = fminf(a, b);
+			v[j] = fmaxf(a, b);
+		}
+	}
+
+	return v[N/2];
+}
+
+template<typename T, int C, int R>
+__global__ void gpuFilterMedian( const T* input, T* output, int width, int height )
+{
+	extern __shared__ float tile[];
+
+	filterLoadTile<T,C>(input, width, height, R, tile);
+
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int tileWidth = blockDim.x + R * 2;
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+	{
+		float v[(R*2+1)*(R*2+1)];
+
+		#pragma unroll
+		for( int j=0; j <= R * 2; j++ )
+		{
+			#pragma unroll
+			for( int i=0; i <= R * 2; i++ )
+				v[j * (R*2+1) + i] = tile[((threadIdx.y + j) * tileWidth + threadIdx.x + i) * C + c];
+		}
+
+		output[(y * width + x) * C + c] = filterCast<T>(medianSelect<(R*2+1)*(R*2+1)>(v));
+	}
+}
+
+
+//----------------------------------------------------------------------------
+// Format dispatch
+//----------------------------------------------------------------------------
+static bool validateFilterArgs( void* input, void* output, size_t width, size_t height, imageFormat format, const char* function )
+{
+	if( !input || !output )
+	{
+		LogError(LOG_CUDA "%s -- input/output pointers were NULL\n", function);
+		return false;
+	}
+
+	if( width == 0 || height == 0 )
+	{
+		LogError(LOG_CUDA "%s -- image dimensions were 0\n", function);
+		return false;
+	}
+
+	if( imageFormatIsRGB(format) || imageFormatIsBGR(format) || imageFormatIsGray(format) )
+		return true;
+
+	LogError(LOG_CUDA "%s -- unsupported image format (%s)\n", function, imageFormatToStr(format));
+	LogError(LOG_CUDA "      supported formats are:\n");
+	LogError(LOG_CUDA "          * gray8, gray32f\n");
+	LogError(LOG_CUDA "          * rgb8, rgba8, rgb32f, rgba32f\n");
+	LogError(LOG_CUDA "          * bgr8, bgra8, bgr32f, bgra32f\n");
+
+	return false;
+}
+
+// dispatch a templated launch function by base type and number of channels
+#define FILTER_DISPATCH(format, launch, ...) \
+{ \
+	const size_t channels = imageFormatChannels(format); \
+	\
+	if( imageFormatBaseType(format) == IMAGE_FLOAT ) \
+	{ \
+		if( channels == 1 )      return launch<float,1>((float*)input, (float*)output, __VA_ARGS__); \
+		else if( channels == 3 ) return launch<float,3>((float*)input, (float*)output, __VA_ARGS__); \
+		else if( channels == 4 ) return launch<float,4>((float*)input, (float*)output, __VA_ARGS__); \
+	} \
+	else \
+	{ \
+		if( channels == 1 )      return launch<uint8_t,1>((uint8_t*)input, (uint8_t*)output, __VA_ARGS__); \
+		else if( channels == 3 ) return launch<uint8_t,3>((uint8_t*)input, (uint8_t*)output, __VA_ARGS__); \
+		else if( channels == 4 ) return launch<uint8_t,4>((uint8_t*)input, (uint8_t*)output, __VA_ARGS__); \
+	} \
+	\
+	return cudaErrorInvalidValue; \
+}
+
+
+// cudaFilterSeparable
+cudaError_t cudaFilterSeparable( void* input, void* output, size_t width, size_t height, imageFormat format,
+                                 const float* kernelX, const float* kernelY, int radius, cudaStream_t stream )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cudaFilterSeparable()") )
+		return cudaErrorInvalidValue;
+
+	if( !kernelX || radius < 0 || radius > FILTER_MAX_RADIUS )
+	{
+		LogError(LOG_CUDA "cudaFilterSeparable() -- invalid kernel (the radius can be up to %i)\n", FILTER_MAX_RADIUS);
+		return cudaErrorInvalidValue;
+	}
+
+	if( !kernelY )
+		kernelY = kernelX;
+
+	filterKernel kx;
+	filterKernel ky;
+
+	memset(&kx, 0, sizeof(filterKernel));
+	memset(&ky, 0, sizeof(filterKernel));
+
+	memcpy(kx.taps, kernelX, (radius * 2 + 1) * sizeof(float));
+	memcpy(ky.taps, kernelY, (radius * 2 + 1) * sizeof(float));
+
+	float* scratch = filterScratchBuffer(stream, width * height * imageFormatChannels(format) * sizeof(float));
+
+	if( !scratch )
+		return cudaErrorMemoryAllocation;
+
+	FILTER_DISPATCH(format, launchFilterSeparable, width, height, scratch, kx, ky, radius, stream);
+}
+
+// launchFilter2D
+template<typename T, int C>
+static cudaError_t launchFilter2D( T* input, T* output, int width, int height, const filterKernel2D& kernel, int radius, cudaStream_t stream )
+{
+	const dim3 blockDim(FILTER_TILE_SIZE, FILTER_TILE_SIZE);
+	const dim3 gridDim(iDivUp(width, blockDim.x), iDivUp(height, blockDim.y));
+
+	const size_t sharedMem = (FILTER_TILE_SIZE + radius * 2) * (FILTER_TILE_SIZE + radius * 2) * C * sizeof(float);
+
+	gpuFilter2D<T,C><<<gridDim, blockDim, sharedMem, stream>>>(input, output, width, height, radius, kernel);
+	return CUDA(cudaGetLastError());
+}
+
+// cudaFilter2D
+cudaError_t cudaFilter2D( void* input, void* output, size_t width, size_t height, imageFormat format,
+                          const float* kernel, int radius, cudaStream_t stream )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cudaFilter2D()") )
+		return cudaErrorInvalidValue;
+
+	if( !kernel || radius < 0 || radius > FILTER_MAX_RADIUS_2D )
+	{
+		LogError(LOG_CUDA "cudaFilter2D() -- invalid kernel (the radius can be up to %i)\n", FILTER_MAX_RADIUS_2D);
+		return cudaErrorInvalidValue;
+	}
+
+	filterKernel2D k;
+
+	memset(&k, 0, sizeof(filterKernel2D));
+	memcpy(k.taps, kernel, (radius * 2 + 1) * (radius * 2 + 1) * sizeof(float));
+
+	input = filterStageInput(input, output, width, height, format, stream);
+
+	if( !input )
+		return cudaErrorMemoryAllocation;
+
+	FILTER_DISPATCH(format, launchFilter2D, width, height, k, radius, stream);
+}
+
+// cudaFilterGaussian
+cudaError_t cudaFilterGaussian( void* input, void* output, size_t width, size_t height, imageFormat format,
+                                float sigma, int radius, cudaStream_t stream )
+{
+	float kernel[FILTER_MAX_RADIUS * 2 + 1];
+
+	radius = cudaFilterGaussianKernel(kernel, sigma, radius);
+
+	if( radius < 0 )
+	{
+		LogError(LOG_CUDA "cudaFilterGaussian() -- invalid sigma (%f) or radius (the radius can be up to %i)\n", sigma, FILTER_MAX_RADIUS);
+		return cudaErrorInvalidValue;
+	}
+
+	return cudaFilterSeparable(input, output, width, height, format, kernel, kernel, radius, stream);
+}
+
+// cudaFilterBox
+cudaError_t cudaFilterBox( void* input, void* output, size_t width, size_t height, imageFormat format,
+                           int radius, cudaStream_t stream )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cudaFilterBox()") )
+		return cudaErrorInvalidValue;
+
+	if( radius < 0 )
+		return cudaErrorInvalidValue;
+
+	float* scratch = filterScratchBuffer(stream, width * height * imageFormatChannels(format) * sizeof(float));
+
+	if( !scratch )
+		return cudaErrorMemoryAllocation;
+
+	FILTER_DISPATCH(format, launchFilterBox, width, height, scratch, radius, stream);
+}
+
+// launchFilterGradient
+template<typename T, int C>
+static cudaError_t launchFilterGradient( T* input, T* output, int width, int height, cudaGradientOperator op, 
+                                         cudaGradientMode mode, float scale, cudaStream_t stream )
+{
+	const dim3 blockDim(FILTER_TILE_SIZE, FILTER_TILE_SIZE);
+	const dim3 gridDim(iDivUp(width, blockDim.x), iDivUp(height, blockDim.y));
+
+	const size_t sharedMem = (FILTER_TILE_SIZE + 2) * (FILTER_TILE_SIZE + 2) * C * sizeof(float);
+
+	const float outer  = (op == FILTER_SCHARR) ? 3.0f : 1.0f;
+	const float center = (op == FILTER_SCHARR) ? 10.0f : 2.0f;
+
+	gpuFilterGradient<T,C><<<gridDim, blockDim, sharedMem, stream>>>(input, output, width, height, outer, center, mode, scale);
+	return CUDA(cudaGetLastError());
+}
+
+// cudaFilterGradient
+cudaError_t cudaFilterGradient( void* input, void* output, size_t width, size_t height, imageFormat format,
+                                cudaGradientOperator op, cudaGradientMode mode, float scale, cudaStream_t stream )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cudaFilterGradient()") )
+		return cudaErrorInvalidValue;
+
+	input = filterStageInput(input, output, width, height, format, stream);
+
+	if( !input )
+		return cudaErrorMemoryAllocation;
+
+	FILTER_DISPATCH(format, launchFilterGradient, width, height, op, mode, scale, stream);
+}
+
+// launchFilterMedian
+template<typename T, int C>
+static cudaError_t launchFilterMedian( T* input, T* output, int width, int height, int size, cudaStream_t stream )
+{
+	const dim3 blockDim(FILTER_TILE_SIZE, FILTER_TILE_SIZE);
+	const dim3 gridDim(iDivUp(width, blockDim.x), iDivUp(height, blockDim.y));
+
+	const size_t sharedMem = (FILTER_TILE_SIZE + size - 1) * (FILTER_TILE_SIZE + size - 1) * C * sizeof(float);
+
+	if( size == 3 )
+		gpuFilterMedian<T,C,1><<<gridDim, blockDim, sharedMem, stream>>>(input, output, width, height);
+	else if( size == 5 )
+		gpuFilterMedian<T,C,2><<<gridDim, blockDim, sharedMem, stream>>>(input, output, width, height);
+	else
+		return cudaErrorInvalidValue;
+
+	return CUDA(cudaGetLastError());
+}
+
+// cudaFilterMedian
+cudaError_t cudaFilterMedian( void* input, void* output, size_t width, size_t height, imageFormat format,
+                              int size, cudaStream_t stream )
+{
+	if( !validateFilterArgs(input, output, width, height, format, "cudaFilterMedian()") )
+		return cudaErrorInvalidValue;
+
+	if( size != 3 && size != 5 )
+	{
+		LogError(LOG_CUDA "cudaFilterMedian() -- invalid size %i (must be 3 or 5)\n", size);
+		return cudaErrorInvalidValue;
+	}
+
+	input = filterStageInput(input, output, width, height, format, stream);
+
+	if( !input )
+		return cudaErrorMemoryAllocation;
+
+	FILTER_DISPATCH(format, launchFilterMedian, width, height, size, stream);
+}
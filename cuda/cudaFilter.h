@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CUDA_FILTER_H__
+#define __CUDA_FILTER_H__
+
+
+#include "cudaUtility.h"
+#include "imageFormat.h"
+
+
+/**
+ * The maximum radius of the kernels passed to cudaFilterSeparable() and cudaFilterGaussian(),
+ * which can have up to `FILTER_MAX_RADIUS * 2 + 1` taps in each dimension.
+ * @ingroup filter
+ */
+#define FILTER_MAX_RADIUS 15
+
+/**
+ * The maximum radius of the kernels passed to cudaFilter2D(),
+ * which can have up to `(FILTER_MAX_RADIUS_2D * 2 + 1)^2` taps.
+ * @ingroup filter
+ */
+#define FILTER_MAX_RADIUS_2D 5
+
+
+/**
+ * Gradient operators used by cudaFilterGradient()
+ * @ingroup filter
+ */
+enum cudaGradientOperator
+{
+	FILTER_SOBEL,		/**< 3x3 Sobel operator (smoothing weights 1,2,1) */
+	FILTER_SCHARR		/**< 3x3 Scharr operator (smoothing weights 3,10,3), which is more rotationally accurate */
+};
+
+/**
+ * Output modes of cudaFilterGradient()
+ * @ingroup filter
+ */
+enum cudaGradientMode
+{
+	GRADIENT_X,		/**< Horizontal derivative */
+	GRADIENT_Y,		/**< Vertical derivative */
+	GRADIENT_MAGNITUDE	/**< Gradient magnitude, `sqrt(dx^2 + dy^2)` */
+};
+
+
+/**
+ * Convolve an image on the GPU with a separable kernel, by first filtering the rows with
+ * `kernelX` and then the columns with `kernelY`.  Each kernel has `radius * 2 + 1` taps, 
+ * and the radius can be up to FILTER_MAX_RADIUS.  Pixels outside of the image are clamped
+ * to the nearest edge.  The intermediate results are kept in floating-point, so the input
+ * and output can be the same image.
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param output the output image, with the same dimensions and format as the input
+ * @param kernelX the horizontal kernel weights in CPU memory
+ * @param kernelY the vertical kernel weights in CPU memory (if NULL, `kernelX` is used)
+ *
+ * @ingroup filter
+ */
+cudaError_t cudaFilterSeparable( void* input, void* output, size_t width, size_t height, imageFormat format,
+                                 const float* kernelX, const float* kernelY, int radius, cudaStream_t stream=0 );
+
+/**
+ * Convolve an image on the GPU with a small 2D kernel (for example, to sharpen or emboss).
+ * The kernel is stored in row-major order with `(radius * 2 + 1)^2` weights, and the radius
+ * can be up to FILTER_MAX_RADIUS_2D.  Pixels outside of the image are clamped to the nearest edge.
+ * The input and output can be the same image (the input then gets copied to a scratch buffer first).
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param output the output image, with the same dimensions and format as the input
+ * @param kernel the kernel weights in CPU memory
+ *
+ * @ingroup filter
+ */
+cudaError_t cudaFilter2D( void* input, void* output, size_t width, size_t height, imageFormat format,
+                          const float* kernel, int radius, cudaStream_t stream=0 );
+
+/**
+ * Apply a Gaussian blur to an image on the GPU with a separable kernel.
+ * If the radius is 0, it's set to `ceil(sigma * 3)` (limited to FILTER_MAX_RADIUS).
+ * For larger blurs, cudaFilterBox() has a cost that doesn't depend on the radius.
+ * The input and output can be the same image.
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param output the output image, with the same dimensions and format as the input
+ * @param sigma the standard deviation of the Gaussian (in pixels)
+ * @param radius the radius of the kernel, or 0 to compute it from sigma
+ *
+ * @ingroup filter
+ */
+cudaError_t cudaFilterGaussian( void* input, void* output, size_t width, size_t height, imageFormat format,
+                                float sigma, int radius=0, cudaStream_t stream=0 );
+
+/**
+ * Apply a box blur (the mean of the `(radius * 2 + 1)^2` neighborhood) to an image on the GPU.
+ * This uses running sums along the rows and columns, so the cost per pixel stays the same
+ * regardless of the radius.  The input and output can be the same image.
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param output the output image, with the same dimensions and format as the input
+ * @param radius the radius of the box (any size)
+ *
+ * @ingroup filter
+ */
+cudaError_t cudaFilterBox( void* input, void* output, size_t width, size_t height, imageFormat format,
+                           int radius, cudaStream_t stream=0 );
+
+/**
+ * Compute the image gradient on the GPU with the Sobel or Scharr operator.
+ * The derivatives are unnormalized, so use `scale` to bring them into the desired range
+ * (for example, 1/8 for Sobel or 1/32 for Scharr gives the per-pixel difference).
+ * uint8 images get the absolute value of GRADIENT_X and GRADIENT_Y, while float images keep the sign.
+ * The alpha channel of RGBA/BGRA images is passed through.  The input and output can be the same
+ * image (the input then gets copied to a scratch buffer first).
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param output the output image, with the same dimensions and format as the input
+ *
+ * @ingroup filter
+ */
+cudaError_t cudaFilterGradient( void* input, void* output, size_t width, size_t height, imageFormat format,
+                                cudaGradientOperator op=FILTER_SOBEL, cudaGradientMode mode=GRADIENT_MAGNITUDE, 
+                                float scale=1.0f, cudaStream_t stream=0 );
+
+/**
+ * Apply a median filter to each channel of an image on the GPU.
+ * The input and output can be the same image (the input then gets copied to a scratch buffer first).
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param output the output image, with the same dimensions and format as the input
+ * @param size the size of the neighborhood (either 3 for 3x3, or 5 for 5x5)
+ *
+ * @ingroup filter
+ */
+cudaError_t cudaFilterMedian( void* input, void* output, size_t width, size_t height, imageFormat format,
+                              int size=3, cudaStream_t stream=0 );
+
+/**
+ * Convolve an image on the CPU with a separable kernel.
+ * @see cudaFilterSeparable() for a description of the parameters.
+ * @ingroup filter
+ */
+bool cpuFilterSeparable( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                         const float* kernelX, const float* kernelY, int radius );
+
+/**
+ * Convolve an image on the CPU with a small 2D kernel.
+ * The input and output can be the same image.
+ * @see cudaFilter2D() for a description of the parameters.
+ * @ingroup filter
+ */
+bool cpuFilter2D( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                  const float* kernel, int radius );
+
+/**
+ * Apply a Gaussian blur to an image on the CPU.
+ * @see cudaFilterGaussian() for a description of the parameters.
+ * @ingroup filter
+ */
+bool cpuFilterGaussian( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                        float sigma, int radius=0 );
+
+/**
+ * Apply a box blur to an image on the CPU using running sums.
+ * @see cudaFilterBox() for a description of the parameters.
+ * @ingroup filter
+ */
+bool cpuFilterBox( const void* input, void* output, size_t width, size_t height, imageFormat format, int radius );
+
+/**
+ * Compute the image gradient on the CPU with the Sobel or Scharr operator.
+ * The input and output can be the same image.
+ * @see cudaFilterGradient() for a description of the parameters.
+ * @ingroup filter
+ */
+bool cpuFilterGradient( const void* input, void* output, size_t width, size_t height, imageFormat format,
+                        cudaGradientOperator op=FILTER_SOBEL, cudaGradientMode mode=GRADIENT_MAGNITUDE, 
+                        float scale=1.0f );
+
+/**
+ * Apply a 3x3 or 5x5 median filter to an image on the CPU.
+ * The input and output can be the same image.
+ * @see cudaFilterMedian() for a description of the parameters.
+ * @ingroup filter
+ */
+bool cpuFilterMedian( const void* input, void* output, size_t width, size_t height, imageFormat format, int size=3 );
+
+/**
+ * Compute the weights of a normalized Gaussian kernel with `radius * 2 + 1` taps.
+ * If the radius is 0, it's set to `ceil(sigma * 3)` (limited to FILTER_MAX_RADIUS).
+ *
+ * @param kernel array that receives the weights (must have at least `FILTER_MAX_RADIUS * 2 + 1` elements)
+ * @returns the radius of the kernel, or -1 if the parameters were invalid.
+ *
+ * @ingroup filter
+ */
+int cudaFilterGaussianKernel( float* kernel, float sigma, int radius=0 );
+
+
+#endif
@@ -29,6 +29,8 @@
 #include "filesystem.h"
 #include "logging.h"
 
+#include <limits.h>
+
 #define STBTT_STATIC
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "../image/stb/stb_truetype.h"
@@ -48,6 +50,27 @@ struct __align__(16) GlyphCommand
 	short height;	// height of the glyph in pixels
 };
 
+// Struct for one character to render from an SDF atlas
+struct __align__(16) GlyphCommandSDF
+{
+	float x;		// x coordinate in output image of the glyph's top-left corner (including SDF padding)
+	float y;		// y coordinate in output image of the glyph's top-left corner (including SDF padding)
+	short u;		// x texture coordinate in the SDF atlas where the glyph resides
+	short v;		// y texture coordinate in the SDF atlas where the glyph resides
+	short width;	// width of the glyph in the SDF atlas
+	short height;	// height of the glyph in the SDF atlas
+};
+
+// Struct for one cached text sprite to blit
+struct __align__(16) SpriteCommand
+{
+	uchar4* sprite;	// pointer to the RGBA sprite in GPU memory
+	short x;		// x coordinate in output image to begin drawing the sprite at
+	short y;		// y coordinate in output image to begin drawing the sprite at
+	short width;	// width of the sprite in pixels
+	short height;	// height of the sprite in pixels
+};
+
 
 // adaptFontSize
 float adaptFontSize( uint32_t dimension )
@@ -74,6 +97,13 @@ float adaptFontSize( uint32_t dimension )
 cudaFont::cudaFont()
 {
 	mSize = 0.0f;
+	mSDF  = false;
+
+	mOutlineColor = make_float4(0,0,0,0);
+	mOutlineWidth = 1.0f;
+
+	mShadowColor  = make_float4(0,0,0,0);
+	mShadowOffset = make_int2(2,2);
 	
 	mCommandCPU = NULL;
 	mCommandGPU = NULL;
@@ -86,6 +116,13 @@ cudaFont::cudaFont()
 	mRectsGPU   = NULL;
 	mRectIndex  = 0;
 
+	mSpriteCmdCPU   = NULL;
+	mSpriteCmdGPU   = NULL;
+	mSpriteCmdIndex = 0;
+
+	mCacheSize  = 0;
+	mSpriteBatch = 1;
+
 	mFontMapWidth  = 256;
 	mFontMapHeight = 256;
 }
@@ -95,6 +132,16 @@ cudaFont::cudaFont()
 // destructor
 cudaFont::~cudaFont()
 {
+	freeCache();
+
+	if( mSpriteCmdCPU != NULL )
+	{
+		CUDA(cudaFreeHost(mSpriteCmdCPU));
+		
+		mSpriteCmdCPU = NULL; 
+		mSpriteCmdGPU = NULL;
+	}
+
 	if( mRectsCPU != NULL )
 	{
 		CUDA(cudaFreeHost(mRectsCPU));
@@ -174,8 +221,55 @@ cudaFont* cudaFont::Create( const char* font, float size )
 }
 
 
-// init
-bool cudaFont::init( const char* filename, float size )
+// CreateSDF
+cudaFont* cudaFont::CreateSDF( const char* font, float size )
+{
+	// default fonts
+	if( !font )
+	{
+		std::vector<std::string> fonts;
+	
+		fonts.push_back("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf");
+		fonts.push_back("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf");
+
+		return CreateSDF(fonts, size);
+	}
+
+	// create new font
+	cudaFont* c = new cudaFont();
+	
+	if( !c )
+		return NULL;
+		
+	if( !c->initSDF(font, size) )
+	{
+		delete c;
+		return NULL;
+	}
+
+	return c;
+}
+
+
+// CreateSDF
+cudaFont* cudaFont::CreateSDF( const std::vector<std::string>& fonts, float size )
+{
+	const uint32_t numFonts = fonts.size();
+
+	for( uint32_t n=0; n < numFonts; n++ )
+	{
+		cudaFont* font = CreateSDF(fonts[n].c_str(), size);
+
+		if( font != NULL )
+			return font;
+	}
+
+	return NULL;
+}
+
+
+// loadFontFile
+static uint8_t* loadFontFile( const char* filename )
 {
 	// validate parameters
 	if( !filename )
@@ -187,16 +281,16 @@ bool cudaFont::init( const char* filename, float size )
 	if( !ttf_size )
 	{
 		LogError(LOG_CUDA "font doesn't exist or empty file '%s'\n", filename);
- 		return false;
+ 		return NULL;
 	}
 
 	// allocate memory to store the font file
-	void* ttf_buffer = malloc(ttf_size);
+	uint8_t* ttf_buffer = (uint8_t*)malloc(ttf_size);
 
 	if( !ttf_buffer )
 	{
 		LogError(LOG_CUDA "failed to allocate %zu byte buffer for reading '%s'\n", ttf_size, filename);
-		return false;
+		return NULL;
 	}
 
 	// open the font file
@@ -206,7 +300,7 @@ bool cudaFont::init( const char* filename, float size )
 	{
 		LogError(LOG_CUDA "failed to open '%s' for reading\n", filename);
 		free(ttf_buffer);
-		return false;
+		return NULL;
 	}
 
 	// read the font file
@@ -220,9 +314,22 @@ bool cudaFont::init( const char* filename, float size )
 		LogError(LOG_CUDA "(read %zu bytes, expected %zu bytes)\n", ttf_read, ttf_size);
 
 		free(ttf_buffer);
-		return false;
+		return NULL;
 	}
 
+	return ttf_buffer;
+}
+
+
+// init
+bool cudaFont::init( const char* filename, float size )
+{
+	// load the TTF font data
+	uint8_t* ttf_buffer = loadFontFile(filename);
+
+	if( !ttf_buffer )
+		return false;
+
 	// buffer that stores the coordinates of the baked glyphs
 	stbtt_bakedchar bakeCoords[NumGlyphs];
 
@@ -240,7 +347,7 @@ bool cudaFont::init( const char* filename, float size )
 		}
 
 		// attempt to pack the bitmap
-		const int result = stbtt_BakeFontBitmap((uint8_t*)ttf_buffer, 0, size, 
+		const int result = stbtt_BakeFontBitmap(ttf_buffer, 0, size, 
 										mFontMapCPU, mFontMapWidth, mFontMapHeight,
 									     FirstGlyph, NumGlyphs, bakeCoords);
 
@@ -317,11 +424,195 @@ bool cudaFont::init( const char* filename, float size )
 	if( !cudaAllocMapped((void**)&mRectsCPU, (void**)&mRectsGPU, sizeof(float4) * MaxCommands) )
 		return false;
 
+	// allocate memory for cached sprite command buffer
+	if( !cudaAllocMapped(&mSpriteCmdCPU, &mSpriteCmdGPU, sizeof(SpriteCommand) * MaxCommands) )
+		return false;
+
+	mSize = size;
+	return true;
+}
+
+
+// initSDF
+bool cudaFont::initSDF( const char* filename, float size )
+{
+	// load the TTF font data
+	uint8_t* ttf_buffer = loadFontFile(filename);
+
+	if( !ttf_buffer )
+		return false;
+
+	stbtt_fontinfo fontInfo;
+
+	if( !stbtt_InitFont(&fontInfo, ttf_buffer, stbtt_GetFontOffsetForIndex(ttf_buffer, 0)) )
+	{
+		LogError(LOG_CUDA "failed to parse font '%s'\n", filename);
+		free(ttf_buffer);
+		return false;
+	}
+
+	// rasterize the SDF of each glyph at the base size
+	const float scale = stbtt_ScaleForPixelHeight(&fontInfo, SDFBaseSize);
+	const float distScale = float(SDFOnEdge) / float(SDFPadding);
+
+	uint8_t* glyphSDF[NumGlyphs];
+
+	for( uint32_t n=0; n < NumGlyphs; n++ )
+	{
+		int width = 0;
+		int height = 0;
+		int xOffset = 0;
+		int yOffset = 0;
+
+		glyphSDF[n] = stbtt_GetCodepointSDF(&fontInfo, scale, n + FirstGlyph, SDFPadding, SDFOnEdge, distScale, 
+		                                    &width, &height, &xOffset, &yOffset);
+
+		int advance = 0;
+		int leftBearing = 0;
+
+		stbtt_GetCodepointHMetrics(&fontInfo, n + FirstGlyph, &advance, &leftBearing);
+
+		// glyphs without any outline (like spaces) only have an advance
+		mGlyphInfo[n].width  = glyphSDF[n] != NULL ? width : 0;
+		mGlyphInfo[n].height = glyphSDF[n] != NULL ? height : 0;
+
+		mGlyphInfo[n].xAdvance = advance * scale;
+		mGlyphInfo[n].xOffset  = xOffset + SDFPadding;	// offsets are stored without the padding,
+		mGlyphInfo[n].yOffset  = yOffset + SDFPadding;	// so they're the same as the baked bitmaps
+	}
+
+	// pack the glyphs into rows, increasing the size of the atlas until they all fit
+	while(true)
+	{
+		int x = 0;
+		int y = 0;
+		int rowHeight = 0;
+		bool fits = true;
+
+		for( uint32_t n=0; n < NumGlyphs && fits; n++ )
+		{
+			if( mGlyphInfo[n].width == 0 )
+				continue;
+
+			if( x + mGlyphInfo[n].width > mFontMapWidth )
+			{
+				x = 0;
+				y += rowHeight;
+				rowHeight = 0;
+			}
+
+			if( y + mGlyphInfo[n].height > mFontMapHeight )
+				fits = false;
+
+			mGlyphInfo[n].x = x;
+			mGlyphInfo[n].y = y;
+
+			x += mGlyphInfo[n].width;
+
+			if( rowHeight < mGlyphInfo[n].height )
+				rowHeight = mGlyphInfo[n].height;
+		}
+
+		if( fits )
+			break;
+
+		if( mFontMapHeight < mFontMapWidth )
+			mFontMapHeight *= 2;
+		else
+			mFontMapWidth *= 2;
+	}
+
+	// allocate memory for the SDF atlas and copy the glyphs into it
+	const size_t fontMapSize = mFontMapWidth * mFontMapHeight * sizeof(unsigned char);
+
+	if( !cudaAllocMapped((void**)&mFontMapCPU, (void**)&mFontMapGPU, fontMapSize) )
+	{
+		LogError(LOG_CUDA "failed to allocate %zu bytes to store %ix%i SDF font atlas\n", fontMapSize, mFontMapWidth, mFontMapHeight);
+		
+		for( uint32_t n=0; n < NumGlyphs; n++ )
+			stbtt_FreeSDF(glyphSDF[n], NULL);
+
+		free(ttf_buffer);
+		return false;
+	}
+
+	for( uint32_t n=0; n < NumGlyphs; n++ )
+	{
+		if( !glyphSDF[n] )
+			continue;
+
+		for( int y=0; y < mGlyphInfo[n].height; y++ )
+			memcpy(mFontMapCPU + (mGlyphInfo[n].y + y) * mFontMapWidth + mGlyphInfo[n].x, 
+				  glyphSDF[n] + y * mGlyphInfo[n].width, mGlyphInfo[n].width);
+
+		stbtt_FreeSDF(glyphSDF[n], NULL);
+	}
+
+	free(ttf_buffer);
+
+	LogVerbose(LOG_CUDA "packed %u glyphs in %ix%i SDF atlas (base size=%ipx)\n", NumGlyphs, mFontMapWidth, mFontMapHeight, SDFBaseSize);
+
+	// allocate memory for GPU command buffer	
+	if( !cudaAllocMapped(&mCommandCPU, &mCommandGPU, sizeof(GlyphCommandSDF) * MaxCommands) )
+		return false;
+	
+	// allocate memory for background rect buffers
+	if( !cudaAllocMapped((void**)&mRectsCPU, (void**)&mRectsGPU, sizeof(float4) * MaxCommands) )
+		return false;
+
+	mSize = size;
+	mSDF  = true;
+
+	return true;
+}
+
+
+// SetSize
+bool cudaFont::SetSize( float size )
+{
+	if( size == mSize )
+		return true;
+
+	if( !mSDF )
+	{
+		LogError(LOG_CUDA "cudaFont::SetSize() -- only fonts created with cudaFont::CreateSDF() can be resized\n");
+		return false;
+	}
+
+	if( size <= 0.0f )
+		return false;
+
 	mSize = size;
+
+	mExtents.clear();	// cached extents depend on the size
+	mExtentsMap.clear();
+
 	return true;
 }
 
 
+// SetOutline
+void cudaFont::SetOutline( const float4& color, float width )
+{
+	if( !mSDF && color.w > 0 )
+		LogWarning(LOG_CUDA "cudaFont::SetOutline() -- outlines are only supported by SDF fonts\n");
+
+	mOutlineColor = color;
+	mOutlineWidth = width;
+}
+
+
+// SetShadow
+void cudaFont::SetShadow( const float4& color, const int2& offset )
+{
+	if( !mSDF && color.w > 0 )
+		LogWarning(LOG_CUDA "cudaFont::SetShadow() -- shadows are only supported by SDF fonts\n");
+
+	mShadowColor  = color;
+	mShadowOffset = offset;
+}
+
+
 /*inline __host__ __device__ float4 operator*(float4 a, float4 b)
 {
     return make_float4(a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w);
@@ -419,6 +710,14 @@ bool cudaFont::OverlayText( void* image, imageFormat format, uint32_t width, uin
 		return false;
 	}
 
+	// SDF fonts are scaled on the GPU
+	if( mSDF )
+		return overlayTextSDF(image, format, width, height, strings, color, bg_color, bg_padding, stream);
+
+	// use the pre-rendered sprites if caching is enabled
+	if( mCacheSize > 0 )
+		return overlaySprites(image, format, width, height, strings, color, bg_color, bg_padding, stream);
+
 	
 	const bool has_bg = bg_color.w > 0.0f;
 	int2 maxGlyphSize = make_int2(0,0);
@@ -596,7 +895,56 @@ int4 cudaFont::TextExtents( const char* str, int x, int y )
 	if( !str )
 		return make_int4(0,0,0,0);
 
+	// get the total advance and max 'height' of the string
+	int2 advance;
+
+	if( mCacheSize > 0 )
+	{
+		const std::string key(str);
+		auto iter = mExtentsMap.find(key);
+
+		if( iter != mExtentsMap.end() )
+		{
+			mExtents.splice(mExtents.begin(), mExtents, iter->second);
+			advance = iter->second->second;
+		}
+		else
+		{
+			advance = textAdvance(str);
+
+			mExtents.push_front(std::pair<std::string, int2>(key, advance));
+			mExtentsMap[key] = mExtents.begin();
+
+			if( mExtents.size() > mCacheSize )
+			{
+				mExtentsMap.erase(mExtents.back().first);
+				mExtents.pop_back();
+			}
+		}
+	}
+	else
+	{
+		advance = textAdvance(str);
+	}
+
+	// get the starting position of the string
+	int2 pos = make_int2(x,y);
+
+	if( pos.x < 0 )
+		pos.x = 0;
+
+	if( pos.y < 0 )
+		pos.y = 0;
+	
+	return make_int4(x, y, pos.x + advance.x, pos.y + advance.y);
+}
+
+
+// textAdvance
+int2 cudaFont::textAdvance( const char* str )
+{
 	const size_t numChars = strlen(str);
+	const float scale = mSDF ? mSize / SDFBaseSize : 1.0f;
 
 	// determine the max 'height' of the string
 	int maxHeight = 0;
@@ -610,25 +958,16 @@ int4 cudaFont::TextExtents( const char* str, int x, int y )
 		
 		c -= FirstGlyph;
 
-		const int yOffset = abs((int)mGlyphInfo[c].yOffset);
+		const int yOffset = abs((int)(mGlyphInfo[c].yOffset * scale));
 
 		if( maxHeight < yOffset )
 			maxHeight = yOffset;
 	}
 
-	// get the starting position of the string
-	int2 pos = make_int2(x,y);
-
-	if( pos.x < 0 )
-		pos.x = 0;
-
-	if( pos.y < 0 )
-		pos.y = 0;
-	
-	pos.y += maxHeight;
-
-
 	// find the extents of the string
+	int advance = 0;
+	float advanceSDF = 0.0f;
+
 	for( uint32_t n=0; n < numChars; n++ )
 	{
 		char c = str[n];
@@ -640,13 +979,644 @@ int4 cudaFont::TextExtents( const char* str, int x, int y )
 		c -= FirstGlyph;	// rebase char against glyph 0
 		
 		// advance the text position
-		pos.x += mGlyphInfo[c].xAdvance;
+		if( mSDF )
+			advanceSDF += mGlyphInfo[c].xAdvance * scale;
+		else
+			advance += (int)mGlyphInfo[c].xAdvance;
 	}
 
-	return make_int4(x, y, pos.x, pos.y);
+	if( mSDF )
+		advance = advanceSDF;
+
+	return make_int2(advance, maxHeight);
 }
-	
 
 
-				
-	
+// SetCacheSize
+void cudaFont::SetCacheSize( uint32_t maxSprites )
+{
+	mCacheSize = maxSprites;
+
+	if( maxSprites == 0 )
+	{
+		freeCache();
+		return;
+	}
+
+	evictSprites(maxSprites);
+
+	while( mExtents.size() > maxSprites )
+	{
+		mExtentsMap.erase(mExtents.back().first);
+		mExtents.pop_back();
+	}
+}
+
+
+// evictSprites
+void cudaFont::evictSprites( uint32_t maxSprites )
+{
+	std::list<TextSprite*>::iterator iter = mSprites.end();
+	bool synchronized = false;
+
+	// remove the least-recently used sprites first
+	while( mSprites.size() > maxSprites && iter != mSprites.begin() )
+	{
+		iter--;
+
+		TextSprite* sprite = *iter;
+
+		// the batch that's being built still needs its sprites
+		if( sprite->batch == mSpriteBatch )
+			continue;
+
+		// kernels that were already launched (on any stream) could still be reading it
+		if( !synchronized )
+		{
+			CUDA(cudaDeviceSynchronize());
+			synchronized = true;
+		}
+
+		mSpriteMap.erase(sprite->key);
+		iter = mSprites.erase(iter);
+
+		CUDA(cudaFreeHost(sprite->pixelsCPU));
+		delete sprite;
+	}
+}
+
+
+// freeCache
+void cudaFont::freeCache()
+{
+	if( mSprites.size() > 0 )
+		CUDA(cudaDeviceSynchronize());	// wait for kernels that could still be reading them
+
+	for( std::list<TextSprite*>::iterator iter=mSprites.begin(); iter != mSprites.end(); iter++ )
+	{
+		CUDA(cudaFreeHost((*iter)->pixelsCPU));
+		delete *iter;
+	}
+
+	mSprites.clear();
+	mSpriteMap.clear();
+
+	mExtents.clear();
+	mExtentsMap.clear();
+}
+
+
+// getSprite
+cudaFont::TextSprite* cudaFont::getSprite( const std::string& str, const float4& color, const float4& bg_color, int bg_padding )
+{
+	const bool has_bg = bg_color.w > 0.0f;
+
+	// the sprite is keyed by the string and everything that affects its pixels
+	std::string key(str);
+
+	key.append((const char*)&color, sizeof(float4));
+
+	if( has_bg )
+	{
+		key.append((const char*)&bg_color, sizeof(float4));
+		key.append((const char*)&bg_padding, sizeof(int));
+	}
+
+	auto iter = mSpriteMap.find(key);
+
+	if( iter != mSpriteMap.end() )
+	{
+		mSprites.splice(mSprites.begin(), mSprites, iter->second);	// move to front of LRU
+		(*iter->second)->batch = mSpriteBatch;
+		return *iter->second;
+	}
+
+	// layout the glyphs the same way that OverlayText() does, relative to (0,0)
+	const uint32_t numChars = str.size();
+	const int maxHeight = textAdvance(str.c_str()).y;
+
+	std::vector<GlyphCommand> glyphs;
+	glyphs.reserve(numChars);
+
+	int4 box = make_int4(INT_MAX, INT_MAX, INT_MIN, INT_MIN);
+	int pos = 0;
+
+	for( uint32_t n=0; n < numChars; n++ )
+	{
+		char c = str[n];
+		
+		if( c < FirstGlyph || c > LastGlyph )
+			continue;
+		
+		c -= FirstGlyph;
+
+		GlyphCommand cmd;
+
+		cmd.x = pos;
+		cmd.y = maxHeight + mGlyphInfo[c].yOffset;
+		cmd.u = mGlyphInfo[c].x;
+		cmd.v = mGlyphInfo[c].y;
+
+		cmd.width  = mGlyphInfo[c].width;
+		cmd.height = mGlyphInfo[c].height;
+
+		pos += mGlyphInfo[c].xAdvance;
+
+		if( cmd.x < box.x )
+			box.x = cmd.x;
+
+		if( cmd.y < box.y )
+			box.y = cmd.y;
+
+		if( cmd.x + cmd.width > box.z )
+			box.z = cmd.x + cmd.width;
+
+		if( cmd.y + cmd.height > box.w )
+			box.w = cmd.y + cmd.height;
+
+		glyphs.push_back(cmd);
+	}
+
+	if( glyphs.size() == 0 )
+		return NULL;
+
+	if( has_bg )
+	{
+		box.x -= bg_padding;
+		box.y -= bg_padding;
+		box.z += bg_padding;
+		box.w += bg_padding;
+	}
+
+	const int spriteWidth  = box.z - box.x;
+	const int spriteHeight = box.w - box.y;
+
+	if( spriteWidth <= 0 || spriteHeight <= 0 )
+		return NULL;
+
+	// allocate the sprite
+	TextSprite* sprite = new TextSprite();
+
+	sprite->key    = key;
+	sprite->offset = make_int2(box.x, box.y);
+	sprite->width  = spriteWidth;
+	sprite->height = spriteHeight;
+	sprite->batch  = mSpriteBatch;
+
+	if( !cudaAllocMapped((void**)&sprite->pixelsCPU, (void**)&sprite->pixelsGPU, spriteWidth * spriteHeight * sizeof(uchar4)) )
+	{
+		delete sprite;
+		return NULL;
+	}
+
+	// composite the background and glyphs on the CPU (in float, with straight alpha)
+	const int numPixels = spriteWidth * spriteHeight;
+	std::vector<float4> pixels(numPixels, has_bg ? make_float4(bg_color.x, bg_color.y, bg_color.z, bg_color.w / 255.0f) : make_float4(0,0,0,0));
+
+	for( size_t g=0; g < glyphs.size(); g++ )
+	{
+		const GlyphCommand& cmd = glyphs[g];
+
+		for( int gy=0; gy < cmd.height; gy++ )
+		{
+			for( int gx=0; gx < cmd.width; gx++ )
+			{
+				const float px_glyph = mFontMapCPU[(cmd.v + gy) * mFontMapWidth + cmd.u + gx];
+
+				if( px_glyph == 0.0f )
+					continue;
+
+				// same scaling as gpuOverlayText()
+				const float alpha = px_glyph * color.w / (255.0f * 255.0f);
+				const float scale = px_glyph / 255.0f;
+
+				float4& px = pixels[(cmd.y - box.y + gy) * spriteWidth + (cmd.x - box.x + gx)];
+
+				const float a = alpha + px.w * (1.0f - alpha);
+
+				if( a > 0.0f )
+				{
+					px.x = (alpha * scale * color.x + (1.0f - alpha) * px.w * px.x) / a;
+					px.y = (alpha * scale * color.y + (1.0f - alpha) * px.w * px.y) / a;
+					px.z = (alpha * scale * color.z + (1.0f - alpha) * px.w * px.z) / a;
+				}
+
+				px.w = a;
+			}
+		}
+	}
+
+	for( int n=0; n < numPixels; n++ )
+	{
+		const float4 px = pixels[n];
+
+		sprite->pixelsCPU[n] = make_uchar4(fminf(px.x, 255.0f), 
+		                                   fminf(px.y, 255.0f), 
+		                                   fminf(px.z, 255.0f), 
+		                                   fminf(px.w * 255.0f, 255.0f));
+	}
+
+	// insert into the cache, evicting the least-recently used sprite (unless it's in the current batch)
+	mSprites.push_front(sprite);
+	mSpriteMap[key] = mSprites.begin();
+
+	evictSprites(mCacheSize);
+
+#ifdef DEBUG_FONT
+	LogDebug(LOG_CUDA "cached %ix%i text sprite '%s' (%zu sprites)\n", spriteWidth, spriteHeight, str.c_str(), mSprites.size());
+#endif
+
+	return sprite;
+}
+
+
+template<typename T>
+__global__ void gpuOverlaySprites( SpriteCommand* commands, T* image, int imgWidth, int imgHeight ) 
+{
+	const SpriteCommand cmd = commands[blockIdx.x];
+
+	for( int sy=threadIdx.y; sy < cmd.height; sy += blockDim.y )
+	{
+		const int y = cmd.y + sy;
+
+		if( y < 0 || y >= imgHeight )
+			continue;
+
+		for( int sx=threadIdx.x; sx < cmd.width; sx += blockDim.x )
+		{
+			const int x = cmd.x + sx;
+
+			if( x < 0 || x >= imgWidth )
+				continue;
+
+			const uchar4 px_sprite = cmd.sprite[sy * cmd.width + sx];
+
+			if( px_sprite.w == 0 )
+				continue;
+
+			const float4 px_in = cast_vec<float4>(image[y * imgWidth + x]);
+			image[y * imgWidth + x] = cast_vec<T>(alpha_blend(px_in, cast_vec<float4>(px_sprite)));
+		}
+	}
+}
+
+
+// cudaOverlaySprites
+cudaError_t cudaOverlaySprites( SpriteCommand* commands, size_t numCommands, void* image, 
+                                imageFormat format, size_t imgWidth, size_t imgHeight, cudaStream_t stream )
+{
+	if( !commands || !image || numCommands == 0 || imgWidth == 0 || imgHeight == 0 )
+		return cudaErrorInvalidValue;
+
+	const dim3 block(32, 8);
+	const dim3 grid(numCommands);
+
+	if( format == IMAGE_RGB8 )
+		gpuOverlaySprites<uchar3><<<grid, block, 0, stream>>>(commands, (uchar3*)image, imgWidth, imgHeight); 
+	else if( format == IMAGE_RGBA8 )
+		gpuOverlaySprites<uchar4><<<grid, block, 0, stream>>>(commands, (uchar4*)image, imgWidth, imgHeight); 
+	else if( format == IMAGE_RGB32F )
+		gpuOverlaySprites<float3><<<grid, block, 0, stream>>>(commands, (float3*)image, imgWidth, imgHeight); 
+	else if( format == IMAGE_RGBA32F )
+		gpuOverlaySprites<float4><<<grid, block, 0, stream>>>(commands, (float4*)image, imgWidth, imgHeight); 
+	else
+		return cudaErrorInvalidValue;
+
+	return cudaGetLastError();
+}
+
+
+// overlaySprites
+bool cudaFont::overlaySprites( void* image, imageFormat format, uint32_t width, uint32_t height, 
+                               const std::vector< std::pair< std::string, int2 > >& strings,
+                               const float4& color, const float4& bg_color, int bg_padding, 
+                               cudaStream_t stream )
+{
+	const uint32_t numStrings = strings.size();
+
+	// reset the buffer index if we need the space
+	if( mSpriteCmdIndex + numStrings >= MaxCommands )
+		mSpriteCmdIndex = 0;
+
+	int numCommands = 0;
+
+	for( uint32_t s=0; s < numStrings; s++ )
+	{
+		TextSprite* sprite = getSprite(strings[s].first, color, bg_color, bg_padding);
+
+		if( !sprite )
+			continue;
+
+		// get the starting position of the string
+		int2 pos = strings[s].second;
+
+		if( pos.x < 0 )
+			pos.x = 0;
+
+		if( pos.y < 0 )
+			pos.y = 0;
+
+		// flush the batch if the command buffer is full
+		if( mSpriteCmdIndex + numCommands >= MaxCommands )
+		{
+			CUDA(cudaOverlaySprites(((SpriteCommand*)mSpriteCmdGPU) + mSpriteCmdIndex, numCommands, image, format, width, height, stream));
+
+			mSpriteCmdIndex = 0;
+			numCommands = 0;
+		}
+
+		SpriteCommand* cmd = ((SpriteCommand*)mSpriteCmdCPU) + mSpriteCmdIndex + numCommands;
+
+		cmd->sprite = sprite->pixelsGPU;
+		cmd->x      = pos.x + sprite->offset.x;
+		cmd->y      = pos.y + sprite->offset.y;
+		cmd->width  = sprite->width;
+		cmd->height = sprite->height;
+
+		numCommands++;
+	}
+
+	// draw all of the sprites in one launch
+	if( numCommands > 0 )
+	{
+		CUDA(cudaOverlaySprites(((SpriteCommand*)mSpriteCmdGPU) + mSpriteCmdIndex, numCommands, image, format, width, height, stream));
+		mSpriteCmdIndex += numCommands;
+	}
+
+	// unpin this batch's sprites, and trim the cache if it had more strings than fit
+	mSpriteBatch++;
+	evictSprites(mCacheSize);
+
+	return true;
+}
+
+
+
+inline __device__ float smoothstep( float edge0, float edge1, float x )
+{
+	const float t = fminf(fmaxf((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+	return t * t * (3.0f - 2.0f * t);
+}
+
+// bilinear sample of the glyph's SDF, returns 0..1 with the edge at cudaFont::SDFOnEdge/255
+inline __device__ float sampleSDF( const unsigned char* font, int fontWidth, const GlyphCommandSDF& cmd, float gx, float gy )
+{
+	if( gx < 0.0f || gy < 0.0f || gx > cmd.width - 1 || gy > cmd.height - 1 )
+		return 0.0f;
+
+	const int x0 = gx;
+	const int y0 = gy;
+	const int x1 = min(x0 + 1, cmd.width - 1);
+	const int y1 = min(y0 + 1, cmd.height - 1);
+
+	const float fx = gx - x0;
+	const float fy = gy - y0;
+
+	const unsigned char* row0 = font + (cmd.v + y0) * fontWidth + cmd.u;
+	const unsigned char* row1 = font + (cmd.v + y1) * fontWidth + cmd.u;
+
+	const float top    = row0[x0] + (row0[x1] - row0[x0]) * fx;
+	const float bottom = row1[x0] + (row1[x1] - row1[x0]) * fx;
+
+	return (top + (bottom - top) * fy) / 255.0f;
+}
+
+template<typename T>
+__global__ void gpuOverlayTextSDF( unsigned char* font, int fontWidth, GlyphCommandSDF* commands,
+                                   T* image, int imgWidth, int imgHeight, float scale, float edge, float smoothing, 
+                                   float4 color, float4 outlineColor, float outlineEdge,
+                                   float4 shadowColor, int2 shadowOffset ) 
+{
+	const GlyphCommandSDF cmd = commands[blockIdx.x];
+
+	// the area covered by the scaled glyph and its shadow
+	const int x0 = floorf(cmd.x) + min(shadowOffset.x, 0);
+	const int y0 = floorf(cmd.y) + min(shadowOffset.y, 0);
+
+	const int width  = ceilf(cmd.width * scale) + abs(shadowOffset.x) + 1;
+	const int height = ceilf(cmd.height * scale) + abs(shadowOffset.y) + 1;
+
+	for( int ty=threadIdx.y; ty < height; ty += blockDim.y )
+	{
+		const int y = y0 + ty;
+
+		if( y < 0 || y >= imgHeight )
+			continue;
+
+		for( int tx=threadIdx.x; tx < width; tx += blockDim.x )
+		{
+			const int x = x0 + tx;
+
+			if( x < 0 || x >= imgWidth )
+				continue;
+
+			// map the output pixel into the glyph's atlas coordinates
+			const float gx = (x + 0.5f - cmd.x) / scale - 0.5f;
+			const float gy = (y + 0.5f - cmd.y) / scale - 0.5f;
+
+			float4 px = cast_vec<float4>(image[y * imgWidth + x]);
+			bool modified = false;
+
+			// drop shadow
+			if( shadowColor.w > 0.0f )
+			{
+				const float shadow = smoothstep(edge - smoothing, edge + smoothing, 
+				                                sampleSDF(font, fontWidth, cmd, gx - shadowOffset.x / scale, gy - shadowOffset.y / scale));
+
+				if( shadow > 0.0f )
+				{
+					px = alpha_blend(px, make_float4(shadowColor.x, shadowColor.y, shadowColor.z, shadowColor.w * shadow));
+					modified = true;
+				}
+			}
+
+			// fill and outline
+			const float dist = sampleSDF(font, fontWidth, cmd, gx, gy);
+			const float fill = smoothstep(edge - smoothing, edge + smoothing, dist);
+
+			float4 fg = make_float4(color.x, color.y, color.z, color.w * fill);
+
+			if( outlineColor.w > 0.0f )
+			{
+				const float outline = smoothstep(outlineEdge - smoothing, outlineEdge + smoothing, dist);
+
+				fg.x = outlineColor.x + (color.x - outlineColor.x) * fill;
+				fg.y = outlineColor.y + (color.y - outlineColor.y) * fill;
+				fg.z = outlineColor.z + (color.z - outlineColor.z) * fill;
+				fg.w = (outlineColor.w + (color.w - outlineColor.w) * fill) * outline;
+			}
+
+			if( fg.w > 0.0f )
+			{
+				px = alpha_blend(px, fg);
+				modified = true;
+			}
+
+			if( modified )
+				image[y * imgWidth + x] = cast_vec<T>(px);
+		}
+	}
+}
+
+
+// overlayTextSDF
+bool cudaFont::overlayTextSDF( void* image, imageFormat format, uint32_t width, uint32_t height, 
+                               const std::vector< std::pair< std::string, int2 > >& strings,
+                               const float4& color, const float4& bg_color, int bg_padding, 
+                               cudaStream_t stream )
+{
+	const uint32_t numStrings = strings.size();
+	const bool has_bg = bg_color.w > 0.0f;
+
+	const float scale = mSize / SDFBaseSize;
+	const float padding = SDFPadding * scale;
+
+	int numCommands = 0;
+	int numRects = 0;
+	int maxChars = 0;
+
+	// find the total char count
+	for( uint32_t s=0; s < numStrings; s++ )
+		maxChars += strings[s].first.size();
+
+	// reset the buffer indices if we need the space
+	if( mCmdIndex + maxChars >= MaxCommands )
+		mCmdIndex = 0;
+
+	if( has_bg && mRectIndex + numStrings >= MaxCommands )
+		mRectIndex = 0;
+
+	// generate glyph commands and bg rects
+	for( uint32_t s=0; s < numStrings; s++ )
+	{
+		const uint32_t numChars = strings[s].first.size();
+		
+		if( numChars == 0 )
+			continue;
+
+		// get the starting position of the string
+		const int2 advance = textAdvance(strings[s].first.c_str());
+
+		float2 pos = make_float2(strings[s].second.x, strings[s].second.y);
+
+		if( pos.x < 0 )
+			pos.x = 0;
+
+		if( pos.y < 0 )
+			pos.y = 0;
+		
+		pos.y += advance.y;
+
+		// reset the background rect if needed
+		if( has_bg )
+			mRectsCPU[mRectIndex + numRects] = make_float4(width, height, 0, 0);
+
+		// make a glyph command for each character
+		for( uint32_t n=0; n < numChars; n++ )
+		{
+			char c = strings[s].first[n];
+			
+			// make sure the character is in range
+			if( c < FirstGlyph || c > LastGlyph )
+				continue;
+			
+			c -= FirstGlyph;	// rebase char against glyph 0
+
+			if( mGlyphInfo[c].width > 0 )
+			{
+				GlyphCommandSDF* cmd = ((GlyphCommandSDF*)mCommandCPU) + mCmdIndex + numCommands;
+
+				cmd->x = pos.x + mGlyphInfo[c].xOffset * scale - padding;
+				cmd->y = pos.y + mGlyphInfo[c].yOffset * scale - padding;
+				cmd->u = mGlyphInfo[c].x;
+				cmd->v = mGlyphInfo[c].y;
+
+				cmd->width  = mGlyphInfo[c].width;
+				cmd->height = mGlyphInfo[c].height;
+
+				// expand the background rect (without the SDF padding)
+				if( has_bg )
+				{
+					float4* rect = mRectsCPU + mRectIndex + numRects;
+
+					const float x1 = cmd->x + padding;
+					const float y1 = cmd->y + padding;
+					const float x2 = cmd->x + cmd->width * scale - padding;
+					const float y2 = cmd->y + cmd->height * scale - padding;
+
+					if( x1 < rect->x )
+						rect->x = x1;
+
+					if( y1 < rect->y )
+						rect->y = y1;
+
+					if( x2 > rect->z )
+						rect->z = x2;
+
+					if( y2 > rect->w )
+						rect->w = y2;
+				}
+
+				numCommands++;
+			}
+
+			// advance the text position
+			pos.x += mGlyphInfo[c].xAdvance * scale;
+		}
+
+		if( has_bg && mRectsCPU[mRectIndex + numRects].z > 0 )
+		{
+			float4* rect = mRectsCPU + mRectIndex + numRects;
+
+			// apply padding
+			rect->x = floorf(rect->x) - bg_padding;
+			rect->y = floorf(rect->y) - bg_padding;
+			rect->z = ceilf(rect->z) + bg_padding;
+			rect->w = ceilf(rect->w) + bg_padding;
+
+			numRects++;
+		}
+	}
+
+	// draw background rects
+	if( has_bg && numRects > 0 )
+		CUDA(cudaRectFill(image, image, width, height, format, mRectsGPU + mRectIndex, numRects, bg_color, stream));
+
+	if( numCommands == 0 )
+		return true;
+
+	// anti-aliasing width, in SDF units per output pixel
+	const float edge = float(SDFOnEdge) / 255.0f;
+	const float distScale = float(SDFOnEdge) / float(SDFPadding) / 255.0f;
+	const float smoothing = fminf(0.5f * distScale / scale, 0.25f);
+
+	// the outline is the isocontour that's outlineWidth pixels outside the edge
+	const float outlineEdge = fmaxf(edge - mOutlineWidth * distScale / scale, smoothing);
+
+	// draw text characters
+	const dim3 block(16, 16);
+	const dim3 grid(numCommands);
+
+	GlyphCommandSDF* commands = ((GlyphCommandSDF*)mCommandGPU) + mCmdIndex;
+
+	#define LAUNCH_OVERLAY_TEXT_SDF(type) \
+		gpuOverlayTextSDF<type><<<grid, block, 0, stream>>>(mFontMapGPU, mFontMapWidth, commands, (type*)image, width, height, \
+		                                                    scale, edge, smoothing, color, mOutlineColor, outlineEdge, mShadowColor, mShadowOffset)
+
+	if( format == IMAGE_RGB8 )
+		LAUNCH_OVERLAY_TEXT_SDF(uchar3);
+	else if( format == IMAGE_RGBA8 )
+		LAUNCH_OVERLAY_TEXT_SDF(uchar4);
+	else if( format == IMAGE_RGB32F )
+		LAUNCH_OVERLAY_TEXT_SDF(float3);
+	else if( format == IMAGE_RGBA32F )
+		LAUNCH_OVERLAY_TEXT_SDF(float4);
+
+	CUDA(cudaGetLastError());
+
+	// advance the buffer indices
+	mCmdIndex += numCommands;
+	mRectIndex += numRects;
+
+	return true;
+}
@@ -29,6 +29,8 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <unordered_map>
 
 
 /**
@@ -71,6 +73,28 @@ public:
 	 */
 	static cudaFont* Create( const std::vector<std::string>& fonts, float size );
 
+	/**
+	 * Create new CUDA font overlay object using a signed distance field (SDF) atlas.
+	 *
+	 * The glyphs are rasterized once into an SDF atlas, which can then be rendered
+	 * at any size with SetSize() while staying sharp, without needing to create 
+	 * a separate font for each size.  SDF fonts also support outlines and drop
+	 * shadows that are rendered in the same pass (see SetOutline() and SetShadow()).
+	 *
+	 * @param font The name of the TTF font to use (or NULL for the default fonts).
+	 * @param size The initial height of the font, in pixels.
+	 */
+	static cudaFont* CreateSDF( const char* font=NULL, float size=32.0f );
+
+	/**
+	 * Create new CUDA font overlay object using a signed distance field (SDF) atlas.
+	 * @param font A list of font names that are acceptable to use.
+	 *             If the first font isn't found on the system,
+	 *             then the next font from the list will be tried.
+	 * @param size The initial height of the font, in pixels.
+	 */
+	static cudaFont* CreateSDF( const std::vector<std::string>& fonts, float size );
+
 	/**
 	 * Destructor
 	 */
@@ -124,18 +148,96 @@ public:
 	 * Return the size of the font (height in pixels)
 	 */
 	inline float GetSize() const	{ return mSize; }
+
+	/**
+	 * Change the size of the font (height in pixels).
+	 * This is only supported by SDF fonts, and returns false otherwise.
+	 */
+	bool SetSize( float size );
+
+	/**
+	 * Return true if the font is using a signed distance field (SDF) atlas.
+	 */
+	inline bool IsSDF() const		{ return mSDF; }
+
+	/**
+	 * Set the color and width (in pixels) of the text outline.
+	 * This is only supported by SDF fonts.  Set color.w to 0 to disable it (the default).
+	 */
+	void SetOutline( const float4& color, float width=1.0f );
+
+	/**
+	 * Set the color and offset (in pixels) of the text drop shadow.
+	 * This is only supported by SDF fonts.  Set color.w to 0 to disable it (the default).
+	 */
+	void SetShadow( const float4& color, const int2& offset=make_int2(2,2) );
 	
 	/**
 	 * Return the bounding rectangle of the given text string.
 	 */
 	int4 TextExtents( const char* str, int x=0, int y=0 );
 
+	/**
+	 * Enable caching of pre-rendered text sprites.
+	 *
+	 * When enabled, each unique combination of string, color, background,
+	 * and padding passed to OverlayText() is rasterized once into an RGBA
+	 * sprite, and then subsequent draws of it are a batched alpha blit.
+	 * The results of TextExtents() are cached in the same way.  
+	 *
+	 * Once more than `maxSprites` are cached, the least-recently used ones 
+	 * are evicted.  Caching is disabled by default (or when set to 0), as it
+	 * only helps when the same labels are drawn repeatedly over many frames.
+	 */
+	void SetCacheSize( uint32_t maxSprites );
+
+	/**
+	 * Return the maximum number of cached text sprites (0 if disabled).
+	 */
+	inline uint32_t GetCacheSize() const		{ return mCacheSize; }
+
 
 protected:
 	cudaFont();
 	bool init( const char* font, float size );
+	bool initSDF( const char* font, float size );
+
+	bool overlayTextSDF( void* image, imageFormat format, uint32_t width, uint32_t height, 
+	                     const std::vector< std::pair< std::string, int2 > >& text,
+	                     const float4& color, const float4& background, int backgroundPadding, 
+	                     cudaStream_t stream );
+
+	struct TextSprite
+	{
+		std::string key;
+
+		uchar4* pixelsCPU;
+		uchar4* pixelsGPU;
+
+		int2 offset;	// top-left corner of the sprite, relative to the text position
+		int  width;
+		int  height;
+
+		uint32_t batch;	// the last overlaySprites() batch that drew it (pinned while it's being built)
+	};
+
+	TextSprite* getSprite( const std::string& str, const float4& color, const float4& background, int backgroundPadding );
+	bool overlaySprites( void* image, imageFormat format, uint32_t width, uint32_t height, 
+	                     const std::vector< std::pair< std::string, int2 > >& text,
+	                     const float4& color, const float4& background, int backgroundPadding, 
+	                     cudaStream_t stream );
+	int2 textAdvance( const char* str );
+	void evictSprites( uint32_t maxSprites );
+	void freeCache();
 		
 	float mSize;
+	bool  mSDF;
+
+	float4 mOutlineColor;
+	float  mOutlineWidth;
+
+	float4 mShadowColor;
+	int2   mShadowOffset;
 		
 	uint8_t* mFontMapCPU;
 	uint8_t* mFontMapGPU;
@@ -151,11 +253,28 @@ protected:
 	float4* mRectsGPU;
 	int     mRectIndex;
 
+	void* mSpriteCmdCPU;
+	void* mSpriteCmdGPU;
+	int   mSpriteCmdIndex;
+
+	uint32_t mCacheSize;
+	uint32_t mSpriteBatch;
+
+	std::list<TextSprite*> mSprites;
+	std::unordered_map<std::string, std::list<TextSprite*>::iterator> mSpriteMap;
+
+	std::list< std::pair<std::string, int2> > mExtents;
+	std::unordered_map<std::string, std::list< std::pair<std::string, int2> >::iterator> mExtentsMap;
+
 	static const uint32_t MaxCommands = 1024;
 	static const uint32_t FirstGlyph  = 32;
 	static const uint32_t LastGlyph   = 255;
 	static const uint32_t NumGlyphs   = LastGlyph - FirstGlyph;
 
+	static const int SDFBaseSize  = 32;	// glyph height the SDF atlas is rasterized at
+	static const int SDFPadding   = 5;	// SDF border around each glyph (in atlas pixels)
+	static const int SDFOnEdge    = 128;	// SDF value on the glyph's edge
+
 	struct GlyphInfo
 	{
 		uint16_t x;
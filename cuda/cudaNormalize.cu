@@ -21,13 +21,33 @@
  */
 
 #include "cudaNormalize.h"
+#include "cudaReduce.h"
 #include "cudaVector.h"
 
 
+// get the range of the color channels from the image stats (auto-range mode)
+inline __device__ float2 autoRange( const cudaImageStats* stats, float* )	{ return make_float2(stats->min.x, stats->max.x); }
+inline __device__ float2 autoRange( const cudaImageStats* stats, float3* )	{ return make_float2(fminf(fminf(stats->min.x, stats->min.y), stats->min.z), fmaxf(fmaxf(stats->max.x, stats->max.y), stats->max.z)); }
+inline __device__ float2 autoRange( const cudaImageStats* stats, float4* )	{ return autoRange(stats, (float3*)NULL); }
+
+#define rescale(v) ((v - range.x) * scaling_factor + offset)
+
+#define rescaleSetup() \
+	float2 range = input_range; \
+	float offset = 0.0f; \
+	if( stats != NULL ) \
+	{ \
+		range = autoRange(stats, (T*)NULL); \
+		scaling_factor = (output_range.y - output_range.x) / fmaxf(range.y - range.x, 1e-6f); \
+		offset = output_range.x; \
+	}
+
+
 // gpuNormalize
 template <typename T>
 __global__ void gpuNormalize( T* input, T* output, int width, int height, 
-					     float2 input_range, float scaling_factor )
+					     float2 input_range, float scaling_factor,
+					     float2 output_range, const cudaImageStats* stats )
 {
 	const int x = blockIdx.x * blockDim.x + threadIdx.x;
 	const int y = blockIdx.y * blockDim.y + threadIdx.y;
@@ -37,12 +57,12 @@ __global__ void gpuNormalize( T* input, T* output, int width, int height,
 
 	const T px = input[ y * width + x ];
 
-	#define rescale(v) ((v - input_range.x) * scaling_factor)
+	rescaleSetup();
 
 	output[y*width+x] = make_vec<T>(rescale(px.x),
 							  rescale(px.y),
 							  rescale(px.z),
-							  rescale(alpha(px, input_range.y)));
+							  rescale(alpha(px, range.y)));
 }
 
 template<typename T>
@@ -59,11 +79,24 @@ static cudaError_t launchNormalizeRGB( T* input, const float2& input_range,
 
 	const float multiplier = output_range.y / input_range.y;
 
+	// compute the range on the GPU if needed
+	cudaImageStats* stats = NULL;
+
+	if( input_range.x == input_range.y )
+	{
+		stats = cudaReduceStream(stream);
+
+		if( !stats )
+			return cudaErrorMemoryAllocation;
+
+		CUDA_ASSERT(cudaReduceMinMax(input, width, height, imageFormatFromType<T>(), stats, stream));
+	}
+
 	// launch kernel
 	const dim3 blockDim(32,8);
 	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
 
-	gpuNormalize<T><<<gridDim, blockDim, 0, stream>>>(input, output, width, height, input_range, multiplier);
+	gpuNormalize<T><<<gridDim, blockDim, 0, stream>>>(input, output, width, height, input_range, multiplier, output_range, stats);
 
 	return CUDA(cudaGetLastError());
 }
@@ -90,7 +123,8 @@ cudaError_t cudaNormalize( float4* input, const float2& input_range,
 //-----------------------------------------------------------------------------------
 template <typename T>
 __global__ void gpuNormalizeGray( T* input, T* output, int width, int height, 
-					     float2 input_range, float scaling_factor )
+					     float2 input_range, float scaling_factor,
+					     float2 output_range, const cudaImageStats* stats )
 {
 	const int x = blockIdx.x * blockDim.x + threadIdx.x;
 	const int y = blockIdx.y * blockDim.y + threadIdx.y;
@@ -98,6 +132,8 @@ __global__ void gpuNormalizeGray( T* input, T* output, int width, int height,
 	if( x >= width || y >= height )
 		return;
 
+	rescaleSetup();
+
 	const T px = rescale(input[ y * width + x ]);
 	output[y*width+x] = px;
 }
@@ -116,11 +152,24 @@ static cudaError_t launchNormalizeGray( T* input, const float2& input_range,
 
 	const float multiplier = output_range.y / input_range.y;
 
+	// compute the range on the GPU if needed
+	cudaImageStats* stats = NULL;
+
+	if( input_range.x == input_range.y )
+	{
+		stats = cudaReduceStream(stream);
+
+		if( !stats )
+			return cudaErrorMemoryAllocation;
+
+		CUDA_ASSERT(cudaReduceMinMax(input, width, height, imageFormatFromType<T>(), stats, stream));
+	}
+
 	// launch kernel
 	const dim3 blockDim(32,8);
 	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
 
-	gpuNormalizeGray<T><<<gridDim, blockDim, 0, stream>>>(input, output, width, height, input_range, multiplier);
+	gpuNormalizeGray<T><<<gridDim, blockDim, 0, stream>>>(input, output, width, height, input_range, multiplier, output_range, stats);
 
 	return CUDA(cudaGetLastError());
 }
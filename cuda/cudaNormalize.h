@@ -28,10 +28,20 @@
 #include "imageFormat.h"
 
 
+/**
+ * Pass this as the `input_range` to have the range computed automatically on the GPU.
+ * Any range where `input_range.x == input_range.y` will enable the auto-range mode,
+ * which uses cudaReduceMinMax() without needing to sync or copy the range to the CPU.
+ * @ingroup normalization
+ */
+#define NORMALIZE_AUTO_RANGE make_float2(0,0)
+
+
 /**
  * Normalize the pixel intensities of a floating-point grayscale image between two scales.
  * For example, convert an image with values between `[0,1]` to `[0,255]`
- * @param input_range the range of pixel values of the input image (e.g. `[0,1]`)
+ * @param input_range the range of pixel values of the input image (e.g. `[0,1]`),
+ *                    or NORMALIZE_AUTO_RANGE to use the min/max of the input image.
  * @param output_range the desired range of pixel values of the output image (e.g. `[0,255]`)
  * @ingroup normalization
  */
@@ -43,7 +53,8 @@ cudaError_t cudaNormalize( float* input,  const float2& input_range,
 /**
  * Normalize the pixel intensities of a float3 RGB/BGR image between two scales.
  * For example, convert an image with values between `[0,1]` to `[0,255]`
- * @param input_range the range of pixel values of the input image (e.g. `[0,1]`)
+ * @param input_range the range of pixel values of the input image (e.g. `[0,1]`),
+ *                    or NORMALIZE_AUTO_RANGE to use the min/max of the input image.
  * @param output_range the desired range of pixel values of the output image (e.g. `[0,255]`)
  * @ingroup normalization
  */
@@ -55,7 +66,8 @@ cudaError_t cudaNormalize( float3* input,  const float2& input_range,
 /**
  * Normalize the pixel intensities of a float4 RGBA/BGRA image between two scales.
  * For example, convert an image with values between `[0,1]` to `[0,255]`
- * @param input_range the range of pixel values of the input image (e.g. `[0,1]`)
+ * @param input_range the range of pixel values of the input image (e.g. `[0,1]`),
+ *                    or NORMALIZE_AUTO_RANGE to use the min/max of the input image.
  * @param output_range the desired range of pixel values of the output image (e.g. `[0,255]`)
  * @ingroup normalization
  */
@@ -67,7 +79,8 @@ cudaError_t cudaNormalize( float4* input,  const float2& input_range,
 /**
  * Normalize the pixel intensities of an image between two scales.
  * For example, convert an image with values between `[0,1]` to `[0,255]`
- * @param input_range the range of pixel values of the input image (e.g. `[0,1]`)
+ * @param input_range the range of pixel values of the input image (e.g. `[0,1]`),
+ *                    or NORMALIZE_AUTO_RANGE to use the min/max of the input image.
  * @param output_range the desired range of pixel values of the output image (e.g. `[0,255]`)
  * @param format the image format - valid formats are gray32f, rgb32f/bgr32f, and rgba32f/bgra32f.
  * @ingroup normalization
@@ -22,6 +22,8 @@
 
 #include "cudaPointCloud.h"
 #include "cudaMappedMemory.h"
+#include "cudaFilter.h"
+#include "cudaSIMD.h"
 
 #include "glUtility.h"
 #include "glBuffer.h"
@@ -29,6 +31,17 @@
 
 #include "mat33.h"
 #include "logging.h"
+#include "filesystem.h"
+#include "Socket.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
 
 
 // constructor
@@ -36,15 +49,50 @@ cudaPointCloud::cudaPointCloud()
 {
 	mPointsCPU   = NULL;
 	mPointsGPU   = NULL;
+	mNormalsCPU  = NULL;
+	mNormalsGPU  = NULL;
 	mBufferGL    = NULL;
 	mCameraGL    = NULL;
 	mDepthResize = NULL;
-
+	mFileBuffer  = NULL;
+	mScratchGPU  = NULL;
+
+	mFrameStampsCPU = NULL;
+	mFrameStampsGPU = NULL;
+	mRingCounterCPU = NULL;
+	mRingCounterGPU = NULL;
+
+	mRingCapacity = 0;
+	mRingHead     = 0;
+	mRingMaxAge   = 0;
+	mFrameCount   = 0;
+	mHasPose      = false;
+
+	mSequenceFile   = NULL;
+	mSequenceFormat = PCD_BINARY;
+	mSequenceLength = 0;
+
+	mEncodeOrigin   = make_float3(0.0f, 0.0f, 0.0f);
+	mEncodeStep     = make_float3(1.0f, 1.0f, 1.0f);
+	mEncodeFrame    = 0;
+	mEncodeKeyframe = 0;
+	mDecodeFrame    = 0;
+	mDecodeValid    = false;
+	mRecvSize       = 0;
+	mRecvBytes      = 0;
+	mRecvFrameID    = 0;
+
+	mFileBufferSize = 0;
+	mScratchSize = 0;
 	mDepthSize = 0;
 	mNumPoints = 0;
 	mMaxPoints = 0;
+	mHeight    = 1;
 
+	mOrganized      = false;
+	mHostMemory     = false;
 	mHasRGB         = false;
+	mHasNormals     = false;
 	mHasNewPoints	 = false;
 	mHasCalibration = false;
 }
@@ -65,6 +113,20 @@ cudaPointCloud::~cudaPointCloud()
 		mCameraGL = NULL;
 	}
 
+	CloseSequence();
+
+	if( mScratchGPU != NULL )
+	{
+		CUDA(cudaFree(mScratchGPU));
+		mScratchGPU = NULL;
+	}
+
+	if( mFileBuffer != NULL )
+	{
+		free(mFileBuffer);
+		mFileBuffer = NULL;
+	}
+
 	Free();
 }
 
@@ -72,20 +134,48 @@ cudaPointCloud::~cudaPointCloud()
 // Free
 void cudaPointCloud::Free()
 {
+	if( mFrameStampsCPU != NULL )
+	{
+		CUDA(cudaFreeHost(mFrameStampsCPU));
+
+		mFrameStampsCPU = NULL;
+		mFrameStampsGPU = NULL;
+		mRingCounterCPU = NULL;
+		mRingCounterGPU = NULL;
+		mRingCapacity   = 0;
+	}
+
 	if( mBufferGL != NULL )
 	{
 		delete mBufferGL;
 		mBufferGL = NULL;
 	}
 
+	if( mNormalsCPU != NULL )
+	{
+		if( mHostMemory )
+			free(mNormalsCPU);
+		else
+			CUDA(cudaFreeHost(mNormalsCPU));
+
+		mNormalsCPU = NULL;
+		mNormalsGPU = NULL;
+		mHasNormals = false;
+	}
+
 	if( mPointsCPU != NULL )
 	{
-		CUDA(cudaFreeHost(mPointsCPU));
+		if( mHostMemory )
+			free(mPointsCPU);
+		else
+			CUDA(cudaFreeHost(mPointsCPU));
 
 		mPointsCPU = NULL;
 		mPointsGPU = NULL;
 		mNumPoints = 0;
 		mMaxPoints = 0;
+		mHeight    = 1;
+		mHostMemory = false;
 	}
 }
 
@@ -95,8 +185,20 @@ void cudaPointCloud::Clear()
 {
 	if( mPointsGPU != NULL )
 		CUDA(cudaMemset(mPointsGPU, 0, GetMaxSize()));
+	else if( mPointsCPU != NULL )
+		memset(mPointsCPU, 0, GetMaxSize());
 
-	mNumPoints = 0;
+	if( mFrameStampsGPU != NULL )
+	{
+		CUDA(cudaMemset(mFrameStampsGPU, 0xFF, mRingCapacity * sizeof(uint32_t)));
+		*mRingCounterCPU = 0;
+	}
+
+	mRingHead   = 0;
+	mFrameCount = 0;
+	mNumPoints  = 0;
+	mHeight     = 1;
+	mHasNormals = false;
 }
 
 
@@ -123,11 +225,20 @@ bool cudaPointCloud::Reserve( uint32_t maxPoints )
 	// determine size of new memory
 	const size_t maxSize = maxPoints * sizeof(Vertex);
 
-	// allocate new memory
+	// allocate new memory (falling back to CPU memory for systems without a GPU)
 	if( !cudaAllocMapped((void**)&mPointsCPU, (void**)&mPointsGPU, maxSize) )
 	{
-		LogError(LOG_CUDA "failed to allocate %zu bytes for point cloud\n", maxSize);
-		return false;
+		mPointsCPU = (Vertex*)malloc(maxSize);
+		mPointsGPU = NULL;
+
+		if( !mPointsCPU )
+		{
+			LogError(LOG_CUDA "failed to allocate %zu bytes for point cloud\n", maxSize);
+			return false;
+		}
+
+		LogWarning(LOG_CUDA "cudaPointCloud -- failed to allocate mapped memory, using CPU memory instead\n");
+		mHostMemory = true;
 	}
 	
 	mMaxPoints = maxPoints;
@@ -135,6 +246,105 @@ bool cudaPointCloud::Reserve( uint32_t maxPoints )
 }
 
 
+// allocRing
+bool cudaPointCloud::allocRing( uint32_t capacity )
+{
+	if( mFrameStampsCPU != NULL && mRingCapacity == capacity )
+		return true;
+
+	if( mFrameStampsCPU != NULL )
+	{
+		CUDA(cudaFreeHost(mFrameStampsCPU));
+
+		mFrameStampsCPU = NULL;
+		mFrameStampsGPU = NULL;
+	}
+
+	// the frame stamps are followed by the counter of points appended during Extract()
+	const size_t size = (capacity + 1) * sizeof(uint32_t);
+
+	if( !cudaAllocMapped((void**)&mFrameStampsCPU, (void**)&mFrameStampsGPU, size) )
+	{
+		LogError(LOG_CUDA "failed to allocate %zu bytes for point cloud frame stamps\n", size);
+		return false;
+	}
+
+	mRingCounterCPU = mFrameStampsCPU + capacity;
+	mRingCounterGPU = mFrameStampsGPU + capacity;
+
+	return true;
+}
+
+
+// SetAccumulation
+bool cudaPointCloud::SetAccumulation( uint32_t capacity, uint32_t maxAge )
+{
+	if( capacity == 0 )
+	{
+		if( mFrameStampsCPU != NULL )
+		{
+			CUDA(cudaFreeHost(mFrameStampsCPU));
+
+			mFrameStampsCPU = NULL;
+			mFrameStampsGPU = NULL;
+			mRingCounterCPU = NULL;
+			mRingCounterGPU = NULL;
+		}
+
+		mRingCapacity = 0;
+		Clear();
+		return true;
+	}
+
+	// allocate the memory once up-front (Reserve() frees the ring if it reallocates)
+	if( !Reserve(capacity) )
+		return false;
+
+	if( mHostMemory )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::SetAccumulation() -- accumulation mode requires a GPU\n");
+		return false;
+	}
+
+	if( !allocRing(capacity) )
+		return false;
+
+	mRingCapacity = capacity;
+	mRingMaxAge   = maxAge;
+
+	Clear();
+	return true;
+}
+
+
+// SetPose
+void cudaPointCloud::SetPose( const float pose[4][4] )
+{
+	for( int i=0; i < 3; i++ )
+		for( int j=0; j < 4; j++ )
+			mPose[i][j] = pose[i][j];
+
+	mHasPose = true;
+}
+
+
+// SetPose
+void cudaPointCloud::SetPose( const float rotation[3][3], const float3& translation )
+{
+	const float t[3] = { translation.x, translation.y, translation.z };
+
+	for( int i=0; i < 3; i++ )
+	{
+		for( int j=0; j < 3; j++ )
+			mPose[i][j] = rotation[i][j];
+
+		mPose[i][3] = t[i];
+	}
+
+	mHasPose = true;
+}
+
+
 // allocBufferGL
 bool cudaPointCloud::allocBufferGL()
 {
@@ -179,10 +389,90 @@ bool cudaPointCloud::allocDepthResize( size_t size )
 }
 
 
+// allocScratch
+bool cudaPointCloud::allocScratch( size_t size )
+{
+	if( mScratchGPU != NULL && mScratchSize >= size )
+		return true;
+
+	if( mScratchGPU != NULL )
+	{
+		CUDA(cudaFree(mScratchGPU));
+		mScratchGPU = NULL;
+	}
+
+	mScratchSize = 0;
+
+	if( CUDA_FAILED(cudaMalloc(&mScratchGPU, size)) )
+	{
+		LogError(LOG_CUDA "cudaPointCloud -- failed to allocate %zu bytes of scratch memory\n", size);
+		return false;
+	}
+
+	mScratchSize = size;
+	return true;
+}
+
+
+// allocNormals
+bool cudaPointCloud::allocNormals()
+{
+	if( mNormalsCPU != NULL )
+		return true;	// Free() releases the normals when Reserve() reallocates the points
+
+	const size_t size = mMaxPoints * sizeof(float3);
+
+	if( mHostMemory )
+	{
+		mNormalsCPU = (float3*)malloc(size);
+		mNormalsGPU = NULL;
+
+		if( !mNormalsCPU )
+		{
+			LogError(LOG_CUDA "failed to allocate %zu bytes for point cloud normals\n", size);
+			return false;
+		}
+	}
+	else if( !cudaAllocMapped((void**)&mNormalsCPU, (void**)&mNormalsGPU, size) )
+	{
+		LogError(LOG_CUDA "failed to allocate %zu bytes for point cloud normals\n", size);
+		return false;
+	}
+
+	return true;
+}
+
+
+// allocFileBuffer
+bool cudaPointCloud::allocFileBuffer( size_t size )
+{
+	if( mFileBuffer != NULL && mFileBufferSize >= size )
+		return true;
+
+	if( mFileBuffer != NULL )
+	{
+		free(mFileBuffer);
+		mFileBuffer = NULL;
+	}
+
+	mFileBuffer = (uint8_t*)malloc(size);
+	mFileBufferSize = 0;
+
+	if( !mFileBuffer )
+	{
+		LogError(LOG_CUDA "cudaPointCloud -- failed to allocate %zu bytes for file buffer\n", size);
+		return false;
+	}
+
+	mFileBufferSize = size;
+	return true;
+}
+
+
 // Render
 bool cudaPointCloud::Render()
 {
-	if( mNumPoints == 0 )
+	if( mNumPoints == 0 || !mPointsGPU )
 		return false;
 
 	// make sure GL buffer is ready
@@ -239,149 +529,1686 @@ bool cudaPointCloud::Render()
 }
 
 
-// SetCalibration
-void cudaPointCloud::SetCalibration( const float2& focalLength, const float2& principalPoint )
+// extractCPU
+bool cudaPointCloud::extractCPU( float* depth, uint32_t depth_width, uint32_t depth_height,
+						   float4* rgba, uint32_t width, uint32_t height )
 {
-	mFocalLength 	 = focalLength;
-	mPrincipalPoint = principalPoint;
-	mHasCalibration = true;
+	if( IsAccumulating() )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Extract() -- accumulation mode isn't supported on the CPU\n");
+		return false;
+	}
+
+	// wait for the GPU to finish producing the depth/RGBA
+	if( !mHostMemory )
+		CUDA(cudaDeviceSynchronize());
+
+	const bool resize = (depth_width != width || depth_height != height);
+	const bool organized = mOrganized;
+
+	const float2 scale = make_float2(float(depth_width) / float(width), float(depth_height) / float(height));
+	const float2 invFocal = make_float2(1.0f / mFocalLength.x, 1.0f / mFocalLength.y);
+
+	const simd4f lanes = { 0.0f, 1.0f, 2.0f, 3.0f };
+	const simd4f zero = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		float* resized = resize ? new float[width] : NULL;
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			const float* row = depth + y * depth_width;
+
+			// bilinear upsampling of the depth to the color resolution
+			if( resize )
+			{
+				const float sy = fminf(fmaxf((y + 0.5f) * scale.y - 0.5f, 0.0f), depth_height - 1);
+				const int iy0 = (int)sy;
+				const int iy1 = (iy0 + 1 < (int)depth_height) ? iy0 + 1 : iy0;
+				const float fy = sy - iy0;
+
+				for( uint32_t x=0; x < width; x++ )
+				{
+					const float sx = fminf(fmaxf((x + 0.5f) * scale.x - 0.5f, 0.0f), depth_width - 1);
+					const int ix0 = (int)sx;
+					const int ix1 = (ix0 + 1 < (int)depth_width) ? ix0 + 1 : ix0;
+					const float fx = sx - ix0;
+
+					const float* r0 = depth + iy0 * depth_width;
+					const float* r1 = depth + iy1 * depth_width;
+
+					resized[x] = (r0[ix0] * (1.0f - fx) + r0[ix1] * fx) * (1.0f - fy) 
+							 + (r1[ix0] * (1.0f - fx) + r1[ix1] * fx) * fy;
+				}
+
+				row = resized;
+			}
+
+			const float yFactor = -(float(y) - mPrincipalPoint.y) * invFocal.y;
+
+			Vertex* points = mPointsCPU + y * width;
+			const float4* colors = mHasRGB ? rgba + y * width : NULL;
+
+			// back-project four pixels at a time
+			for( uint32_t x=0; x < width; x += 4 )
+			{
+				simd4f d = zero;
+				const uint32_t count = (width - x < 4) ? width - x : 4;
+
+				if( count == 4 )
+					d = simdLoad(row + x);
+				else
+					for( uint32_t n=0; n < count; n++ )
+						d[n] = row[x + n];
+
+				const simd4f px = ((simd4f){ float(x), float(x), float(x), float(x) } + lanes - mPrincipalPoint.x) * invFocal.x * d;
+				const simd4f py = yFactor * d;
+				const simd4f pz = -d;
+
+				for( uint32_t n=0; n < count; n++ )
+				{
+					Vertex& point = points[x + n];
+
+					if( organized && !(d[n] > 0.0f && isfinite(d[n])) )
+						point.pos = make_float3(NAN, NAN, NAN);
+					else
+						point.pos = make_float3(px[n], py[n], pz[n]);
+
+					if( colors != NULL )
+					{
+						const float4 c = colors[x + n];
+						point.color = make_uchar3(fminf(c.x, 255.0f), fminf(c.y, 255.0f), fminf(c.z, 255.0f));
+					}
+					else
+					{
+						point.color = make_uchar3(255, 255, 255);
+					}
+
+					point.classID = 0;
+				}
+			}
+		}
+
+		delete[] resized;
+	}, 8);
+
+	mNumPoints = width * height;
+	mHeight = organized ? height : 1;
+	mHasNormals = false;
+	mHasNewPoints = true;
+
+	return true;
 }
 
 
-// SetCalibration
-void cudaPointCloud::SetCalibration( const float K[3][3] )
+// voxelKey (packs 21 bits of each voxel coordinate)
+static inline uint64_t voxelKey( int x, int y, int z )
 {
-	SetCalibration(make_float2(K[0][0], K[1][1]), make_float2(K[0][2], K[1][2]));
+	return (uint64_t(x & 0x1FFFFF) << 42) | (uint64_t(y & 0x1FFFFF) << 21) | uint64_t(z & 0x1FFFFF);
 }
 
+static inline uint64_t voxelKey( const float3& pos, float scale )
+{
+	return voxelKey(floorf(pos.x * scale), floorf(pos.y * scale), floorf(pos.z * scale));
+}
 
-// SetCalibration
-bool cudaPointCloud::SetCalibration( const char* filename )
+static inline bool pointValid( const float3& pos )
 {
-	if( !filename )
-		return false;
+	return isfinite(pos.x) && isfinite(pos.y) && isfinite(pos.z);
+}
 
-	// open the camera calibration file
-	FILE* file = fopen(filename, "r");
+#define VOXEL_EMPTY 0xFFFFFFFFFFFFFFFFULL
 
-	if( !file )
-	{
-		LogError(LOG_CUDA "cudaPointCloud::Extract() -- failed to open calibration file %s\n", filename);
-		return false;
-	}
- 
-	// parse the 3x3 calibration matrix
-	float K[3][3];
 
-	for( int n=0; n < 3; n++ )
+// windowMean (the average position of the valid points in a window, or the fallback if there are none)
+static inline float3 windowMean( const float4* means, int x, int y, int width, int height, const float3& fallback )
+{
+	const float4 m = means[std::min(std::max(y, 0), height - 1) * width + std::min(std::max(x, 0), width - 1)];
+
+	if( m.w < 1e-6f )
+		return fallback;
+
+	return make_float3(m.x / m.w, m.y / m.w, m.z / m.w);
+}
+
+// pointNormal (cross product of the differences between the window means, facing the viewpoint)
+static inline float3 pointNormal( const float4* means, int x, int y, int width, int height, int radius, 
+						    const float3& pos, const float3& viewpoint )
+{
+	if( !pointValid(pos) )
+		return make_float3(NAN, NAN, NAN);
+
+	const int offset = std::max(radius, 1);
+	const float3 center = windowMean(means, x, y, width, height, pos);
+
+	const float3 left  = windowMean(means, x - offset, y, width, height, center);
+	const float3 right = windowMean(means, x + offset, y, width, height, center);
+	const float3 up    = windowMean(means, x, y - offset, width, height, center);
+	const float3 down  = windowMean(means, x, y + offset, width, height, center);
+
+	const float3 dx = make_float3(right.x - left.x, right.y - left.y, right.z - left.z);
+	const float3 dy = make_float3(down.x - up.x, down.y - up.y, down.z - up.z);
+
+	float3 n = make_float3(dx.y * dy.z - dx.z * dy.y, dx.z * dy.x - dx.x * dy.z, dx.x * dy.y - dx.y * dy.x);
+
+	const float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+	if( !(length > 0.0f) )
+		return make_float3(NAN, NAN, NAN);
+
+	const float flip = ((viewpoint.x - pos.x) * n.x + (viewpoint.y - pos.y) * n.y + (viewpoint.z - pos.z) * n.z < 0.0f) ? -1.0f : 1.0f;
+	const float scale = flip / length;
+
+	return make_float3(n.x * scale, n.y * scale, n.z * scale);
+}
+
+
+// downsampleCPU
+bool cudaPointCloud::downsampleCPU( float voxelSize )
+{
+	struct Voxel
 	{
-		char str[512];
+		float    pos[3];
+		uint32_t color[3];
+		uint32_t count;
+		uint8_t  classID;
+	};
 
-		if( !fgets(str, 512, file) )
+	// wait for the GPU to finish any processing
+	if( !mHostMemory )
+		CUDA(cudaDeviceSynchronize());
+
+	const uint32_t numPoints = mNumPoints;
+	const float scale = 1.0f / voxelSize;
+
+	uint64_t* keys = new uint64_t[numPoints];
+
+	ParallelFor(numPoints, [&](uint32_t begin, uint32_t end)
+	{
+		for( uint32_t n=begin; n < end; n++ )
 		{
-			LogError(LOG_CUDA "cudaPointCloud::Extract() -- failed to read line %i from calibration file %s\n", n+1, filename);
-			return false;
+			const float3& pos = mPointsCPU[n].pos;
+			keys[n] = (pointValid(pos) && pos.z != 0.0f) ? voxelKey(pos, scale) : VOXEL_EMPTY;
 		}
+	}, 4096);
 
-		const int len = strlen(str);
+	// each thread reduces the voxels whose hash falls in its partition, 
+	// so the partial results never need to be merged
+	const uint32_t numPartitions = ParallelForThreads();
+	std::vector<std::vector<Voxel>> partitions(numPartitions);
 
-		if( len <= 0 )
+	ParallelFor(numPartitions, [&](uint32_t begin, uint32_t end)
+	{
+		for( uint32_t p=begin; p < end; p++ )
 		{
-			LogError(LOG_CUDA "cudaPointCloud::Extract() -- invalid line %i from calibration file %s\n", n+1, filename);
-			return false;
+			std::unordered_map<uint64_t, uint32_t> index;
+			std::vector<Voxel>& voxels = partitions[p];
+
+			for( uint32_t n=0; n < numPoints; n++ )
+			{
+				const uint64_t key = keys[n];
+
+				if( key == VOXEL_EMPTY || ((key * 0x9E3779B97F4A7C15ULL) >> 32) % numPartitions != p )
+					continue;
+
+				std::unordered_map<uint64_t, uint32_t>::iterator iter = index.find(key);
+				uint32_t v = 0;
+
+				if( iter != index.end() )
+				{
+					v = iter->second;
+				}
+				else
+				{
+					v = voxels.size();
+					index[key] = v;
+					voxels.push_back(Voxel());
+					memset(&voxels[v], 0, sizeof(Voxel));
+				}
+
+				const Vertex& point = mPointsCPU[n];
+				Voxel& voxel = voxels[v];
+
+				voxel.pos[0] += point.pos.x;
+				voxel.pos[1] += point.pos.y;
+				voxel.pos[2] += point.pos.z;
+
+				voxel.color[0] += point.color.x;
+				voxel.color[1] += point.color.y;
+				voxel.color[2] += point.color.z;
+
+				voxel.classID = std::max(voxel.classID, point.classID);
+				voxel.count++;
+			}
 		}
+	});
 
-		if( str[len-1] == '\n' )
-			str[len-1] = 0;
+	delete[] keys;
 
-		if( sscanf(str, "%f %f %f", &K[n][0], &K[n][1], &K[n][2]) != 3 )
+	// the voxels hold all of the data, so they can overwrite the points in-place
+	uint32_t numVoxels = 0;
+
+	for( uint32_t p=0; p < numPartitions; p++ )
+	{
+		for( size_t v=0; v < partitions[p].size(); v++ )
 		{
-			LogError(LOG_CUDA "cudaPointCloud::Extract() -- failed to parse line %i from calibration file %s\n", n+1, filename);
-			return false;
+			const Voxel& voxel = partitions[p][v];
+			const float n = voxel.count;
+
+			Vertex& point = mPointsCPU[numVoxels++];
+
+			point.pos = make_float3(voxel.pos[0] / n, voxel.pos[1] / n, voxel.pos[2] / n);
+			point.color = make_uchar3(voxel.color[0] / n + 0.5f, voxel.color[1] / n + 0.5f, voxel.color[2] / n + 0.5f);
+			point.classID = voxel.classID;
 		}
 	}
 
-	// close the file
-	fclose(file);
-
-	// dump the matrix
-	LogVerbose(LOG_CUDA "cudaPointCloud::Extract() -- loaded intrinsic camera calibration from %s\n", filename);
-	mat33_print(K, "K");
+	mNumPoints = numVoxels;
+	mHeight = 1;
+	mHasNormals = false;
+	mHasNewPoints = true;
 
-	// save the calibration
-	SetCalibration(K);
 	return true;
 }
 
 
-// Save
-bool cudaPointCloud::Save( const char* filename )
+// filterOutliersCPU
+bool cudaPointCloud::filterOutliersCPU( float radius, uint32_t minNeighbors )
 {
-	if( !filename || mNumPoints == 0 || !mPointsCPU )
-		return false;
+	// wait for the GPU to finish any processing
+	if( !mHostMemory )
+		CUDA(cudaDeviceSynchronize());
 
-	// open the PCD file
-	FILE* file = fopen(filename, "w");
+	const uint32_t numPoints = mNumPoints;
+	const float scale = 1.0f / radius;
+	const float radiusSq = radius * radius;
 
-	if( !file )
+	// sort the points by grid cell (the cell size is the radius)
+	std::vector<std::pair<uint64_t, uint32_t>> cells(numPoints);
+
+	ParallelFor(numPoints, [&](uint32_t begin, uint32_t end)
 	{
-		LogError(LOG_CUDA "cudaPointCloud::Save() -- failed to create %s\n", filename);
-		return false;
-	}
+		for( uint32_t n=begin; n < end; n++ )
+		{
+			const float3& pos = mPointsCPU[n].pos;
+			cells[n] = std::make_pair(pointValid(pos) ? voxelKey(pos, scale) : VOXEL_EMPTY, n);
+		}
+	}, 4096);
 
-	// write the PCD header
-	fprintf(file, "# .PCD v0.7 - Point Cloud Data file format\n");
-	fprintf(file, "VERSION 0.7\n");
+	std::sort(cells.begin(), cells.end());
+
+	std::unordered_map<uint64_t, uint2> grid;	// cell -> (first, count) in the sorted points
+	grid.reserve(numPoints / 4);
 
-	if( mHasRGB )
+	for( uint32_t n=0; n < numPoints; )
 	{
-		fprintf(file, "FIELDS x y z rgb\n");
-		fprintf(file, "SIZE 4 4 4 4\n");
-		fprintf(file, "TYPE F F F U\n");
+		const uint64_t key = cells[n].first;
+		uint32_t end = n + 1;
+
+		while( end < numPoints && cells[end].first == key )
+			end++;
+
+		if( key != VOXEL_EMPTY )
+			grid[key] = make_uint2(n, end - n);
+
+		n = end;
 	}
-	else
+
+	// count the neighbors of each point
+	uint8_t* keep = new uint8_t[numPoints];
+
+	ParallelFor(numPoints, [&](uint32_t begin, uint32_t end)
 	{
-		fprintf(file, "FIELDS x y z\n");
-		fprintf(file, "SIZE 4 4 4\n");
-		fprintf(file, "TYPE F F F\n");
-	}
+		for( uint32_t i=begin; i < end; i++ )
+		{
+			const float3 pos = mPointsCPU[i].pos;
 
-	fprintf(file, "COUNT 1 1 1 1\n");
-	fprintf(file, "WIDTH %u\n", mNumPoints);
-	fprintf(file, "HEIGHT 1\n");
-	fprintf(file, "VIEWPOINT 0 0 0 1 0 0 0\n");
-	fprintf(file, "POINTS %u\n", mNumPoints);
-	fprintf(file, "DATA ascii\n");
+			if( !pointValid(pos) )
+			{
+				keep[i] = 0;
+				continue;
+			}
 
-	// wait for the GPU to finish any processing
-	CUDA(cudaDeviceSynchronize());
+			const int cx = floorf(pos.x * scale);
+			const int cy = floorf(pos.y * scale);
+			const int cz = floorf(pos.z * scale);
 
-	// write out points to the PCD file
-	for( size_t n=0; n < mNumPoints; n++ )
-	{
-		Vertex* point = GetData(n);
+			uint32_t neighbors = 0;
 
-		// output XYZ coordinates
-		fprintf(file, "%f %f %f", point->pos.x, point->pos.y, point->pos.z);
+			for( int z=cz-1; z <= cz+1 && neighbors < minNeighbors; z++ )
+			{
+				for( int y=cy-1; y <= cy+1 && neighbors < minNeighbors; y++ )
+				{
+					for( int x=cx-1; x <= cx+1 && neighbors < minNeighbors; x++ )
+					{
+						std::unordered_map<uint64_t, uint2>::const_iterator cell = grid.find(voxelKey(x, y, z));
 
-		// output RGB color
-		if( mHasRGB )
-		{
-			// pack the color into 24 bits
-			const uint32_t rgb_packed = (uint32_t(point->color.x) << 16 |
-	      					         uint32_t(point->color.y) << 8 | 
-							         uint32_t(point->color.z));
-		
-			fprintf(file, " %u", rgb_packed);
-		}
+						if( cell == grid.end() )
+							continue;
 
-		fprintf(file, "\n");
-	}
-		
-	fclose(file);
-	return true;
-}
+						for( uint32_t n=cell->second.x; n < cell->second.x + cell->second.y; n++ )
+						{
+							const uint32_t j = cells[n].second;
 
+							if( j == i )
+								continue;
 
+							const float3& q = mPointsCPU[j].pos;
 
+							const float dx = q.x - pos.x;
+							const float dy = q.y - pos.y;
+							const float dz = q.z - pos.z;
 
+							if( dx * dx + dy * dy + dz * dz <= radiusSq )
+								neighbors++;
+						}
+					}
+				}
+			}
+
+			keep[i] = (neighbors >= minNeighbors);
+		}
+	}, 1024);
+
+	// compact the points in-place (preserving their order)
+	uint32_t numKept = 0;
+
+	for( uint32_t n=0; n < numPoints; n++ )
+	{
+		if( keep[n] )
+			mPointsCPU[numKept++] = mPointsCPU[n];
+	}
+
+	delete[] keep;
+
+	mNumPoints = numKept;
+	mHeight = 1;
+	mHasNormals = false;
+	mHasNewPoints = true;
+
+	return true;
+}
+
+
+// computeNormalsCPU
+bool cudaPointCloud::computeNormalsCPU( uint32_t radius )
+{
+	// wait for the GPU to finish any processing
+	if( !mHostMemory )
+		CUDA(cudaDeviceSynchronize());
+
+	const uint32_t width = GetWidth();
+	const uint32_t height = GetHeight();
+	const uint32_t numPoints = mNumPoints;
+
+	// organized clouds are never transformed by the pose (it's only applied 
+	// when accumulating), so the camera is always at the origin of the points
+	const float3 viewpoint = make_float3(0.0f, 0.0f, 0.0f);
+
+	// weight the positions by their validity, so the box means divided by the 
+	// mean weight give the average position of the valid points in each window
+	float4* means = new float4[numPoints];
+
+	ParallelFor(numPoints, [&](uint32_t begin, uint32_t end)
+	{
+		for( uint32_t n=begin; n < end; n++ )
+		{
+			const float3& pos = mPointsCPU[n].pos;
+			means[n] = pointValid(pos) ? make_float4(pos.x, pos.y, pos.z, 1.0f) : make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+	}, 4096);
+
+	if( !cpuFilterBox(means, means, width, height, IMAGE_RGBA32F, radius) )
+	{
+		delete[] means;
+		return false;
+	}
+
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			for( uint32_t x=0; x < width; x++ )
+			{
+				const uint32_t n = y * width + x;
+				mNormalsCPU[n] = pointNormal(means, x, y, width, height, radius, mPointsCPU[n].pos, viewpoint);
+			}
+		}
+	}, 8);
+
+	delete[] means;
+
+	mHasNormals = true;
+	return true;
+}
+
+
+// SetCalibration
+void cudaPointCloud::SetCalibration( const float2& focalLength, const float2& principalPoint )
+{
+	mFocalLength 	 = focalLength;
+	mPrincipalPoint = principalPoint;
+	mHasCalibration = true;
+}
+
+
+// SetCalibration
+void cudaPointCloud::SetCalibration( const float K[3][3] )
+{
+	SetCalibration(make_float2(K[0][0], K[1][1]), make_float2(K[0][2], K[1][2]));
+}
+
+
+// SetCalibration
+bool cudaPointCloud::SetCalibration( const char* filename )
+{
+	if( !filename )
+		return false;
+
+	// open the camera calibration file
+	FILE* file = fopen(filename, "r");
+
+	if( !file )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Extract() -- failed to open calibration file %s\n", filename);
+		return false;
+	}
+ 
+	// parse the 3x3 calibration matrix
+	float K[3][3];
+
+	for( int n=0; n < 3; n++ )
+	{
+		char str[512];
+
+		if( !fgets(str, 512, file) )
+		{
+			LogError(LOG_CUDA "cudaPointCloud::Extract() -- failed to read line %i from calibration file %s\n", n+1, filename);
+			return false;
+		}
+
+		const int len = strlen(str);
+
+		if( len <= 0 )
+		{
+			LogError(LOG_CUDA "cudaPointCloud::Extract() -- invalid line %i from calibration file %s\n", n+1, filename);
+			return false;
+		}
+
+		if( str[len-1] == '\n' )
+			str[len-1] = 0;
+
+		if( sscanf(str, "%f %f %f", &K[n][0], &K[n][1], &K[n][2]) != 3 )
+		{
+			LogError(LOG_CUDA "cudaPointCloud::Extract() -- failed to parse line %i from calibration file %s\n", n+1, filename);
+			return false;
+		}
+	}
+
+	// close the file
+	fclose(file);
+
+	// dump the matrix
+	LogVerbose(LOG_CUDA "cudaPointCloud::Extract() -- loaded intrinsic camera calibration from %s\n", filename);
+	mat33_print(K, "K");
+
+	// save the calibration
+	SetCalibration(K);
+	return true;
+}
+
+
+// lzfCompress (LZF format as used by PCD binary_compressed, returns 0 if the output didn't fit)
+static size_t lzfCompress( const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize )
+{
+	const int hashBits = 14;
+	const size_t maxOffset = 1 << 13;
+	const size_t maxLiteral = 1 << 5;
+	const size_t maxMatch = 255 + 7 + 2;
+
+	uint32_t* table = new uint32_t[1 << hashBits]();	// positions + 1 (0 is empty)
+
+	size_t ip = 0;
+	size_t op = 1;		// output[0] is reserved for the control byte of the first literal run
+	size_t lit = 0;
+
+	if( outputSize == 0 )
+	{
+		delete[] table;
+		return 0;
+	}
+
+	while( ip < inputSize )
+	{
+		size_t ref = 0;
+
+		if( ip + 2 < inputSize )
+		{
+			const uint32_t v = (input[ip] << 16) | (input[ip+1] << 8) | input[ip+2];
+			const uint32_t h = (v * 2654435761u) >> (32 - hashBits);
+
+			ref = table[h];
+			table[h] = ip + 1;
+		}
+
+		if( ref > 0 && ip - (ref - 1) <= maxOffset && memcmp(input + ref - 1, input + ip, 3) == 0 )
+		{
+			const size_t r = ref - 1;
+			const size_t limit = (inputSize - ip < maxMatch) ? inputSize - ip : maxMatch;
+
+			size_t len = 3;
+
+			while( len < limit && input[r + len] == input[ip + len] )
+				len++;
+
+			// terminate the current literal run
+			if( lit == 0 )
+				op--;
+			else
+				output[op - lit - 1] = lit - 1;
+
+			if( op + 4 > outputSize )
+				break;
+
+			// emit the back-reference
+			const size_t off = ip - r - 1;
+			const size_t l = len - 2;
+
+			if( l < 7 )
+			{
+				output[op++] = (l << 5) | (off >> 8);
+			}
+			else
+			{
+				output[op++] = (7 << 5) | (off >> 8);
+				output[op++] = l - 7;
+			}
+
+			output[op++] = off & 0xFF;
+
+			ip += len;
+			lit = 0;
+			op++;	// reserve the control byte of the next literal run
+		}
+		else
+		{
+			if( op >= outputSize )
+				break;
+
+			output[op++] = input[ip++];
+			lit++;
+
+			if( lit == maxLiteral )
+			{
+				output[op - lit - 1] = lit - 1;
+				lit = 0;
+				op++;
+			}
+		}
+	}
+
+	delete[] table;
+
+	if( ip < inputSize )
+		return 0;
+
+	if( lit == 0 )
+		op--;
+	else
+		output[op - lit - 1] = lit - 1;
+
+	return op;
+}
+
+
+// writeHeaderPCD
+bool cudaPointCloud::writeHeaderPCD( FILE* file, const char* data )
+{
+	fprintf(file, "# .PCD v0.7 - Point Cloud Data file format\n");
+	fprintf(file, "VERSION 0.7\n");
+
+	const char* rgb = mHasRGB ? " rgb" : "";
+	const char* normals = mHasNormals ? " normal_x normal_y normal_z" : "";
+
+	fprintf(file, "FIELDS x y z%s%s\n", rgb, normals);
+	fprintf(file, "SIZE 4 4 4%s%s\n", mHasRGB ? " 4" : "", mHasNormals ? " 4 4 4" : "");
+	fprintf(file, "TYPE F F F%s%s\n", mHasRGB ? " U" : "", mHasNormals ? " F F F" : "");
+	fprintf(file, "COUNT 1 1 1%s%s\n", mHasRGB ? " 1" : "", mHasNormals ? " 1 1 1" : "");
+
+	fprintf(file, "WIDTH %u\n", GetWidth());
+	fprintf(file, "HEIGHT %u\n", GetHeight());
+	fprintf(file, "VIEWPOINT 0 0 0 1 0 0 0\n");
+	fprintf(file, "POINTS %u\n", mNumPoints);
+	fprintf(file, "DATA %s\n", data);
+
+	return true;
+}
+
+
+// pack the color into 24 bits
+static inline uint32_t packRGB( const uchar3& color )
+{
+	return (uint32_t(color.x) << 16 | uint32_t(color.y) << 8 | uint32_t(color.z));
+}
+
+
+// writeFile
+bool cudaPointCloud::writeFile( FILE* file, FileFormat format )
+{
+	// wait for the GPU to finish any processing
+	if( !mHostMemory )
+		CUDA(cudaDeviceSynchronize());
+
+	if( format == PCD_ASCII )
+	{
+		writeHeaderPCD(file, "ascii");
+
+		// write out points to the PCD file
+		for( size_t n=0; n < mNumPoints; n++ )
+		{
+			Vertex* point = GetData(n);
+
+			fprintf(file, "%f %f %f", point->pos.x, point->pos.y, point->pos.z);
+
+			if( mHasRGB )
+				fprintf(file, " %u", packRGB(point->color));
+
+			if( mHasNormals )
+				fprintf(file, " %f %f %f", mNormalsCPU[n].x, mNormalsCPU[n].y, mNormalsCPU[n].z);
+
+			fprintf(file, "\n");
+		}
+	}
+	else if( format == PCD_BINARY )
+	{
+		writeHeaderPCD(file, "binary");
+
+		// the fields are x/y/z/rgb/normals, so the points are repacked in chunks and written in 
+		// large blocks (the vertex layout can't be used directly because of the RGB byte order)
+		const size_t rgbSize = mHasRGB ? sizeof(uint32_t) : 0;
+		const size_t pointSize = sizeof(float3) + rgbSize + (mHasNormals ? sizeof(float3) : 0);
+		const size_t chunkPoints = 65536;
+
+		if( !allocFileBuffer(chunkPoints * pointSize) )
+			return false;
+
+		for( size_t n=0; n < mNumPoints; n += chunkPoints )
+		{
+			const size_t count = (mNumPoints - n < chunkPoints) ? mNumPoints - n : chunkPoints;
+			uint8_t* ptr = mFileBuffer;
+
+			for( size_t i=0; i < count; i++ )
+			{
+				const Vertex* point = GetData(n + i);
+
+				memcpy(ptr, &point->pos, sizeof(float3));
+
+				if( mHasRGB )
+				{
+					const uint32_t rgb = packRGB(point->color);
+					memcpy(ptr + sizeof(float3), &rgb, sizeof(uint32_t));
+				}
+
+				if( mHasNormals )
+					memcpy(ptr + sizeof(float3) + rgbSize, mNormalsCPU + n + i, sizeof(float3));
+
+				ptr += pointSize;
+			}
+
+			if( fwrite(mFileBuffer, pointSize, count, file) != count )
+				return false;
+		}
+	}
+	else if( format == PCD_BINARY_COMPRESSED )
+	{
+		writeHeaderPCD(file, "binary_compressed");
+
+		// the data is stored field-by-field (all x, then all y, ect) and compressed with LZF,
+		// which takes up to 1/32 more space than the input in the worst case 
+		const size_t normalField = mHasRGB ? 4 : 3;
+		const size_t numFields = normalField + (mHasNormals ? 3 : 0);
+		const size_t uncompressedSize = mNumPoints * numFields * sizeof(float);
+		const size_t compressedMax = uncompressedSize + uncompressedSize / 16 + 64;
+
+		if( !allocFileBuffer(uncompressedSize + compressedMax) )
+			return false;
+
+		float* fields = (float*)mFileBuffer;
+		uint8_t* compressed = mFileBuffer + uncompressedSize;
+
+		for( size_t n=0; n < mNumPoints; n++ )
+		{
+			const Vertex* point = GetData(n);
+
+			fields[n] = point->pos.x;
+			fields[mNumPoints + n] = point->pos.y;
+			fields[mNumPoints * 2 + n] = point->pos.z;
+
+			if( mHasRGB )
+			{
+				const uint32_t rgb = packRGB(point->color);
+				memcpy(fields + mNumPoints * 3 + n, &rgb, sizeof(uint32_t));
+			}
+
+			if( mHasNormals )
+			{
+				fields[mNumPoints * normalField + n] = mNormalsCPU[n].x;
+				fields[mNumPoints * (normalField + 1) + n] = mNormalsCPU[n].y;
+				fields[mNumPoints * (normalField + 2) + n] = mNormalsCPU[n].z;
+			}
+		}
+
+		const uint32_t sizes[] = { (uint32_t)lzfCompress(mFileBuffer, uncompressedSize, compressed, compressedMax),
+							  (uint32_t)uncompressedSize };
+
+		if( sizes[0] == 0 )
+		{
+			LogError(LOG_CUDA "cudaPointCloud::Save() -- failed to compress point cloud\n");
+			return false;
+		}
+
+		if( fwrite(sizes, sizeof(sizes), 1, file) != 1 || fwrite(compressed, sizes[0], 1, file) != 1 )
+			return false;
+	}
+	else if( format == PLY_BINARY )
+	{
+		// the properties match the layout of Vertex, so the points are written straight from mapped memory
+		// unless the normals need to be interleaved (the platforms this runs on are little-endian)
+		fprintf(file, "ply\n");
+		fprintf(file, "format binary_little_endian 1.0\n");
+		fprintf(file, "element vertex %u\n", mNumPoints);
+		fprintf(file, "property float x\n");
+		fprintf(file, "property float y\n");
+		fprintf(file, "property float z\n");
+		fprintf(file, "property uchar red\n");
+		fprintf(file, "property uchar green\n");
+		fprintf(file, "property uchar blue\n");
+		fprintf(file, "property uchar class\n");
+
+		if( mHasNormals )
+		{
+			fprintf(file, "property float nx\n");
+			fprintf(file, "property float ny\n");
+			fprintf(file, "property float nz\n");
+		}
+
+		fprintf(file, "end_header\n");
+
+		if( !mHasNormals )
+		{
+			if( fwrite(mPointsCPU, sizeof(Vertex), mNumPoints, file) != mNumPoints )
+				return false;
+
+			return true;
+		}
+
+		const size_t pointSize = sizeof(Vertex) + sizeof(float3);
+		const size_t chunkPoints = 65536;
+
+		if( !allocFileBuffer(chunkPoints * pointSize) )
+			return false;
+
+		for( size_t n=0; n < mNumPoints; n += chunkPoints )
+		{
+			const size_t count = (mNumPoints - n < chunkPoints) ? mNumPoints - n : chunkPoints;
+
+			for( size_t i=0; i < count; i++ )
+			{
+				memcpy(mFileBuffer + i * pointSize, GetData(n + i), sizeof(Vertex));
+				memcpy(mFileBuffer + i * pointSize + sizeof(Vertex), mNormalsCPU + n + i, sizeof(float3));
+			}
+
+			if( fwrite(mFileBuffer, pointSize, count, file) != count )
+				return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+// Save
+bool cudaPointCloud::Save( const char* filename )
+{
+	if( !filename )
+		return false;
+
+	return Save(filename, fileHasExtension(filename, "ply") ? PLY_BINARY : PCD_ASCII);
+}
+
+
+// Save
+bool cudaPointCloud::Save( const char* filename, FileFormat format )
+{
+	if( !filename || mNumPoints == 0 || !mPointsCPU )
+		return false;
+
+	// open the output file
+	FILE* file = fopen(filename, (format == PCD_ASCII) ? "w" : "wb");
+
+	if( !file )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Save() -- failed to create %s\n", filename);
+		return false;
+	}
+
+	const bool result = writeFile(file, format);
+
+	if( !result )
+		LogError(LOG_CUDA "cudaPointCloud::Save() -- failed to write %s\n", filename);
+
+	fclose(file);
+	return result;
+}
+
+
+// OpenSequence
+bool cudaPointCloud::OpenSequence( const char* filename, FileFormat format )
+{
+	if( !filename )
+		return false;
+
+	CloseSequence();
+
+	mSequenceFile = fopen(filename, "wb");
+
+	if( !mSequenceFile )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::OpenSequence() -- failed to create %s\n", filename);
+		return false;
+	}
+
+	// use a large stdio buffer so the headers and small clouds get batched together
+	setvbuf(mSequenceFile, NULL, _IOFBF, 4 * 1024 * 1024);
+
+	mSequenceFormat = format;
+	mSequenceLength = 0;
+
+	return true;
+}
+
+
+// SaveSequence
+bool cudaPointCloud::SaveSequence()
+{
+	if( !mSequenceFile || mNumPoints == 0 || !mPointsCPU )
+		return false;
+
+	if( !writeFile(mSequenceFile, mSequenceFormat) )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::SaveSequence() -- failed to write point cloud %u\n", mSequenceLength);
+		return false;
+	}
+
+	mSequenceLength++;
+	return true;
+}
+
+
+// CloseSequence
+void cudaPointCloud::CloseSequence()
+{
+	if( !mSequenceFile )
+		return;
+
+	fclose(mSequenceFile);
+
+	mSequenceFile = NULL;
+	mSequenceLength = 0;
+}
+
+
+//----------------------------------------------------------------------------
+// Point cloud streaming
+//----------------------------------------------------------------------------
+#define STREAM_FRAME_MAGIC 0x31514350	// 'PCQ1'
+#define STREAM_CHUNK_MAGIC 0x43514350	// 'PCQC'
+#define STREAM_FLAG_CLASS  0x01		// the class IDs of the added points are included
+#define STREAM_QUANT_MAX   65535		// positions are quantized to 16 bits per axis
+
+// header of the encoded frames (followed by the body, which is LZF-compressed unless compressedSize is 0)
+struct streamFrameHeader
+{
+	uint32_t magic;
+	uint32_t frame;			// frame number
+	uint32_t reference;			// the frame that this is a delta of (the same as frame for keyframes)
+	uint32_t numPoints;			// the number of decoded points
+	uint32_t numAdded;			// the number of voxel keys stored in the body
+	uint32_t numPrevious;		// the number of points in the reference frame (0 for keyframes)
+	uint8_t  colors;			// ColorEncoding
+	uint8_t  flags;
+	uint16_t paletteSize;
+	float    origin[3];
+	float    step[3];
+	uint32_t bodySize;
+	uint32_t compressedSize;
+};
+
+// header of the chunks that Send() splits the frames into
+struct streamChunkHeader
+{
+	uint32_t magic;
+	uint32_t frame;
+	uint32_t frameSize;
+	uint32_t offset;
+	uint32_t size;
+};
+
+// spread 16 bits out to every third bit (for Morton codes)
+static inline uint64_t mortonSpread( uint64_t x )
+{
+	x &= 0xFFFF;
+	x = (x | x << 16) & 0x0000FF0000FFULL;
+	x = (x | x << 8)  & 0x00F00F00F00FULL;
+	x = (x | x << 4)  & 0x0C30C30C30C3ULL;
+	x = (x | x << 2)  & 0x249249249249ULL;
+	return x;
+}
+
+static inline uint32_t mortonCompact( uint64_t x )
+{
+	x &= 0x249249249249ULL;
+	x = (x ^ (x >> 2))  & 0x0C30C30C30C3ULL;
+	x = (x ^ (x >> 4))  & 0x00F00F00F00FULL;
+	x = (x ^ (x >> 8))  & 0x0000FF0000FFULL;
+	x = (x ^ (x >> 16)) & 0xFFFF;
+	return (uint32_t)x;
+}
+
+// LEB128 variable-length integers
+static inline void writeVarint( std::vector<uint8_t>& output, uint64_t value )
+{
+	while( value >= 0x80 )
+	{
+		output.push_back(uint8_t(value) | 0x80);
+		value >>= 7;
+	}
+
+	output.push_back(uint8_t(value));
+}
+
+static inline bool readVarint( const uint8_t*& ptr, const uint8_t* end, uint64_t& value )
+{
+	value = 0;
+
+	for( int shift=0; ptr < end && shift < 64; shift += 7 )
+	{
+		const uint8_t byte = *ptr++;
+		value |= uint64_t(byte & 0x7F) << shift;
+
+		if( !(byte & 0x80) )
+			return true;
+	}
+
+	return false;
+}
+
+// lzfDecompress (returns the decompressed size, or 0 if the input was invalid)
+static size_t lzfDecompress( const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize )
+{
+	size_t ip = 0;
+	size_t op = 0;
+
+	while( ip < inputSize )
+	{
+		const uint32_t ctrl = input[ip++];
+
+		if( ctrl < 32 )
+		{
+			// literal run
+			const size_t len = ctrl + 1;
+
+			if( ip + len > inputSize || op + len > outputSize )
+				return 0;
+
+			memcpy(output + op, input + ip, len);
+
+			ip += len;
+			op += len;
+		}
+		else
+		{
+			// back-reference
+			size_t len = ctrl >> 5;
+
+			if( len == 7 )
+			{
+				if( ip >= inputSize )
+					return 0;
+
+				len += input[ip++];
+			}
+
+			if( ip >= inputSize )
+				return 0;
+
+			const size_t off = ((ctrl & 0x1F) << 8) + input[ip++] + 1;
+
+			len += 2;
+
+			if( off > op || op + len > outputSize )
+				return 0;
+
+			for( size_t n=0; n < len; n++, op++ )
+				output[op] = output[op - off];		// the ranges can overlap
+		}
+	}
+
+	return op;
+}
+
+// buildPalette (the most common colors at 4 bits per channel, with the other colors mapped to the closest one)
+static uint32_t buildPalette( const uchar3* colors, size_t count, uchar3* palette, uint8_t* indices )
+{
+	std::vector<uint32_t> bins(4096 * 4, 0);	// count and RGB sums of each bin
+
+	for( size_t n=0; n < count; n++ )
+	{
+		const uchar3 c = colors[n];
+		uint32_t* bin = &bins[((c.x >> 4) << 8 | (c.y >> 4) << 4 | (c.z >> 4)) * 4];
+
+		bin[0]++;
+		bin[1] += c.x;
+		bin[2] += c.y;
+		bin[3] += c.z;
+	}
+
+	std::vector<uint32_t> order;
+
+	for( uint32_t b=0; b < 4096; b++ )
+	{
+		if( bins[b * 4] > 0 )
+			order.push_back(b);
+	}
+
+	const uint32_t paletteSize = std::min<uint32_t>(order.size(), 256);
+
+	std::partial_sort(order.begin(), order.begin() + paletteSize, order.end(), [&](uint32_t a, uint32_t b) 
+	{
+		return bins[a * 4] > bins[b * 4];
+	});
+
+	uint8_t lookup[4096];
+
+	for( size_t i=0; i < order.size(); i++ )
+	{
+		const uint32_t* bin = &bins[order[i] * 4];
+		const uchar3 color = make_uchar3(bin[1] / bin[0], bin[2] / bin[0], bin[3] / bin[0]);
+
+		if( i < paletteSize )
+		{
+			palette[i] = color;
+			lookup[order[i]] = i;
+			continue;
+		}
+
+		int closest = 0;
+		int closestDist = INT_MAX;
+
+		for( uint32_t p=0; p < paletteSize; p++ )
+		{
+			const int dr = int(color.x) - palette[p].x;
+			const int dg = int(color.y) - palette[p].y;
+			const int db = int(color.z) - palette[p].z;
+			const int dist = dr * dr + dg * dg + db * db;
+
+			if( dist < closestDist )
+			{
+				closest = p;
+				closestDist = dist;
+			}
+		}
+
+		lookup[order[i]] = closest;
+	}
+
+	for( size_t n=0; n < count; n++ )
+		indices[n] = lookup[(colors[n].x >> 4) << 8 | (colors[n].y >> 4) << 4 | (colors[n].z >> 4)];
+
+	return paletteSize;
+}
+
+
+// Encode
+bool cudaPointCloud::Encode( uint8_t** data, size_t* size, ColorEncoding colors, uint32_t keyframeInterval, float voxelSize )
+{
+	if( !data || !size || !mPointsCPU )
+		return false;
+
+	// wait for the GPU to finish any processing
+	if( !mHostMemory )
+		CUDA(cudaDeviceSynchronize());
+
+	const uint32_t numPoints = mNumPoints;
+
+	// find the bounding box of the valid points
+	float3 minPos = make_float3(FLT_MAX, FLT_MAX, FLT_MAX);
+	float3 maxPos = make_float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for( uint32_t n=0; n < numPoints; n++ )
+	{
+		const float3& pos = mPointsCPU[n].pos;
+
+		if( !pointValid(pos) )
+			continue;
+
+		minPos = make_float3(fminf(minPos.x, pos.x), fminf(minPos.y, pos.y), fminf(minPos.z, pos.z));
+		maxPos = make_float3(fmaxf(maxPos.x, pos.x), fmaxf(maxPos.y, pos.y), fmaxf(maxPos.z, pos.z));
+	}
+
+	if( minPos.x > maxPos.x )
+	{
+		minPos = make_float3(0.0f, 0.0f, 0.0f);
+		maxPos = minPos;
+	}
+
+	// delta frames can only be used if the points fit inside the box of the keyframe
+	bool keyframe = (keyframeInterval <= 1 || mEncodeFrame == 0 || mEncodeFrame - mEncodeKeyframe >= keyframeInterval);
+
+	if( !keyframe )
+	{
+		const float3 boxMax = make_float3(mEncodeOrigin.x + mEncodeStep.x * STREAM_QUANT_MAX,
+								    mEncodeOrigin.y + mEncodeStep.y * STREAM_QUANT_MAX,
+								    mEncodeOrigin.z + mEncodeStep.z * STREAM_QUANT_MAX);
+
+		keyframe = minPos.x < mEncodeOrigin.x || minPos.y < mEncodeOrigin.y || minPos.z < mEncodeOrigin.z ||
+				 maxPos.x > boxMax.x || maxPos.y > boxMax.y || maxPos.z > boxMax.z;
+	}
+
+	if( keyframe )
+	{
+		// pad the box when delta frames are used, so the next frames are more likely to fit
+		const float minStep = fmaxf(voxelSize, 1e-9f);
+		const float padding = (keyframeInterval > 1) ? 0.05f : 0.0f;
+		const float3 pad = make_float3((maxPos.x - minPos.x) * padding, (maxPos.y - minPos.y) * padding, (maxPos.z - minPos.z) * padding);
+
+		mEncodeOrigin = make_float3(minPos.x - pad.x, minPos.y - pad.y, minPos.z - pad.z);
+
+		mEncodeStep = make_float3(fmaxf((maxPos.x - minPos.x + pad.x * 2.0f) / STREAM_QUANT_MAX, minStep),
+							 fmaxf((maxPos.y - minPos.y + pad.y * 2.0f) / STREAM_QUANT_MAX, minStep),
+							 fmaxf((maxPos.z - minPos.z + pad.z * 2.0f) / STREAM_QUANT_MAX, minStep));
+	}
+
+	// quantize the positions into voxel keys, and sort them (the first point of each voxel is kept)
+	const float3 origin = mEncodeOrigin;
+	const float3 scale = make_float3(1.0f / mEncodeStep.x, 1.0f / mEncodeStep.y, 1.0f / mEncodeStep.z);
+
+	std::vector<std::pair<uint64_t, uint32_t>> voxels(numPoints);
+
+	ParallelFor(numPoints, [&](uint32_t begin, uint32_t end)
+	{
+		for( uint32_t n=begin; n < end; n++ )
+		{
+			const float3& pos = mPointsCPU[n].pos;
+
+			if( !pointValid(pos) )
+			{
+				voxels[n] = std::make_pair(VOXEL_EMPTY, n);
+				continue;
+			}
+
+			const uint32_t x = fminf(fmaxf((pos.x - origin.x) * scale.x + 0.5f, 0.0f), STREAM_QUANT_MAX);
+			const uint32_t y = fminf(fmaxf((pos.y - origin.y) * scale.y + 0.5f, 0.0f), STREAM_QUANT_MAX);
+			const uint32_t z = fminf(fmaxf((pos.z - origin.z) * scale.z + 0.5f, 0.0f), STREAM_QUANT_MAX);
+
+			voxels[n] = std::make_pair(mortonSpread(x) | mortonSpread(y) << 1 | mortonSpread(z) << 2, n);
+		}
+	}, 4096);
+
+	std::sort(voxels.begin(), voxels.end());
+
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> indices;		// the point index of each voxel
+
+	keys.reserve(numPoints);
+	indices.reserve(numPoints);
+
+	for( uint32_t n=0; n < numPoints && voxels[n].first != VOXEL_EMPTY; n++ )
+	{
+		if( !keys.empty() && keys.back() == voxels[n].first )
+			continue;
+
+		keys.push_back(voxels[n].first);
+		indices.push_back(voxels[n].second);
+	}
+
+	// delta frames start with a bitmask of the voxels from the previous frame that were retained,
+	// and only the added voxels are stored (keyframes add all of the voxels)
+	const uint32_t numPrevious = keyframe ? 0 : mEncodeKeys.size();
+
+	std::vector<uint8_t> body((numPrevious + 7) / 8, 0);
+	std::vector<uint32_t> added;
+
+	added.reserve(keys.size());
+
+	for( size_t i=0, j=0; j < keys.size(); )
+	{
+		if( i < numPrevious && mEncodeKeys[i] < keys[j] )
+		{
+			i++;
+		}
+		else if( i < numPrevious && mEncodeKeys[i] == keys[j] )
+		{
+			body[i / 8] |= 1 << (i % 8);
+			i++;
+			j++;
+		}
+		else
+		{
+			added.push_back(j++);
+		}
+	}
+
+	const size_t numAdded = added.size();
+
+	// the sorted keys are stored as the varint deltas between them
+	uint64_t lastKey = 0;
+
+	for( size_t n=0; n < numAdded; n++ )
+	{
+		writeVarint(body, keys[added[n]] - lastKey);
+		lastKey = keys[added[n]];
+	}
+
+	// the colors are stored as byte planes, which compress better than interleaved bytes
+	uint32_t paletteSize = 0;
+
+	if( colors == COLOR_RGB565 )
+	{
+		const size_t offset = body.size();
+		body.resize(offset + numAdded * 2);
+
+		for( size_t n=0; n < numAdded; n++ )
+		{
+			const uchar3 c = mPointsCPU[indices[added[n]]].color;
+			const uint16_t rgb = (c.x >> 3) << 11 | (c.y >> 2) << 5 | (c.z >> 3);
+
+			body[offset + n] = rgb & 0xFF;
+			body[offset + numAdded + n] = rgb >> 8;
+		}
+	}
+	else if( colors == COLOR_PALETTE )
+	{
+		std::vector<uchar3> colorsAdded(numAdded);
+
+		for( size_t n=0; n < numAdded; n++ )
+			colorsAdded[n] = mPointsCPU[indices[added[n]]].color;
+
+		uchar3 palette[256];
+		std::vector<uint8_t> paletteIndices(numAdded);
+
+		paletteSize = buildPalette(colorsAdded.data(), numAdded, palette, paletteIndices.data());
+
+		body.insert(body.end(), (uint8_t*)palette, (uint8_t*)palette + paletteSize * 3);
+		body.insert(body.end(), paletteIndices.begin(), paletteIndices.end());
+	}
+
+	// the class IDs are only included if any are set
+	uint8_t flags = 0;
+
+	for( size_t n=0; n < numAdded; n++ )
+	{
+		if( mPointsCPU[indices[added[n]]].classID != 0 )
+		{
+			flags |= STREAM_FLAG_CLASS;
+			break;
+		}
+	}
+
+	if( flags & STREAM_FLAG_CLASS )
+	{
+		for( size_t n=0; n < numAdded; n++ )
+			body.push_back(mPointsCPU[indices[added[n]]].classID);
+	}
+
+	// compress the body (or store it uncompressed if it doesn't compress)
+	const size_t headerSize = sizeof(streamFrameHeader);
+	const size_t bodyMax = body.size() + body.size() / 16 + 64;
+
+	mEncodeBuffer.resize(headerSize + bodyMax);
+
+	streamFrameHeader header;
+	memset(&header, 0, sizeof(header));
+
+	header.magic          = STREAM_FRAME_MAGIC;
+	header.frame          = mEncodeFrame;
+	header.reference      = keyframe ? mEncodeFrame : mEncodeFrame - 1;
+	header.numPoints      = keys.size();
+	header.numAdded       = numAdded;
+	header.numPrevious    = numPrevious;
+	header.colors         = colors;
+	header.flags          = flags;
+	header.paletteSize    = paletteSize;
+	header.origin[0]      = mEncodeOrigin.x;
+	header.origin[1]      = mEncodeOrigin.y;
+	header.origin[2]      = mEncodeOrigin.z;
+	header.step[0]        = mEncodeStep.x;
+	header.step[1]        = mEncodeStep.y;
+	header.step[2]        = mEncodeStep.z;
+	header.bodySize       = body.size();
+	header.compressedSize = lzfCompress(body.data(), body.size(), mEncodeBuffer.data() + headerSize, bodyMax);
+
+	if( header.compressedSize == 0 || header.compressedSize >= body.size() )
+	{
+		header.compressedSize = 0;
+		memcpy(mEncodeBuffer.data() + headerSize, body.data(), body.size());
+	}
+
+	memcpy(mEncodeBuffer.data(), &header, headerSize);
+
+	// the keys are kept for the next delta frame
+	mEncodeKeys.swap(keys);
+
+	if( keyframe )
+		mEncodeKeyframe = mEncodeFrame;
+
+	mEncodeFrame++;
+
+	*data = mEncodeBuffer.data();
+	*size = headerSize + (header.compressedSize > 0 ? header.compressedSize : header.bodySize);
+
+	return true;
+}
+
+
+// Decode
+bool cudaPointCloud::Decode( const uint8_t* data, size_t size )
+{
+	if( !data || size < sizeof(streamFrameHeader) )
+		return false;
+
+	if( IsAccumulating() )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Decode() -- not supported in accumulation mode\n");
+		return false;
+	}
+
+	streamFrameHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	if( header.magic != STREAM_FRAME_MAGIC || header.colors > COLOR_PALETTE || header.paletteSize > 256 )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Decode() -- invalid frame header\n");
+		return false;
+	}
+
+	const bool keyframe = (header.reference == header.frame);
+
+	if( !keyframe && (!mDecodeValid || mDecodeFrame != header.reference || mDecodeKeys.size() != header.numPrevious) )
+	{
+		LogVerbose(LOG_CUDA "cudaPointCloud::Decode() -- skipping frame %u (missing reference frame %u)\n", header.frame, header.reference);
+		return false;
+	}
+
+	// decompress the body
+	const uint8_t* payload = data + sizeof(header);
+	const size_t payloadSize = size - sizeof(header);
+
+	std::vector<uint8_t> body(header.bodySize);
+
+	if( header.compressedSize == 0 )
+	{
+		if( payloadSize < header.bodySize )
+			return false;
+
+		memcpy(body.data(), payload, header.bodySize);
+	}
+	else if( payloadSize < header.compressedSize || 
+		    lzfDecompress(payload, header.compressedSize, body.data(), header.bodySize) != header.bodySize )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Decode() -- failed to decompress frame %u\n", header.frame);
+		return false;
+	}
+
+	// parse the body
+	const uint8_t* ptr = body.data();
+	const uint8_t* bodyEnd = body.data() + body.size();
+
+	const size_t numAdded = header.numAdded;
+	const size_t retainedSize = (header.numPrevious + 7) / 8;
+	const size_t colorSize = (header.colors == COLOR_RGB565) ? numAdded * 2 : (header.colors == COLOR_PALETTE) ? header.paletteSize * 3 + numAdded : 0;
+	const size_t classSize = (header.flags & STREAM_FLAG_CLASS) ? numAdded : 0;
+
+	if( size_t(bodyEnd - ptr) < retainedSize )
+		return false;
+
+	const uint8_t* retained = ptr;
+	ptr += retainedSize;
+
+	std::vector<uint64_t> addedKeys(numAdded);
+	uint64_t lastKey = 0;
+
+	for( size_t n=0; n < numAdded; n++ )
+	{
+		uint64_t delta = 0;
+
+		if( !readVarint(ptr, bodyEnd, delta) )
+		{
+			LogError(LOG_CUDA "cudaPointCloud::Decode() -- invalid voxel keys in frame %u\n", header.frame);
+			return false;
+		}
+
+		lastKey += delta;
+		addedKeys[n] = lastKey;
+	}
+
+	if( size_t(bodyEnd - ptr) < colorSize + classSize )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Decode() -- frame %u is truncated\n", header.frame);
+		return false;
+	}
+
+	const uint8_t* colorData = ptr;
+	const uint8_t* classData = ptr + colorSize;
+
+	// merge the retained voxels of the previous frame with the added ones (both are sorted)
+	std::vector<uint64_t> keys;
+	std::vector<Vertex> points;
+
+	keys.reserve(header.numPoints);
+	points.reserve(header.numPoints);
+
+	for( size_t i=0, j=0; j < numAdded || i < header.numPrevious; )
+	{
+		if( i < header.numPrevious && !(retained[i / 8] & (1 << (i % 8))) )
+		{
+			i++;
+			continue;
+		}
+
+		if( i < header.numPrevious && (j >= numAdded || mDecodeKeys[i] < addedKeys[j]) )
+		{
+			keys.push_back(mDecodeKeys[i]);
+			points.push_back(mDecodePoints[i++]);
+			continue;
+		}
+
+		Vertex point;
+
+		if( header.colors == COLOR_RGB565 )
+		{
+			const uint16_t rgb = colorData[j] | (colorData[numAdded + j] << 8);
+			const uint8_t r = (rgb >> 11) & 0x1F;
+			const uint8_t g = (rgb >> 5) & 0x3F;
+			const uint8_t b = rgb & 0x1F;
+
+			point.color = make_uchar3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+		}
+		else if( header.colors == COLOR_PALETTE )
+		{
+			const uint8_t index = colorData[header.paletteSize * 3 + j];
+
+			if( index >= header.paletteSize )
+				return false;
+
+			point.color = make_uchar3(colorData[index * 3], colorData[index * 3 + 1], colorData[index * 3 + 2]);
+		}
+		else
+		{
+			point.color = make_uchar3(255, 255, 255);
+		}
+
+		point.classID = classSize ? classData[j] : 0;
+
+		keys.push_back(addedKeys[j++]);
+		points.push_back(point);
+	}
+
+	if( keys.size() != header.numPoints )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Decode() -- frame %u has %zu points (expected %u)\n", header.frame, keys.size(), header.numPoints);
+		return false;
+	}
+
+	// reconstruct the positions from the voxel keys
+	const uint32_t numPoints = header.numPoints;
+
+	if( numPoints > 0 && !Reserve(numPoints) )
+		return false;
+
+	ParallelFor(numPoints, [&](uint32_t begin, uint32_t end)
+	{
+		for( uint32_t n=begin; n < end; n++ )
+		{
+			const uint64_t key = keys[n];
+
+			points[n].pos = make_float3(header.origin[0] + mortonCompact(key) * header.step[0],
+								   header.origin[1] + mortonCompact(key >> 1) * header.step[1],
+								   header.origin[2] + mortonCompact(key >> 2) * header.step[2]);
+
+			mPointsCPU[n] = points[n];
+		}
+	}, 4096);
+
+	mNumPoints = numPoints;
+	mHeight = 1;
+	mHasRGB = (header.colors != COLOR_NONE);
+	mHasNormals = false;
+	mHasNewPoints = true;
+
+	// keep the voxels for the next delta frame
+	mDecodeKeys.swap(keys);
+	mDecodePoints.swap(points);
+
+	mDecodeFrame = header.frame;
+	mDecodeValid = true;
+
+	return true;
+}
+
+
+// Send
+bool cudaPointCloud::Send( Socket* socket, uint32_t remoteIP, uint16_t remotePort, ColorEncoding colors, uint32_t keyframeInterval, float voxelSize )
+{
+	if( !socket )
+		return false;
+
+	uint8_t* data = NULL;
+	size_t size = 0;
+
+	if( !Encode(&data, &size, colors, keyframeInterval, voxelSize) )
+		return false;
+
+	// UDP chunks need to fit in a standard ethernet frame (minus the IP and UDP headers)
+	const size_t packetSize = (socket->GetType() == SOCKET_UDP) ? 1500 - 28 : 65536;
+	const size_t chunkMax = packetSize - sizeof(streamChunkHeader);
+
+	std::vector<uint8_t> packet(packetSize);
+
+	streamChunkHeader chunk;
+
+	chunk.magic     = STREAM_CHUNK_MAGIC;
+	chunk.frame     = mEncodeFrame - 1;
+	chunk.frameSize = size;
+
+	for( size_t offset=0; offset < size; offset += chunkMax )
+	{
+		chunk.offset = offset;
+		chunk.size   = (size - offset < chunkMax) ? size - offset : chunkMax;
+
+		memcpy(packet.data(), &chunk, sizeof(chunk));
+		memcpy(packet.data() + sizeof(chunk), data + offset, chunk.size);
+
+		if( !socket->Send(packet.data(), sizeof(chunk) + chunk.size, remoteIP, remotePort) )
+		{
+			LogError(LOG_CUDA "cudaPointCloud::Send() -- failed to send frame %u\n", chunk.frame);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// Receive
+bool cudaPointCloud::Receive( Socket* socket )
+{
+	if( !socket )
+		return false;
+
+	// room for at least one TCP chunk (UDP receives one chunk per packet)
+	const size_t bufferSize = 65536 * 2;
+
+	if( mRecvBuffer.size() < bufferSize )
+		mRecvBuffer.resize(bufferSize);
+
+	while( true )
+	{
+		// process the complete chunks that have been buffered (TCP can receive partial or multiple chunks at once)
+		while( mRecvSize >= sizeof(streamChunkHeader) )
+		{
+			streamChunkHeader chunk;
+			memcpy(&chunk, mRecvBuffer.data(), sizeof(chunk));
+
+			if( chunk.magic != STREAM_CHUNK_MAGIC || chunk.size > bufferSize - sizeof(chunk) )
+			{
+				LogError(LOG_CUDA "cudaPointCloud::Receive() -- invalid chunk, discarding %zu bytes\n", mRecvSize);
+				mRecvSize = 0;
+				break;
+			}
+
+			const size_t chunkSize = sizeof(chunk) + chunk.size;
+
+			if( mRecvSize < chunkSize )
+				break;
+
+			// start assembling a new frame (any incomplete frame before it is dropped)
+			if( chunk.frame != mRecvFrameID || mRecvBytes == 0 )
+			{
+				mRecvFrame.resize(chunk.frameSize);
+				mRecvFrameID = chunk.frame;
+				mRecvBytes = 0;
+			}
+
+			bool complete = false;
+
+			if( chunk.offset + chunk.size <= mRecvFrame.size() )
+			{
+				memcpy(mRecvFrame.data() + chunk.offset, mRecvBuffer.data() + sizeof(chunk), chunk.size);
+				mRecvBytes += chunk.size;
+				complete = (mRecvBytes == mRecvFrame.size());
+			}
+
+			memmove(mRecvBuffer.data(), mRecvBuffer.data() + chunkSize, mRecvSize - chunkSize);
+			mRecvSize -= chunkSize;
+
+			if( complete )
+			{
+				mRecvBytes = 0;
+				return Decode(mRecvFrame.data(), mRecvFrame.size());
+			}
+		}
+
+		const size_t bytes = socket->Recieve(mRecvBuffer.data() + mRecvSize, bufferSize - mRecvSize);
+
+		if( bytes == 0 )
+			return false;
+
+		mRecvSize += bytes;
+	}
+}
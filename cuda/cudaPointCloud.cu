@@ -22,6 +22,7 @@
 
 #include "cudaPointCloud.h"
 #include "cudaColormap.h"
+#include "cudaFilter.h"
 
 #include "logging.h"
 
@@ -33,10 +34,22 @@ inline __host__ __device__ uchar3 make_uchar3( float4 a )
 }
 
 
+// rigid transform passed to the kernels by value
+struct pointCloudPose
+{
+	float m[3][4];
+};
+
+// frame stamp of evicted points
+#define FRAME_STAMP_INVALID 0xFFFFFFFF
+
+
 // gpuPointCloudExtract
-template<bool useRGB>
+template<bool useRGB, bool accumulate>
 __global__ void gpuPointCloudExtract( float* depth, float4* rgba, int width, int height, 
-							   float2 fx, float2 cx, cudaPointCloud::Vertex* points )
+							   float2 fx, float2 cx, cudaPointCloud::Vertex* points,
+							   bool organized, pointCloudPose pose, uint32_t* stamps, uint32_t* counter,
+							   uint32_t head, uint32_t capacity, uint32_t frame )
 {
 	const int x = blockIdx.x * blockDim.x + threadIdx.x;
 	const int y = blockIdx.y * blockDim.y + threadIdx.y;
@@ -48,6 +61,12 @@ __global__ void gpuPointCloudExtract( float* depth, float4* rgba, int width, int
 	// read depth map sample
 	const float depth_sample = depth[i];
 
+	const bool valid = (depth_sample > 0.0f && isfinite(depth_sample));
+
+	// the ring only stores valid samples
+	if( accumulate && !valid )
+		return;
+
 	// create output point
 	cudaPointCloud::Vertex point;
 
@@ -64,14 +83,59 @@ __global__ void gpuPointCloudExtract( float* depth, float4* rgba, int width, int
 	else
 		point.color = make_uchar3(255,255,255);
 
-	// save the point
-	points[i] = point;
+	if( !accumulate )
+	{
+		// organized clouds keep the grid, with NaN for the invalid pixels
+		if( organized && !valid )
+			point.pos = make_float3(NAN, NAN, NAN);
+
+		// save the point
+		points[i] = point;
+		return;
+	}
+
+	// transform into the world frame
+	const float3 p = point.pos;
+
+	point.pos = make_float3(pose.m[0][0] * p.x + pose.m[0][1] * p.y + pose.m[0][2] * p.z + pose.m[0][3],
+					    pose.m[1][0] * p.x + pose.m[1][1] * p.y + pose.m[1][2] * p.z + pose.m[1][3],
+					    pose.m[2][0] * p.x + pose.m[2][1] * p.y + pose.m[2][2] * p.z + pose.m[2][3]);
+
+	// append the point to the ring (points past the capacity of the ring are dropped,
+	// so a large frame never overwrites its own points)
+	const uint32_t n = atomicAdd(counter, 1);
+
+	if( n >= capacity )
+		return;
+
+	const uint32_t slot = (head + n) % capacity;
+
+	points[slot] = point;
+	stamps[slot] = frame;
+}
+
+
+// gpuPointCloudEvict
+__global__ void gpuPointCloudEvict( cudaPointCloud::Vertex* points, uint32_t* stamps, uint32_t numPoints, uint32_t frame, uint32_t maxAge )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= numPoints )
+		return;
+
+	const uint32_t stamp = stamps[i];
+
+	if( stamp == FRAME_STAMP_INVALID || frame - stamp < maxAge )
+		return;
+
+	points[i].pos = make_float3(NAN, NAN, NAN);
+	stamps[i] = FRAME_STAMP_INVALID;
 }
 
 
 // Extract
 bool cudaPointCloud::Extract( float* depth, uint32_t depth_width, uint32_t depth_height,
-						float4* rgba, uint32_t color_width, uint32_t color_height )
+						float4* rgba, uint32_t color_width, uint32_t color_height, bool gpu )
 {
 	if( !depth )
 	{
@@ -95,6 +159,28 @@ bool cudaPointCloud::Extract( float* depth, uint32_t depth_width, uint32_t depth
 	if( rgba != NULL )
 		mHasRGB = true;
 
+	// the points have the resolution of the color image if it's used
+	const uint32_t width  = mHasRGB ? color_width : depth_width;
+	const uint32_t height = mHasRGB ? color_height : depth_height;
+
+	// allocate point cloud memory (the ring in accumulation mode is already allocated)
+	if( !IsAccumulating() && !Reserve(width * height) )
+		return false;
+		
+	// default calibration if needed
+	if( !mHasCalibration )
+	{
+		const float f_w = (float)width;
+		const float f_h = (float)height;
+
+		mFocalLength = make_float2(f_h, f_h);
+		mPrincipalPoint = make_float2(f_w * 0.5f, f_h * 0.5f);
+	}
+
+	// use the CPU if requested (or if there's no GPU)
+	if( !gpu || mHostMemory )
+		return extractCPU(depth, depth_width, depth_height, rgba, width, height);
+
 	// upsample depth if needed
 	if( mHasRGB && (depth_width != color_width || depth_height != color_height) )
 	{
@@ -115,30 +201,33 @@ bool cudaPointCloud::Extract( float* depth, uint32_t depth_width, uint32_t depth
 		depth_height = color_height;
 	}
 
-	// allocate point cloud memory
 	const uint32_t numPoints = depth_width * depth_height;
 
-	if( !Reserve(numPoints) )
-		return false;
-		
-	// default calibration if needed
-	if( !mHasCalibration )
-	{
-		const float f_w = (float)depth_width;
-		const float f_h = (float)depth_height;
+	// identity transform unless a pose was set
+	pointCloudPose pose;
 
-		mFocalLength = make_float2(f_h, f_h);
-		mPrincipalPoint = make_float2(f_w * 0.5f, f_h * 0.5f);
-	}
+	for( int i=0; i < 3; i++ )
+		for( int j=0; j < 4; j++ )
+			pose.m[i][j] = mHasPose ? mPose[i][j] : ((i == j) ? 1.0f : 0.0f);
 
 	// launch kernel
 	const dim3 blockDim(8, 8);
 	const dim3 gridDim(iDivUp(depth_width,blockDim.x), iDivUp(depth_height,blockDim.y));
 
-	if( mHasRGB )
-		gpuPointCloudExtract<true><<<gridDim, blockDim>>>(depth, rgba, depth_width, depth_height, mFocalLength, mPrincipalPoint, mPointsGPU);
+	#define LAUNCH_EXTRACT(accumulate) \
+	{ \
+		if( mHasRGB ) \
+			gpuPointCloudExtract<true, accumulate><<<gridDim, blockDim>>>(depth, rgba, depth_width, depth_height, mFocalLength, mPrincipalPoint, mPointsGPU, \
+															   mOrganized, pose, mFrameStampsGPU, mRingCounterGPU, mRingHead, mRingCapacity, mFrameCount); \
+		else \
+			gpuPointCloudExtract<false, accumulate><<<gridDim, blockDim>>>(depth, rgba, depth_width, depth_height, mFocalLength, mPrincipalPoint, mPointsGPU, \
+															    mOrganized, pose, mFrameStampsGPU, mRingCounterGPU, mRingHead, mRingCapacity, mFrameCount); \
+	}
+
+	if( IsAccumulating() )
+		LAUNCH_EXTRACT(true)
 	else
-		gpuPointCloudExtract<false><<<gridDim, blockDim>>>(depth, rgba, depth_width, depth_height, mFocalLength, mPrincipalPoint, mPointsGPU);
+		LAUNCH_EXTRACT(false)
 
 	// check for launch errors
 	if( CUDA_FAILED(cudaGetLastError()) )
@@ -146,23 +235,644 @@ bool cudaPointCloud::Extract( float* depth, uint32_t depth_width, uint32_t depth
 		LogError(LOG_CUDA "cudaPointCloud::Extract() -- failed to extra point cloud with CUDA\n");
 		return false;
 	}
-	
-	mNumPoints = numPoints;
-	mHasNewPoints = true;
 
+	if( IsAccumulating() )
+	{
+		// wait for the number of points that were appended
+		if( CUDA_FAILED(cudaDeviceSynchronize()) )
+			return false;
+
+		const uint32_t appended = min(*mRingCounterCPU, mRingCapacity);
+
+		*mRingCounterCPU = 0;
+
+		mRingHead  = (mRingHead + appended) % mRingCapacity;
+		mNumPoints = min(mNumPoints + appended, mRingCapacity);
+
+		// evict the points from old frames
+		if( mRingMaxAge > 0 && mFrameCount >= mRingMaxAge )
+		{
+			gpuPointCloudEvict<<<iDivUp(mNumPoints, 256), 256>>>(mPointsGPU, mFrameStampsGPU, mNumPoints, mFrameCount, mRingMaxAge);
+
+			if( CUDA_FAILED(cudaGetLastError()) )
+				return false;
+		}
+
+		mFrameCount++;
+		mHeight = 1;
+	}
+	else
+	{
+		mNumPoints = numPoints;
+		mHeight = mOrganized ? depth_height : 1;
+	}
+
+	mHasNormals = false;
+	mHasNewPoints = true;
 	return true;
 }
 
 
 // Extract
-bool cudaPointCloud::Extract( float* depth, float4* rgba, uint32_t width, uint32_t height )
+bool cudaPointCloud::Extract( float* depth, float4* rgba, uint32_t width, uint32_t height, bool gpu )
+{
+	return Extract(depth, width, height, rgba, width, height, gpu);
+}
+
+
+
+
+
+
+
+
+
+//----------------------------------------------------------------------------
+// Exclusive prefix sum (used to compact the voxels and filtered points)
+//----------------------------------------------------------------------------
+#define SCAN_BLOCK_SIZE 256
+#define SCAN_ITEMS 4
+#define SCAN_TILE (SCAN_BLOCK_SIZE * SCAN_ITEMS)
+
+// scan each tile, and store the tile totals so they can be scanned in turn
+__global__ void gpuScanTiles( const uint32_t* input, uint32_t* output, uint32_t count, uint32_t* tileSums )
+{
+	__shared__ uint32_t shared[SCAN_BLOCK_SIZE];
+
+	const uint32_t base = blockIdx.x * SCAN_TILE + threadIdx.x * SCAN_ITEMS;
+
+	uint32_t items[SCAN_ITEMS];
+	uint32_t sum = 0;
+
+	#pragma unroll
+	for( int n=0; n < SCAN_ITEMS; n++ )
+	{
+		items[n] = (base + n < count) ? input[base + n] : 0;
+		sum += items[n];
+	}
+
+	shared[threadIdx.x] = sum;
+	__syncthreads();
+
+	for( int offset=1; offset < SCAN_BLOCK_SIZE; offset *= 2 )
+	{
+		const uint32_t value = (threadIdx.x >= offset) ? shared[threadIdx.x - offset] : 0;
+		__syncthreads();
+		shared[threadIdx.x] += value;
+		__syncthreads();
+	}
+
+	uint32_t prefix = shared[threadIdx.x] - sum;
+
+	#pragma unroll
+	for( int n=0; n < SCAN_ITEMS; n++ )
+	{
+		if( base + n < count )
+			output[base + n] = prefix;
+
+		prefix += items[n];
+	}
+
+	if( threadIdx.x == SCAN_BLOCK_SIZE - 1 )
+		tileSums[blockIdx.x] = shared[threadIdx.x];
+}
+
+__global__ void gpuScanAdd( uint32_t* output, uint32_t count, const uint32_t* tileSums )
+{
+	#pragma unroll
+	for( int n=0; n < SCAN_ITEMS; n++ )
+	{
+		const uint32_t i = blockIdx.x * SCAN_TILE + n * SCAN_BLOCK_SIZE + threadIdx.x;
+
+		if( i < count )
+			output[i] += tileSums[blockIdx.x];
+	}
+}
+
+// the scratch needs count/(SCAN_TILE-1)+1 elements, and total receives the sum in GPU memory
+static void scanExclusive( const uint32_t* input, uint32_t* output, uint32_t count, uint32_t* scratch, uint32_t* total )
+{
+	const uint32_t tiles = iDivUp(count, SCAN_TILE);
+
+	gpuScanTiles<<<tiles, SCAN_BLOCK_SIZE>>>(input, output, count, scratch);
+
+	if( tiles > 1 )
+	{
+		scanExclusive(scratch, scratch, tiles, scratch + tiles, total);
+		gpuScanAdd<<<tiles, SCAN_BLOCK_SIZE>>>(output, count, scratch);
+	}
+	else
+	{
+		CUDA(cudaMemcpyAsync(total, scratch, sizeof(uint32_t), cudaMemcpyDeviceToDevice));
+	}
+}
+
+static inline size_t scanScratchSize( uint32_t count )
+{
+	return (count / (SCAN_TILE - 1) + 16) * sizeof(uint32_t);
+}
+
+
+//----------------------------------------------------------------------------
+// Hashed voxel/grid keys
+//----------------------------------------------------------------------------
+#define VOXEL_EMPTY 0xFFFFFFFFFFFFFFFFULL
+
+// pack 21 bits of each coordinate (the top bit is never set, so keys can't be VOXEL_EMPTY)
+inline __device__ unsigned long long voxelKey( const float3& pos, float scale )
+{
+	const int x = floorf(pos.x * scale);
+	const int y = floorf(pos.y * scale);
+	const int z = floorf(pos.z * scale);
+
+	return ((unsigned long long)(x & 0x1FFFFF) << 42) | ((unsigned long long)(y & 0x1FFFFF) << 21) | (unsigned long long)(z & 0x1FFFFF);
+}
+
+inline __device__ unsigned long long voxelKey( int x, int y, int z )
+{
+	return ((unsigned long long)(x & 0x1FFFFF) << 42) | ((unsigned long long)(y & 0x1FFFFF) << 21) | (unsigned long long)(z & 0x1FFFFF);
+}
+
+inline __device__ uint32_t voxelHash( unsigned long long key )
+{
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+
+	return (uint32_t)key;
+}
+
+inline __device__ bool pointValid( const float3& pos )
+{
+	return isfinite(pos.x) && isfinite(pos.y) && isfinite(pos.z);
+}
+
+static inline uint32_t nextPow2( uint32_t value )
+{
+	uint32_t n = 1;
+
+	while( n < value )
+		n *= 2;
+
+	return n;
+}
+
+// carve aligned arrays from the scratch memory
+template<typename T>
+static inline T* scratchAlloc( uint8_t*& ptr, size_t count )
+{
+	T* array = (T*)ptr;
+	ptr += ((count * sizeof(T) + 255) / 256) * 256;
+	return array;
+}
+
+
+//----------------------------------------------------------------------------
+// Voxel grid downsampling (hash reduce)
+//----------------------------------------------------------------------------
+__global__ void gpuVoxelInsert( const cudaPointCloud::Vertex* points, uint32_t numPoints, float scale,
+                                unsigned long long* keys, float4* sums, uint4* colors, uint32_t mask )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= numPoints )
+		return;
+
+	const cudaPointCloud::Vertex point = points[i];
+
+	if( !pointValid(point.pos) || point.pos.z == 0.0f )
+		return;
+
+	const unsigned long long key = voxelKey(point.pos, scale);
+
+	// linear probing (the table is at least twice the number of points)
+	uint32_t slot = voxelHash(key) & mask;
+
+	while( true )
+	{
+		const unsigned long long prev = atomicCAS(&keys[slot], VOXEL_EMPTY, key);
+
+		if( prev == VOXEL_EMPTY || prev == key )
+			break;
+
+		slot = (slot + 1) & mask;
+	}
+
+	atomicAdd(&sums[slot].x, point.pos.x);
+	atomicAdd(&sums[slot].y, point.pos.y);
+	atomicAdd(&sums[slot].z, point.pos.z);
+	atomicAdd(&sums[slot].w, 1.0f);
+
+	atomicAdd(&colors[slot].x, point.color.x);
+	atomicAdd(&colors[slot].y, point.color.y);
+	atomicAdd(&colors[slot].z, point.color.z);
+	atomicMax(&colors[slot].w, point.classID);
+}
+
+__global__ void gpuVoxelFlags( const unsigned long long* keys, uint32_t* flags, uint32_t tableSize )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= tableSize )
+		return;
+
+	flags[i] = (keys[i] != VOXEL_EMPTY) ? 1 : 0;
+}
+
+__global__ void gpuVoxelCompact( const unsigned long long* keys, const float4* sums, const uint4* colors, 
+                                 const uint32_t* offsets, uint32_t tableSize, cudaPointCloud::Vertex* points )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= tableSize || keys[i] == VOXEL_EMPTY )
+		return;
+
+	const float4 sum = sums[i];
+	const uint4 color = colors[i];
+	const float n = sum.w;
+
+	cudaPointCloud::Vertex point;
+
+	point.pos = make_float3(sum.x / n, sum.y / n, sum.z / n);
+	point.color = make_uchar3(color.x / n + 0.5f, color.y / n + 0.5f, color.z / n + 0.5f);
+	point.classID = color.w;
+
+	points[offsets[i]] = point;
+}
+
+
+// Downsample
+bool cudaPointCloud::Downsample( float voxelSize, bool gpu )
+{
+	if( voxelSize <= 0.0f || mNumPoints == 0 )
+		return false;
+
+	if( IsAccumulating() )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Downsample() -- not supported in accumulation mode\n");
+		return false;
+	}
+
+	if( !gpu || mHostMemory )
+		return downsampleCPU(voxelSize);
+
+	const uint32_t tableSize = nextPow2(mNumPoints * 2);
+
+	const size_t scratchSize = tableSize * (sizeof(unsigned long long) + sizeof(float4) + sizeof(uint4) + sizeof(uint32_t) * 2) 
+						+ scanScratchSize(tableSize) + 256 * 16;
+
+	if( !allocScratch(scratchSize) )
+		return false;
+
+	uint8_t* ptr = (uint8_t*)mScratchGPU;
+
+	unsigned long long* keys = scratchAlloc<unsigned long long>(ptr, tableSize);
+	float4*   sums    = scratchAlloc<float4>(ptr, tableSize);
+	uint4*    colors  = scratchAlloc<uint4>(ptr, tableSize);
+	uint32_t* flags   = scratchAlloc<uint32_t>(ptr, tableSize);
+	uint32_t* offsets = scratchAlloc<uint32_t>(ptr, tableSize);
+	uint32_t* total   = scratchAlloc<uint32_t>(ptr, 1);
+	uint32_t* scan    = scratchAlloc<uint32_t>(ptr, scanScratchSize(tableSize) / sizeof(uint32_t));
+
+	CUDA(cudaMemsetAsync(keys, 0xFF, tableSize * sizeof(unsigned long long)));
+	CUDA(cudaMemsetAsync(sums, 0, tableSize * sizeof(float4)));
+	CUDA(cudaMemsetAsync(colors, 0, tableSize * sizeof(uint4)));
+
+	const float scale = 1.0f / voxelSize;
+
+	gpuVoxelInsert<<<iDivUp(mNumPoints, 256), 256>>>(mPointsGPU, mNumPoints, scale, keys, sums, colors, tableSize - 1);
+	gpuVoxelFlags<<<iDivUp(tableSize, 256), 256>>>(keys, flags, tableSize);
+
+	scanExclusive(flags, offsets, tableSize, scan, total);
+
+	// the voxels are read from the table, so they can overwrite the points in-place
+	gpuVoxelCompact<<<iDivUp(tableSize, 256), 256>>>(keys, sums, colors, offsets, tableSize, mPointsGPU);
+
+	uint32_t numVoxels = 0;
+
+	if( CUDA_FAILED(cudaMemcpy(&numVoxels, total, sizeof(uint32_t), cudaMemcpyDeviceToHost)) )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Downsample() -- failed to downsample point cloud with CUDA\n");
+		return false;
+	}
+
+	mNumPoints = numVoxels;
+	mHeight = 1;
+	mHasNormals = false;
+	mHasNewPoints = true;
+
+	return true;
+}
+
+
+//----------------------------------------------------------------------------
+// Radius outlier filter (hashed grid with a cell size equal to the radius)
+//----------------------------------------------------------------------------
+__global__ void gpuGridCount( const cudaPointCloud::Vertex* points, uint32_t numPoints, float scale,
+                              uint32_t* pointBuckets, uint32_t* bucketCounts, uint32_t mask )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= numPoints )
+		return;
+
+	const float3 pos = points[i].pos;
+
+	if( !pointValid(pos) )
+	{
+		pointBuckets[i] = 0xFFFFFFFF;
+		return;
+	}
+
+	const uint32_t bucket = voxelHash(voxelKey(pos, scale)) & mask;
+
+	pointBuckets[i] = bucket;
+	atomicAdd(&bucketCounts[bucket], 1);
+}
+
+__global__ void gpuGridFill( const uint32_t* pointBuckets, uint32_t numPoints, const uint32_t* bucketStarts,
+                             uint32_t* bucketFill, uint32_t* bucketPoints )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= numPoints )
+		return;
+
+	const uint32_t bucket = pointBuckets[i];
+
+	if( bucket == 0xFFFFFFFF )
+		return;
+
+	bucketPoints[bucketStarts[bucket] + atomicAdd(&bucketFill[bucket], 1)] = i;
+}
+
+__global__ void gpuRadiusFilter( const cudaPointCloud::Vertex* points, uint32_t numPoints, float radius, 
+                                 uint32_t minNeighbors, const uint32_t* pointBuckets, const uint32_t* bucketStarts, 
+                                 const uint32_t* bucketCounts, const uint32_t* bucketPoints, uint32_t mask, uint32_t* keep )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= numPoints )
+		return;
+
+	if( pointBuckets[i] == 0xFFFFFFFF )
+	{
+		keep[i] = 0;
+		return;
+	}
+
+	const float3 pos = points[i].pos;
+	const float scale = 1.0f / radius;
+	const float radiusSq = radius * radius;
+
+	const int cx = floorf(pos.x * scale);
+	const int cy = floorf(pos.y * scale);
+	const int cz = floorf(pos.z * scale);
+
+	uint32_t neighbors = 0;
+
+	for( int z=cz-1; z <= cz+1 && neighbors < minNeighbors; z++ )
+	{
+		for( int y=cy-1; y <= cy+1 && neighbors < minNeighbors; y++ )
+		{
+			for( int x=cx-1; x <= cx+1 && neighbors < minNeighbors; x++ )
+			{
+				const unsigned long long key = voxelKey(x, y, z);
+				const uint32_t bucket = voxelHash(key) & mask;
+				const uint32_t end = bucketStarts[bucket] + bucketCounts[bucket];
+
+				for( uint32_t n=bucketStarts[bucket]; n < end; n++ )
+				{
+					const uint32_t j = bucketPoints[n];
+
+					if( j == i )
+						continue;
+
+					const float3 q = points[j].pos;
+
+					// buckets can be shared by several cells, so only count points from this cell
+					if( voxelKey(q, scale) != key )
+						continue;
+
+					const float dx = q.x - pos.x;
+					const float dy = q.y - pos.y;
+					const float dz = q.z - pos.z;
+
+					if( dx * dx + dy * dy + dz * dz <= radiusSq )
+						neighbors++;
+				}
+			}
+		}
+	}
+
+	keep[i] = (neighbors >= minNeighbors) ? 1 : 0;
+}
+
+__global__ void gpuPointsCompact( const cudaPointCloud::Vertex* input, uint32_t numPoints, const uint32_t* keep, 
+                                  const uint32_t* offsets, cudaPointCloud::Vertex* output )
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= numPoints || !keep[i] )
+		return;
+
+	output[offsets[i]] = input[i];
+}
+
+
+// FilterOutliers
+bool cudaPointCloud::FilterOutliers( float radius, uint32_t minNeighbors, bool gpu )
+{
+	if( radius <= 0.0f || mNumPoints == 0 )
+		return false;
+
+	if( IsAccumulating() )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::FilterOutliers() -- not supported in accumulation mode\n");
+		return false;
+	}
+
+	if( !gpu || mHostMemory )
+		return filterOutliersCPU(radius, minNeighbors);
+
+	const uint32_t numPoints = mNumPoints;
+	const uint32_t numBuckets = nextPow2(numPoints);
+
+	const size_t scratchSize = numBuckets * sizeof(uint32_t) * 3 + numPoints * (sizeof(uint32_t) * 3 + sizeof(Vertex))
+						+ scanScratchSize(numBuckets) + 256 * 16;
+
+	if( !allocScratch(scratchSize) )
+		return false;
+
+	uint8_t* ptr = (uint8_t*)mScratchGPU;
+
+	uint32_t* bucketCounts = scratchAlloc<uint32_t>(ptr, numBuckets);
+	uint32_t* bucketStarts = scratchAlloc<uint32_t>(ptr, numBuckets);
+	uint32_t* bucketFill   = scratchAlloc<uint32_t>(ptr, numBuckets);
+	uint32_t* bucketPoints = scratchAlloc<uint32_t>(ptr, numPoints);
+	uint32_t* pointBuckets = scratchAlloc<uint32_t>(ptr, numPoints);
+	uint32_t* keep         = scratchAlloc<uint32_t>(ptr, numPoints);
+	Vertex*   filtered     = scratchAlloc<Vertex>(ptr, numPoints);
+	uint32_t* total        = scratchAlloc<uint32_t>(ptr, 1);
+	uint32_t* scan         = scratchAlloc<uint32_t>(ptr, scanScratchSize(numBuckets) / sizeof(uint32_t));
+
+	CUDA(cudaMemsetAsync(bucketCounts, 0, numBuckets * sizeof(uint32_t)));
+	CUDA(cudaMemsetAsync(bucketFill, 0, numBuckets * sizeof(uint32_t)));
+
+	const dim3 blockDim(256);
+	const dim3 gridDim(iDivUp(numPoints, blockDim.x));
+
+	// sort the points into buckets
+	gpuGridCount<<<gridDim, blockDim>>>(mPointsGPU, numPoints, 1.0f / radius, pointBuckets, bucketCounts, numBuckets - 1);
+	scanExclusive(bucketCounts, bucketStarts, numBuckets, scan, total);
+	gpuGridFill<<<gridDim, blockDim>>>(pointBuckets, numPoints, bucketStarts, bucketFill, bucketPoints);
+
+	// count the neighbors and compact the points that are kept (preserving their order)
+	gpuRadiusFilter<<<gridDim, blockDim>>>(mPointsGPU, numPoints, radius, minNeighbors, pointBuckets, bucketStarts, 
+									bucketCounts, bucketPoints, numBuckets - 1, keep);
+
+	scanExclusive(keep, bucketPoints, numPoints, scan, total);	// the bucket points are reused for the offsets
+	gpuPointsCompact<<<gridDim, blockDim>>>(mPointsGPU, numPoints, keep, bucketPoints, filtered);
+
+	uint32_t numKept = 0;
+
+	if( CUDA_FAILED(cudaMemcpy(&numKept, total, sizeof(uint32_t), cudaMemcpyDeviceToHost)) ||
+	    CUDA_FAILED(cudaMemcpy(mPointsGPU, filtered, numKept * sizeof(Vertex), cudaMemcpyDeviceToDevice)) )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::FilterOutliers() -- failed to filter point cloud with CUDA\n");
+		return false;
+	}
+
+	mNumPoints = numKept;
+	mHeight = 1;
+	mHasNormals = false;
+	mHasNewPoints = true;
+
+	return true;
+}
+
+
+//----------------------------------------------------------------------------
+// Surface normals of organized point clouds (window means from box sums)
+//----------------------------------------------------------------------------
+__global__ void gpuNormalsWeight( const cudaPointCloud::Vertex* points, uint32_t numPoints, float4* means )
 {
-	return Extract(depth, width, height, rgba, width, height);
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= numPoints )
+		return;
+
+	const float3 pos = points[i].pos;
+	means[i] = pointValid(pos) ? make_float4(pos.x, pos.y, pos.z, 1.0f) : make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+// the average position of the valid points in a window, or the fallback if there are none
+inline __device__ float3 windowMean( const float4* means, int x, int y, int width, int height, const float3& fallback )
+{
+	const float4 m = means[min(max(y, 0), height - 1) * width + min(max(x, 0), width - 1)];
+
+	if( m.w < 1e-6f )
+		return fallback;
+
+	return make_float3(m.x / m.w, m.y / m.w, m.z / m.w);
+}
+
+__global__ void gpuNormalsCompute( const cudaPointCloud::Vertex* points, const float4* means, float3* normals, 
+							int width, int height, int offset, float3 viewpoint )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int i = y * width + x;
+	const float3 pos = points[i].pos;
+
+	if( !pointValid(pos) )
+	{
+		normals[i] = make_float3(NAN, NAN, NAN);
+		return;
+	}
+
+	const float3 center = windowMean(means, x, y, width, height, pos);
+
+	const float3 left  = windowMean(means, x - offset, y, width, height, center);
+	const float3 right = windowMean(means, x + offset, y, width, height, center);
+	const float3 up    = windowMean(means, x, y - offset, width, height, center);
+	const float3 down  = windowMean(means, x, y + offset, width, height, center);
+
+	const float3 dx = make_float3(right.x - left.x, right.y - left.y, right.z - left.z);
+	const float3 dy = make_float3(down.x - up.x, down.y - up.y, down.z - up.z);
+
+	const float3 n = make_float3(dx.y * dy.z - dx.z * dy.y, dx.z * dy.x - dx.x * dy.z, dx.x * dy.y - dx.y * dy.x);
+	const float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+	if( !(length > 0.0f) )
+	{
+		normals[i] = make_float3(NAN, NAN, NAN);
+		return;
+	}
+
+	// face the normal towards the viewpoint
+	const float flip = ((viewpoint.x - pos.x) * n.x + (viewpoint.y - pos.y) * n.y + (viewpoint.z - pos.z) * n.z < 0.0f) ? -1.0f : 1.0f;
+	const float scale = flip / length;
+
+	normals[i] = make_float3(n.x * scale, n.y * scale, n.z * scale);
 }
 
 
+// ComputeNormals
+bool cudaPointCloud::ComputeNormals( uint32_t radius, bool gpu )
+{
+	if( mNumPoints == 0 )
+		return false;
 
+	if( !IsOrganized() )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::ComputeNormals() -- the point cloud needs to be organized (see SetOrganized())\n");
+		return false;
+	}
+
+	if( !allocNormals() )
+		return false;
 
+	if( !gpu || mHostMemory )
+		return computeNormalsCPU(radius);
+
+	const uint32_t width = GetWidth();
+	const uint32_t height = GetHeight();
+
+	if( !allocScratch(mNumPoints * sizeof(float4)) )
+		return false;
 
+	float4* means = (float4*)mScratchGPU;
 
+	// organized clouds are never transformed by the pose (it's only applied 
+	// when accumulating), so the camera is always at the origin of the points
+	const float3 viewpoint = make_float3(0.0f, 0.0f, 0.0f);
+
+	// weight the positions by their validity, so the box means divided by the 
+	// mean weight give the average position of the valid points in each window
+	gpuNormalsWeight<<<iDivUp(mNumPoints, 256), 256>>>(mPointsGPU, mNumPoints, means);
+
+	if( CUDA_FAILED(cudaFilterBox(means, means, width, height, IMAGE_RGBA32F, radius)) )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::ComputeNormals() -- failed to compute the window means\n");
+		return false;
+	}
 
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuNormalsCompute<<<gridDim, blockDim>>>(mPointsGPU, means, mNormalsGPU, width, height, max((int)radius, 1), viewpoint);
+
+	if( CUDA_FAILED(cudaGetLastError()) )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::ComputeNormals() -- failed to compute normals with CUDA\n");
+		return false;
+	}
+
+	mHasNormals = true;
+	return true;
+}
@@ -26,10 +26,13 @@
 
 #include "cudaUtility.h"
 
+#include <vector>
+
 
 // forward declarations
 class glBuffer;
 class glCamera;
+class Socket;
 
 
 /**
@@ -63,6 +66,27 @@ public:
 
 	} __attribute__((packed));
 
+	/**
+	 * File formats supported by Save() and OpenSequence()
+	 */
+	enum FileFormat
+	{
+		PCD_ASCII,			/**< PCD with `DATA ascii` (human-readable, but slow and large) */
+		PCD_BINARY,			/**< PCD with `DATA binary` */
+		PCD_BINARY_COMPRESSED,	/**< PCD with `DATA binary_compressed` (LZF-compressed, fields stored contiguously) */
+		PLY_BINARY			/**< PLY with `format binary_little_endian`, written directly from the point array */
+	};
+
+	/**
+	 * Color encodings supported by Encode() and Send()
+	 */
+	enum ColorEncoding
+	{
+		COLOR_NONE,			/**< colors aren't sent (the decoded points are white) */
+		COLOR_RGB565,			/**< 16-bit RGB565 colors */
+		COLOR_PALETTE			/**< 8-bit indices into a palette of up to 256 colors that's built for each frame */
+	};
+
 	/**
 	 * Create
 	 */
@@ -94,14 +118,97 @@ public:
 
 	/**
 	 * Extract point cloud from depth map and optional RGBA image.
+	 *
+	 * @param gpu if true, the points are extracted on the GPU, otherwise they're extracted 
+	 *            on the CPU using multiple threads (in which case the depth and RGBA images
+	 *            need to be in CPU-accessible memory).  The CPU is also used if there's no GPU.
 	 */
-	bool Extract( float* depth, float4* rgba, uint32_t width, uint32_t height );
+	bool Extract( float* depth, float4* rgba, uint32_t width, uint32_t height, bool gpu=true );
 
 	/**
 	 * Extract point cloud from depth map and optional RGBA image.
+	 * If the resolution of the depth map and RGBA image differ, the depth is upsampled.
+	 * @see the other overload of Extract() for a description of the `gpu` parameter.
 	 */
 	bool Extract( float* depth, uint32_t depth_width, uint32_t depth_height,
-			    float4* rgba, uint32_t color_width, uint32_t color_height );
+			    float4* rgba, uint32_t color_width, uint32_t color_height, bool gpu=true );
+
+	/**
+	 * Enable organized mode, where Extract() keeps the width x height grid of the depth map
+	 * so that the neighbors of each point can be looked up directly with GetData(x,y).
+	 * Pixels with invalid depth (zero, negative, or non-finite) get NaN positions.
+	 * Save() records the dimensions of the grid in the `WIDTH` and `HEIGHT` fields of PCD files.
+	 *
+	 * Operators that remove or reorder points (like Downsample(), FilterOutliers(), and 
+	 * accumulation mode) turn the cloud back into an unorganized list.
+	 */
+	inline void SetOrganized( bool organized )		{ mOrganized = organized; }
+
+	/**
+	 * Is the point cloud organized into a 2D grid?
+	 */
+	inline bool IsOrganized() const				{ return mHeight > 1; }
+
+	/**
+	 * Retrieve the width of the point cloud
+	 * (for unorganized clouds, this is the number of points).
+	 */
+	inline uint32_t GetWidth() const				{ return mNumPoints / mHeight; }
+
+	/**
+	 * Retrieve the height of the point cloud
+	 * (for unorganized clouds, this is 1).
+	 */
+	inline uint32_t GetHeight() const				{ return mHeight; }
+
+	/**
+	 * Enable accumulation mode, where Extract() appends the points from each frame to a 
+	 * fixed-capacity ring instead of replacing the point cloud.  The ring is allocated once
+	 * in mapped memory using the regular Vertex layout, so Render() and Save() read it directly.
+	 * Invalid depth samples aren't stored, and each point is stamped with the frame that it came from.
+	 *
+	 * When the ring is full, the oldest points get overwritten by new ones.  If `maxAge` is
+	 * non-zero, points from frames that are `maxAge` or more frames old are also evicted (their
+	 * positions are set to NaN, so they're skipped by Downsample(), FilterOutliers(), and viewers).
+	 * Each frame can be transformed into a common world frame with SetPose() before it's extracted.
+	 *
+	 * @param capacity the maximum number of points in the ring (0 disables accumulation mode)
+	 * @param maxAge the number of frames that points are kept for (or 0 to keep them until overwritten)
+	 *
+	 * @note In accumulation mode, Extract() waits for the GPU to finish so that the number of
+	 *       points appended is known, and Downsample()/FilterOutliers() aren't supported.
+	 */
+	bool SetAccumulation( uint32_t capacity, uint32_t maxAge=0 );
+
+	/**
+	 * Is accumulation mode enabled?
+	 */
+	inline bool IsAccumulating() const			{ return mRingCapacity > 0; }
+
+	/**
+	 * Retrieve the number of frames that have been accumulated since 
+	 * accumulation mode was enabled (or the cloud was cleared).
+	 */
+	inline uint32_t GetFrameCount() const			{ return mFrameCount; }
+
+	/**
+	 * Retrieve the frame stamps of the points in accumulation mode (in mapped memory).
+	 * Evicted points have a stamp of `0xFFFFFFFF`, otherwise it's the frame number (starting at 0).
+	 */
+	inline uint32_t* GetFrameStamps() const			{ return mFrameStampsCPU; }
+
+	/**
+	 * Set the pose that transforms the points of subsequent frames into the world frame,
+	 * as a 4x4 row-major rigid transform.  The pose is applied to the points after they're
+	 * back-projected from the depth map (where the camera looks down the -Z axis, with +Y up).
+	 */
+	void SetPose( const float pose[4][4] );
+
+	/**
+	 * Set the pose that transforms the points of subsequent frames into the world frame,
+	 * as a 3x3 rotation matrix followed by a translation.
+	 */
+	void SetPose( const float rotation[3][3], const float3& translation );
 
 	/**
 	 * Retrieve the number of points being used.
@@ -132,12 +239,74 @@ public:
 	 * Retrieve memory pointer to a specific point.
 	 */
 	inline Vertex* GetData( size_t index ) const	{ return mPointsCPU + index; }
+
+	/**
+	 * Retrieve memory pointer to the point at the given coordinates of an organized point cloud.
+	 */
+	inline Vertex* GetData( uint32_t x, uint32_t y ) const	{ return mPointsCPU + y * GetWidth() + x; }
  
 	/**
 	 * Does the point cloud have RGB data?
 	 */
 	inline bool HasRGB() const				{ return mHasRGB; }
 
+	/**
+	 * Downsample the point cloud in-place to one point per voxel.
+	 * The points in each voxel are averaged together (including their colors), 
+	 * and the voxel takes the highest class ID of its points.  Points with a 
+	 * non-finite position or zero depth are removed.  The order of the 
+	 * resulting points is unspecified.
+	 *
+	 * @param voxelSize the edge length of the voxels (in the units of the point positions)
+	 * @param gpu if true, the voxels are reduced with a hash table on the GPU,
+	 *            otherwise they're reduced on the CPU using multiple threads.
+	 */
+	bool Downsample( float voxelSize, bool gpu=true );
+
+	/**
+	 * Remove outliers from the point cloud in-place, by discarding the points that
+	 * have fewer than `minNeighbors` other points within the radius.  Points with a 
+	 * non-finite position are also removed.  The order of the remaining points is kept.
+	 *
+	 * @param radius the radius of the neighborhood (in the units of the point positions)
+	 * @param minNeighbors the number of neighbors a point needs to be kept
+	 * @param gpu if true, the neighbors are searched on the GPU using a hashed grid,
+	 *            otherwise they're searched on the CPU using multiple threads.
+	 */
+	bool FilterOutliers( float radius, uint32_t minNeighbors, bool gpu=true );
+
+	/**
+	 * Estimate the surface normals of an organized point cloud (see SetOrganized()).
+	 * The mean position of the valid points in the `(radius * 2 + 1)^2` window around each pixel 
+	 * is found with running box sums (so the cost doesn't depend on the radius), and the normal is
+	 * the cross product of the horizontal and vertical differences between these means `radius` 
+	 * pixels apart.  The normals are oriented towards the camera, and pixels with an invalid 
+	 * position (or without enough valid neighbors) get a NaN normal.
+	 *
+	 * The normals are stored in mapped memory alongside the points (see GetNormals()), and Save()
+	 * writes them out as `normal_x normal_y normal_z` fields until the points change again.
+	 *
+	 * @param radius the radius of the smoothing window (in pixels)
+	 * @param gpu if true, the normals are estimated on the GPU, otherwise they're
+	 *            estimated on the CPU using multiple threads.
+	 */
+	bool ComputeNormals( uint32_t radius=4, bool gpu=true );
+
+	/**
+	 * Have normals been computed for the current points?
+	 */
+	inline bool HasNormals() const				{ return mHasNormals; }
+
+	/**
+	 * Retrieve memory pointer to the normals (in mapped memory, with one normal per point).
+	 */
+	inline float3* GetNormals() const				{ return mNormalsCPU; }
+
+	/**
+	 * Retrieve memory pointer to the normal of a specific point.
+	 */
+	inline float3* GetNormal( size_t index ) const	{ return mNormalsCPU + index; }
+
 	/**
 	 * Render the point cloud with OpenGL
 	 */
@@ -145,9 +314,94 @@ public:
 
 	/**
 	 * Save point cloud to PCD file.
+	 * Files with the `.ply` extension are saved as binary PLY,
+	 * otherwise the points are saved as ASCII PCD.
 	 */
 	bool Save( const char* filename );
 
+	/**
+	 * Save point cloud to a PCD or PLY file with the specified format.
+	 */
+	bool Save( const char* filename, FileFormat format );
+
+	/**
+	 * Open a sequence file that successive point clouds get appended to with SaveSequence().
+	 * The file stays open between clouds, and each cloud is stored as a complete 
+	 * PCD or PLY document (header followed by data) directly after the previous one.
+	 */
+	bool OpenSequence( const char* filename, FileFormat format=PCD_BINARY );
+
+	/**
+	 * Append the current point cloud to the sequence file opened with OpenSequence().
+	 */
+	bool SaveSequence();
+
+	/**
+	 * Close the sequence file opened with OpenSequence().
+	 */
+	void CloseSequence();
+
+	/**
+	 * Is a sequence file currently open?
+	 */
+	inline bool IsSequenceOpen() const			{ return mSequenceFile != NULL; }
+
+	/**
+	 * Retrieve the number of clouds that have been written to the sequence file.
+	 */
+	inline uint32_t GetSequenceLength() const		{ return mSequenceLength; }
+
+	/**
+	 * Encode the point cloud into a compact format for streaming, which Decode() turns back into a point cloud.
+	 *
+	 * The positions are quantized to 16 bits per axis relative to the bounding box of the points, and are 
+	 * stored as the deltas between their sorted voxel keys (Morton codes), so points that fall into the 
+	 * same voxel get merged and invalid points are dropped (the decoded cloud is unorganized).  Delta 
+	 * frames only store which voxels of the previous frame were removed and which ones were added, 
+	 * with the retained voxels keeping their previous color.  The data is then compressed with LZF.
+	 *
+	 * @param[out] data pointer to the encoded data, which stays valid until the next call to Encode()
+	 * @param[out] size the size of the encoded data (in bytes)
+	 * @param colors the encoding of the colors
+	 * @param keyframeInterval the number of frames between keyframes, or 1 to disable delta frames.
+	 *                         Delta frames reuse the bounding box of their keyframe (which is padded when
+	 *                         this is more than 1), so a keyframe is also sent when points move outside of it.
+	 * @param voxelSize the minimum size of the voxels (in the units of the point positions).  By default the
+	 *                  voxels are 1/65535 of the bounding box, which is often finer than the noise of the sensor,
+	 *                  and coarser voxels compress much better (for example, 1mm is around twice as small).
+	 */
+	bool Encode( uint8_t** data, size_t* size, ColorEncoding colors=COLOR_RGB565, 
+			   uint32_t keyframeInterval=1, float voxelSize=0.0f );
+
+	/**
+	 * Decode a point cloud from the data produced by Encode(), replacing the current points.
+	 * Delta frames are rejected until the keyframe (or delta frame) that they reference has been decoded.
+	 */
+	bool Decode( const uint8_t* data, size_t size );
+
+	/**
+	 * Encode the point cloud and send it with a TCP or UDP socket.  The encoded frame is split into 
+	 * chunks that each fit in a packet (for UDP) and start with a small header, so that Receive() can
+	 * reassemble it.  With UDP, a frame is lost if any of its packets are dropped, so the receiving
+	 * socket should have a large enough buffer for a whole frame (see Socket::SetBufferSize()).
+	 * @see Encode() for a description of the parameters.
+	 */
+	bool Send( Socket* socket, uint32_t remoteIP, uint16_t remotePort, ColorEncoding colors=COLOR_RGB565, 
+			 uint32_t keyframeInterval=1, float voxelSize=0.0f );
+
+	/**
+	 * Receive chunks from a socket until a complete frame has been decoded.
+	 * Returns false if the socket times out (see Socket::SetRecieveTimeout()) or the frame couldn't be decoded.
+	 * Frames with missing chunks are discarded when the chunks of the next frame arrive.
+	 */
+	bool Receive( Socket* socket );
+
+	/**
+	 * Retrieve the size (in bytes) of the last encoded frame that was reassembled by Receive(),
+	 * not including the chunk headers.
+	 */
+	inline size_t GetReceivedSize() const			{ return mRecvFrame.size(); }
+
 	/**
 	 * Set the intrinsic camera calibration.
 	 */
@@ -168,23 +422,85 @@ protected:
 
 	bool allocBufferGL();
 	bool allocDepthResize( size_t size );
+	bool allocFileBuffer( size_t size );
+	bool allocScratch( size_t size );
+	bool allocNormals();
+
+	bool allocRing( uint32_t capacity );
+	bool extractCPU( float* depth, uint32_t depth_width, uint32_t depth_height,
+				  float4* rgba, uint32_t color_width, uint32_t color_height );
+
+	bool downsampleCPU( float voxelSize );
+	bool filterOutliersCPU( float radius, uint32_t minNeighbors );
+	bool computeNormalsCPU( uint32_t radius );
+
+	bool writeFile( FILE* file, FileFormat format );
+	bool writeHeaderPCD( FILE* file, const char* data );
 	
 	Vertex* mPointsCPU;
 	Vertex* mPointsGPU;
 
+	float3* mNormalsCPU;
+	float3* mNormalsGPU;
+
 	glBuffer* mBufferGL;
 	glCamera* mCameraGL;
 
 	uint32_t mNumPoints;
 	uint32_t mMaxPoints;
+	uint32_t mHeight;
 
 	float2 mFocalLength;
 	float2 mPrincipalPoint;
 
+	float mPose[3][4];
+	bool  mHasPose;
+
+	uint32_t* mFrameStampsCPU;
+	uint32_t* mFrameStampsGPU;
+	uint32_t* mRingCounterCPU;
+	uint32_t* mRingCounterGPU;
+
+	uint32_t mRingCapacity;
+	uint32_t mRingHead;
+	uint32_t mRingMaxAge;
+	uint32_t mFrameCount;
+
 	float* mDepthResize;
 	size_t mDepthSize;
 
+	void*  mScratchGPU;
+	size_t mScratchSize;
+
+	uint8_t* mFileBuffer;
+	size_t   mFileBufferSize;
+
+	FILE*      mSequenceFile;
+	FileFormat mSequenceFormat;
+	uint32_t   mSequenceLength;
+
+	std::vector<uint8_t>  mEncodeBuffer;
+	std::vector<uint64_t> mEncodeKeys;
+	float3   mEncodeOrigin;
+	float3   mEncodeStep;
+	uint32_t mEncodeFrame;
+	uint32_t mEncodeKeyframe;
+
+	std::vector<uint64_t> mDecodeKeys;
+	std::vector<Vertex>   mDecodePoints;
+	uint32_t mDecodeFrame;
+	bool     mDecodeValid;
+
+	std::vector<uint8_t> mRecvBuffer;
+	std::vector<uint8_t> mRecvFrame;
+	size_t   mRecvSize;
+	size_t   mRecvBytes;
+	uint32_t mRecvFrameID;
+
+	bool mOrganized;
+	bool mHostMemory;
 	bool mHasRGB;
+	bool mHasNormals;
 	bool mHasNewPoints;
 	bool mHasCalibration;
 };
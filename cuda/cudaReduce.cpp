@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cudaReduce.h"
+#include "cudaSIMD.h"
+
+#include "ParallelFor.h"
+#include "Mutex.h"
+
+#include <math.h>
+
+
+// partial results from a range of rows
+struct reducePartial
+{
+	float  min[4];
+	float  max[4];
+	double sum[4];
+	double sq[4];
+
+	void init()
+	{
+		for( int c=0; c < 4; c++ )
+		{
+			min[c] = INFINITY;
+			max[c] = -INFINITY;
+			sum[c] = 0.0;
+			sq[c]  = 0.0;
+		}
+	}
+
+	void merge( const reducePartial& p )
+	{
+		for( int c=0; c < 4; c++ )
+		{
+			min[c] = fminf(min[c], p.min[c]);
+			max[c] = fmaxf(max[c], p.max[c]);
+			sum[c] += p.sum[c];
+			sq[c]  += p.sq[c];
+		}
+	}
+};
+
+
+// generic scalar path (any type/channel count)
+template<typename T, int C>
+static void reduceRows( const T* input, size_t width, uint32_t y0, uint32_t y1, 
+                        const float* shift, bool full, reducePartial& p )
+{
+	for( uint32_t y=y0; y < y1; y++ )
+	{
+		const T* row = input + y * width * C;
+
+		float rowSum[C] = {0};
+		float rowSq[C] = {0};
+
+		for( size_t x=0; x < width; x++ )
+		{
+			for( int c=0; c < C; c++ )
+			{
+				const float v = row[x * C + c];
+
+				p.min[c] = fminf(p.min[c], v);
+				p.max[c] = fmaxf(p.max[c], v);
+
+				if( full )
+				{
+					const float d = v - shift[c];
+
+					rowSum[c] += d;
+					rowSq[c]  += d * d;
+				}
+			}
+		}
+
+		for( int c=0; c < C; c++ )
+		{
+			p.sum[c] += rowSum[c];
+			p.sq[c]  += rowSq[c];
+		}
+	}
+}
+
+// SIMD path for float RGBA/BGRA (one pixel per vector)
+static void reduceRowsRGBA32F( const float* input, size_t width, uint32_t y0, uint32_t y1, 
+                               const float* shift, bool full, reducePartial& p )
+{
+	const simd4f vshift = { shift[0], shift[1], shift[2], shift[3] };
+
+	simd4f vmin = simdSet(INFINITY);
+	simd4f vmax = simdSet(-INFINITY);
+
+	for( uint32_t y=y0; y < y1; y++ )
+	{
+		const float* row = input + y * width * 4;
+
+		simd4f vsum = simdSet(0.0f);
+		simd4f vsq  = simdSet(0.0f);
+
+		for( size_t x=0; x < width; x++ )
+		{
+			const simd4f v = simdLoad(row + x * 4);
+
+			vmin = simdMin(v, vmin);
+			vmax = simdMax(v, vmax);
+
+			if( full )
+			{
+				const simd4f d = v - vshift;
+
+				vsum += d;
+				vsq  += d * d;
+			}
+		}
+
+		for( int c=0; c < 4; c++ )
+		{
+			p.sum[c] += vsum[c];
+			p.sq[c]  += vsq[c];
+		}
+	}
+
+	for( int c=0; c < 4; c++ )
+	{
+		p.min[c] = fminf(p.min[c], vmin[c]);
+		p.max[c] = fmaxf(p.max[c], vmax[c]);
+	}
+}
+
+// SIMD path for float grayscale (four pixels per vector)
+static void reduceRowsGray32F( const float* input, size_t width, uint32_t y0, uint32_t y1, 
+                               const float* shift, bool full, reducePartial& p )
+{
+	const simd4f vshift = simdSet(shift[0]);
+
+	simd4f vmin = simdSet(INFINITY);
+	simd4f vmax = simdSet(-INFINITY);
+
+	for( uint32_t y=y0; y < y1; y++ )
+	{
+		const float* row = input + y * width;
+
+		simd4f vsum = simdSet(0.0f);
+		simd4f vsq  = simdSet(0.0f);
+
+		size_t x = 0;
+
+		for( ; x + 4 <= width; x += 4 )
+		{
+			const simd4f v = simdLoad(row + x);
+
+			vmin = simdMin(v, vmin);
+			vmax = simdMax(v, vmax);
+
+			if( full )
+			{
+				const simd4f d = v - vshift;
+
+				vsum += d;
+				vsq  += d * d;
+			}
+		}
+
+		double rowSum = vsum[0] + vsum[1] + vsum[2] + vsum[3];
+		double rowSq  = vsq[0] + vsq[1] + vsq[2] + vsq[3];
+
+		for( ; x < width; x++ )
+		{
+			const float v = row[x];
+
+			p.min[0] = fminf(p.min[0], v);
+			p.max[0] = fmaxf(p.max[0], v);
+
+			if( full )
+			{
+				const float d = v - shift[0];
+
+				rowSum += d;
+				rowSq  += d * d;
+			}
+		}
+
+		p.sum[0] += rowSum;
+		p.sq[0]  += rowSq;
+	}
+
+	for( int n=0; n < 4; n++ )
+	{
+		p.min[0] = fminf(p.min[0], vmin[n]);
+		p.max[0] = fmaxf(p.max[0], vmax[n]);
+	}
+}
+
+template<typename T, int C>
+static void reduceImage( const T* input, size_t width, size_t height, cudaImageStats* stats, bool full )
+{
+	float shift[4] = {0};
+
+	if( full )
+	{
+		for( int c=0; c < C; c++ )
+			shift[c] = input[c];
+	}
+
+	reducePartial result;
+	result.init();
+
+	Mutex mutex;
+
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		reducePartial p;
+		p.init();
+
+		if( C == 4 && sizeof(T) == sizeof(float) )
+			reduceRowsRGBA32F((const float*)input, width, y0, y1, shift, full, p);
+		else if( C == 1 && sizeof(T) == sizeof(float) )
+			reduceRowsGray32F((const float*)input, width, y0, y1, shift, full, p);
+		else
+			reduceRows<T,C>(input, width, y0, y1, shift, full, p);
+
+		mutex.Lock();
+		result.merge(p);
+		mutex.Unlock();
+	}, 16);
+
+	const double n = double(width) * double(height);
+
+	float* min    = (float*)&stats->min;
+	float* max    = (float*)&stats->max;
+	float* sum    = (float*)&stats->sum;
+	float* mean   = (float*)&stats->mean;
+	float* stddev = (float*)&stats->stddev;
+
+	for( int c=0; c < 4; c++ )
+	{
+		const bool valid = (c < C);
+
+		min[c] = valid ? result.min[c] : 0.0f;
+		max[c] = valid ? result.max[c] : 0.0f;
+
+		if( full && valid )
+		{
+			const double m = result.sum[c] / n;
+
+			sum[c]    = result.sum[c] + shift[c] * n;
+			mean[c]   = shift[c] + m;
+			stddev[c] = sqrt(fmax(result.sq[c] / n - m * m, 0.0));
+		}
+		else
+		{
+			sum[c]    = 0.0f;
+			mean[c]   = 0.0f;
+			stddev[c] = 0.0f;
+		}
+	}
+
+	stats->count = width * height;
+}
+
+static bool reduceImage( const void* input, size_t width, size_t height, imageFormat format, 
+                         cudaImageStats* stats, bool full, const char* function )
+{
+	if( !input || !stats || width == 0 || height == 0 )
+		return false;
+
+	if( !imageFormatIsRGB(format) && !imageFormatIsBGR(format) && !imageFormatIsGray(format) )
+	{
+		LogError(LOG_CUDA "%s -- unsupported image format (%s)\n", function, imageFormatToStr(format));
+		return false;
+	}
+
+	const size_t channels = imageFormatChannels(format);
+
+	#define REDUCE_IMAGE(type) \
+	{ \
+		if( channels == 1 ) \
+			reduceImage<type, 1>((const type*)input, width, height, stats, full); \
+		else if( channels == 3 ) \
+			reduceImage<type, 3>((const type*)input, width, height, stats, full); \
+		else if( channels == 4 ) \
+			reduceImage<type, 4>((const type*)input, width, height, stats, full); \
+		else \
+			return false; \
+	}
+
+	if( imageFormatBaseType(format) == IMAGE_FLOAT )
+		REDUCE_IMAGE(float)
+	else
+		REDUCE_IMAGE(uint8_t)
+
+	return true;
+}
+
+
+// cpuReduceMinMax
+bool cpuReduceMinMax( const void* input, size_t width, size_t height, imageFormat format, cudaImageStats* stats )
+{
+	return reduceImage(input, width, height, format, stats, false, "cpuReduceMinMax()");
+}
+
+
+// cpuReduceStats
+bool cpuReduceStats( const void* input, size_t width, size_t height, imageFormat format, cudaImageStats* stats )
+{
+	return reduceImage(input, width, height, format, stats, true, "cpuReduceStats()");
+}
+
+
+// histogramImage
+template<typename T, int C>
+static void histogramImage( const T* input, size_t width, size_t height, uint32_t* histogram, uint32_t bins, const float2& range )
+{
+	const float scale = float(bins) / (range.y - range.x);
+	const int maxBin = bins - 1;
+
+	memset(histogram, 0, bins * C * sizeof(uint32_t));
+
+	Mutex mutex;
+
+	ParallelFor(height, [&](uint32_t y0, uint32_t y1)
+	{
+		uint32_t* local = new uint32_t[bins * C]();
+
+		for( uint32_t y=y0; y < y1; y++ )
+		{
+			const T* row = input + y * width * C;
+
+			for( size_t x=0; x < width; x++ )
+			{
+				for( int c=0; c < C; c++ )
+				{
+					int bin = int((row[x * C + c] - range.x) * scale);
+
+					if( bin < 0 )
+						bin = 0;
+					else if( bin > maxBin )
+						bin = maxBin;
+
+					local[c * bins + bin]++;
+				}
+			}
+		}
+
+		mutex.Lock();
+
+		for( uint32_t n=0; n < bins * C; n++ )
+			histogram[n] += local[n];
+
+		mutex.Unlock();
+
+		delete[] local;
+	}, 16);
+}
+
+
+// cpuHistogram
+bool cpuHistogram( const void* input, size_t width, size_t height, imageFormat format,
+                   uint32_t* histogram, uint32_t bins, const float2& range )
+{
+	if( !input || !histogram || width == 0 || height == 0 || bins == 0 || range.y <= range.x )
+		return false;
+
+	if( !imageFormatIsRGB(format) && !imageFormatIsBGR(format) && !imageFormatIsGray(format) )
+	{
+		LogError(LOG_CUDA "cpuHistogram() -- unsupported image format (%s)\n", imageFormatToStr(format));
+		return false;
+	}
+
+	const size_t channels = imageFormatChannels(format);
+
+	#define HISTOGRAM_IMAGE(type) \
+	{ \
+		if( channels == 1 ) \
+			histogramImage<type, 1>((const type*)input, width, height, histogram, bins, range); \
+		else if( channels == 3 ) \
+			histogramImage<type, 3>((const type*)input, width, height, histogram, bins, range); \
+		else if( channels == 4 ) \
+			histogramImage<type, 4>((const type*)input, width, height, histogram, bins, range); \
+		else \
+			return false; \
+	}
+
+	if( imageFormatBaseType(format) == IMAGE_FLOAT )
+		HISTOGRAM_IMAGE(float)
+	else
+		HISTOGRAM_IMAGE(uint8_t)
+
+	return true;
+}
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cudaReduce.h"
+#include "cudaVector.h"
+
+#include "Mutex.h"
+
+#include <map>
+
+
+#define REDUCE_BLOCK_SIZE 256	// threads per block (must be a multiple of the warp size)
+#define REDUCE_MAX_BLOCKS 256	// blocks loop over the image, so each one reduces many pixels
+
+
+//----------------------------------------------------------------------------
+// Float atomics for min/max (signed floats are ordered like sign-magnitude ints)
+//----------------------------------------------------------------------------
+inline __device__ void atomicMinFloat( float* address, float value )
+{
+	if( value >= 0.0f )
+		atomicMin((int*)address, __float_as_int(value));
+	else
+		atomicMax((unsigned int*)address, __float_as_uint(value));
+}
+
+inline __device__ void atomicMaxFloat( float* address, float value )
+{
+	if( value >= 0.0f )
+		atomicMax((int*)address, __float_as_int(value));
+	else
+		atomicMin((unsigned int*)address, __float_as_uint(value));
+}
+
+
+//----------------------------------------------------------------------------
+// Warp-shuffle and block reductions
+//----------------------------------------------------------------------------
+struct ReduceMin
+{
+	static inline __device__ float identity()					{ return INFINITY; }
+	static inline __device__ float apply( float a, float b )		{ return fminf(a, b); }
+};
+
+struct ReduceMax
+{
+	static inline __device__ float identity()					{ return -INFINITY; }
+	static inline __device__ float apply( float a, float b )		{ return fmaxf(a, b); }
+};
+
+struct ReduceSum
+{
+	static inline __device__ float identity()					{ return 0.0f; }
+	static inline __device__ float apply( float a, float b )		{ return a + b; }
+};
+
+template<class Op>
+inline __device__ float warpReduce( float value )
+{
+	#pragma unroll
+	for( int offset=16; offset > 0; offset /= 2 )
+		value = Op::apply(value, __shfl_down_sync(0xFFFFFFFF, value, offset));
+
+	return value;
+}
+
+// the result is only valid in thread 0
+template<class Op>
+inline __device__ float blockReduce( float value, float* shared )
+{
+	const int lane = threadIdx.x % 32;
+	const int warp = threadIdx.x / 32;
+
+	value = warpReduce<Op>(value);
+
+	if( lane == 0 )
+		shared[warp] = value;
+
+	__syncthreads();
+
+	value = (threadIdx.x < blockDim.x / 32) ? shared[lane] : Op::identity();
+
+	if( warp == 0 )
+		value = warpReduce<Op>(value);
+
+	__syncthreads();	// so the shared memory can be reused
+	return value;
+}
+
+
+//----------------------------------------------------------------------------
+// Statistics
+//----------------------------------------------------------------------------
+__global__ void gpuReduceInit( cudaImageStats* stats, uint32_t count )
+{
+	stats->min    = make_float4(INFINITY, INFINITY, INFINITY, INFINITY);
+	stats->max    = make_float4(-INFINITY, -INFINITY, -INFINITY, -INFINITY);
+	stats->sum    = make_float4(0,0,0,0);
+	stats->mean   = make_float4(0,0,0,0);
+	stats->stddev = make_float4(0,0,0,0);
+	stats->count  = count;
+}
+
+// the sums are accumulated relative to the first pixel for numerical stability,
+// and stats->stddev holds the sum of squares until gpuReduceFinalize() is run
+template<typename T, int C, bool full>
+__global__ void gpuReduceStats( const T* input, uint32_t numPixels, cudaImageStats* stats )
+{
+	__shared__ float shared[32];
+
+	float vmin[C], vmax[C], vsum[C], vsq[C], shift[C];
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+	{
+		vmin[c]  = INFINITY;
+		vmax[c]  = -INFINITY;
+		vsum[c]  = 0.0f;
+		vsq[c]   = 0.0f;
+		shift[c] = full ? (float)input[c] : 0.0f;
+	}
+
+	for( uint32_t i=blockIdx.x * blockDim.x + threadIdx.x; i < numPixels; i += gridDim.x * blockDim.x )
+	{
+		const T* px = input + i * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+		{
+			const float v = px[c];
+
+			vmin[c] = fminf(vmin[c], v);
+			vmax[c] = fmaxf(vmax[c], v);
+
+			if( full )
+			{
+				const float d = v - shift[c];
+
+				vsum[c] += d;
+				vsq[c]  += d * d;
+			}
+		}
+	}
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+	{
+		const float blockMin = blockReduce<ReduceMin>(vmin[c], shared);
+		const float blockMax = blockReduce<ReduceMax>(vmax[c], shared);
+
+		if( threadIdx.x == 0 )
+		{
+			atomicMinFloat(((float*)&stats->min) + c, blockMin);
+			atomicMaxFloat(((float*)&stats->max) + c, blockMax);
+		}
+
+		if( full )
+		{
+			const float blockSum = blockReduce<ReduceSum>(vsum[c], shared);
+			const float blockSq  = blockReduce<ReduceSum>(vsq[c], shared);
+
+			if( threadIdx.x == 0 )
+			{
+				atomicAdd(((float*)&stats->sum) + c, blockSum);
+				atomicAdd(((float*)&stats->stddev) + c, blockSq);
+			}
+		}
+	}
+}
+
+template<typename T, int C>
+__global__ void gpuReduceFinalize( const T* input, cudaImageStats* stats )
+{
+	const float n = stats->count;
+
+	#pragma unroll
+	for( int c=0; c < C; c++ )
+	{
+		const float shift = input[c];
+		const float sum   = ((float*)&stats->sum)[c];
+		const float sq    = ((float*)&stats->stddev)[c];
+		const float mean  = sum / n;
+
+		((float*)&stats->mean)[c]   = shift + mean;
+		((float*)&stats->sum)[c]    = sum + shift * n;
+		((float*)&stats->stddev)[c] = sqrtf(fmaxf(sq / n - mean * mean, 0.0f));
+	}
+}
+
+template<typename T>
+static cudaError_t launchReduceStats( const T* input, uint32_t numPixels, int channels, 
+                                      cudaImageStats* stats, bool full, cudaStream_t stream )
+{
+	const dim3 blockDim(REDUCE_BLOCK_SIZE);
+	const dim3 gridDim(min(iDivUp(numPixels, REDUCE_BLOCK_SIZE), REDUCE_MAX_BLOCKS));
+
+	gpuReduceInit<<<1, 1, 0, stream>>>(stats, numPixels);
+
+	#define LAUNCH_REDUCE(channels) \
+	{ \
+		if( full ) \
+		{ \
+			gpuReduceStats<T, channels, true><<<gridDim, blockDim, 0, stream>>>(input, numPixels, stats); \
+			gpuReduceFinalize<T, channels><<<1, 1, 0, stream>>>(input, stats); \
+		} \
+		else \
+		{ \
+			gpuReduceStats<T, channels, false><<<gridDim, blockDim, 0, stream>>>(input, numPixels, stats); \
+		} \
+	}
+
+	if( channels == 1 )
+		LAUNCH_REDUCE(1)
+	else if( channels == 2 )
+		LAUNCH_REDUCE(2)
+	else if( channels == 3 )
+		LAUNCH_REDUCE(3)
+	else if( channels == 4 )
+		LAUNCH_REDUCE(4)
+	else
+		return cudaErrorInvalidValue;
+
+	return CUDA(cudaGetLastError());
+}
+
+static bool validateReduceFormat( imageFormat format, const char* function )
+{
+	if( imageFormatIsRGB(format) || imageFormatIsBGR(format) || imageFormatIsGray(format) )
+		return true;
+
+	LogError(LOG_CUDA "%s -- unsupported image format (%s)\n", function, imageFormatToStr(format));
+	LogError(LOG_CUDA "      supported formats are:\n");
+	LogError(LOG_CUDA "          * gray8, gray32f\n");
+	LogError(LOG_CUDA "          * rgb8, rgba8, rgb32f, rgba32f\n");
+	LogError(LOG_CUDA "          * bgr8, bgra8, bgr32f, bgra32f\n");
+
+	return false;
+}
+
+static cudaError_t reduceStats( void* input, size_t width, size_t height, imageFormat format,
+                                cudaImageStats* stats, bool full, cudaStream_t stream )
+{
+	if( !input || !stats )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
+
+	if( !validateReduceFormat(format, full ? "cudaReduceStats()" : "cudaReduceMinMax()") )
+		return cudaErrorInvalidValue;
+
+	if( imageFormatBaseType(format) == IMAGE_FLOAT )
+		return launchReduceStats<float>((float*)input, width * height, imageFormatChannels(format), stats, full, stream);
+	else
+		return launchReduceStats<uint8_t>((uint8_t*)input, width * height, imageFormatChannels(format), stats, full, stream);
+}
+
+// cudaReduceMinMax
+cudaError_t cudaReduceMinMax( void* input, size_t width, size_t height, imageFormat format,
+                              cudaImageStats* stats, cudaStream_t stream )
+{
+	return reduceStats(input, width, height, format, stats, false, stream);
+}
+
+// cudaReduceStats
+cudaError_t cudaReduceStats( void* input, size_t width, size_t height, imageFormat format,
+                             cudaImageStats* stats, cudaStream_t stream )
+{
+	return reduceStats(input, width, height, format, stats, true, stream);
+}
+
+
+//----------------------------------------------------------------------------
+// Histograms (privatized per-block in shared memory)
+//----------------------------------------------------------------------------
+template<typename T, int C>
+__global__ void gpuHistogram( const T* input, uint32_t numPixels, uint32_t* histogram, 
+                              int bins, float min_value, float scale )
+{
+	extern __shared__ uint32_t localHist[];
+
+	for( int i=threadIdx.x; i < bins * C; i += blockDim.x )
+		localHist[i] = 0;
+
+	__syncthreads();
+
+	for( uint32_t i=blockIdx.x * blockDim.x + threadIdx.x; i < numPixels; i += gridDim.x * blockDim.x )
+	{
+		const T* px = input + i * C;
+
+		#pragma unroll
+		for( int c=0; c < C; c++ )
+		{
+			const int bin = max(min(int((px[c] - min_value) * scale), bins - 1), 0);
+			atomicAdd(&localHist[c * bins + bin], 1);
+		}
+	}
+
+	__syncthreads();
+
+	for( int i=threadIdx.x; i < bins * C; i += blockDim.x )
+	{
+		if( localHist[i] > 0 )
+			atomicAdd(&histogram[i], localHist[i]);
+	}
+}
+
+template<typename T>
+static cudaError_t launchHistogram( const T* input, uint32_t numPixels, int channels, uint32_t* histogram, 
+                                    uint32_t bins, const float2& range, cudaStream_t stream )
+{
+	CUDA_ASSERT(cudaMemsetAsync(histogram, 0, bins * channels * sizeof(uint32_t), stream));
+
+	const float scale = float(bins) / (range.y - range.x);
+	const size_t sharedMem = bins * channels * sizeof(uint32_t);
+
+	const dim3 blockDim(REDUCE_BLOCK_SIZE);
+	const dim3 gridDim(min(iDivUp(numPixels, REDUCE_BLOCK_SIZE), REDUCE_MAX_BLOCKS));
+
+	#define LAUNCH_HISTOGRAM(channels) \
+		gpuHistogram<T, channels><<<gridDim, blockDim, sharedMem, stream>>>(input, numPixels, histogram, bins, range.x, scale)
+
+	if( channels == 1 )
+		LAUNCH_HISTOGRAM(1);
+	else if( channels == 2 )
+		LAUNCH_HISTOGRAM(2);
+	else if( channels == 3 )
+		LAUNCH_HISTOGRAM(3);
+	else if( channels == 4 )
+		LAUNCH_HISTOGRAM(4);
+	else
+		return cudaErrorInvalidValue;
+
+	return CUDA(cudaGetLastError());
+}
+
+// cudaHistogram
+cudaError_t cudaHistogram( void* input, size_t width, size_t height, imageFormat format,
+                           uint32_t* histogram, uint32_t bins, const float2& range, cudaStream_t stream )
+{
+	if( !input || !histogram )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 || bins == 0 || bins > 1024 || range.y <= range.x )
+		return cudaErrorInvalidValue;
+
+	if( !validateReduceFormat(format, "cudaHistogram()") )
+		return cudaErrorInvalidValue;
+
+	if( imageFormatBaseType(format) == IMAGE_FLOAT )
+		return launchHistogram<float>((float*)input, width * height, imageFormatChannels(format), histogram, bins, range, stream);
+	else
+		return launchHistogram<uint8_t>((uint8_t*)input, width * height, imageFormatChannels(format), histogram, bins, range, stream);
+}
+
+
+//----------------------------------------------------------------------------
+// Per-stream stats buffers used by the auto-range modes
+//----------------------------------------------------------------------------
+static std::map<cudaStream_t, cudaImageStats*> reduceStreamBuffers;
+static Mutex reduceStreamMutex;
+
+// cudaReduceStream
+cudaImageStats* cudaReduceStream( cudaStream_t stream )
+{
+	cudaImageStats* stats = NULL;
+
+	reduceStreamMutex.Lock();
+
+	std::map<cudaStream_t, cudaImageStats*>::iterator iter = reduceStreamBuffers.find(stream);
+
+	if( iter != reduceStreamBuffers.end() )
+	{
+		stats = iter->second;
+	}
+	else if( CUDA_SUCCESS(cudaMalloc((void**)&stats, sizeof(cudaImageStats))) )
+	{
+		reduceStreamBuffers[stream] = stats;
+	}
+	else
+	{
+		stats = NULL;
+	}
+
+	reduceStreamMutex.Unlock();
+	return stats;
+}
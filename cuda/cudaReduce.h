@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CUDA_REDUCE_H__
+#define __CUDA_REDUCE_H__
+
+
+#include "cudaUtility.h"
+#include "imageFormat.h"
+
+
+/**
+ * Per-channel statistics of an image, as computed by cudaReduceStats().
+ * The channels are stored in the x/y/z/w components (for example, gray images
+ * only use the x component, and RGB images use x/y/z).  Unused channels are 0.
+ *
+ * The results can remain in GPU memory and be consumed by other kernels 
+ * (as done by the auto-range modes of cudaNormalize() and cudaColormap()), 
+ * or be allocated in mapped memory with cudaAllocMapped() to read them on the CPU.
+ *
+ * @ingroup reduce
+ */
+struct cudaImageStats
+{
+	float4 min;		/**< Minimum value of each channel */
+	float4 max;		/**< Maximum value of each channel */
+	float4 sum;		/**< Sum of each channel */
+	float4 mean;		/**< Mean of each channel */
+	float4 stddev;		/**< Standard deviation of each channel */
+	uint32_t count;	/**< Number of pixels that were reduced */
+};
+
+
+/**
+ * Compute the per-channel minimum and maximum of an image on the GPU.
+ * Only the `min`, `max`, and `count` members of the stats are filled out.
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param stats pointer to cudaImageStats in GPU-accessible memory that receives the results
+ *
+ * @ingroup reduce
+ */
+cudaError_t cudaReduceMinMax( void* input, size_t width, size_t height, imageFormat format,
+                              cudaImageStats* stats, cudaStream_t stream=0 );
+
+/**
+ * Compute the per-channel min, max, sum, mean, and standard deviation of an image on the GPU.
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param stats pointer to cudaImageStats in GPU-accessible memory that receives the results
+ *
+ * @ingroup reduce
+ */
+cudaError_t cudaReduceStats( void* input, size_t width, size_t height, imageFormat format,
+                             cudaImageStats* stats, cudaStream_t stream=0 );
+
+/**
+ * Compute a histogram for each channel of an image on the GPU.
+ *
+ * @param input the input image (gray, RGB/RGBA, or BGR/BGRA in uint8 or float)
+ * @param histogram GPU-accessible array of `bins * channels` elements that receives the counts.
+ *                  The histogram of each channel is stored consecutively (i.e. all the red bins, 
+ *                  then all the green bins, ect).  Values outside of the range are clamped.
+ * @param bins the number of bins in each channel's histogram (up to 1024)
+ * @param range the range of pixel values that the bins span
+ *
+ * @ingroup reduce
+ */
+cudaError_t cudaHistogram( void* input, size_t width, size_t height, imageFormat format,
+                           uint32_t* histogram, uint32_t bins=256, 
+                           const float2& range=make_float2(0,255), cudaStream_t stream=0 );
+
+/**
+ * Compute the per-channel minimum and maximum of an image on the CPU.
+ * The work is divided between the CPU cores, and the `stats` should be in CPU memory.
+ * @ingroup reduce
+ */
+bool cpuReduceMinMax( const void* input, size_t width, size_t height, imageFormat format,
+                      cudaImageStats* stats );
+
+/**
+ * Compute the per-channel min, max, sum, mean, and standard deviation of an image on the CPU.
+ * The work is divided between the CPU cores, and the `stats` should be in CPU memory.
+ * @ingroup reduce
+ */
+bool cpuReduceStats( const void* input, size_t width, size_t height, imageFormat format,
+                     cudaImageStats* stats );
+
+/**
+ * Compute a histogram for each channel of an image on the CPU.
+ * @see cudaHistogram() for a description of the parameters.
+ * @ingroup reduce
+ */
+bool cpuHistogram( const void* input, size_t width, size_t height, imageFormat format,
+                   uint32_t* histogram, uint32_t bins=256, const float2& range=make_float2(0,255) );
+
+/**
+ * Get a cudaImageStats buffer in GPU memory that's reserved for the given stream.
+ * This is used internally by the auto-range modes of cudaNormalize() and cudaColormap(),
+ * so that the range can be computed and consumed without syncing with the CPU.
+ * @ingroup reduce
+ */
+cudaImageStats* cudaReduceStream( cudaStream_t stream );
+
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __CUDA_SIMD_H__
+#define __CUDA_SIMD_H__
+
+#include <stdint.h>
+
+
+/*
+ * 4-wide float vectors (NEON on ARM, SSE on x86) that are used internally
+ * by the CPU implementations in cudaReduce, cudaFilter, and cudaPointCloud.
+ */
+typedef float   simd4f  __attribute__((vector_size(16)));
+typedef int32_t simd4i  __attribute__((vector_size(16)));
+typedef float   simd4fu __attribute__((vector_size(16), aligned(4)));	// unaligned loads
+
+// the minimum of each lane (NaN's in value compare false, so accum is kept)
+static inline simd4f simdMin( simd4f value, simd4f accum )
+{
+	const simd4i mask = (value < accum);
+	return (simd4f)(((simd4i)value & mask) | ((simd4i)accum & ~mask));
+}
+
+// the maximum of each lane (NaN's in value compare false, so accum is kept)
+static inline simd4f simdMax( simd4f value, simd4f accum )
+{
+	const simd4i mask = (value > accum);
+	return (simd4f)(((simd4i)value & mask) | ((simd4i)accum & ~mask));
+}
+
+// set all the lanes to the same value
+static inline simd4f simdSet( float value )
+{
+	const simd4f v = { value, value, value, value };
+	return v;
+}
+
+// load 4 floats from an address that doesn't need to be 16-byte aligned
+static inline simd4f simdLoad( const float* ptr )
+{
+	return *(const simd4fu*)ptr;
+}
+
+// store 4 floats to an address that doesn't need to be 16-byte aligned
+static inline void simdStore( float* ptr, simd4f value )
+{
+	*(simd4fu*)ptr = value;
+}
+
+#endif
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cudaPointCloud.h"
+#include "cudaMappedMemory.h"
+
+#include "Socket.h"
+#include "Endian.h"
+#include "Thread.h"
+
+#include "logging.h"
+#include "commandLine.h"
+
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+
+#include <sys/socket.h>
+
+#include <unordered_map>
+#include <vector>
+
+
+#define SCENE_WIDTH  640
+#define SCENE_HEIGHT 480
+
+
+int usage()
+{
+	printf("usage: point-cloud-loopback [--help] [--frames=N] [--colors=MODE] [--voxel=SIZE]\n");
+	printf("                            [--keyframes=N] [--port=N] [--cpu]\n\n");
+	printf("Stream a synthetic point cloud through a TCP socket on the loopback interface with\n");
+	printf("cudaPointCloud::Send() and Receive(), check that the received points match the ones\n");
+	printf("that were sent (to within the quantization step), and report the compression ratio.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --frames=N        number of frames to send (default: 10)\n");
+	printf("  --colors=MODE     color encoding: none, rgb565 or palette (default: rgb565)\n");
+	printf("  --voxel=SIZE      minimum voxel size in meters, or 0 for full precision (default: 0)\n");
+	printf("  --keyframes=N     frames between keyframes, or 1 to disable delta frames (default: 1)\n");
+	printf("  --port=N          TCP port on the loopback interface (default: 47300)\n");
+	printf("  --cpu             extract the point clouds on the CPU instead of the GPU\n\n");
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+/*
+ * settings that are shared with the sender thread
+ */
+struct Settings
+{
+	uint32_t frames;
+	uint16_t port;
+	uint32_t keyframes;
+	float    voxelSize;
+	bool     gpu;
+
+	cudaPointCloud::ColorEncoding colors;
+};
+
+
+/*
+ * generate frame N of the synthetic scene:  a back wall 3m away, a floor, and a
+ * box that moves towards the camera, with 2mm of depth noise like a stereo sensor.
+ */
+static float sceneNoise( uint32_t n )
+{
+	uint32_t h = n * 2654435761u;
+
+	h ^= h >> 13;
+	h *= 0x5bd1e995;
+	h ^= h >> 15;
+
+	return (h & 0xFFFF) / 65535.0f - 0.5f;
+}
+
+static void generateScene( float* depth, float4* rgba, uint32_t frame )
+{
+	const float focalLength = 500.0f;
+
+	for( uint32_t y=0; y < SCENE_HEIGHT; y++ )
+	{
+		for( uint32_t x=0; x < SCENE_WIDTH; x++ )
+		{
+			const uint32_t n = y * SCENE_WIDTH + x;
+			const float v = -(y - SCENE_HEIGHT * 0.5f) / focalLength;
+
+			float d = 3.0f;
+
+			if( v < -0.05f && 1.2f / -v < d )
+				d = 1.2f / -v;
+
+			const bool box = (x > 200 && x < 300 && y > 150 && y < 350);
+
+			if( box )
+				d = 1.5f - 0.01f * frame;
+
+			depth[n] = d + 0.004f * sceneNoise(n + frame * 977);
+
+			const float checker = ((x / 64 + y / 64) % 2) ? 200.0f : 60.0f;
+			rgba[n] = make_float4(checker, box ? 180.0f : 90.0f, 40.0f + (x * y) % 7, 255.0f);
+		}
+	}
+}
+
+static cudaPointCloud* createScene( float* depth, float4* rgba, uint32_t frame, bool gpu )
+{
+	cudaPointCloud* cloud = cudaPointCloud::Create();
+
+	if( !cloud )
+		return NULL;
+
+	cloud->SetCalibration(make_float2(500.0f, 500.0f), make_float2(SCENE_WIDTH * 0.5f, SCENE_HEIGHT * 0.5f));
+
+	generateScene(depth, rgba, frame);
+
+	if( !cloud->Extract(depth, rgba, SCENE_WIDTH, SCENE_HEIGHT, gpu) )
+	{
+		delete cloud;
+		return NULL;
+	}
+
+	if( gpu )
+		CUDA(cudaDeviceSynchronize());
+
+	return cloud;
+}
+
+
+/*
+ * check that every point in A has a point in B within the tolerance on each axis
+ */
+static uint64_t gridKey( const float3& pos, const float3& tolerance, int dx=0, int dy=0, int dz=0 )
+{
+	const uint64_t x = (int64_t)floorf(pos.x / tolerance.x) + dx + (1 << 20);
+	const uint64_t y = (int64_t)floorf(pos.y / tolerance.y) + dy + (1 << 20);
+	const uint64_t z = (int64_t)floorf(pos.z / tolerance.z) + dz + (1 << 20);
+
+	return (x & 0x1FFFFF) | (y & 0x1FFFFF) << 21 | (z & 0x1FFFFF) << 42;
+}
+
+static inline bool pointValid( const float3& pos )
+{
+	return isfinite(pos.x) && isfinite(pos.y) && isfinite(pos.z);
+}
+
+static uint32_t findMissing( cudaPointCloud* a, cudaPointCloud* b, const float3& tolerance )
+{
+	std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+
+	for( uint32_t n=0; n < b->GetNumPoints(); n++ )
+	{
+		const float3 pos = b->GetData(n)->pos;
+
+		if( pointValid(pos) )
+			grid[gridKey(pos, tolerance)].push_back(n);
+	}
+
+	uint32_t missing = 0;
+
+	for( uint32_t n=0; n < a->GetNumPoints(); n++ )
+	{
+		const float3 pos = a->GetData(n)->pos;
+
+		if( !pointValid(pos) )
+			continue;
+
+		bool found = false;
+
+		for( int dz=-1; dz <= 1 && !found; dz++ )
+		{
+			for( int dy=-1; dy <= 1 && !found; dy++ )
+			{
+				for( int dx=-1; dx <= 1 && !found; dx++ )
+				{
+					auto cell = grid.find(gridKey(pos, tolerance, dx, dy, dz));
+
+					if( cell == grid.end() )
+						continue;
+
+					for( size_t i=0; i < cell->second.size() && !found; i++ )
+					{
+						const float3 other = b->GetData(cell->second[i])->pos;
+
+						found = fabsf(other.x - pos.x) <= tolerance.x &&
+							   fabsf(other.y - pos.y) <= tolerance.y &&
+							   fabsf(other.z - pos.z) <= tolerance.z;
+					}
+				}
+			}
+		}
+
+		if( !found )
+			missing++;
+	}
+
+	return missing;
+}
+
+
+/*
+ * sender thread
+ */
+static bool sendSucceeded = false;
+
+static void* senderThread( void* param )
+{
+	const Settings* settings = (Settings*)param;
+
+	float*  depth = NULL;
+	float4* rgba  = NULL;
+
+	if( !cudaAllocMapped(&depth, SCENE_WIDTH * SCENE_HEIGHT * sizeof(float)) || !cudaAllocMapped(&rgba, SCENE_WIDTH * SCENE_HEIGHT * sizeof(float4)) )
+		return NULL;
+
+	Socket* socket = Socket::Create(SOCKET_TCP);
+
+	// the same cloud is used for every frame, so that delta frames can reference the previous one
+	cudaPointCloud* cloud = cudaPointCloud::Create();
+
+	bool success = (socket != NULL && cloud != NULL);
+
+	if( success && !socket->Connect(netswap32(IP_LOOPBACK), settings->port) )
+	{
+		LogError("point-cloud-loopback:  failed to connect to port %u\n", settings->port);
+		success = false;
+	}
+
+	if( success )
+		cloud->SetCalibration(make_float2(500.0f, 500.0f), make_float2(SCENE_WIDTH * 0.5f, SCENE_HEIGHT * 0.5f));
+
+	for( uint32_t n=0; n < settings->frames && success; n++ )
+	{
+		generateScene(depth, rgba, n);
+
+		success = cloud->Extract(depth, rgba, SCENE_WIDTH, SCENE_HEIGHT, settings->gpu);
+
+		if( success && settings->gpu )
+			success = CUDA_SUCCESS(cudaDeviceSynchronize());
+
+		if( success )
+			success = cloud->Send(socket, netswap32(IP_LOOPBACK), settings->port, settings->colors, settings->keyframes, settings->voxelSize);
+	}
+
+	sendSucceeded = success;
+
+	delete cloud;
+	delete socket;
+
+	CUDA_FREE_HOST(depth);
+	CUDA_FREE_HOST(rgba);
+
+	return NULL;
+}
+
+
+int main( int argc, char** argv )
+{
+	/*
+	 * parse command line
+	 */
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	Settings settings;
+
+	settings.frames    = cmdLine.GetUnsignedInt("frames", 10);
+	settings.port      = cmdLine.GetUnsignedInt("port", 47300);
+	settings.keyframes = cmdLine.GetUnsignedInt("keyframes", 1);
+	settings.voxelSize = cmdLine.GetFloat("voxel", 0.0f);
+	settings.gpu       = !cmdLine.GetFlag("cpu");
+	settings.colors    = cudaPointCloud::COLOR_RGB565;
+
+	const char* colors = cmdLine.GetString("colors", "rgb565");
+
+	if( strcasecmp(colors, "none") == 0 )
+		settings.colors = cudaPointCloud::COLOR_NONE;
+	else if( strcasecmp(colors, "palette") == 0 )
+		settings.colors = cudaPointCloud::COLOR_PALETTE;
+	else if( strcasecmp(colors, "rgb565") != 0 )
+	{
+		LogError("point-cloud-loopback:  invalid --colors=%s (should be none, rgb565 or palette)\n", colors);
+		return 1;
+	}
+
+
+	/*
+	 * listen on the loopback interface, and start sending from another thread
+	 */
+	Socket* server = Socket::Create(SOCKET_TCP);
+
+	if( !server || !server->Bind("127.0.0.1", settings.port) )
+	{
+		LogError("point-cloud-loopback:  failed to bind to port %u\n", settings.port);
+		return 1;
+	}
+
+	// Accept() starts listening, but the sender could try to connect before then
+	if( listen(server->GetFD(), 1) != 0 )
+	{
+		LogError("point-cloud-loopback:  failed to listen on port %u\n", settings.port);
+		return 1;
+	}
+
+	Thread sender;
+
+	if( !sender.Start(&senderThread, &settings) )
+		return 1;
+
+	if( !server->Accept(5 * 1000 * 1000) || !server->SetRecieveTimeout(5 * 1000 * 1000) )
+	{
+		LogError("point-cloud-loopback:  the sender didn't connect\n");
+		sender.Stop(true);
+		return 1;
+	}
+
+
+	/*
+	 * receive each frame, and compare it against the cloud that was sent
+	 */
+	float*  depth = NULL;
+	float4* rgba  = NULL;
+
+	if( !cudaAllocMapped(&depth, SCENE_WIDTH * SCENE_HEIGHT * sizeof(float)) || !cudaAllocMapped(&rgba, SCENE_WIDTH * SCENE_HEIGHT * sizeof(float4)) )
+		return 1;
+
+	cudaPointCloud* received = cudaPointCloud::Create();
+
+	uint64_t rawBytes = 0;
+	uint64_t encodedBytes = 0;
+	uint32_t failures = 0;
+	uint32_t frames = 0;
+
+	for( ; frames < settings.frames; frames++ )
+	{
+		if( !received->Receive(server) )
+		{
+			LogError("point-cloud-loopback:  failed to receive frame %u\n", frames);
+			failures++;
+			break;
+		}
+
+		cudaPointCloud* original = createScene(depth, rgba, frames, settings.gpu);
+
+		if( !original )
+			return 1;
+
+		// the encoder quantizes to 16 bits across the bounding box (padded by 5% on each
+		// side when delta frames are used), or to the voxel size if that's coarser
+		float3 minPos = make_float3(INFINITY, INFINITY, INFINITY);
+		float3 maxPos = make_float3(-INFINITY, -INFINITY, -INFINITY);
+		uint32_t numValid = 0;
+
+		for( uint32_t n=0; n < original->GetNumPoints(); n++ )
+		{
+			const float3 pos = original->GetData(n)->pos;
+
+			if( !pointValid(pos) )
+				continue;
+
+			minPos = make_float3(fminf(minPos.x, pos.x), fminf(minPos.y, pos.y), fminf(minPos.z, pos.z));
+			maxPos = make_float3(fmaxf(maxPos.x, pos.x), fmaxf(maxPos.y, pos.y), fmaxf(maxPos.z, pos.z));
+			numValid++;
+		}
+
+		const float padding = (settings.keyframes > 1) ? 1.1f : 1.0f;
+
+		const float3 tolerance = make_float3(fmaxf((maxPos.x - minPos.x) * padding / 65535.0f, settings.voxelSize) + 1e-6f,
+									  fmaxf((maxPos.y - minPos.y) * padding / 65535.0f, settings.voxelSize) + 1e-6f,
+									  fmaxf((maxPos.z - minPos.z) * padding / 65535.0f, settings.voxelSize) + 1e-6f);
+
+		// every point that was sent should have been received, and nothing else
+		const uint32_t lost = findMissing(original, received, tolerance);
+		const uint32_t extra = findMissing(received, original, tolerance);
+
+		LogVerbose("point-cloud-loopback:  frame %u  %u points -> %u points  %zu bytes  (%u lost, %u extra)\n",
+				 frames, numValid, received->GetNumPoints(), received->GetReceivedSize(), lost, extra);
+
+		if( lost > 0 || extra > 0 || received->GetNumPoints() > numValid )
+		{
+			LogError("point-cloud-loopback:  frame %u doesn't match (%u points lost, %u extra)\n", frames, lost, extra);
+			failures++;
+		}
+
+		rawBytes += numValid * sizeof(cudaPointCloud::Vertex);
+		encodedBytes += received->GetReceivedSize();
+
+		delete original;
+	}
+
+	sender.Stop(true);
+
+	if( !sendSucceeded )
+		failures++;
+
+	if( encodedBytes > 0 )
+	{
+		LogInfo("point-cloud-loopback:  %u frames, %.2f bytes/point, compression ratio %.1fx (vs %zu bytes/point raw)\n",
+			   frames, encodedBytes * sizeof(cudaPointCloud::Vertex) / (double)rawBytes, rawBytes / (double)encodedBytes,
+			   sizeof(cudaPointCloud::Vertex));
+	}
+
+	LogInfo("point-cloud-loopback:  %s\n", (failures == 0) ? "PASSED" : "FAILED");
+
+	delete received;
+	delete server;
+
+	CUDA_FREE_HOST(depth);
+	CUDA_FREE_HOST(rgba);
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -141,12 +141,8 @@ bool imageLoader::Capture( void** output, imageFormat format, uint64_t timeout,
 	if( !output )
 		RETURN_STATUS(ERROR);
 
-	// confirm the stream is open
-	if( !mStreaming )
-	{
-		if( !Open() )
-			RETURN_STATUS(EOS);
-	}
+	if( !load(output, format, status) )
+		return false;
 
 	// reclaim old buffers
 	if( mBuffers.size() >= mOptions.numBuffers )
@@ -155,6 +151,55 @@ bool imageLoader::Capture( void** output, imageFormat format, uint64_t timeout,
 		mBuffers.erase(mBuffers.begin());
 	}
 
+	mBuffers.push_back(*output);
+	recordCapture(OK);
+	RETURN_STATUS(OK);
+}
+
+
+// Capture
+bool imageLoader::Capture( videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
+{
+	// verify the output frame exists
+	if( !frame )
+		RETURN_STATUS(ERROR);
+
+	// the frames take ownership of the images, so they don't need to be reclaimed
+	if( !mFramePool )
+	{
+		mFramePool = videoFramePool::Create(0, 0, true, 0, mSourceID);
+
+		if( !mFramePool )
+			RETURN_STATUS(ERROR);
+	}
+
+	void* image = NULL;
+
+	if( !load(&image, format, status) )
+		return false;
+
+	if( !mFramePool->Adopt(frame, image, mOptions.width, mOptions.height, format) )
+	{
+		CUDA(cudaFreeHost(image));
+		recordCapture(ERROR);
+		RETURN_STATUS(ERROR);
+	}
+
+	recordCapture(OK);
+	RETURN_STATUS(OK);
+}
+
+
+// load
+bool imageLoader::load( void** output, imageFormat format, int* status )
+{
+	// confirm the stream is open
+	if( !mStreaming )
+	{
+		if( !Open() )
+			RETURN_STATUS(EOS);
+	}
+
 	// get the next file to load
 	const size_t currFile = mNextFile;
 	mNextFile++;
@@ -178,10 +223,13 @@ bool imageLoader::Capture( void** output, imageFormat format, uint64_t timeout,
 	int imgWidth  = 0;
 	int imgHeight = 0;
 
+	recordReceived();
+
 	if( !loadImage(mFiles[currFile].c_str(), &imgPtr, &imgWidth, &imgHeight, format) )
 	{
 		LogError(LOG_IMAGE "imageLoader -- failed to load '%s'\n", mFiles[currFile].c_str());
-		return Capture(output, format, timeout, status, stream);
+		recordDropped(DROP_FAILED);
+		return load(output, format, status);
 	}
 
 	// set outputs
@@ -189,8 +237,6 @@ bool imageLoader::Capture( void** output, imageFormat format, uint64_t timeout,
 	mOptions.height = imgHeight;
 
 	*output = imgPtr;
-	mBuffers.push_back(imgPtr);
-
 	RETURN_STATUS(OK);
 }
 
@@ -73,6 +73,12 @@ public:
 	 */
 	virtual bool Capture( void** image, imageFormat format, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
 
+	/**
+	 * Load the next frame into a reference-counted videoFrame, which takes ownership of the image.
+	 * @see videoSource::Capture()
+	 */
+	virtual bool Capture( videoFrame* frame, imageFormat format=IMAGE_RGB8, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
+
 	/**
 	 * Open the stream.
 	 * @see videoSource::Open()
@@ -131,6 +137,8 @@ public:
 protected:
 	imageLoader( const videoOptions& options );
 
+	bool load( void** image, imageFormat format, int* status );
+
 	inline bool isLooping() const { return (mOptions.loop < 0) || ((mOptions.loop > 0) && (mLoopCount < mOptions.loop)); }
 
 	bool mEOS;
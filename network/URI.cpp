@@ -148,6 +148,14 @@ bool URI::Parse( const char* uri )
 	{
 		extension = fileExtension(location);
 	}
+	else if( protocol == "shm" )
+	{
+		if( location.size() == 0 || location.find("/") != std::string::npos )
+		{
+			LogError("URI -- invalid shared memory stream name '%s'\n", location.c_str());
+			return false;
+		}
+	}
 	else
 	{		
 		// search for ip/port format
@@ -66,6 +66,8 @@
  *        decoding include H.264, H.265, VP8, VP9, MPEG-2, MPEG-4, and MJPEG. Supported image formats
  *        for loading include JPG, PNG, TGA, BMP, GIF, PSD, HDR, PIC, and PNM (PPM/PGM binary).
  *
+ *     - `shm://my_stream` to receive frames that another process is sharing through shared memory.
+ *
  * URI protocols for videoOutput streams include rendering to displays (`display://`), broadcasting RTP/RTSP 
  * streams (`rtp://`, `rtsp://`), WebRTC streams (`webrtc://`), and saving videos/images to disk (`file://`) 
  *
@@ -95,6 +97,8 @@
  *        encoding include H.264, H.265, VP8, VP9, and MJPEG. Supported image formats for saving 
  *        include JPG, PNG, TGA, and BMP.
  *
+ *     - `shm://my_stream` to share frames with other processes through shared memory.
+ *
  * The URI strings used should take one of the above forms for input/output streams to be parsed correctly.
  * @ingroup video
  */
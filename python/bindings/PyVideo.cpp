@@ -103,6 +103,7 @@ static PyObject* PyVideoOptions_ToDict( const videoOptions& options )
 	{
 		PYDICT_SET_INT(dict, "loop", options.loop);
 		PYDICT_SET_STRING(dict, "flipMethod", videoOptions::FlipMethodToStr(options.flipMethod));
+		PYDICT_SET_UINT(dict, "retainBuffers", options.retainBuffers);
 	}
 
 	PYDICT_SET_UINT(dict, "numBuffers", options.numBuffers);
@@ -146,6 +147,7 @@ static bool PyVideoOptions_FromDict( PyObject* dict, videoOptions& options )
 	PYDICT_GET_UINT(dict, "height", options.height);
 	PYDICT_GET_UINT(dict, "bitrate", options.bitRate);
 	PYDICT_GET_UINT(dict, "numBuffers", options.numBuffers);
+	PYDICT_GET_UINT(dict, "retainBuffers", options.retainBuffers);
 	
 	PYDICT_GET_INT(dict, "loop", options.loop);
 	PYDICT_GET_INT(dict, "latency", options.latency);
@@ -421,6 +423,86 @@ static PyObject* PyVideoSource_GetFrameCount( PyVideoSource_Object* self )
 	return PYLONG_FROM_UNSIGNED_LONG(self->source->GetFrameCount());
 }
 
+// PyVideoSource_GetLastPTS
+static PyObject* PyVideoSource_GetLastPTS( PyVideoSource_Object* self )
+{
+	if( !self || !self->source )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "videoSource invalid object instance");
+		return NULL;
+	}
+
+	return PYLONG_FROM_UNSIGNED_LONG_LONG(self->source->GetLastPTS());
+}
+
+// PyVideoSource_GetStats
+static PyObject* PyVideoSource_GetStats( PyVideoSource_Object* self )
+{
+	if( !self || !self->source )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "videoSource invalid object instance");
+		return NULL;
+	}
+
+	const videoSource::Stats stats = self->source->GetStats();
+
+	PyObject* dict = PyDict_New();
+	PyObject* dropped = PyDict_New();
+	PyObject* latency = PyDict_New();
+	PyObject* histogram = PyList_New(0);
+
+	PYDICT_SET_ITEM(dropped, "skipped", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.droppedSkipped));
+	PYDICT_SET_ITEM(dropped, "overwritten", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.droppedOverwritten));
+	PYDICT_SET_ITEM(dropped, "failed", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.droppedFailed));
+
+	// the histogram is a list of (min, max, count) tuples for the bins that aren't empty
+	for( uint32_t n=0; n < videoSource::LatencyBins; n++ )
+	{
+		if( stats.histogram[n] == 0 )
+			continue;
+
+		uint64_t min = 0;
+		uint64_t max = 0;
+
+		videoSource::LatencyBinRange(n, &min, &max);
+
+		PyObject* bin = Py_BuildValue("(KKK)", (unsigned long long)min, (unsigned long long)max, (unsigned long long)stats.histogram[n]);
+		PyList_Append(histogram, bin);
+		Py_DECREF(bin);
+	}
+
+	PYDICT_SET_ITEM(latency, "count", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.latencyCount));
+	PYDICT_SET_ITEM(latency, "min", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.latencyMin));
+	PYDICT_SET_ITEM(latency, "max", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.latencyMax));
+	PYDICT_SET_ITEM(latency, "mean", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.latencyMean));
+	PYDICT_SET_ITEM(latency, "p50", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.latencyP50));
+	PYDICT_SET_ITEM(latency, "p99", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.latencyP99));
+	PYDICT_SET_ITEM(latency, "histogram", histogram);
+
+	PYDICT_SET_ITEM(dict, "received", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.received));
+	PYDICT_SET_ITEM(dict, "delivered", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.delivered));
+	PYDICT_SET_ITEM(dict, "dropped", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.dropped));
+	PYDICT_SET_ITEM(dict, "droppedReasons", dropped);
+	PYDICT_SET_ITEM(dict, "timeouts", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.timeouts));
+	PYDICT_SET_ITEM(dict, "errors", PYLONG_FROM_UNSIGNED_LONG_LONG(stats.errors));
+	PYDICT_SET_ITEM(dict, "latency", latency);
+
+	return dict;
+}
+
+// PyVideoSource_ResetStats
+static PyObject* PyVideoSource_ResetStats( PyVideoSource_Object* self )
+{
+	if( !self || !self->source )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "videoSource invalid object instance");
+		return NULL;
+	}
+
+	self->source->ResetStats();
+	Py_RETURN_NONE;
+}
+
 // PyVideoSource_GetOptions
 static PyObject* PyVideoSource_GetOptions( PyVideoSource_Object* self )
 {
@@ -465,6 +547,9 @@ static PyMethodDef pyVideoSource_Methods[] =
 	{ "GetHeight", (PyCFunction)PyVideoSource_GetHeight, METH_NOARGS, "Return the height of the video source (in pixels)"},
 	{ "GetFrameRate", (PyCFunction)PyVideoSource_GetFrameRate, METH_NOARGS, "Return the frames per second of the video source"},	
 	{ "GetFrameCount", (PyCFunction)PyVideoSource_GetFrameCount, METH_NOARGS, "Return the number of frames captured so far"},
+	{ "GetLastPTS", (PyCFunction)PyVideoSource_GetLastPTS, METH_NOARGS, "Return the presentation timestamp (PTS) of the last captured frame in nanoseconds, which is its position in the media (0 if unknown)"},
+	{ "GetStats", (PyCFunction)PyVideoSource_GetStats, METH_NOARGS, "Return a dict of the frame counters (received, delivered, dropped, timeouts) and capture latency in nanoseconds (p50, p99, histogram)"},
+	{ "ResetStats", (PyCFunction)PyVideoSource_ResetStats, METH_NOARGS, "Reset the frame counters and latency statistics"},
 	{ "GetOptions", (PyCFunction)PyVideoSource_GetOptions, METH_NOARGS, "Return a dict representing the videoOptions of the source"},	
 	{ "IsStreaming", (PyCFunction)PyVideoSource_IsStreaming, METH_NOARGS, "Return true if the stream is open, return false if closed"},
 	{ "Usage", (PyCFunction)PyVideoSource_Usage, METH_NOARGS|METH_STATIC, "Return help text describing the command line options"},		
@@ -26,8 +26,18 @@
 #include "Mutex.h"
 #include "timespec.h"
 
+#include <atomic>
+#include <vector>
+
+
 /**
  * Event object for signalling other threads.
+ *
+ * Events are implemented with a Linux futex, so Wake() only makes a system call
+ * when there are threads waiting on the event.  A thread can wait on multiple events
+ * at once with WaitAny(), and events that are created with `pollable=true` also have
+ * an eventfd (see GetFD()) that can be used with poll/epoll alongside sockets.
+ *
  * @ingroup threads
  */
 class Event
@@ -36,8 +46,9 @@ public:
 	/**
 	 * Event constructor. By default, it will automatically be reset when it's raised.
 	 * @param auto_reset Once this event has been raised, should it automatically be reset?
+	 * @param pollable Create an eventfd that becomes readable when the event is raised (see GetFD()).
 	 */
-	inline Event( bool auto_reset=true );
+	inline Event( bool auto_reset=true, bool pollable=false );
 
 	/**
 	 * Destructor
@@ -45,7 +56,8 @@ public:
 	inline ~Event();
 
 	/**
-	 * Raise the event.  Any threads waiting on this event will be woken up.
+	 * Raise the event.  If it's an auto-reset event, one waiting thread will be woken up.
+	 * Otherwise, all the waiting threads will be woken up and the event stays raised until Reset().
 	 */
 	inline void Wake();
 
@@ -89,19 +101,58 @@ public:
 	 * @see Wake
 	 */
 	inline bool WaitUs( uint64_t timeout );
-	
+
+	/**
+	 * Wait for a specified number of milliseconds until any of the events are raised, or timeout occurs.
+	 * If more than one event is raised, the one that's first in the array is returned (and reset, if
+	 * it's an auto-reset event).  The other events are left as they were.
+	 * @returns the index of the event that was raised, or -1 if the timeout occurred.
+	 */
+	static inline int WaitAny( Event** events, uint32_t count, uint64_t timeout=UINT64_MAX );
+
+	/**
+	 * Get the eventfd file descriptor of a pollable event, or -1 if the event wasn't created with
+	 * `pollable=true`.  The descriptor becomes readable when the event is raised, so it can be watched
+	 * with poll/epoll along with other descriptors (like sockets).  After it becomes readable, call 
+	 * Wait(0) or Query() to check the event, because spurious readiness is possible.
+	 */
+	inline int GetFD() const						{ return mFD; }
+
+	/**
+	 * Get the futex word of the event, which is non-zero while the event is raised.
+	 * @deprecated Events used to be a pthread_cond_t (which this returned), and are now a futex.
+	 *             The word can be waited on with futexWait(), but use Wait() or GetFD() instead.
+	 */
+	inline std::atomic<uint32_t>* GetID();
+
 	/**
-	 * Get the Event object
+	 * Wait on a raw futex word while it still contains `value`, until it gets woken by futexWake()
+	 * or the absolute deadline (in the CLOCK_MONOTONIC timebase of timeMonotonic()) expires.
+	 * Set `shared=true` for futex words that live in memory shared between processes.
+	 * @returns false if the deadline expired, otherwise true (which can also be a spurious wakeup).
 	 */
-	inline pthread_cond_t* GetID();
+	static inline bool futexWait( std::atomic<uint32_t>* word, uint32_t value, const timespec* deadline, bool shared=false );
+
+	/**
+	 * Wake up to `count` threads that are waiting in futexWait() on the futex word.
+	 * Set `shared=true` for futex words that live in memory shared between processes.
+	 */
+	static inline void futexWake( std::atomic<uint32_t>* word, int count, bool shared=false );
 
 protected:
 
-	pthread_cond_t mID;
+	inline bool wait( const timespec* deadline );
+	inline bool consume();
+	inline void clearFD();
+
+	std::atomic<uint32_t> mState;
+	std::atomic<uint32_t> mWaiters;
+
+	Mutex mListenerMutex;
+	std::vector<std::atomic<uint32_t>*> mListeners;
 
-	Mutex mQueryMutex;
-	bool  mQuery;
-	bool  mAutoReset;
+	bool mAutoReset;
+	int  mFD;
 };
 
 // inline implementations
@@ -24,94 +24,172 @@
 #define __MULTITHREAD_EVENT_INLINE_H
 
 #include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
 
 
 // constructor
-inline Event::Event( bool autoReset )
+inline Event::Event( bool autoReset, bool pollable )
 {
 	mAutoReset = autoReset;
-	mQuery     = false;
-	
-	pthread_cond_init(&mID, NULL);
+	mState     = 0;
+	mWaiters   = 0;
+	mFD        = -1;
+
+	if( pollable )
+	{
+		mFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		if( mFD < 0 )
+			LogError("Event -- failed to create eventfd (error %i)\n", errno);
+	}
 }
 
 
 // destructor
 inline Event::~Event()
 {
-	pthread_cond_destroy(&mID);
+	if( mFD >= 0 )
+		close(mFD);
+}
+
+
+// futexWait
+inline bool Event::futexWait( std::atomic<uint32_t>* word, uint32_t value, const timespec* deadline, bool shared )
+{
+	// FUTEX_WAIT_BITSET takes an absolute deadline (without FUTEX_CLOCK_REALTIME, on the CLOCK_MONOTONIC clock of timeMonotonic())
+	const int flags = shared ? 0 : FUTEX_PRIVATE_FLAG;
+	const int op = (deadline != NULL) ? (FUTEX_WAIT_BITSET | flags) : (FUTEX_WAIT | flags);
+
+	if( syscall(SYS_futex, (uint32_t*)word, op, value, deadline, NULL, FUTEX_BITSET_MATCH_ANY) != 0 )
+		return (errno != ETIMEDOUT);
+
+	return true;
+}
+
+
+// futexWake
+inline void Event::futexWake( std::atomic<uint32_t>* word, int count, bool shared )
+{
+	syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE | (shared ? 0 : FUTEX_PRIVATE_FLAG), count, NULL, NULL, 0);
+}
+
+
+// clearFD
+inline void Event::clearFD()
+{
+	uint64_t value = 0;
+
+	if( read(mFD, &value, sizeof(value)) < 0 && errno != EAGAIN )
+		LogError("Event -- failed to read eventfd (error %i)\n", errno);
+}
+
+
+// consume
+inline bool Event::consume()
+{
+	if( mState.load() == 0 )
+		return false;
+
+	if( !mAutoReset )
+		return true;
+
+	// clear the eventfd before the state, so a Wake() that comes after re-arms it
+	if( mFD >= 0 )
+		clearFD();
+
+	uint32_t expected = 1;
+	return mState.compare_exchange_strong(expected, 0);
 }
 
 
 // Query
 inline bool Event::Query()
 {
-	bool r = false;
-	mQueryMutex.Lock();
-	r = mQuery;
-	mQueryMutex.Unlock();
-	return r;
+	return (mState.load() != 0);
 }
 
 
 // Wake
 inline void Event::Wake()
 {
-	mQueryMutex.Lock();
-	mQuery = true;
-	pthread_cond_signal(&mID);
-	mQueryMutex.Unlock();
+	if( mState.exchange(1) != 0 )
+		return;	// already raised
+
+	if( mFD >= 0 )
+	{
+		const uint64_t value = 1;
+
+		if( write(mFD, &value, sizeof(value)) < 0 )
+			LogError("Event -- failed to write eventfd (error %i)\n", errno);
+	}
+
+	// skip the system call when nobody is waiting
+	if( mWaiters.load() == 0 )
+		return;
+
+	futexWake(&mState, mAutoReset ? 1 : INT_MAX);
+
+	mListenerMutex.Lock();
+
+	for( size_t n=0; n < mListeners.size(); n++ )
+	{
+		mListeners[n]->store(1);
+		futexWake(mListeners[n], 1);
+	}
+
+	mListenerMutex.Unlock();
 }
 
 
 // Reset
 inline void Event::Reset()
 { 
-	mQueryMutex.Lock(); 
-	mQuery = false; 
-	mQueryMutex.Unlock(); 
+	if( mFD >= 0 )
+		clearFD();
+
+	mState = 0;
 }
 
 
-// Wait
-inline bool Event::Wait()
+// wait
+inline bool Event::wait( const timespec* deadline )
 {
-	mQueryMutex.Lock();
+	while( true )
+	{
+		if( consume() )
+			return true;
 
-	while(!mQuery)
-		pthread_cond_wait(&mID, mQueryMutex.GetID());
+		if( deadline != NULL && timeCmp(timeMonotonic(), *deadline) >= 0 )
+			return false;
 
-	if( mAutoReset )
-		mQuery = false;
+		mWaiters++;
+		const bool signalled = futexWait(&mState, 0, deadline);
+		mWaiters--;
 
-	mQueryMutex.Unlock();
-	return true;
+		if( !signalled )
+			return consume();
+	}
 }
 
 
 // Wait
-inline bool Event::Wait( const timespec& timeout )
+inline bool Event::Wait()
 {
-	mQueryMutex.Lock();
-
-	const timespec abs_time = timeAdd( timestamp(), timeout );
+	return wait(NULL);
+}
 
-	while(!mQuery)
-	{
-		const int ret = pthread_cond_timedwait(&mID, mQueryMutex.GetID(), &abs_time);
-		
-		if( ret == ETIMEDOUT )
-		{
-			mQueryMutex.Unlock();
-			return false;
-		}
-	}
-	
-	if( mAutoReset )
-		mQuery = false;
 
-	mQueryMutex.Unlock();
-	return true;
+// Wait
+inline bool Event::Wait( const timespec& timeout )
+{
+	const timespec deadline = timeAdd(timeMonotonic(), timeout);
+	return wait(&deadline);
 }
 
 
@@ -136,10 +214,78 @@ inline bool Event::WaitUs( uint64_t timeout )
 }
 
 
+// WaitAny
+inline int Event::WaitAny( Event** events, uint32_t count, uint64_t timeout )
+{
+	if( !events || count == 0 )
+		return -1;
+
+	for( uint32_t n=0; n < count; n++ )
+	{
+		if( events[n] != NULL && events[n]->consume() )
+			return n;
+	}
+
+	if( timeout == 0 )
+		return -1;
+
+	const bool infinite = (timeout == UINT64_MAX);
+	const timespec deadline = infinite ? timeZero() : timeAdd(timeMonotonic(), timeNew(timeout*1000*1000));
+
+	// register a futex with each of the events, that gets raised by any of them
+	std::atomic<uint32_t> listener(0);
+
+	for( uint32_t n=0; n < count; n++ )
+	{
+		if( !events[n] )
+			continue;
+
+		events[n]->mListenerMutex.Lock();
+		events[n]->mListeners.push_back(&listener);
+		events[n]->mListenerMutex.Unlock();
+		events[n]->mWaiters++;
+	}
+
+	int result = -1;
+
+	while( result < 0 )
+	{
+		listener = 0;
+
+		for( uint32_t n=0; n < count && result < 0; n++ )
+		{
+			if( events[n] != NULL && events[n]->consume() )
+				result = n;
+		}
+
+		if( result >= 0 || (!infinite && timeCmp(timeMonotonic(), deadline) >= 0) )
+			break;
+
+		futexWait(&listener, 0, infinite ? NULL : &deadline);
+	}
+
+	for( uint32_t n=0; n < count; n++ )
+	{
+		if( !events[n] )
+			continue;
+
+		events[n]->mWaiters--;
+		events[n]->mListenerMutex.Lock();
+
+		std::vector<std::atomic<uint32_t>*>& listeners = events[n]->mListeners;
+		listeners.erase(std::find(listeners.begin(), listeners.end(), &listener));
+
+		events[n]->mListenerMutex.Unlock();
+	}
+
+	return result;
+}
+
+
 // GetID
-inline pthread_cond_t* Event::GetID()	
-{ 
-	return &mID; 
+inline std::atomic<uint32_t>* Event::GetID()
+{
+	return &mState;
 }
 
 	
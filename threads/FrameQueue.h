@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MULTITHREAD_FRAME_QUEUE_H_
+#define __MULTITHREAD_FRAME_QUEUE_H_
+
+#include "Event.h"
+#include "Mutex.h"
+
+#include <vector>
+
+
+/**
+ * Bounded multi-producer/multi-consumer queue for handing frames between threads.
+ *
+ * Unlike RingBuffer (where the latest write wins), every item that gets pushed is
+ * popped exactly once by one of the consumers, unless the overflow policy drops it.
+ * When the queue is full, Push() either blocks until there's space (Block), evicts the
+ * oldest item to make room (DropOldest), or discards the new item (DropNewest).
+ *
+ * Producers and consumers wait on Event objects, so Push() and Pop() accept the same
+ * millisecond timeouts as Event::Wait().  Close() wakes any waiting threads for shutdown.
+ *
+ * Items are stored by value, so T should be something cheap to copy (like a pointer or
+ * a small struct).  Items that get dropped can be returned to the caller for recycling.
+ *
+ * @ingroup threads
+ */
+template<typename T>
+class FrameQueue
+{
+public:
+	/**
+	 * Overflow policy for when the queue is full.
+	 */
+	enum Policy
+	{
+		Block,		/**< Wait for a consumer to make space (up to the timeout). */
+		DropOldest,	/**< Evict the oldest item in the queue to make space for the new one. */
+		DropNewest	/**< Discard the new item and keep the queue contents. */
+	};
+
+	/**
+	 * Queue statistics (see GetStats())
+	 */
+	struct Stats
+	{
+		size_t depth;			/**< Number of items currently in the queue. */
+		size_t maxDepth;		/**< Highest number of items that were in the queue. */
+		uint64_t enqueued;		/**< Total number of items that were pushed. */
+		uint64_t dequeued;		/**< Total number of items that were popped. */
+		uint64_t dropped;		/**< Total number of items dropped by the overflow policy or timeouts. */
+		float enqueueRate;		/**< Items pushed per second since the previous call to GetStats(). */
+		float dequeueRate;		/**< Items popped per second since the previous call to GetStats(). */
+	};
+
+	/**
+	 * Construct a queue that holds up to the specified number of items.
+	 */
+	inline FrameQueue( size_t capacity, Policy policy=Block );
+
+	/**
+	 * Destructor
+	 */
+	inline ~FrameQueue();
+
+	/**
+	 * Add an item to the back of the queue.
+	 *
+	 * @param item the item to add.
+	 * @param timeout the number of milliseconds to wait for space when the policy is Block
+	 *                (the default of UINT64_MAX waits forever, and 0 returns immediately).
+	 * @param dropped if non-NULL and an item gets dropped (either the oldest item with the
+	 *                DropOldest policy, or this item if it couldn't be added), the item
+	 *                that was dropped gets returned here so it can be released by the caller.
+	 * @param wasDropped set to true if an item was dropped (optional).
+	 *
+	 * @returns true if the item was added to the queue, or false if it was dropped
+	 *          (because of the DropNewest policy, a timeout, or the queue being closed).
+	 */
+	inline bool Push( const T& item, uint64_t timeout=UINT64_MAX, T* dropped=NULL, bool* wasDropped=NULL );
+
+	/**
+	 * Remove an item from the front of the queue.
+	 *
+	 * @param item output for the item that was removed.
+	 * @param timeout the number of milliseconds to wait for an item if the queue is empty
+	 *                (the default of UINT64_MAX waits forever, and 0 returns immediately).
+	 *
+	 * @returns true if an item was removed, or false on timeout or if the queue was closed and empty.
+	 */
+	inline bool Pop( T* item, uint64_t timeout=UINT64_MAX );
+
+	/**
+	 * Close the queue, waking up any threads that are waiting in Push() or Pop().
+	 * Further calls to Push() will fail, and Pop() will return the remaining items and then fail.
+	 */
+	inline void Close();
+
+	/**
+	 * Re-open the queue after it was closed.
+	 */
+	inline void Open();
+
+	/**
+	 * Remove all items from the queue, without counting them as dequeued or dropped.
+	 * @param cleared if non-NULL, the items that were removed get appended here (oldest
+	 *                first) so they can be released by the caller, like Push() does
+	 *                with the items that it drops.
+	 */
+	inline void Clear( std::vector<T>* cleared=NULL );
+
+	/**
+	 * Return true if the queue has been closed.
+	 */
+	inline bool IsClosed();
+
+	/**
+	 * Get the number of items currently in the queue.
+	 */
+	inline size_t GetDepth();
+
+	/**
+	 * Get the maximum number of items the queue can hold.
+	 */
+	inline size_t GetCapacity() const		{ return mCapacity; }
+
+	/**
+	 * Get the overflow policy.
+	 */
+	inline Policy GetPolicy() const		{ return mPolicy; }
+
+	/**
+	 * Set the overflow policy.
+	 */
+	inline void SetPolicy( Policy policy )	{ mPolicy = policy; }
+
+	/**
+	 * Get the queue statistics.  The enqueue/dequeue rates are measured over the time
+	 * since the previous call to GetStats(), so call it periodically (e.g. once per second).
+	 */
+	inline Stats GetStats();
+
+	/**
+	 * Reset the statistics counters (not including the current depth).
+	 */
+	inline void ResetStats();
+
+protected:
+	inline bool wait( Event& event, const timespec& deadline, bool infinite );
+	inline void wake( bool notEmpty, bool notFull );
+
+	T*     mItems;
+	size_t mCapacity;
+	size_t mHead;
+	size_t mCount;
+	bool   mClosed;
+
+	uint32_t mWaitingProducers;
+	uint32_t mWaitingConsumers;
+
+	Policy mPolicy;
+	Mutex  mMutex;
+	Event  mNotEmpty;
+	Event  mNotFull;
+
+	size_t   mMaxDepth;
+	uint64_t mEnqueued;
+	uint64_t mDequeued;
+	uint64_t mDropped;
+
+	timespec mRateTime;
+	uint64_t mRateEnqueued;
+	uint64_t mRateDequeued;
+};
+
+// inline implementations
+#include "FrameQueue.inl"
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MULTITHREAD_FRAME_QUEUE_INLINE_H_
+#define __MULTITHREAD_FRAME_QUEUE_INLINE_H_
+
+#include <stdint.h>
+
+
+// constructor
+template<typename T>
+inline FrameQueue<T>::FrameQueue( size_t capacity, Policy policy )
+{
+	mCapacity = (capacity > 0) ? capacity : 1;
+	mItems    = new T[mCapacity];
+	mPolicy   = policy;
+	mHead     = 0;
+	mCount    = 0;
+	mClosed   = false;
+
+	mWaitingProducers = 0;
+	mWaitingConsumers = 0;
+
+	mMaxDepth = 0;
+	mEnqueued = 0;
+	mDequeued = 0;
+	mDropped  = 0;
+
+	mRateTime     = timeMonotonic();
+	mRateEnqueued = 0;
+	mRateDequeued = 0;
+}
+
+
+// destructor
+template<typename T>
+inline FrameQueue<T>::~FrameQueue()
+{
+	delete[] mItems;
+}
+
+
+// wait (called with the mutex unlocked)
+template<typename T>
+inline bool FrameQueue<T>::wait( Event& event, const timespec& deadline, bool infinite )
+{
+	if( infinite )
+		return event.Wait();
+
+	const timespec now = timeMonotonic();
+
+	if( timeCmp(now, deadline) >= 0 )
+		return false;
+
+	return event.Wait(timeDiff(now, deadline));
+}
+
+
+// wake (called with the mutex unlocked)
+template<typename T>
+inline void FrameQueue<T>::wake( bool notEmpty, bool notFull )
+{
+	// Events only wake one waiting thread at a time, so each thread that
+	// gets woken up passes it on if the queue still has items or space left
+	if( notEmpty )
+		mNotEmpty.Wake();
+
+	if( notFull )
+		mNotFull.Wake();
+}
+
+
+// Push
+template<typename T>
+inline bool FrameQueue<T>::Push( const T& item, uint64_t timeout, T* dropped, bool* wasDropped )
+{
+	const bool infinite = (timeout == UINT64_MAX);
+	const timespec deadline = infinite ? timeZero() : timeAdd(timeMonotonic(), timeNew(timeout*1000*1000));
+
+	if( wasDropped != NULL )
+		*wasDropped = false;
+
+	mMutex.Lock();
+
+	if( mCount == mCapacity && !mClosed )
+	{
+		if( mPolicy == Block )
+		{
+			while( mCount == mCapacity && !mClosed )
+			{
+				mWaitingProducers++;
+				mMutex.Unlock();
+
+				const bool signalled = wait(mNotFull, deadline, infinite);
+
+				mMutex.Lock();
+				mWaitingProducers--;
+
+				if( !signalled )
+					break;
+			}
+		}
+		else if( mPolicy == DropOldest )
+		{
+			if( dropped != NULL )
+				*dropped = mItems[mHead];
+
+			if( wasDropped != NULL )
+				*wasDropped = true;
+
+			mHead = (mHead + 1) % mCapacity;
+			mCount--;
+			mDropped++;
+		}
+	}
+
+	const bool added = (mCount < mCapacity && !mClosed);
+
+	if( added )
+	{
+		mItems[(mHead + mCount) % mCapacity] = item;
+		mCount++;
+		mEnqueued++;
+
+		if( mCount > mMaxDepth )
+			mMaxDepth = mCount;
+	}
+	else
+	{
+		if( dropped != NULL )
+			*dropped = item;
+
+		if( wasDropped != NULL )
+			*wasDropped = true;
+
+		mDropped++;
+	}
+
+	const bool notEmpty = (mWaitingConsumers > 0) && (mCount > 0 || mClosed);
+	const bool notFull  = (mWaitingProducers > 0) && (mCount < mCapacity || mClosed);
+
+	mMutex.Unlock();
+
+	wake(notEmpty, notFull);
+	return added;
+}
+
+
+// Pop
+template<typename T>
+inline bool FrameQueue<T>::Pop( T* item, uint64_t timeout )
+{
+	if( !item )
+		return false;
+
+	const bool infinite = (timeout == UINT64_MAX);
+	const timespec deadline = infinite ? timeZero() : timeAdd(timeMonotonic(), timeNew(timeout*1000*1000));
+
+	mMutex.Lock();
+
+	while( mCount == 0 && !mClosed )
+	{
+		mWaitingConsumers++;
+		mMutex.Unlock();
+
+		const bool signalled = wait(mNotEmpty, deadline, infinite);
+
+		mMutex.Lock();
+		mWaitingConsumers--;
+
+		if( !signalled )
+			break;
+	}
+
+	const bool removed = (mCount > 0);
+
+	if( removed )
+	{
+		*item = mItems[mHead];
+		mHead = (mHead + 1) % mCapacity;
+		mCount--;
+		mDequeued++;
+	}
+
+	const bool notEmpty = (mWaitingConsumers > 0) && (mCount > 0 || mClosed);
+	const bool notFull  = (mWaitingProducers > 0) && (mCount < mCapacity || mClosed);
+
+	mMutex.Unlock();
+
+	wake(notEmpty, notFull);
+	return removed;
+}
+
+
+// Close
+template<typename T>
+inline void FrameQueue<T>::Close()
+{
+	mMutex.Lock();
+	mClosed = true;
+	mMutex.Unlock();
+
+	wake(true, true);
+}
+
+
+// Open
+template<typename T>
+inline void FrameQueue<T>::Open()
+{
+	mMutex.Lock();
+	mClosed = false;
+	mMutex.Unlock();
+}
+
+
+// Clear
+template<typename T>
+inline void FrameQueue<T>::Clear( std::vector<T>* cleared )
+{
+	mMutex.Lock();
+
+	if( cleared != NULL )
+	{
+		for( size_t n=0; n < mCount; n++ )
+			cleared->push_back(mItems[(mHead + n) % mCapacity]);
+	}
+
+	mHead  = 0;
+	mCount = 0;
+
+	const bool notFull = (mWaitingProducers > 0);
+
+	mMutex.Unlock();
+
+	wake(false, notFull);
+}
+
+
+// IsClosed
+template<typename T>
+inline bool FrameQueue<T>::IsClosed()
+{
+	mMutex.Lock();
+	const bool closed = mClosed;
+	mMutex.Unlock();
+	return closed;
+}
+
+
+// GetDepth
+template<typename T>
+inline size_t FrameQueue<T>::GetDepth()
+{
+	mMutex.Lock();
+	const size_t depth = mCount;
+	mMutex.Unlock();
+	return depth;
+}
+
+
+// GetStats
+template<typename T>
+inline typename FrameQueue<T>::Stats FrameQueue<T>::GetStats()
+{
+	Stats stats;
+
+	const timespec now = timeMonotonic();
+
+	mMutex.Lock();
+
+	const double elapsed = timeDouble(timeDiff(mRateTime, now)) * 0.001;
+
+	stats.depth       = mCount;
+	stats.maxDepth    = mMaxDepth;
+	stats.enqueued    = mEnqueued;
+	stats.dequeued    = mDequeued;
+	stats.dropped     = mDropped;
+	stats.enqueueRate = (elapsed > 0.0) ? (mEnqueued - mRateEnqueued) / elapsed : 0.0f;
+	stats.dequeueRate = (elapsed > 0.0) ? (mDequeued - mRateDequeued) / elapsed : 0.0f;
+
+	mRateTime     = now;
+	mRateEnqueued = mEnqueued;
+	mRateDequeued = mDequeued;
+
+	mMutex.Unlock();
+	return stats;
+}
+
+
+// ResetStats
+template<typename T>
+inline void FrameQueue<T>::ResetStats()
+{
+	mMutex.Lock();
+
+	mMaxDepth = mCount;
+	mEnqueued = 0;
+	mDequeued = 0;
+	mDropped  = 0;
+
+	mRateTime     = timeMonotonic();
+	mRateEnqueued = 0;
+	mRateDequeued = 0;
+
+	mMutex.Unlock();
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __MULTITHREAD_PARALLEL_FOR_H_
+#define __MULTITHREAD_PARALLEL_FOR_H_
+
+#include "ThreadPool.h"
+
+#include <stdint.h>
+#include <unistd.h>
+
+
+/**
+ * Get the number of CPU cores that ParallelFor() will distribute work across.
+ * @ingroup threads
+ */
+inline uint32_t ParallelForThreads()
+{
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cpus > 0) ? cpus : 1;
+}
+
+
+/**
+ * Split the range `[0,count)` into contiguous chunks and process them in parallel
+ * on the CPU.  The function object is called as `func(begin, end)` once per chunk,
+ * and ParallelFor() returns after all of the chunks have been processed.
+ *
+ * The chunks are run by the shared ThreadPool::Global() workers, along with the calling
+ * thread.  Each chunk will contain at least `minChunk` items (so small ranges don't pay 
+ * the cost of extra threads).  This is used by the CPU implementations of the image and 
+ * point cloud operators.
+ *
+ * @ingroup threads
+ */
+template<typename F>
+void ParallelFor( uint32_t count, const F& func, uint32_t minChunk=1 )
+{
+	ThreadPool::Global()->ParallelFor(count, func, minChunk);
+}
+
+
+/**
+ * Split an image into tiles and process them in parallel on the CPU, using the
+ * shared ThreadPool::Global() workers.  The function object is called as 
+ * `func(x0, y0, x1, y1)` once per tile, and ParallelFor2D() returns after all
+ * of the tiles have been processed.
+ *
+ * @ingroup threads
+ */
+template<typename F>
+void ParallelFor2D( uint32_t width, uint32_t height, uint32_t tileWidth, uint32_t tileHeight, const F& func )
+{
+	ThreadPool::Global()->ParallelFor2D(width, height, tileWidth, tileHeight, func);
+}
+
+
+#endif
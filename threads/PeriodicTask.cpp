@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PeriodicTask.h"
+
+#include "timespec.h"
+#include "logging.h"
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+
+
+// latenessBin (bin 0 is <1us, bin N is [2^(N-1), 2^N) us)
+static inline uint32_t latenessBin( uint64_t lateness )
+{
+	uint64_t us = lateness / 1000;
+	uint32_t bin = 0;
+
+	while( us > 0 && bin < PeriodicTask::HistogramBins - 1 )
+	{
+		us >>= 1;
+		bin++;
+	}
+
+	return bin;
+}
+
+
+// constructor
+PeriodicTask::PeriodicTask( uint64_t period, int priority, int cpu, OverrunPolicy overrun )
+{
+	mPeriod   = (period > 0) ? period : 1;
+	mPriority = priority;
+	mCPU      = cpu;
+	mOverrun  = overrun;
+	mFunction = NULL;
+	mUser     = NULL;
+	mRunning  = false;
+	mStop     = false;
+
+	ResetStats();
+}
+
+
+// destructor
+PeriodicTask::~PeriodicTask()
+{
+	Stop();
+}
+
+
+// Start
+bool PeriodicTask::Start( TaskFunction function, void* user )
+{
+	if( !function )
+		return false;
+
+	if( mRunning )
+	{
+		LogError("PeriodicTask -- the task is already running\n");
+		return false;
+	}
+
+	// join the thread if the function stopped the task by itself
+	mThread.Stop(true);
+
+	mFunction = function;
+	mUser     = user;
+	mStop     = false;
+	mRunning  = true;
+
+	if( !mThread.Start(threadEntry, this) )
+	{
+		LogError("PeriodicTask -- failed to start thread\n");
+		mRunning = false;
+		return false;
+	}
+
+	return true;
+}
+
+
+// Stop
+void PeriodicTask::Stop()
+{
+	mStop = true;
+	mThread.Stop(true);
+	mRunning = false;
+}
+
+
+// threadEntry
+void* PeriodicTask::threadEntry( void* user )
+{
+	((PeriodicTask*)user)->run();
+	return NULL;
+}
+
+
+// run
+void PeriodicTask::run()
+{
+	// SetAffinity() and SetPriority() print an error if they fail
+	if( mCPU >= 0 )
+		Thread::SetAffinity(mCPU);
+
+	if( mPriority > 0 )
+		Thread::SetPriority(mPriority);
+
+	uint64_t index   = 0;
+	uint64_t release = timeNs();
+
+	while( !mStop )
+	{
+		// sleep until the absolute release time, so that the period doesn't drift
+		const timespec deadline = timeFromNs(release);
+
+		while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR ) { }
+
+		if( mStop )
+			break;
+
+		const uint64_t start = timeNs();
+		const bool keepRunning = mFunction(index, mUser);
+		const uint64_t finish = timeNs();
+
+		// find the next release time
+		const uint64_t period = mPeriod.load();
+		const uint64_t lateness = (start > release) ? (start - release) : 0;
+
+		release += period;
+		index++;
+
+		const bool overrun = (finish > release);
+		uint64_t skipped = 0;
+
+		if( overrun && mOverrun == Skip )
+		{
+			skipped = (finish - release) / period + 1;
+			release += skipped * period;
+			index += skipped;
+		}
+
+		record(lateness, finish - start, overrun, skipped);
+
+		if( !keepRunning )
+			break;
+	}
+
+	mRunning = false;
+}
+
+
+// record
+void PeriodicTask::record( uint64_t lateness, uint64_t runtime, bool overrun, uint64_t skipped )
+{
+	mStatsMutex.Lock();
+
+	if( mStats.periods == 0 || lateness < mStats.latenessMin )
+		mStats.latenessMin = lateness;
+
+	if( lateness > mStats.latenessMax )
+		mStats.latenessMax = lateness;
+
+	if( runtime > mStats.runtimeMax )
+		mStats.runtimeMax = runtime;
+
+	mStats.periods++;
+	mStats.skipped += skipped;
+	mStats.histogram[latenessBin(lateness)]++;
+
+	if( overrun )
+		mStats.overruns++;
+
+	mLatenessTotal += lateness;
+	mRuntimeTotal  += runtime;
+
+	mStatsMutex.Unlock();
+}
+
+
+// GetStats
+PeriodicTask::Stats PeriodicTask::GetStats()
+{
+	mStatsMutex.Lock();
+
+	Stats stats = mStats;
+
+	if( stats.periods > 0 )
+	{
+		stats.latenessMean = mLatenessTotal / stats.periods;
+		stats.runtimeMean  = mRuntimeTotal / stats.periods;
+	}
+
+	mStatsMutex.Unlock();
+	return stats;
+}
+
+
+// ResetStats
+void PeriodicTask::ResetStats()
+{
+	mStatsMutex.Lock();
+
+	memset(&mStats, 0, sizeof(Stats));
+
+	mLatenessTotal = 0;
+	mRuntimeTotal  = 0;
+
+	mStatsMutex.Unlock();
+}
+
+
+// PrintStats
+void PeriodicTask::PrintStats( const char* name )
+{
+	const Stats stats = GetStats();
+
+	LogInfo("PeriodicTask%s%s (period %.3f ms)\n", name != NULL ? " " : "", name != NULL ? name : "", mPeriod.load() / 1000000.0);
+	LogInfo("   -- periods:   %" PRIu64 "\n", stats.periods);
+	LogInfo("   -- overruns:  %" PRIu64 " (%" PRIu64 " skipped)\n", stats.overruns, stats.skipped);
+	LogInfo("   -- lateness:  min %.1f us, mean %.1f us, max %.1f us\n", stats.latenessMin / 1000.0, stats.latenessMean / 1000.0, stats.latenessMax / 1000.0);
+	LogInfo("   -- runtime:   mean %.1f us, max %.1f us\n", stats.runtimeMean / 1000.0, stats.runtimeMax / 1000.0);
+
+	for( uint32_t n=0; n < HistogramBins; n++ )
+	{
+		if( stats.histogram[n] == 0 )
+			continue;
+
+		const uint64_t low  = (n == 0) ? 0 : ((uint64_t)1 << (n - 1));
+		const uint64_t high = (uint64_t)1 << n;
+		const double percent = stats.histogram[n] * 100.0 / stats.periods;
+
+		if( n == HistogramBins - 1 )
+		{
+			LogInfo("      >= %5" PRIu64 " us   %8" PRIu64 "  (%5.1f%%)\n", low, stats.histogram[n], percent);
+		}
+		else
+		{
+			LogInfo("      %4" PRIu64 "-%-5" PRIu64 " us  %8" PRIu64 "  (%5.1f%%)\n", low, high, stats.histogram[n], percent);
+		}
+	}
+}
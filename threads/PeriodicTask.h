@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MULTITHREAD_PERIODIC_TASK_H_
+#define __MULTITHREAD_PERIODIC_TASK_H_
+
+#include "Thread.h"
+#include "Mutex.h"
+
+#include <stdint.h>
+#include <atomic>
+
+
+/**
+ * Run a function at a fixed period on its own thread, and measure how well the period is kept.
+ *
+ * The thread sleeps until each release time with `clock_nanosleep(TIMER_ABSTIME)` on CLOCK_MONOTONIC,
+ * so the release times don't drift (unlike sleeping for a relative amount of time after each run).
+ * The thread can run at a SCHED_FIFO realtime priority and be locked to a CPU core, which along with
+ * Thread::InitRealtime() keeps the jitter low for driving actuators or generating streams at exact rates.
+ *
+ * For each period, the lateness (how long after the release time the function actually started)
+ * is recorded into a histogram, along with the runtime of the function.  If the function runs past 
+ * the next release time, it's counted as an overrun - and depending on the OverrunPolicy, either
+ * the missed release times are skipped, or the task runs again immediately to catch up.
+ *
+ * @ingroup threads
+ */
+class PeriodicTask
+{
+public:
+	/**
+	 * Function that gets called once per period, with the index of the period since the task was started
+	 * (which accounts for skipped periods, so `index * period` is the release time relative to the start).
+	 * Return false to stop the task.
+	 */
+	typedef bool (*TaskFunction)( uint64_t index, void* user );
+
+	/**
+	 * What to do when the function runs past the next release time.
+	 */
+	enum OverrunPolicy
+	{
+		Skip,		/**< Skip the release times that were missed, and stay aligned to the period (default) */
+		CatchUp	/**< Run again immediately for each release time that was missed */
+	};
+
+	/**
+	 * The number of bins in the lateness histogram.
+	 */
+	static const uint32_t HistogramBins = 16;
+
+	/**
+	 * Timing statistics (see GetStats())
+	 */
+	struct Stats
+	{
+		uint64_t periods;				/**< Number of periods that the function was run */
+		uint64_t overruns;				/**< Number of periods where the function ran past the next release time */
+		uint64_t skipped;				/**< Number of release times that were skipped because of overruns */
+		uint64_t latenessMin;			/**< Minimum lateness (in nanoseconds) */
+		uint64_t latenessMax;			/**< Maximum lateness (in nanoseconds) */
+		uint64_t latenessMean;			/**< Average lateness (in nanoseconds) */
+		uint64_t runtimeMax;			/**< Maximum runtime of the function (in nanoseconds) */
+		uint64_t runtimeMean;			/**< Average runtime of the function (in nanoseconds) */
+
+		/**
+		 * Number of periods by lateness.  Bin 0 is less than 1us, and bin N is from 2^(N-1) to 2^N microseconds.
+		 * The last bin also includes everything that was later than that.
+		 */
+		uint64_t histogram[HistogramBins];
+	};
+
+	/**
+	 * Create a periodic task (it starts running when Start() is called).
+	 * @param period the period (in nanoseconds), for example `1000000000 / rate` for a rate in Hz.
+	 * @param priority if positive, the SCHED_FIFO realtime priority of the thread (see Thread::SetPriority())
+	 * @param cpu if not negative, the CPU core to lock the thread to (see Thread::SetAffinity())
+	 * @param overrun what to do when the function runs past the next release time.
+	 */
+	PeriodicTask( uint64_t period, int priority=0, int cpu=-1, OverrunPolicy overrun=Skip );
+
+	/**
+	 * Destructor.  Stops the task.
+	 */
+	~PeriodicTask();
+
+	/**
+	 * Start calling the function at the period.  The first period is released immediately.
+	 * @returns false if the task is already running, or the thread couldn't be started.
+	 */
+	bool Start( TaskFunction function, void* user=NULL );
+
+	/**
+	 * Stop the task, and wait for the thread to exit.  This can take up to one period
+	 * (plus the runtime of the function) since the thread could be sleeping.
+	 */
+	void Stop();
+
+	/**
+	 * Return true if the task is running.
+	 */
+	inline bool IsRunning() const				{ return mRunning.load(); }
+
+	/**
+	 * Get the period (in nanoseconds).
+	 */
+	inline uint64_t GetPeriod() const			{ return mPeriod.load(); }
+
+	/**
+	 * Change the period (in nanoseconds).  It takes effect after the next release time.
+	 */
+	inline void SetPeriod( uint64_t period )		{ if( period > 0 ) mPeriod = period; }
+
+	/**
+	 * Get a snapshot of the timing statistics since the task was started (or ResetStats()).
+	 */
+	Stats GetStats();
+
+	/**
+	 * Reset the timing statistics.
+	 */
+	void ResetStats();
+
+	/**
+	 * Print the timing statistics and lateness histogram to the log.
+	 */
+	void PrintStats( const char* name=NULL );
+
+protected:
+	static void* threadEntry( void* user );
+	void run();
+
+	void record( uint64_t lateness, uint64_t runtime, bool overrun, uint64_t skipped );
+
+	Thread mThread;
+	Mutex  mStatsMutex;
+	Stats  mStats;
+
+	uint64_t mLatenessTotal;
+	uint64_t mRuntimeTotal;
+
+	TaskFunction mFunction;
+	void*        mUser;
+
+	std::atomic<uint64_t> mPeriod;
+	std::atomic<bool>     mRunning;
+	std::atomic<bool>     mStop;
+
+	int mPriority;
+	int mCPU;
+
+	OverrunPolicy mOverrun;
+};
+
+#endif
@@ -27,6 +27,8 @@
 
 #include <string.h>
 #include <limits.h>
+#include <signal.h>
+#include <errno.h>
 
 
 // readLink
@@ -61,6 +63,20 @@ pid_t Process::GetParentID()
 }
 
 
+// IsRunning
+bool Process::IsRunning( pid_t pid )
+{
+	if( pid <= 0 )
+		return false;
+
+	// signal 0 only checks if the process exists (EPERM means it's owned by another user)
+	if( kill(pid, 0) == 0 )
+		return true;
+
+	return (errno == EPERM);
+}
+
+
 // GetCommandLine
 std::string Process::GetCommandLine( pid_t pid )
 {
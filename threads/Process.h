@@ -44,6 +44,12 @@ public:
 	 * Get the parent's process ID
 	 */
 	static pid_t GetParentID();
+
+	/**
+	 * Check if the process with the specified PID is still running.
+	 * This can be used to detect when another process has exited or crashed.
+	 */
+	static bool IsRunning( pid_t pid );
 	
 	/**
 	 * Retrieve the command line of the process with the specified PID,
@@ -24,10 +24,26 @@
 #define __MULTITHREAD_RINGBUFFER_H_
 
 #include "Mutex.h"
+#include "RingBufferAllocator.h"
+
+#include <atomic>
 
 
 /**
  * Thread-safe circular ring buffer queue
+ *
+ * Each buffer that gets written is stamped with a sequence number (starting at 1), 
+ * which is returned by Peek() and Next() so that readers can detect skipped buffers.
+ * The number of buffers that were written but never read is also kept (see GetDropped()).
+ *
+ * By default the read/write positions are protected by a mutex (the Threaded flag).
+ * When there's only one writer thread and one reader thread, the LockFree flag uses
+ * atomic sequence numbers with acquire/release ordering instead, so neither side blocks.
+ *
+ * The buffers are allocated in GPU memory, mapped zeroCopy memory (the ZeroCopy flag), or from
+ * a RingBufferAllocator (like HostAllocator, HugePageAllocator, or SharedMemoryAllocator).
+ * Each buffer also has Metadata that the writer can fill out for the readers.
+ *
  * @ingroup threads
  */
 class RingBuffer
@@ -45,8 +61,22 @@ public:
 		Write          = (1 << 4),				/**< Write the next buffer. */
 		Threaded       = (1 << 5),      			/**< Buffers should be thread-safe (enabled by default). */
 		ZeroCopy       = (1 << 6),				/**< Buffers should be allocated in mapped CPU/GPU zeroCopy memory (otherwise GPU only) */
+		LockFree       = (1 << 7),				/**< Single-producer/single-consumer mode without locking (overrides Threaded). */
 	};
 	
+	/**
+	 * Per-buffer metadata (see GetMetadata())
+	 */
+	struct Metadata
+	{
+		uint64_t timestamp;		/**< Timestamp of the buffer (in nanoseconds) */
+		uint32_t format;		/**< Format of the buffer contents (for example, an imageFormat) */
+		uint32_t width;		/**< Width of the buffer contents (for images) */
+		uint32_t height;		/**< Height of the buffer contents (for images) */
+		size_t   size;			/**< Number of bytes of the buffer being used */
+		void*    user;			/**< User-defined pointer */
+	};
+
 	/**
 	 * Construct a new ring buffer.
 	 */
@@ -69,6 +99,13 @@ public:
 	 */
 	inline bool Alloc( uint32_t numBuffers, size_t size, uint32_t flags=0 );
 
+	/**
+	 * Allocate memory for a set of buffers from the specified allocator,
+	 * which needs to stay alive until the buffers are freed.
+	 * @see the other overload of Alloc() for a description of the return value.
+	 */
+	inline bool Alloc( uint32_t numBuffers, size_t size, RingBufferAllocator* allocator );
+
 	/**
 	 * Free the buffer allocations.
 	 */
@@ -76,13 +113,58 @@ public:
 
 	/**
 	 * Get the next read/write buffer without advancing the position in the queue.
+	 * @param sequence optional output, the sequence number of the buffer (for Write, 
+	 *                 the sequence number that it will have once Next() is called)
 	 */
-	inline void* Peek( uint32_t flags );
+	inline void* Peek( uint32_t flags, uint64_t* sequence=NULL );
 
 	/**
 	 * Get the next read/write buffer and advance the position in the queue.
+	 *
+	 * In LockFree mode, Read returns the buffers in the order they were written, skipping ahead
+	 * to the oldest buffer that hasn't been overwritten yet if the reader fell behind.
+	 *
+	 * @param sequence optional output, the sequence number of the buffer.  Readers can compare
+	 *                 it with the previous one they got to detect buffers that were skipped.
+	 */
+	inline void* Next( uint32_t flags, uint64_t* sequence=NULL );
+
+	/**
+	 * Get the metadata of a buffer returned by Peek() or Next() (or NULL if it isn't one of the buffers).
+	 * The writer should fill it out before calling Next(Write), so that it gets published with the buffer.
+	 */
+	inline Metadata* GetMetadata( void* buffer );
+
+	/**
+	 * Get the number of buffers.
+	 */
+	inline uint32_t GetNumBuffers() const			{ return mNumBuffers; }
+
+	/**
+	 * Get the size of each buffer (in bytes).
+	 */
+	inline size_t GetBufferSize() const			{ return mBufferSize; }
+
+	/**
+	 * Get the buffer at the specified index (for example, to share them with another process).
+	 */
+	inline void* GetBuffer( uint32_t index ) const	{ return (index < mNumBuffers) ? mBuffers[index] : NULL; }
+
+	/**
+	 * Get the allocator of the buffers (or NULL if they haven't been allocated).
 	 */
-	inline void* Next( uint32_t flags );
+	inline RingBufferAllocator* GetAllocator() const	{ return mAllocator; }
+
+	/**
+	 * Get the sequence number of the latest buffer that was written (or 0 if none have been).
+	 */
+	inline uint64_t GetWriteSequence() const;
+
+	/**
+	 * Get the number of buffers that were written but skipped by the reader, either because 
+	 * it read a later buffer with ReadLatest, or because they were overwritten before being read.
+	 */
+	inline uint64_t GetDropped() const;
 
 	/**
 	 * Get the flags of the ring buffer.
@@ -101,6 +183,8 @@ public:
 
 protected:
 
+	inline void updateRead( uint64_t sequence );
+
 	uint32_t mNumBuffers;
 	uint32_t mLatestRead;
 	uint32_t mLatestWrite;
@@ -110,6 +194,17 @@ protected:
 	size_t mBufferSize;
 	bool   mReadOnce;
 	Mutex  mMutex;
+
+	uint64_t* mSequences;		// the sequence number of each buffer
+	Metadata* mMetadata;
+
+	RingBufferAllocator* mAllocator;
+	
+	// the writer and reader positions are kept on separate cache lines
+	std::atomic<uint64_t> mWriteSequence;
+	uint8_t mPadding[64];
+	std::atomic<uint64_t> mReadSequence;
+	std::atomic<uint64_t> mDropped;
 };
 
 // inline implementations
@@ -38,6 +38,13 @@ RingBuffer::RingBuffer( uint32_t flags )
 	mReadOnce = false;
 	mLatestRead = 0;
 	mLatestWrite = 0;
+	mSequences = NULL;
+	mMetadata = NULL;
+	mAllocator = NULL;
+
+	mWriteSequence = 0;
+	mReadSequence = 0;
+	mDropped = 0;
 }
 
 
@@ -51,13 +58,39 @@ RingBuffer::~RingBuffer()
 		free(mBuffers);
 		mBuffers = NULL;
 	}
+
+	if( mSequences != NULL )
+	{
+		free(mSequences);
+		mSequences = NULL;
+	}
+
+	if( mMetadata != NULL )
+	{
+		free(mMetadata);
+		mMetadata = NULL;
+	}
 }
 
 
 // Alloc
 inline bool RingBuffer::Alloc( uint32_t numBuffers, size_t size, uint32_t flags )
 {
-	if( numBuffers == mNumBuffers && size <= mBufferSize && (flags & ZeroCopy) == (mFlags & ZeroCopy) )
+	if( !Alloc(numBuffers, size, (flags & ZeroCopy) ? RingBufferAllocator::Mapped() : RingBufferAllocator::Device()) )
+		return false;
+
+	mFlags |= flags;
+	return true;
+}
+
+
+// Alloc
+inline bool RingBuffer::Alloc( uint32_t numBuffers, size_t size, RingBufferAllocator* allocator )
+{
+	if( !allocator || numBuffers == 0 )
+		return false;
+
+	if( numBuffers == mNumBuffers && size <= mBufferSize && allocator == mAllocator )
 		return true;
 	
 	Free();
@@ -65,7 +98,12 @@ inline bool RingBuffer::Alloc( uint32_t numBuffers, size_t size, uint32_t flags
 	if( mBuffers != NULL && mNumBuffers != numBuffers )
 	{
 		free(mBuffers);
+		free(mSequences);
+		free(mMetadata);
+
 		mBuffers = NULL;
+		mSequences = NULL;
+		mMetadata = NULL;
 	}
 	
 	if( mBuffers == NULL )
@@ -73,34 +111,34 @@ inline bool RingBuffer::Alloc( uint32_t numBuffers, size_t size, uint32_t flags
 		const size_t bufferListSize = numBuffers * sizeof(void*);
 		mBuffers = (void**)malloc(bufferListSize);
 		memset(mBuffers, 0, bufferListSize);
+
+		const size_t sequenceListSize = numBuffers * sizeof(uint64_t);
+		mSequences = (uint64_t*)malloc(sequenceListSize);
+		memset(mSequences, 0, sequenceListSize);
+
+		mMetadata = (Metadata*)malloc(numBuffers * sizeof(Metadata));
 	}
 	
+	memset(mMetadata, 0, numBuffers * sizeof(Metadata));
+
+	mNumBuffers = numBuffers;
+	mBufferSize = size;
+	mAllocator  = allocator;
+
 	for( uint32_t n=0; n < numBuffers; n++ )
 	{
-		if( flags & ZeroCopy )
-		{
-			if( !cudaAllocMapped(&mBuffers[n], size) )
-			{
-				LogError(LOG_CUDA "RingBuffer -- failed to allocate zero-copy buffer of %zu bytes\n", size);
-				return false;
-			}
-		}
-		else
+		mBuffers[n] = allocator->Alloc(size);
+
+		if( !mBuffers[n] )
 		{
-			if( CUDA_FAILED(cudaMalloc(&mBuffers[n], size)) )
-			{
-				LogError(LOG_CUDA "RingBuffer -- failed to allocate CUDA buffer of %zu bytes\n", size);
-				return false;
-			}
+			LogError(LOG_CUDA "RingBuffer -- failed to allocate %s buffer of %zu bytes\n", allocator->GetName(), size);
+			Free();
+			return false;
 		}
 	}
 		
-	LogVerbose(LOG_CUDA "allocated %u ring buffers (%zu bytes each, %zu bytes total)\n", numBuffers, size, size * numBuffers);
-	
-	mNumBuffers = numBuffers;
-	mBufferSize = size;
-	mFlags     |= flags;
-	
+	LogVerbose(LOG_CUDA "allocated %u %s ring buffers (%zu bytes each, %zu bytes total)\n", numBuffers, allocator->GetName(), size, size * numBuffers);
+
 	return true;
 }
 
@@ -108,23 +146,37 @@ inline bool RingBuffer::Alloc( uint32_t numBuffers, size_t size, uint32_t flags
 // Free
 inline void RingBuffer::Free()
 {
-	if( !mBuffers || mNumBuffers == 0 )
+	if( !mBuffers || mNumBuffers == 0 || !mAllocator )
 		return;
 	
 	for( uint32_t n=0; n < mNumBuffers; n++ )
 	{
-		if( mFlags & ZeroCopy )
-			CUDA(cudaFreeHost(mBuffers[n]));
-		else
-			CUDA(cudaFree(mBuffers[n]));
+		if( mBuffers[n] != NULL )
+			mAllocator->Free(mBuffers[n], mBufferSize);
 		
 		mBuffers[n] = NULL;
 	}
+
+	mBufferSize = 0;
+	mAllocator = NULL;
+}
+
+
+// GetMetadata
+inline RingBuffer::Metadata* RingBuffer::GetMetadata( void* buffer )
+{
+	for( uint32_t n=0; n < mNumBuffers; n++ )
+	{
+		if( mBuffers[n] == buffer && buffer != NULL )
+			return mMetadata + n;
+	}
+
+	return NULL;
 }
 
 
 // Peek
-inline void* RingBuffer::Peek( uint32_t flags )
+inline void* RingBuffer::Peek( uint32_t flags, uint64_t* sequence )
 {
 	flags |= mFlags;
 
@@ -134,18 +186,48 @@ inline void* RingBuffer::Peek( uint32_t flags )
 		return NULL;
 	}
 
+	// in lock-free mode, the buffers are indexed by their sequence number
+	if( flags & LockFree )
+	{
+		uint64_t bufferSequence = 0;
+
+		if( flags & Write )
+			bufferSequence = mWriteSequence.load(std::memory_order_relaxed) + 1;	// only the writer changes it
+		else if( flags & ReadLatest )
+			bufferSequence = mWriteSequence.load(std::memory_order_acquire);
+		else if( flags & Read )
+			bufferSequence = mReadSequence.load(std::memory_order_relaxed);
+		else
+		{
+			LogError(LOG_CUDA "RingBuffer::Peek() -- error, invalid flags (must be Write or Read flags)\n");
+			return NULL;
+		}
+
+		if( sequence != NULL )
+			*sequence = bufferSequence;
+
+		return mBuffers[bufferSequence % mNumBuffers];
+	}
+
 	if( flags & Threaded )
 		mMutex.Lock();
 
 	int bufferIndex = -1;
+	uint64_t bufferSequence = 0;
 
 	if( flags & Write )
+	{
 		bufferIndex = (mLatestWrite + 1) % mNumBuffers;
+		bufferSequence = mWriteSequence.load(std::memory_order_relaxed) + 1;
+	}
 	else if( flags & ReadLatest )
 		bufferIndex = mLatestWrite;
 	else if( flags & Read )
 		bufferIndex = mLatestRead;
 	
+	if( bufferIndex >= 0 && !(flags & Write) )
+		bufferSequence = mSequences[bufferIndex];
+
 	if( flags & Threaded )
 		mMutex.Unlock();
 
@@ -155,12 +237,15 @@ inline void* RingBuffer::Peek( uint32_t flags )
 		return NULL;
 	}
 
+	if( sequence != NULL )
+		*sequence = bufferSequence;
+
 	return mBuffers[bufferIndex];
 }
 
 
 // Next
-inline void* RingBuffer::Next( uint32_t flags )
+inline void* RingBuffer::Next( uint32_t flags, uint64_t* sequence )
 {
 	flags |= mFlags;
 
@@ -170,16 +255,70 @@ inline void* RingBuffer::Next( uint32_t flags )
 		return NULL;
 	}
 
+	// in lock-free mode, the writer only changes the write sequence and the reader only changes 
+	// the read sequence, so the release/acquire pair on the write sequence is the only ordering needed
+	if( flags & LockFree )
+	{
+		uint64_t bufferSequence = 0;
+
+		if( flags & Write )
+		{
+			bufferSequence = mWriteSequence.load(std::memory_order_relaxed) + 1;
+			mSequences[bufferSequence % mNumBuffers] = bufferSequence;
+
+			// publish the contents of the buffer that were written since Peek()
+			mWriteSequence.store(bufferSequence, std::memory_order_release);
+		}
+		else if( flags & Read )
+		{
+			const uint64_t latestWrite = mWriteSequence.load(std::memory_order_acquire);
+			const uint64_t latestRead = mReadSequence.load(std::memory_order_relaxed);
+
+			if( (flags & ReadOnce) && latestRead >= latestWrite )
+				return NULL;
+
+			if( flags & ReadLatest )
+			{
+				bufferSequence = latestWrite;
+			}
+			else
+			{
+				bufferSequence = latestRead + 1;
+
+				// skip ahead if the buffer was overwritten (the one after the latest may be getting written now)
+				if( latestWrite >= mNumBuffers && bufferSequence < latestWrite - mNumBuffers + 2 )
+					bufferSequence = latestWrite - mNumBuffers + 2;
+			}
+
+			updateRead(bufferSequence);
+		}
+		else
+		{
+			LogError(LOG_CUDA "RingBuffer::Next() -- error, invalid flags (must be Write or Read flags)\n");
+			return NULL;
+		}
+
+		if( sequence != NULL )
+			*sequence = bufferSequence;
+
+		return mBuffers[bufferSequence % mNumBuffers];
+	}
+
 	if( flags & Threaded )
 		mMutex.Lock();
 
 	int bufferIndex = -1;
+	uint64_t bufferSequence = 0;
 
 	if( flags & Write )
 	{
 		mLatestWrite = (mLatestWrite + 1) % mNumBuffers;
 		bufferIndex  = mLatestWrite;
 		mReadOnce    = false;
+
+		bufferSequence = mWriteSequence.load(std::memory_order_relaxed) + 1;
+		mSequences[bufferIndex] = bufferSequence;
+		mWriteSequence.store(bufferSequence, std::memory_order_release);
 	}
 	else if( (flags & ReadOnce) && mReadOnce )
 	{
@@ -201,6 +340,12 @@ inline void* RingBuffer::Next( uint32_t flags )
 		mReadOnce   = true;
 	}
 	
+	if( bufferIndex >= 0 && !(flags & Write) )
+	{
+		bufferSequence = mSequences[bufferIndex];
+		updateRead(bufferSequence);
+	}
+
 	if( flags & Threaded )
 		mMutex.Unlock();
 
@@ -210,10 +355,42 @@ inline void* RingBuffer::Next( uint32_t flags )
 		return NULL;
 	}
 
+	if( sequence != NULL )
+		*sequence = bufferSequence;
+
 	return mBuffers[bufferIndex];
 }
 
 
+// updateRead
+inline void RingBuffer::updateRead( uint64_t sequence )
+{
+	const uint64_t latestRead = mReadSequence.load(std::memory_order_relaxed);
+
+	if( sequence <= latestRead )
+		return;
+
+	if( sequence > latestRead + 1 )
+		mDropped.fetch_add(sequence - latestRead - 1, std::memory_order_relaxed);
+
+	mReadSequence.store(sequence, std::memory_order_relaxed);
+}
+
+
+// GetWriteSequence
+inline uint64_t RingBuffer::GetWriteSequence() const
+{
+	return mWriteSequence.load(std::memory_order_acquire);
+}
+
+
+// GetDropped
+inline uint64_t RingBuffer::GetDropped() const
+{
+	return mDropped.load(std::memory_order_relaxed);
+}
+
+
 // GetFlags
 inline uint32_t RingBuffer::GetFlags() const
 {
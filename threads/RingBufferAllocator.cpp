@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "RingBufferAllocator.h"
+
+#include "cudaMappedMemory.h"
+#include "logging.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+
+// registerCUDA (page-lock host memory and map it into the GPU's address space)
+static bool registerCUDA( void* ptr, size_t size, const char* allocator )
+{
+	if( CUDA_FAILED(cudaHostRegister(ptr, size, cudaHostRegisterMapped)) )
+	{
+		LogError(LOG_CUDA "RingBuffer -- failed to register %zu bytes of %s memory with CUDA\n", size, allocator);
+		return false;
+	}
+
+	return true;
+}
+
+
+//----------------------------------------------------------------------------
+// Built-in CUDA allocators
+//----------------------------------------------------------------------------
+class MappedAllocator : public RingBufferAllocator
+{
+public:
+	virtual void* Alloc( size_t size )
+	{
+		void* ptr = NULL;
+
+		if( !cudaAllocMapped(&ptr, size) )
+			return NULL;
+
+		return ptr;
+	}
+
+	virtual void Free( void* ptr, size_t size )
+	{
+		CUDA(cudaFreeHost(ptr));
+	}
+
+	virtual const char* GetName() const		{ return "zeroCopy"; }
+};
+
+class DeviceAllocator : public RingBufferAllocator
+{
+public:
+	virtual void* Alloc( size_t size )
+	{
+		void* ptr = NULL;
+
+		if( CUDA_FAILED(cudaMalloc(&ptr, size)) )
+			return NULL;
+
+		return ptr;
+	}
+
+	virtual void Free( void* ptr, size_t size )
+	{
+		CUDA(cudaFree(ptr));
+	}
+
+	virtual const char* GetName() const		{ return "CUDA"; }
+};
+
+
+// Mapped
+RingBufferAllocator* RingBufferAllocator::Mapped()
+{
+	static MappedAllocator allocator;
+	return &allocator;
+}
+
+
+// Device
+RingBufferAllocator* RingBufferAllocator::Device()
+{
+	static DeviceAllocator allocator;
+	return &allocator;
+}
+
+
+//----------------------------------------------------------------------------
+// HostAllocator
+//----------------------------------------------------------------------------
+HostAllocator::HostAllocator( size_t alignment )
+{
+	mAlignment = alignment;
+
+	if( mAlignment < sizeof(void*) || (mAlignment & (mAlignment - 1)) != 0 )
+	{
+		LogWarning(LOG_CUDA "HostAllocator -- invalid alignment of %zu bytes, using %zu instead\n", alignment, sizeof(void*));
+		mAlignment = sizeof(void*);
+	}
+}
+
+
+// Alloc
+void* HostAllocator::Alloc( size_t size )
+{
+	void* ptr = NULL;
+
+	if( posix_memalign(&ptr, mAlignment, size) != 0 )
+		return NULL;
+
+	return ptr;
+}
+
+
+// Free
+void HostAllocator::Free( void* ptr, size_t size )
+{
+	free(ptr);
+}
+
+
+//----------------------------------------------------------------------------
+// HugePageAllocator
+//----------------------------------------------------------------------------
+HugePageAllocator::HugePageAllocator( bool cudaRegister )
+{
+	mRegister = cudaRegister;
+}
+
+
+// Alloc
+void* HugePageAllocator::Alloc( size_t size )
+{
+	const size_t mapSize = ((size + PageSize - 1) / PageSize) * PageSize;
+
+	bool hugeTLB = true;
+	void* ptr = mmap(NULL, mapSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+
+	// fall back to transparent huge pages if none are reserved
+	if( ptr == MAP_FAILED )
+	{
+		hugeTLB = false;
+		ptr = mmap(NULL, mapSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+		if( ptr == MAP_FAILED )
+		{
+			LogError(LOG_CUDA "HugePageAllocator -- failed to map %zu bytes\n", mapSize);
+			return NULL;
+		}
+
+		madvise(ptr, mapSize, MADV_HUGEPAGE);
+	}
+
+	if( mRegister && !registerCUDA(ptr, mapSize, GetName()) )
+	{
+		munmap(ptr, mapSize);
+		return NULL;
+	}
+
+	LogVerbose(LOG_CUDA "HugePageAllocator -- mapped %zu bytes (%s)\n", mapSize, hugeTLB ? "MAP_HUGETLB" : "transparent huge pages");
+	return ptr;
+}
+
+
+// Free
+void HugePageAllocator::Free( void* ptr, size_t size )
+{
+	if( !ptr )
+		return;
+
+	if( mRegister )
+		CUDA(cudaHostUnregister(ptr));
+
+	munmap(ptr, ((size + PageSize - 1) / PageSize) * PageSize);
+}
+
+
+//----------------------------------------------------------------------------
+// SharedMemoryAllocator
+//----------------------------------------------------------------------------
+SharedMemoryAllocator::SharedMemoryAllocator( const char* name, bool cudaRegister )
+{
+	strncpy(mName, name != NULL ? name : "ringbuffer", sizeof(mName) - 1);
+	mName[sizeof(mName) - 1] = '\0';
+
+	mRegister = cudaRegister;
+}
+
+
+// Alloc
+void* SharedMemoryAllocator::Alloc( size_t size )
+{
+	// memfd_create() is called through syscall() since older glibc versions don't wrap it
+	const int fd = syscall(SYS_memfd_create, mName, MFD_CLOEXEC);
+
+	if( fd < 0 )
+	{
+		LogError(LOG_CUDA "SharedMemoryAllocator -- memfd_create() failed\n");
+		return NULL;
+	}
+
+	if( ftruncate(fd, size) != 0 )
+	{
+		LogError(LOG_CUDA "SharedMemoryAllocator -- failed to resize memory file to %zu bytes\n", size);
+		close(fd);
+		return NULL;
+	}
+
+	void* ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if( ptr == MAP_FAILED )
+	{
+		LogError(LOG_CUDA "SharedMemoryAllocator -- failed to map %zu bytes\n", size);
+		close(fd);
+		return NULL;
+	}
+
+	if( mRegister && !registerCUDA(ptr, size, GetName()) )
+	{
+		munmap(ptr, size);
+		close(fd);
+		return NULL;
+	}
+
+	mMutex.Lock();
+	mFiles[ptr] = fd;
+	mMutex.Unlock();
+
+	return ptr;
+}
+
+
+// Free
+void SharedMemoryAllocator::Free( void* ptr, size_t size )
+{
+	if( !ptr )
+		return;
+
+	const int fd = GetFD(ptr);
+
+	mMutex.Lock();
+	mFiles.erase(ptr);
+	mMutex.Unlock();
+
+	if( mRegister )
+		CUDA(cudaHostUnregister(ptr));
+
+	munmap(ptr, size);
+
+	if( fd >= 0 )
+		close(fd);
+}
+
+
+// GetFD
+int SharedMemoryAllocator::GetFD( void* ptr )
+{
+	int fd = -1;
+
+	mMutex.Lock();
+
+	std::map<void*, int>::const_iterator iter = mFiles.find(ptr);
+
+	if( iter != mFiles.end() )
+		fd = iter->second;
+
+	mMutex.Unlock();
+	return fd;
+}
+
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MULTITHREAD_RINGBUFFER_ALLOCATOR_H_
+#define __MULTITHREAD_RINGBUFFER_ALLOCATOR_H_
+
+#include "Mutex.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+
+
+/**
+ * Interface for the memory that RingBuffer allocates its buffers from.
+ * The built-in allocators are singletons returned by the static functions,
+ * while allocators with options (like HostAllocator) get created by the user,
+ * and need to stay alive for as long as the ring buffers that use them.
+ * @ingroup threads
+ */
+class RingBufferAllocator
+{
+public:
+	/**
+	 * Destructor
+	 */
+	virtual ~RingBufferAllocator()		{ }
+
+	/**
+	 * Allocate a buffer of the specified size, or return NULL on error.
+	 */
+	virtual void* Alloc( size_t size ) = 0;
+
+	/**
+	 * Free a buffer that was returned by Alloc() (with the same size that it was allocated with).
+	 */
+	virtual void Free( void* ptr, size_t size ) = 0;
+
+	/**
+	 * Get the name of the allocator (for logging).
+	 */
+	virtual const char* GetName() const = 0;
+
+	/**
+	 * Mapped CPU/GPU zeroCopy memory from cudaAllocMapped() (used for RingBuffer::ZeroCopy).
+	 */
+	static RingBufferAllocator* Mapped();
+
+	/**
+	 * GPU memory from cudaMalloc() (used by default).
+	 */
+	static RingBufferAllocator* Device();
+};
+
+
+/**
+ * Host memory aligned to a power-of-two boundary (for systems without a GPU,
+ * or for CPU-only stages of a pipeline).
+ * @ingroup threads
+ */
+class HostAllocator : public RingBufferAllocator
+{
+public:
+	/**
+	 * Constructor
+	 * @param alignment the alignment of the buffers in bytes (a power of two, at least the size of a pointer)
+	 */
+	HostAllocator( size_t alignment=64 );
+
+	virtual void* Alloc( size_t size );
+	virtual void Free( void* ptr, size_t size );
+	virtual const char* GetName() const		{ return "host"; }
+
+protected:
+	size_t mAlignment;
+};
+
+
+/**
+ * Host memory backed by huge pages, which reduces TLB misses when large buffers get streamed through.
+ * Explicit huge pages (`MAP_HUGETLB`) are used if they're reserved on the system (see `/proc/sys/vm/nr_hugepages`),
+ * otherwise this falls back to regular pages with transparent huge pages requested through `madvise()`.
+ * @ingroup threads
+ */
+class HugePageAllocator : public RingBufferAllocator
+{
+public:
+	/**
+	 * Constructor
+	 * @param cudaRegister if true, the buffers are page-locked and mapped into the GPU's address space with 
+	 *                     cudaHostRegister(), so they can be accessed by CUDA kernels like zeroCopy memory.
+	 */
+	HugePageAllocator( bool cudaRegister=false );
+
+	virtual void* Alloc( size_t size );
+	virtual void Free( void* ptr, size_t size );
+	virtual const char* GetName() const		{ return "hugepage"; }
+
+	/**
+	 * The size of the huge pages that the allocations are rounded up to (2MB).
+	 */
+	static const size_t PageSize = 2 * 1024 * 1024;
+
+protected:
+	bool mRegister;
+};
+
+
+/**
+ * Shareable host memory backed by anonymous memory files (`memfd_create()`).
+ * The file descriptor of each buffer can be passed to another process (for example over a 
+ * UNIX domain socket), which can then `mmap()` the same memory without any copies.
+ * @ingroup threads
+ */
+class SharedMemoryAllocator : public RingBufferAllocator
+{
+public:
+	/**
+	 * Constructor
+	 * @param name the name of the memory files (only used for debugging, it shows up in `/proc/<pid>/fd`)
+	 * @param cudaRegister if true, the buffers are also mapped into the GPU's address space with cudaHostRegister().
+	 */
+	SharedMemoryAllocator( const char* name="ringbuffer", bool cudaRegister=false );
+
+	virtual void* Alloc( size_t size );
+	virtual void Free( void* ptr, size_t size );
+	virtual const char* GetName() const		{ return "shared"; }
+
+	/**
+	 * Get the file descriptor of a buffer, or -1 if it wasn't allocated by this allocator.
+	 */
+	int GetFD( void* ptr );
+
+protected:
+	char  mName[64];
+	bool  mRegister;
+	Mutex mMutex;
+	std::map<void*, int> mFiles;
+};
+
+#endif
+
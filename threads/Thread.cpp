@@ -225,7 +225,7 @@ void Thread::InitRealtime()
 // Yield
 void Thread::Yield( unsigned int ms )
 {
-	sleep(ms);
+	usleep(ms * 1000);
 }
 
 
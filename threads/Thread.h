@@ -117,6 +117,7 @@ public:
 	/**
 	 * Whatever thread you are calling from, yield the processor for the specified number of milliseconds.
 	 * Accuracy may vary wildly the lower you go, and depending on the platform.
+	 * To run something at a fixed rate, use PeriodicTask instead.
 	 */
 	static void Yield( unsigned int ms );
 
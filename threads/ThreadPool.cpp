@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ThreadPool.h"
+
+#include <unistd.h>
+#include <sched.h>
+
+#include "logging.h"
+
+
+// the pool and worker index of the calling thread (if it's a worker)
+static __thread ThreadPool* currentPool = NULL;
+static __thread int currentWorker = -1;
+
+
+// constructor
+ThreadPool::ThreadPool( uint32_t numThreads, bool pinCPU, int priority )
+{
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if( numThreads == 0 )
+		numThreads = (cpus > 1) ? cpus - 1 : 1;
+
+	mQueued    = 0;
+	mSleeping  = 0;
+	mNextQueue = 0;
+	mStolen    = 0;
+	mStop      = false;
+	mPinCPU    = pinCPU;
+	mPriority  = priority;
+
+	for( uint32_t n=0; n < numThreads; n++ )
+		mQueues.push_back(new Queue());
+
+	for( uint32_t n=0; n < numThreads; n++ )
+	{
+		Worker* worker = new Worker(this, n);
+
+		if( !worker->Start() )
+		{
+			LogError("ThreadPool -- failed to start worker thread %u\n", n);
+			delete worker;
+			break;
+		}
+
+		mWorkers.push_back(worker);
+	}
+
+	// only queue tasks for the workers that started
+	while( mQueues.size() > mWorkers.size() )
+	{
+		delete mQueues.back();
+		mQueues.pop_back();
+	}
+}
+
+
+// destructor
+ThreadPool::~ThreadPool()
+{
+	mStop = true;
+	mWake.Wake();
+
+	// join the workers directly, because Thread::Stop() skips the join if the
+	// worker already returned from Run() (and it could still be in mWake.Wake())
+	for( size_t n=0; n < mWorkers.size(); n++ )
+	{
+		pthread_join(*mWorkers[n]->GetThreadID(), NULL);
+		delete mWorkers[n];
+	}
+
+	for( size_t n=0; n < mQueues.size(); n++ )
+		delete mQueues[n];
+}
+
+
+// Global
+ThreadPool* ThreadPool::Global()
+{
+	static ThreadPool pool;
+	return &pool;
+}
+
+
+// Enqueue
+void ThreadPool::Enqueue( TaskFunction func, void* param )
+{
+	if( !func )
+		return;
+
+	const uint32_t numQueues = mQueues.size();
+
+	if( numQueues == 0 )
+	{
+		func(param);
+		return;
+	}
+
+	// workers push onto their own queue, other threads distribute round-robin
+	const uint32_t index = (currentPool == this) ? currentWorker : (mNextQueue++ % numQueues);
+
+	Task task;
+	
+	task.func  = func;
+	task.param = param;
+
+	Queue* queue = mQueues[index];
+
+	queue->mutex.Lock();
+	queue->tasks.push_back(task);
+	queue->mutex.Unlock();
+
+	mQueued++;
+
+	if( mSleeping > 0 )
+		mWake.Wake();
+}
+
+
+// next
+bool ThreadPool::next( int worker, Task* task )
+{
+	const int numQueues = mQueues.size();
+
+	if( numQueues == 0 )
+		return false;
+
+	bool found = false;
+
+	// first check the worker's own queue (newest task first)
+	if( worker >= 0 )
+	{
+		Queue* queue = mQueues[worker];
+
+		queue->mutex.Lock();
+
+		if( !queue->tasks.empty() )
+		{
+			*task = queue->tasks.back();
+			queue->tasks.pop_back();
+			found = true;
+		}
+
+		queue->mutex.Unlock();
+	}
+
+	// then steal the oldest task from another queue
+	for( int n=1; n <= numQueues && !found; n++ )
+	{
+		const int index = (worker + n) % numQueues;
+
+		if( index == worker || mQueued == 0 )
+			break;
+
+		Queue* queue = mQueues[index];
+
+		queue->mutex.Lock();
+
+		if( !queue->tasks.empty() )
+		{
+			*task = queue->tasks.front();
+			queue->tasks.pop_front();
+			found = true;
+		}
+
+		queue->mutex.Unlock();
+
+		if( found && worker >= 0 )
+			mStolen++;
+	}
+
+	if( !found )
+		return false;
+
+	// events only wake one thread, so pass it on if there's more work
+	if( --mQueued > 0 && mSleeping > 0 )
+		mWake.Wake();
+
+	return true;
+}
+
+
+// RunPending
+bool ThreadPool::RunPending()
+{
+	Task task;
+
+	if( !next((currentPool == this) ? currentWorker : -1, &task) )
+		return false;
+
+	task.func(task.param);
+	return true;
+}
+
+
+// wait
+void ThreadPool::wait( TaskGroup* group )
+{
+	// run queued tasks while the group is still in progress, and sleep once
+	// the rest of the group's tasks have been picked up by other threads
+	while( group->pending > 0 )
+	{
+		if( !RunPending() && group->pending > 0 )
+			group->done.Wait();
+	}
+
+	// the group lives on the caller's stack, so it can't go away while the last task is still in Wake()
+	while( !group->finished )
+		sched_yield();
+}
+
+
+// Run
+void ThreadPool::Worker::Run()
+{
+	currentPool = mPool;
+	currentWorker = mIndex;
+
+	// SetAffinity() and SetPriority() print an error if they fail
+	if( mPool->mPinCPU )
+	{
+		const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		LockAffinity(mIndex % ((cpus > 0) ? cpus : 1));
+	}
+
+	if( mPool->mPriority > 0 )
+		SetPriorityLevel(mPool->mPriority);
+
+	while( true )
+	{
+		Task task;
+
+		if( mPool->next(mIndex, &task) )
+		{
+			task.func(task.param);
+			continue;
+		}
+
+		// the queues are drained before exiting
+		if( mPool->mStop )
+			break;
+
+		mPool->mSleeping++;
+
+		if( mPool->mQueued == 0 && !mPool->mStop )
+			mPool->mWake.Wait();
+
+		mPool->mSleeping--;
+	}
+
+	// wake up the next worker so it exits too
+	mPool->mWake.Wake();
+}
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MULTITHREAD_THREAD_POOL_H_
+#define __MULTITHREAD_THREAD_POOL_H_
+
+#include "Thread.h"
+#include "Event.h"
+#include "Mutex.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <vector>
+
+
+/**
+ * Work-stealing thread pool for running host tasks in parallel.
+ *
+ * Each worker thread has its own task deque.  Workers run the tasks they queue from their own
+ * deque in LIFO order (which keeps nested work cache-friendly), and when it's empty they steal
+ * the oldest tasks from the other workers.  Tasks submitted from outside the pool are distributed
+ * round-robin across the workers.  Threads that wait for tasks to complete (in ParallelFor() or
+ * Future::Wait()) run other queued tasks while they wait, so tasks can safely submit more tasks.
+ *
+ * The library's CPU code paths share the Global() pool (see ParallelFor.h), so that running
+ * several pipelines at once doesn't oversubscribe the cores.  Other pools can be created with
+ * their workers pinned to CPU cores or running at a realtime priority level.
+ *
+ * @ingroup threads
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * Task entry function, called with the user parameter that was passed to Enqueue().
+	 */
+	typedef void (*TaskFunction)( void* param );
+
+	/**
+	 * Handle to the result of a task that was submitted with Submit().
+	 */
+	template<typename R> class Future
+	{
+	public:
+		Future() : mPool(NULL) {}
+		Future( ThreadPool* pool, std::future<R>&& future ) : mPool(pool), mFuture(std::move(future)) {}
+
+		/**
+		 * Return true if this future refers to a task.
+		 */
+		inline bool IsValid() const	{ return mFuture.valid(); }
+
+		/**
+		 * Return true if the task has completed.
+		 */
+		inline bool IsReady() const	{ return mFuture.valid() && mFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+
+		/**
+		 * Wait for the task to complete, running other tasks from the pool in the meantime.
+		 */
+		inline void Wait()			{ if( !mFuture.valid() ) return; while( !IsReady() ) { if( !mPool->RunPending() ) mFuture.wait_for(std::chrono::microseconds(100)); } }
+
+		/**
+		 * Wait for the task to complete and return its result.  This can only be called once.
+		 */
+		inline R Get()				{ Wait(); return mFuture.get(); }
+
+	protected:
+		ThreadPool* mPool;
+		std::future<R> mFuture;
+	};
+
+	/**
+	 * Create a thread pool.
+	 * @param numThreads the number of worker threads (or if 0, one less than the number of CPU cores,
+	 *                   since the threads waiting on the pool also run tasks).
+	 * @param pinCPU if true, lock each worker thread to a CPU core with Thread::SetAffinity()
+	 * @param priority if positive, set the realtime priority level of the workers with Thread::SetPriorityLevel()
+	 */
+	ThreadPool( uint32_t numThreads=0, bool pinCPU=false, int priority=0 );
+
+	/**
+	 * Destructor.  Waits for the worker threads to finish their queued tasks and exit.
+	 */
+	~ThreadPool();
+
+	/**
+	 * Get the pool that's shared by the library's CPU code paths (it's created on first use).
+	 */
+	static ThreadPool* Global();
+
+	/**
+	 * Queue a task to be run by one of the workers.
+	 */
+	void Enqueue( TaskFunction func, void* param=NULL );
+
+	/**
+	 * Queue a function object to be run by one of the workers, and return a Future for its result.
+	 */
+	template<typename F>
+	auto Submit( const F& func ) -> Future<decltype(func())>;
+
+	/**
+	 * Split the range `[0,count)` into chunks and process them in parallel, calling `func(begin, end)`
+	 * once per chunk.  The calling thread also processes chunks, and returns after all of them are done.
+	 * Each chunk will contain at least `minChunk` items (so small ranges don't pay the cost of extra threads).
+	 */
+	template<typename F>
+	void ParallelFor( uint32_t count, const F& func, uint32_t minChunk=1 );
+
+	/**
+	 * Split an image into tiles and process them in parallel, calling `func(x0, y0, x1, y1)` once per tile
+	 * with the tile's pixel bounds `[x0,x1) x [y0,y1)`.  Returns after all of the tiles are done.
+	 */
+	template<typename F>
+	void ParallelFor2D( uint32_t width, uint32_t height, uint32_t tileWidth, uint32_t tileHeight, const F& func );
+
+	/**
+	 * Run one queued task on the calling thread, if there are any.
+	 * @returns true if a task was run, or false if the queues were empty.
+	 */
+	bool RunPending();
+
+	/**
+	 * Get the number of worker threads.
+	 */
+	inline uint32_t GetNumThreads() const		{ return mWorkers.size(); }
+
+	/**
+	 * Get the number of tasks that are queued and haven't started running yet.
+	 */
+	inline uint32_t GetNumQueued() const		{ return mQueued.load(); }
+
+	/**
+	 * Get the total number of tasks that workers stole from other workers.
+	 */
+	inline uint64_t GetNumStolen() const		{ return mStolen.load(); }
+
+protected:
+	struct Task
+	{
+		TaskFunction func;
+		void* param;
+	};
+
+	struct TaskGroup
+	{
+		std::atomic<uint32_t> pending;
+		std::atomic<bool> finished;	// set after the last task is done with the event
+		Event done;
+
+		inline void Finish()	{ if( --pending == 0 ) { done.Wake(); finished = true; } }
+	};
+
+	struct Queue
+	{
+		Mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	class Worker : public Thread
+	{
+	public:
+		Worker( ThreadPool* pool, uint32_t index ) : mPool(pool), mIndex(index) {}
+		virtual void Run();
+
+	protected:
+		ThreadPool* mPool;
+		uint32_t mIndex;
+	};
+
+	bool next( int worker, Task* task );
+	void wait( TaskGroup* group );
+
+	std::vector<Worker*> mWorkers;
+	std::vector<Queue*>  mQueues;
+
+	std::atomic<uint32_t> mQueued;
+	std::atomic<uint32_t> mSleeping;
+	std::atomic<uint32_t> mNextQueue;
+	std::atomic<uint64_t> mStolen;
+	std::atomic<bool>     mStop;
+
+	Event mWake;
+
+	bool mPinCPU;
+	int  mPriority;
+};
+
+
+// Submit
+template<typename F>
+auto ThreadPool::Submit( const F& func ) -> Future<decltype(func())>
+{
+	typedef decltype(func()) R;
+
+	struct Job
+	{
+		std::packaged_task<R()> task;
+
+		Job( const F& func ) : task(func) {}
+
+		static void Entry( void* param )
+		{
+			Job* job = (Job*)param;
+			job->task();
+			delete job;
+		}
+	};
+
+	Job* job = new Job(func);
+	Future<R> future(this, job->task.get_future());
+
+	Enqueue(&Job::Entry, job);
+	return future;
+}
+
+
+// ParallelFor
+template<typename F>
+void ThreadPool::ParallelFor( uint32_t count, const F& func, uint32_t minChunk )
+{
+	if( count == 0 )
+		return;
+
+	if( minChunk == 0 )
+		minChunk = 1;
+
+	// use a few chunks per thread, so the load balances out when some chunks take longer
+	uint32_t numChunks = (GetNumThreads() + 1) * 4;
+
+	if( GetNumThreads() == 0 )
+		numChunks = 1;
+
+	if( numChunks > count / minChunk )
+		numChunks = count / minChunk;
+
+	if( numChunks <= 1 )
+	{
+		func(0, count);
+		return;
+	}
+
+	struct Chunk
+	{
+		const F* func;
+		TaskGroup* group;
+		uint32_t begin;
+		uint32_t end;
+
+		static void Entry( void* param )
+		{
+			Chunk* chunk = (Chunk*)param;
+			(*chunk->func)(chunk->begin, chunk->end);
+			chunk->group->Finish();
+		}
+	};
+
+	Chunk* chunks = new Chunk[numChunks];
+
+	TaskGroup group;
+	group.pending  = numChunks - 1;
+	group.finished = false;
+
+	const uint32_t chunkSize = count / numChunks;
+	const uint32_t remainder = count % numChunks;
+
+	uint32_t begin = 0;
+
+	for( uint32_t n=0; n < numChunks; n++ )
+	{
+		chunks[n].func  = &func;
+		chunks[n].group = &group;
+		chunks[n].begin = begin;
+		chunks[n].end   = begin + chunkSize + ((n < remainder) ? 1 : 0);
+
+		begin = chunks[n].end;
+	}
+
+	// queue the other chunks, and process the first one on this thread
+	for( uint32_t n=1; n < numChunks; n++ )
+		Enqueue(&Chunk::Entry, &chunks[n]);
+
+	func(chunks[0].begin, chunks[0].end);
+
+	wait(&group);
+	delete[] chunks;
+}
+
+
+// ParallelFor2D
+template<typename F>
+void ThreadPool::ParallelFor2D( uint32_t width, uint32_t height, uint32_t tileWidth, uint32_t tileHeight, const F& func )
+{
+	if( width == 0 || height == 0 )
+		return;
+
+	if( tileWidth == 0 || tileWidth > width )
+		tileWidth = width;
+
+	if( tileHeight == 0 || tileHeight > height )
+		tileHeight = height;
+
+	const uint32_t tilesX = (width + tileWidth - 1) / tileWidth;
+	const uint32_t tilesY = (height + tileHeight - 1) / tileHeight;
+
+	ParallelFor(tilesX * tilesY, [&](uint32_t begin, uint32_t end)
+	{
+		for( uint32_t n=begin; n < end; n++ )
+		{
+			const uint32_t x0 = (n % tilesX) * tileWidth;
+			const uint32_t y0 = (n / tilesX) * tileHeight;
+			const uint32_t x1 = (x0 + tileWidth < width) ? x0 + tileWidth : width;
+			const uint32_t y1 = (y0 + tileHeight < height) ? y0 + tileHeight : height;
+
+			func(x0, y0, x1, y1);
+		}
+	});
+}
+
+#endif
@@ -24,4 +24,53 @@
 
 
 // reference timestamp of when the process started
-const timespec __apptime_begin__ = timestamp();
+const timespec __apptime_begin__ = timeMonotonic();
+
+
+// calibrateTicks
+static uint64_t calibrateTicks()
+{
+#if defined(__aarch64__)
+	uint64_t frequency;
+	asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+	return frequency;
+#elif defined(__x86_64__) || defined(__i386__)
+	// measure the TSC against the raw monotonic clock
+	const uint64_t ticksBegin = timeTicks();
+	const uint64_t timeBegin  = timeNs(CLOCK_MONOTONIC_RAW);
+
+	sleepMs(10);
+
+	const uint64_t ticksEnd = timeTicks();
+	const uint64_t timeEnd  = timeNs(CLOCK_MONOTONIC_RAW);
+
+	if( timeEnd <= timeBegin || ticksEnd <= ticksBegin )
+		return 1000000000;
+
+	return (uint64_t)((double)(ticksEnd - ticksBegin) * 1000000000.0 / (double)(timeEnd - timeBegin));
+#else
+	return 1000000000;	// timeTicks() falls back to nanoseconds
+#endif
+}
+
+
+// timeTicksFrequency
+uint64_t timeTicksFrequency()
+{
+	static const uint64_t frequency = calibrateTicks();
+	return frequency;
+}
+
+
+// timeTicksToNs
+uint64_t timeTicksToNs( uint64_t ticks )
+{
+#if defined(__SIZEOF_INT128__)
+	// fixed-point 32.32 multiplier, so the conversion is a multiply and shift
+	static const uint64_t scale = (uint64_t)(((unsigned __int128)1000000000 << 32) / timeTicksFrequency());
+	return (uint64_t)(((unsigned __int128)ticks * scale) >> 32);
+#else
+	static const double scale = 1000000000.0 / (double)timeTicksFrequency();
+	return (uint64_t)((double)ticks * scale);
+#endif
+}
@@ -31,7 +31,9 @@
 
 
 /**
- * Retrieve a timestamp of the current system time.
+ * Retrieve a timestamp of the current system time (wall-clock `CLOCK_REALTIME`).
+ * This can jump when the system time is changed (for example by NTP), so use
+ * timeMonotonic() or timeNs() instead for measuring intervals and latencies.
  * @ingroup time
  */
 inline void timestamp( timespec* timestampOut )					{ if(!timestampOut) return; timestampOut->tv_sec=0; timestampOut->tv_nsec=0; clock_gettime(CLOCK_REALTIME, timestampOut); } 
@@ -42,6 +44,103 @@ inline void timestamp( timespec* timestampOut )					{ if(!timestampOut) return;
  */
 inline timespec timestamp()									{ timespec t; timestamp(&t); return t; }
 
+/**
+ * Retrieve a timestamp of the `CLOCK_MONOTONIC` clock, which isn't affected by changes to
+ * the system time.  Use this for deadlines, intervals, and latency measurements.
+ * @ingroup time
+ */
+inline timespec timeMonotonic()								{ timespec t; t.tv_sec=0; t.tv_nsec=0; clock_gettime(CLOCK_MONOTONIC, &t); return t; }
+
+/**
+ * Convert a timespec to an integer number of nanoseconds.
+ * @ingroup time
+ */
+inline uint64_t timeToNs( const timespec& a )					{ return (uint64_t)a.tv_sec * uint64_t(1000000000) + (uint64_t)a.tv_nsec; }
+
+/**
+ * Convert an integer number of nanoseconds to a timespec.
+ * @ingroup time
+ */
+inline timespec timeFromNs( uint64_t nanoseconds )				{ timespec t; t.tv_sec=nanoseconds / 1000000000; t.tv_nsec=nanoseconds % 1000000000; return t; }
+
+/**
+ * Retrieve the current time of a clock in nanoseconds.
+ *
+ * By default this uses `CLOCK_MONOTONIC`, which is the timebase of frame timestamps
+ * and isn't affected by the system time being set.  `CLOCK_MONOTONIC_RAW` is also
+ * not slewed by NTP frequency adjustments, and `CLOCK_REALTIME` is the wall-clock.
+ *
+ * @ingroup time
+ */
+inline uint64_t timeNs( clockid_t clock=CLOCK_MONOTONIC )		{ timespec t; t.tv_sec=0; t.tv_nsec=0; clock_gettime(clock, &t); return timeToNs(t); }
+
+/**
+ * Retrieve the current time of a clock in microseconds.
+ * @see timeNs()
+ * @ingroup time
+ */
+inline uint64_t timeUs( clockid_t clock=CLOCK_MONOTONIC )		{ return timeNs(clock) / 1000; }
+
+/**
+ * Retrieve the current time of a clock in milliseconds.
+ * @see timeNs()
+ * @ingroup time
+ */
+inline uint64_t timeMs( clockid_t clock=CLOCK_MONOTONIC )		{ return timeNs(clock) / 1000000; }
+
+/**
+ * Convert a `CLOCK_MONOTONIC` time in nanoseconds (like a frame timestamp) to wall-clock
+ * `CLOCK_REALTIME` nanoseconds, using the current offset between the two clocks.
+ * @ingroup time
+ */
+inline uint64_t timeMonotonicToRealtime( uint64_t nanoseconds )	{ const uint64_t realtime=timeNs(CLOCK_REALTIME); return nanoseconds + (realtime - timeNs(CLOCK_MONOTONIC)); }
+
+/**
+ * Convert a wall-clock `CLOCK_REALTIME` time in nanoseconds to the `CLOCK_MONOTONIC` domain,
+ * using the current offset between the two clocks.
+ * @ingroup time
+ */
+inline uint64_t timeRealtimeToMonotonic( uint64_t nanoseconds )	{ const uint64_t monotonic=timeNs(CLOCK_MONOTONIC); return nanoseconds - (timeNs(CLOCK_REALTIME) - monotonic); }
+
+/**
+ * Read the CPU's counter register (the TSC on x86, or `CNTVCT_EL0` on aarch64).
+ *
+ * This is cheaper than timeNs() for timing short sections of code - take the
+ * difference between two reads and convert it with timeTicksToNs().  The ticks
+ * aren't synchronized with any clock, so don't use them as timestamps.  On other
+ * architectures, this falls back to timeNs() with `CLOCK_MONOTONIC_RAW`.
+ *
+ * @ingroup time
+ */
+inline uint64_t timeTicks()
+{
+#if defined(__aarch64__)
+	uint64_t ticks;
+	asm volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks) :: "memory");
+	return ticks;
+#elif defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+#else
+	return timeNs(CLOCK_MONOTONIC_RAW);
+#endif
+}
+
+/**
+ * Get the frequency of timeTicks() in Hz.  On aarch64 this is read from `CNTFRQ_EL0`,
+ * and on x86 the TSC gets calibrated against `CLOCK_MONOTONIC_RAW` the first time
+ * this is called (which takes ~10ms).
+ * @ingroup time
+ */
+uint64_t timeTicksFrequency();
+
+/**
+ * Convert a number of timeTicks() to nanoseconds.
+ * @ingroup time
+ */
+uint64_t timeTicksToNs( uint64_t ticks );
+
 /**
  * Return a blank timespec that's been zero'd.
  * @ingroup time
@@ -58,13 +157,13 @@ inline timespec timeNew( time_t seconds, long int nanoseconds )		{ timespec t; t
  * Return an initialized `timespec`
  * @ingroup time
  */
-inline timespec timeNew( long int nanoseconds )					{ const time_t sec=nanoseconds/1e+9; return timeNew(sec, nanoseconds-sec*1e+9); }
+inline timespec timeNew( long int nanoseconds )					{ const time_t sec=nanoseconds/1000000000; return timeNew(sec, nanoseconds-sec*1000000000); }
 
 /**
  * Add two times together.
  * @ingroup time
  */
-inline timespec timeAdd( const timespec& a, const timespec& b )		{ timespec t; t.tv_sec=a.tv_sec+b.tv_sec; t.tv_nsec=a.tv_nsec+b.tv_nsec; const time_t sec=t.tv_nsec/1e+9; t.tv_sec+=sec; t.tv_nsec-=sec*1e+9; return t; }
+inline timespec timeAdd( const timespec& a, const timespec& b )		{ timespec t; t.tv_sec=a.tv_sec+b.tv_sec; t.tv_nsec=a.tv_nsec+b.tv_nsec; const time_t sec=t.tv_nsec/1000000000; t.tv_sec+=sec; t.tv_nsec-=sec*1000000000; return t; }
 
 /**
  * Find the difference between two timestamps.
@@ -119,7 +218,7 @@ inline int timeCmp( const timespec& a, const timespec& b )
 }
 
 /**
- * @internal Reference timestamp of when the process started.
+ * @internal Reference timestamp of when the process started (`CLOCK_MONOTONIC`).
  * @ingroup time
  */
 extern const timespec __apptime_begin__;
@@ -128,13 +227,13 @@ extern const timespec __apptime_begin__;
  * Retrieve the elapsed time since the process started.
  * @ingroup time
  */
-inline void apptime( timespec* a )										{ timespec t; timestamp(&t); timeDiff(__apptime_begin__, t, a); }
+inline void apptime( timespec* a )										{ timespec t=timeMonotonic(); timeDiff(__apptime_begin__, t, a); }
 
 /**
  * Retrieve the elapsed time since the process started (in nanoseconds).
  * @ingroup time
  */
-inline uint64_t apptime_nano()										{ timespec t; apptime(&t); return (uint64_t)t.tv_sec * uint64_t(1000000000) + (uint64_t)t.tv_nsec; }
+inline uint64_t apptime_nano()										{ return timeNs() - timeToNs(__apptime_begin__); }
 
 /**
  * Retrieve the elapsed time since the process started (in seconds).
@@ -188,19 +287,19 @@ inline void sleepTime( time_t seconds, long int nanoseconds )				{ sleepTime(tim
  * Put the current thread to sleep for a specified number of milliseconds.
  * @ingroup time
  */
-inline void sleepMs( uint64_t milliseconds )								{ sleepTime(timeNew(0, milliseconds * 1000 * 1000)); }
+inline void sleepMs( uint64_t milliseconds )								{ sleepTime(timeFromNs(milliseconds * 1000 * 1000)); }
 
 /**
  * Put the current thread to sleep for a specified number of microseconds.
  * @ingroup time
  */
-inline void sleepUs( uint64_t microseconds )								{ sleepTime(timeNew(0, microseconds * 1000)); }
+inline void sleepUs( uint64_t microseconds )								{ sleepTime(timeFromNs(microseconds * 1000)); }
 
 /**
  * Put the current thread to sleep for a specified number of nanoseconds.
  * @ingroup time
  */
-inline void sleepNs( uint64_t nanoseconds )								{ sleepTime(timeNew(0, nanoseconds)); }
+inline void sleepNs( uint64_t nanoseconds )								{ sleepTime(timeFromNs(nanoseconds)); }
 
 
 #endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "shmOutput.h"
+
+#include "cudaMappedMemory.h"
+#include "timespec.h"
+#include "logging.h"
+
+#include <string.h>
+
+
+// constructor
+shmOutput::shmOutput( const videoOptions& options ) : videoOutput(options)
+{
+	mRing       = NULL;
+	mFrameCount = 0;
+	mStreaming  = true;
+}
+
+
+// destructor
+shmOutput::~shmOutput()
+{
+	Close();
+}
+
+
+// Create
+shmOutput* shmOutput::Create( const videoOptions& options )
+{
+	return new shmOutput(options);
+}
+
+
+// Create
+shmOutput* shmOutput::Create( const char* name, const videoOptions& options )
+{
+	videoOptions opt = options;
+	opt.resource = (strstr(name, "://") != NULL) ? name : (std::string("shm://") + name).c_str();
+	return Create(opt);
+}
+
+
+// Render
+bool shmOutput::Render( void* image, uint32_t width, uint32_t height, imageFormat format, cudaStream_t stream )
+{
+	if( !image || width == 0 || height == 0 )
+		return false;
+
+	const bool substreams_success = videoOutput::Render(image, width, height, format, stream);
+
+	if( !mStreaming )
+		Open();
+
+	const size_t size = imageFormatSize(format, width, height);
+
+	// allocate the ring when the first frame comes in (or if the frames got larger)
+	if( !mRing || size > mRing->GetSlotSize() )
+	{
+		if( mRing != NULL )
+		{
+			LogVerbose(LOG_VIDEO "shmOutput -- resizing shm://%s for %ux%u %s frames\n", mOptions.resource.location.c_str(), width, height, imageFormatToStr(format));
+			
+			mRing->Close(shmRing::Resized);
+			delete mRing;
+		}
+
+		mRing = shmRing::Create(mOptions.resource.location.c_str(), mOptions.numBuffers, size);
+
+		if( !mRing )
+		{
+			LogError(LOG_VIDEO "shmOutput -- failed to create shm://%s\n", mOptions.resource.location.c_str());
+			return false;
+		}
+	}
+
+	// copy the frame into the next slot (the GPU can DMA it if the ring is registered with CUDA)
+	void* slot = mRing->Write(mFrameCount);
+
+	if( CUDA_FAILED(cudaMemcpyAsync(slot, image, size, cudaMemcpyDefault, stream)) )
+		return false;
+
+	if( CUDA_FAILED(cudaStreamSynchronize(stream)) )
+		return false;
+
+	mRing->Publish(mFrameCount, width, height, format, size, timeNs());
+
+	mOptions.width  = width;
+	mOptions.height = height;
+
+	mFrameCount++;
+	return substreams_success;
+}
+
+
+// Close
+void shmOutput::Close()
+{
+	if( mRing != NULL )
+	{
+		mRing->Close(shmRing::Closed);
+		delete mRing;
+		mRing = NULL;
+	}
+
+	mStreaming = false;
+}
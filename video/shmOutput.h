@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SHM_OUTPUT_H_
+#define __SHM_OUTPUT_H_
+
+
+#include "videoOutput.h"
+#include "shmRing.h"
+
+
+/**
+ * Share frames with other processes on the same system through shared memory (`shm://name`).
+ *
+ * The frames are copied into a ring of slots in shared memory (see shmRing), that any number
+ * of shmSource consumers in other processes can read from without further copies.  This way,
+ * one process can capture/decode a stream and share it with other processes, instead of each
+ * of them opening the camera or decoding the stream themselves.
+ *
+ * The number of slots in the ring is set by `--num-buffers`.  The ring gets allocated when the
+ * first frame is rendered, with slots that are large enough for that frame.  If a larger frame
+ * is rendered later, the ring is re-created and the consumers automatically reconnect to it.
+ *
+ * The producer never waits on the consumers - if a consumer falls behind by more than the number
+ * of slots, it skips ahead to the latest frame (and counts the frames it missed as dropped).
+ *
+ * @note shmOutput implements the videoOutput interface and is intended to
+ * be used through that as opposed to directly.  videoOutput implements
+ * additional command-line parsing of videoOptions to construct instances.
+ *
+ * @see shmSource
+ * @see videoOutput
+ * @ingroup video
+ */
+class shmOutput : public videoOutput
+{
+public:
+	/**
+	 * Create an shmOutput instance from a stream name and optional videoOptions.
+	 */
+	static shmOutput* Create( const char* name, const videoOptions& options=videoOptions() );
+
+	/**
+	 * Create an shmOutput instance from the provided video options.
+	 */
+	static shmOutput* Create( const videoOptions& options );
+
+	/**
+	 * Destructor
+	 */
+	virtual ~shmOutput();
+
+	/**
+	 * Share the next frame.
+	 * @see videoOutput::Render()
+	 */
+	template<typename T> bool Render( T* image, uint32_t width, uint32_t height, cudaStream_t stream=0 )		{ return Render((void**)image, width, height, imageFormatFromType<T>(), stream); }
+	
+	/**
+	 * Share the next frame.
+	 * @see videoOutput::Render()
+	 */
+	virtual bool Render( void* image, uint32_t width, uint32_t height, imageFormat format, cudaStream_t stream=0 );
+
+	/**
+	 * Close the stream, which signals end-of-stream (EOS) to the consumers.
+	 */
+	virtual void Close();
+
+	/**
+	 * Get the number of frames that have been shared.
+	 */
+	inline uint64_t GetFrameCount() const		{ return mFrameCount; }
+
+	/**
+	 * Get the number of consumers that have connected to the stream.
+	 */
+	inline uint32_t GetNumConnections() const	{ return mRing != NULL ? mRing->GetNumConnections() : 0; }
+
+	/**
+	 * Return the interface type (shmOutput::Type)
+	 */
+	virtual inline uint32_t GetType() const		{ return Type; }
+
+	/**
+	 * Unique type identifier of shmOutput class.
+	 */
+	static const uint32_t Type = (1 << 7);
+
+protected:
+	shmOutput( const videoOptions& options );
+
+	shmRing* mRing;
+	uint64_t mFrameCount;
+};
+
+#endif
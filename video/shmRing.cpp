@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "shmRing.h"
+
+#include "Event.h"
+#include "Process.h"
+#include "videoOptions.h"
+
+#include "cudaMappedMemory.h"
+#include "timespec.h"
+#include "logging.h"
+
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+
+#define SHM_RING_MAGIC    0x4D485356	// "VSHM"
+#define SHM_RING_VERSION  2
+
+
+// alignUp
+static inline size_t alignUp( size_t size, size_t alignment )
+{
+	return ((size + alignment - 1) / alignment) * alignment;
+}
+
+
+// headerSize (the header is padded to a page, so the slots can be mapped separately)
+static inline size_t headerSize()
+{
+	return alignUp(sizeof(shmRing::Header), sysconf(_SC_PAGESIZE));
+}
+
+
+// socketAddress (abstract UNIX socket, which goes away automatically when the producer exits)
+static socklen_t socketAddress( const char* name, sockaddr_un* addr )
+{
+	memset(addr, 0, sizeof(sockaddr_un));
+	addr->sun_family = AF_UNIX;
+
+	const int length = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "jetson-utils/shm/%s", name);
+	return offsetof(sockaddr_un, sun_path) + 1 + length;
+}
+
+
+// constructor
+shmRing::shmRing( const char* name, bool producer )
+{
+	strncpy(mName, name, sizeof(mName) - 1);
+	mName[sizeof(mName) - 1] = '\0';
+
+	mProducer    = producer;
+	mMapped      = false;
+	mHeader      = NULL;
+	mData        = NULL;
+	mSize        = 0;
+	mDataSize    = 0;
+	mAllocator   = NULL;
+	mSocket      = -1;
+	mFD          = -1;
+	mProducerPID = producer ? Process::GetID() : -1;
+	mClosing     = false;
+	mConnections = 0;
+}
+
+
+// destructor
+shmRing::~shmRing()
+{
+	if( mProducer )
+	{
+		if( !mClosing && mHeader != NULL )
+			Close(Closed);
+
+		if( mAllocator != NULL )
+		{
+			mAllocator->Free(mHeader, mSize);	// this also closes the memfd
+			delete mAllocator;
+		}
+	}
+	else
+	{
+		if( mMapped )
+			CUDA(cudaHostUnregister(mData));
+
+		if( mData != NULL )
+			munmap(mData, mDataSize);
+
+		if( mHeader != NULL )
+			munmap(mHeader, mSize);
+
+		if( mFD >= 0 )
+			close(mFD);
+	}
+}
+
+
+// Create
+shmRing* shmRing::Create( const char* name, uint32_t numSlots, size_t slotSize )
+{
+	if( !name || numSlots == 0 || slotSize == 0 )
+		return NULL;
+
+	if( numSlots > MaxSlots )
+	{
+		LogWarning(LOG_VIDEO "shmRing -- shm://%s requested %u slots, limiting to %u\n", name, numSlots, MaxSlots);
+		numSlots = MaxSlots;
+	}
+
+	slotSize = alignUp(slotSize, sysconf(_SC_PAGESIZE));
+
+	shmRing* ring = new shmRing(name, true);
+
+	ring->mDataSize = numSlots * slotSize;
+	ring->mSize     = headerSize() + ring->mDataSize;
+
+	// register the memory with CUDA so the GPU can copy frames straight into it
+	ring->mAllocator = new SharedMemoryAllocator(name, true);
+	void* ptr = ring->mAllocator->Alloc(ring->mSize);
+
+	if( ptr != NULL )
+	{
+		ring->mMapped = true;
+	}
+	else
+	{
+		LogWarning(LOG_VIDEO "shmRing -- shm://%s falling back to unregistered memory\n", name);
+
+		delete ring->mAllocator;
+		ring->mAllocator = new SharedMemoryAllocator(name, false);
+		ptr = ring->mAllocator->Alloc(ring->mSize);
+
+		if( !ptr )
+		{
+			LogError(LOG_VIDEO "shmRing -- failed to allocate %zu bytes of shared memory for shm://%s\n", ring->mSize, name);
+			delete ring;
+			return NULL;
+		}
+	}
+
+	ring->mHeader = (Header*)ptr;
+	ring->mData   = (uint8_t*)ptr + headerSize();
+	ring->mFD     = ring->mAllocator->GetFD(ptr);
+
+	// memfd's start out zeroed, so only the non-zero fields need set
+	Header* header = ring->mHeader;
+
+	header->magic      = SHM_RING_MAGIC;
+	header->version    = SHM_RING_VERSION;
+	header->numSlots   = numSlots;
+	header->slotSize   = slotSize;
+	header->dataOffset = headerSize();
+	header->sequence   = Empty;
+
+	for( uint32_t n=0; n < MaxSlots; n++ )
+		header->slots[n].sequence = Empty;
+
+	if( !ring->listen() )
+	{
+		delete ring;
+		return NULL;
+	}
+
+	LogVerbose(LOG_VIDEO "shmRing -- created shm://%s (%u slots, %zu bytes each)\n", name, numSlots, slotSize);
+	return ring;
+}
+
+
+// listen
+bool shmRing::listen()
+{
+	mSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if( mSocket < 0 )
+	{
+		LogError(LOG_VIDEO "shmRing -- failed to create socket for shm://%s\n", mName);
+		return false;
+	}
+
+	sockaddr_un addr;
+	const socklen_t addrLength = socketAddress(mName, &addr);
+
+	if( bind(mSocket, (sockaddr*)&addr, addrLength) != 0 )
+	{
+		if( errno == EADDRINUSE )
+			LogError(LOG_VIDEO "shmRing -- another process is already streaming to shm://%s\n", mName);
+		else
+			LogError(LOG_VIDEO "shmRing -- failed to bind socket for shm://%s (error %i)\n", mName, errno);
+
+		return false;
+	}
+
+	if( ::listen(mSocket, 16) != 0 )
+	{
+		LogError(LOG_VIDEO "shmRing -- failed to listen on socket for shm://%s\n", mName);
+		return false;
+	}
+
+	if( !mThread.Start(listenThread, this) )
+	{
+		LogError(LOG_VIDEO "shmRing -- failed to start listener thread for shm://%s\n", mName);
+		return false;
+	}
+
+	return true;
+}
+
+
+// listenThread
+void* shmRing::listenThread( void* user )
+{
+	((shmRing*)user)->accept();
+	return NULL;
+}
+
+
+// accept
+void shmRing::accept()
+{
+	while( !mClosing )
+	{
+		const int client = accept4(mSocket, NULL, NULL, SOCK_CLOEXEC);
+
+		if( client < 0 )
+		{
+			if( errno == EINTR || errno == ECONNABORTED )
+				continue;
+
+			if( !mClosing )
+				LogError(LOG_VIDEO "shmRing -- failed to accept connection on shm://%s (error %i)\n", mName, errno);
+
+			break;
+		}
+
+		// pass the memfd to the consumer
+		char data = 0;
+		iovec iov = { &data, sizeof(data) };
+
+		char control[CMSG_SPACE(sizeof(int))];
+		memset(control, 0, sizeof(control));
+
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+
+		msg.msg_iov        = &iov;
+		msg.msg_iovlen     = 1;
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+
+		cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type  = SCM_RIGHTS;
+		cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+
+		memcpy(CMSG_DATA(cmsg), &mFD, sizeof(int));
+
+		if( sendmsg(client, &msg, MSG_NOSIGNAL) < 0 )
+		{
+			LogWarning(LOG_VIDEO "shmRing -- failed to send shm://%s to consumer (error %i)\n", mName, errno);
+		}
+		else
+		{
+			mConnections++;
+			LogVerbose(LOG_VIDEO "shmRing -- consumer connected to shm://%s\n", mName);
+		}
+
+		close(client);
+	}
+}
+
+
+// Connect
+shmRing* shmRing::Connect( const char* name, uint64_t timeout )
+{
+	if( !name )
+		return NULL;
+
+	const int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if( sock < 0 )
+	{
+		LogError(LOG_VIDEO "shmRing -- failed to create socket for shm://%s\n", name);
+		return NULL;
+	}
+
+	sockaddr_un addr;
+	const socklen_t addrLength = socketAddress(name, &addr);
+
+	// the producer might not have been started yet
+	const timespec deadline = timeAdd(timeMonotonic(), timeNew(timeout * 1000 * 1000));
+
+	while( connect(sock, (sockaddr*)&addr, addrLength) != 0 )
+	{
+		if( errno != ECONNREFUSED || timeCmp(timeMonotonic(), deadline) >= 0 )
+		{
+			close(sock);
+			return NULL;
+		}
+
+		sleepMs(10);
+	}
+
+	// receive the memfd and the producer's PID (translated into our PID namespace)
+	timeval recvTimeout = { 1, 0 };
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &recvTimeout, sizeof(recvTimeout));
+
+	ucred credentials;
+	socklen_t credentialsLength = sizeof(credentials);
+	memset(&credentials, 0, sizeof(credentials));
+
+	getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsLength);
+
+	char data = 0;
+	iovec iov = { &data, sizeof(data) };
+
+	char control[CMSG_SPACE(sizeof(int))];
+	memset(control, 0, sizeof(control));
+
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = control;
+	msg.msg_controllen = sizeof(control);
+
+	const ssize_t received = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	close(sock);
+
+	cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+
+	if( received <= 0 || !cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS )
+	{
+		LogError(LOG_VIDEO "shmRing -- failed to receive shm://%s from the producer\n", name);
+		return NULL;
+	}
+
+	shmRing* ring = new shmRing(name, false);
+
+	memcpy(&ring->mFD, CMSG_DATA(cmsg), sizeof(int));
+	ring->mProducerPID = credentials.pid;
+
+	// map the header read-only (consumers only wait on the futex, which doesn't need write access)
+	struct stat fileInfo;
+
+	if( fstat(ring->mFD, &fileInfo) != 0 || (size_t)fileInfo.st_size < headerSize() )
+	{
+		LogError(LOG_VIDEO "shmRing -- invalid shared memory from shm://%s\n", name);
+		delete ring;
+		return NULL;
+	}
+
+	void* header = mmap(NULL, headerSize(), PROT_READ, MAP_SHARED, ring->mFD, 0);
+
+	if( header == MAP_FAILED )
+	{
+		LogError(LOG_VIDEO "shmRing -- failed to map header of shm://%s\n", name);
+		delete ring;
+		return NULL;
+	}
+
+	ring->mHeader = (Header*)header;
+	ring->mSize   = headerSize();
+
+	const Header* h = ring->mHeader;
+
+	if( h->magic != SHM_RING_MAGIC || h->version != SHM_RING_VERSION || h->numSlots == 0 || h->numSlots > MaxSlots 
+	 || h->dataOffset != headerSize() || h->dataOffset + h->numSlots * h->slotSize > (size_t)fileInfo.st_size )
+	{
+		LogError(LOG_VIDEO "shmRing -- shm://%s has an invalid or incompatible header\n", name);
+		delete ring;
+		return NULL;
+	}
+
+	// map the slots read-only
+	ring->mDataSize = h->numSlots * h->slotSize;
+
+	void* slots = mmap(NULL, ring->mDataSize, PROT_READ, MAP_SHARED, ring->mFD, h->dataOffset);
+
+	if( slots == MAP_FAILED )
+	{
+		LogError(LOG_VIDEO "shmRing -- failed to map %zu bytes from shm://%s\n", ring->mDataSize, name);
+		delete ring;
+		return NULL;
+	}
+
+	ring->mData = (uint8_t*)slots;
+
+	// CUDA can only register read-only mappings since CUDA 11.1 (otherwise frames get copied)
+#if CUDART_VERSION >= 11010
+	if( cudaHostRegister(slots, ring->mDataSize, cudaHostRegisterMapped | cudaHostRegisterReadOnly) == cudaSuccess )
+		ring->mMapped = true;
+	else
+		cudaGetLastError();
+#endif
+
+	LogVerbose(LOG_VIDEO "shmRing -- connected to shm://%s (%u slots, %zu bytes each, %s)\n", name, h->numSlots, (size_t)h->slotSize, ring->mMapped ? "zeroCopy" : "copied");
+	return ring;
+}
+
+
+// Write
+void* shmRing::Write( uint64_t sequence )
+{
+	if( !mProducer || sequence == Empty )
+		return NULL;
+
+	const uint32_t index = sequence % mHeader->numSlots;
+
+	// mark the slot as empty before it gets overwritten
+	mHeader->slots[index].sequence.store(Empty, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	return mData + index * mHeader->slotSize;
+}
+
+
+// Publish
+void shmRing::Publish( uint64_t sequence, uint32_t width, uint32_t height, imageFormat format, size_t size, uint64_t timestamp )
+{
+	if( !mProducer || sequence == Empty )
+		return;
+
+	Slot* slot = &mHeader->slots[sequence % mHeader->numSlots];
+
+	slot->timestamp = timestamp;
+	slot->size      = size;
+	slot->width     = width;
+	slot->height    = height;
+	slot->format    = format;
+
+	slot->sequence.store(sequence, std::memory_order_release);
+	mHeader->sequence.store(sequence, std::memory_order_release);
+	mHeader->signal++;
+
+	// the consumers can't write to the header, so they can't count themselves as waiters
+	// (and the producer always wakes them, which is cheap compared to writing the frame)
+	Event::futexWake(&mHeader->signal, INT_MAX, true);
+}
+
+
+// Close
+void shmRing::Close( State state )
+{
+	if( !mProducer || mClosing.exchange(true) )
+		return;
+
+	mHeader->state.store(state, std::memory_order_release);
+	mHeader->signal++;
+
+	Event::futexWake(&mHeader->signal, INT_MAX, true);
+
+	// stop accepting consumers (shutdown() unblocks the listener thread)
+	if( mSocket >= 0 )
+	{
+		shutdown(mSocket, SHUT_RDWR);
+		mThread.Stop(true);
+		close(mSocket);
+		mSocket = -1;
+	}
+}
+
+
+// Wait
+bool shmRing::Wait( uint64_t sequence, uint64_t timeout )
+{
+	const bool infinite = (timeout == UINT64_MAX);
+	const timespec deadline = infinite ? timeZero() : timeAdd(timeMonotonic(), timeNew(timeout * 1000 * 1000));
+
+	while( true )
+	{
+		// load the futex before the sequence, so a frame published in between causes the wait to return
+		const uint32_t signal = mHeader->signal.load(std::memory_order_acquire);
+		const uint64_t latest = GetSequence();
+
+		if( latest != Empty && (sequence == Empty || latest > sequence) )
+			return true;
+
+		if( GetState() != Streaming || timeout == 0 )
+			return false;
+
+		if( !infinite && timeCmp(timeMonotonic(), deadline) >= 0 )
+			return false;
+
+		Event::futexWait(&mHeader->signal, signal, infinite ? NULL : &deadline, true);
+	}
+}
+
+
+// Read
+const void* shmRing::Read( uint64_t sequence, Slot* info )
+{
+	if( sequence == Empty || !info )
+		return NULL;
+
+	const uint32_t index = sequence % mHeader->numSlots;
+	const Slot* slot = &mHeader->slots[index];
+
+	if( slot->sequence.load(std::memory_order_acquire) != sequence )
+		return NULL;
+
+	info->timestamp = slot->timestamp;
+	info->size      = slot->size;
+	info->width     = slot->width;
+	info->height    = slot->height;
+	info->format    = slot->format;
+
+	info->sequence.store(sequence, std::memory_order_relaxed);
+
+	// make sure the metadata wasn't changing while it was copied
+	if( !Validate(sequence) || info->size > mHeader->slotSize )
+		return NULL;
+
+	return mData + index * mHeader->slotSize;
+}
+
+
+// Validate
+bool shmRing::Validate( uint64_t sequence ) const
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return (mHeader->slots[sequence % mHeader->numSlots].sequence.load(std::memory_order_relaxed) == sequence);
+}
+
+
+// IsProducerAlive
+bool shmRing::IsProducerAlive() const
+{
+	if( mProducer )
+		return true;
+
+	return Process::IsRunning(mProducerPID);
+}
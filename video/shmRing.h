@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VIDEO_SHM_RING_H_
+#define __VIDEO_SHM_RING_H_
+
+
+#include "imageFormat.h"
+#include "RingBufferAllocator.h"
+#include "Thread.h"
+
+#include <sys/types.h>
+#include <atomic>
+
+
+/**
+ * Ring of frame slots in shared memory, that's used to stream video between processes
+ * (see shmOutput for the producer side and shmSource for the consumer side).
+ *
+ * The ring is a single memfd that the producer allocates with SharedMemoryAllocator.
+ * Consumers find it by name through an abstract UNIX domain socket, which the producer
+ * uses to pass them the file descriptor.  The consumers map the header and the slots
+ * read-only, so any number of them can read the frames without copying or slowing down
+ * the producer, and they can't corrupt the stream for each other.
+ *
+ * New frames are signalled with a futex in the shared header, and each slot is stamped 
+ * with the sequence number of its frame.  Consumers use the sequence numbers to detect 
+ * frames that they missed, and to check if a slot was overwritten while they were reading it.
+ *
+ * @ingroup video
+ */
+class shmRing
+{
+public:
+	/**
+	 * The maximum number of slots in the ring.
+	 */
+	static const uint32_t MaxSlots = 32;
+
+	/**
+	 * Sequence number used for empty slots, and for slots that are being written.
+	 */
+	static const uint64_t Empty = UINT64_MAX;
+
+	/**
+	 * State of the producer.
+	 */
+	enum State
+	{
+		Streaming = 0,		/**< The producer is writing frames. */
+		Closed    = 1,		/**< The producer closed the stream (EOS). */
+		Resized   = 2		/**< The producer replaced the ring with larger slots, and consumers should reconnect. */
+	};
+
+	/**
+	 * Per-slot metadata of the frame it contains.
+	 */
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;	/**< Sequence number of the frame (or Empty) */
+		uint64_t timestamp;				/**< Timestamp of the frame (CLOCK_MONOTONIC nanoseconds, see timeNs()) */
+		uint64_t size;					/**< Size of the frame (in bytes) */
+		uint32_t width;				/**< Width of the frame (in pixels) */
+		uint32_t height;				/**< Height of the frame (in pixels) */
+		uint32_t format;				/**< imageFormat of the frame */
+		uint32_t reserved;
+	};
+
+	/**
+	 * Header at the beginning of the shared memory.
+	 */
+	struct Header
+	{
+		uint32_t magic;				/**< Magic number that identifies the layout */
+		uint32_t version;				/**< Version of the layout */
+		uint32_t numSlots;				/**< Number of slots in the ring */
+		uint32_t reserved;
+		uint64_t slotSize;				/**< Size of each slot (in bytes) */
+		uint64_t dataOffset;			/**< Offset of the first slot from the beginning of the memory */
+
+		std::atomic<uint64_t> sequence;	/**< Sequence number of the latest frame (or Empty) */
+		std::atomic<uint32_t> signal;		/**< Futex that gets incremented when a frame is published */
+		std::atomic<uint32_t> state;		/**< State of the producer */
+
+		Slot slots[MaxSlots];
+	};
+
+	/**
+	 * Create a ring that consumers can connect to (on the producer side).
+	 * @param name the name of the stream (from `shm://name`)
+	 * @param numSlots the number of frames that the ring holds.
+	 * @param slotSize the maximum size of each frame (in bytes).
+	 * @returns the new ring, or NULL if it couldn't be created (for example, if
+	 *          there's already another producer with the same name).
+	 */
+	static shmRing* Create( const char* name, uint32_t numSlots, size_t slotSize );
+
+	/**
+	 * Connect to the ring of a producer (on the consumer side).
+	 * @param name the name of the stream (from `shm://name`)
+	 * @param timeout the number of milliseconds to wait for the producer to be started.
+	 * @returns the ring, or NULL if there wasn't a producer before the timeout expired.
+	 */
+	static shmRing* Connect( const char* name, uint64_t timeout=0 );
+
+	/**
+	 * Destructor
+	 */
+	~shmRing();
+
+	/**
+	 * Begin writing a frame, and return the slot that it should be written to (producer only).
+	 * The slot is marked as Empty until it gets published, so consumers don't read it.
+	 * @param sequence the sequence number of the frame (these should be increasing).
+	 */
+	void* Write( uint64_t sequence );
+
+	/**
+	 * Publish a frame that was written to the slot from Write() and wake up the consumers (producer only).
+	 */
+	void Publish( uint64_t sequence, uint32_t width, uint32_t height, imageFormat format, size_t size, uint64_t timestamp );
+
+	/**
+	 * Stop the stream and wake up the consumers (producer only).
+	 * @param state either Closed (for EOS), or Resized if the stream is going to continue in a new ring.
+	 */
+	void Close( State state=Closed );
+
+	/**
+	 * Wait until there's a frame newer than the specified sequence number,
+	 * or the producer closed the stream, or the timeout (in milliseconds) expires.
+	 * @param sequence the last sequence number that was read (or Empty for any frame).
+	 * @returns true if there's a newer frame, otherwise false.
+	 */
+	bool Wait( uint64_t sequence, uint64_t timeout );
+
+	/**
+	 * Get the metadata and data of the frame with the specified sequence number.
+	 * @returns a pointer to the frame, or NULL if it's no longer in the ring.
+	 *          The frame stays valid until the producer wraps around the ring,
+	 *          which can be checked afterwards with Validate().
+	 */
+	const void* Read( uint64_t sequence, Slot* info );
+
+	/**
+	 * Check that the slot still contains the frame with the specified sequence number,
+	 * after its data was read (i.e. it wasn't overwritten while it was being read).
+	 */
+	bool Validate( uint64_t sequence ) const;
+
+	/**
+	 * Get the sequence number of the latest frame (or Empty if no frames were written yet).
+	 */
+	inline uint64_t GetSequence() const			{ return mHeader->sequence.load(std::memory_order_acquire); }
+
+	/**
+	 * Get the state of the producer.
+	 */
+	inline State GetState() const					{ return (State)mHeader->state.load(std::memory_order_acquire); }
+
+	/**
+	 * Check if the producer process is still running.
+	 */
+	bool IsProducerAlive() const;
+
+	/**
+	 * Return true if this is the producer side of the ring.
+	 */
+	inline bool IsProducer() const				{ return mProducer; }
+
+	/**
+	 * Return true if the frames can be accessed directly by the GPU (zeroCopy).
+	 * Otherwise, consumers need to copy the frames before using them with CUDA.
+	 */
+	inline bool IsMapped() const					{ return mMapped; }
+
+	/**
+	 * Get the number of slots in the ring.
+	 */
+	inline uint32_t GetNumSlots() const			{ return mHeader->numSlots; }
+
+	/**
+	 * Get the size of each slot (in bytes).
+	 */
+	inline size_t GetSlotSize() const				{ return mHeader->slotSize; }
+
+	/**
+	 * Get the number of consumers that have connected (producer only).
+	 */
+	inline uint32_t GetNumConnections() const		{ return mConnections; }
+
+	/**
+	 * Get the name of the stream.
+	 */
+	inline const char* GetName() const			{ return mName; }
+
+protected:
+	shmRing( const char* name, bool producer );
+
+	bool listen();
+	void accept();
+
+	static void* listenThread( void* user );
+
+	char    mName[64];
+	bool    mProducer;
+	bool    mMapped;
+
+	Header* mHeader;
+	uint8_t* mData;
+	size_t  mSize;
+	size_t  mDataSize;
+
+	SharedMemoryAllocator* mAllocator;
+
+	int     mSocket;
+	int     mFD;
+	pid_t   mProducerPID;
+	Thread  mThread;
+
+	std::atomic<bool>     mClosing;
+	std::atomic<uint32_t> mConnections;
+};
+
+#endif
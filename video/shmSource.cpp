@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "shmSource.h"
+
+#include "cudaColorspace.h"
+#include "cudaMappedMemory.h"
+#include "logging.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+
+#define RETURN_STATUS(code)  { if( status != NULL ) { *status=(code); } return ((code) == videoSource::OK ? true : false); }
+
+
+// constructor
+shmSource::shmSource( const videoOptions& options ) : videoSource(options)
+{
+	mRing         = NULL;
+	mLastSequence = shmRing::Empty;
+	mDropped      = 0;
+	mEOS          = false;
+
+	mBufferRaw.SetThreaded(false);
+	mBufferRGB.SetThreaded(false);
+}
+
+
+// destructor
+shmSource::~shmSource()
+{
+	Close();
+}
+
+
+// Create
+shmSource* shmSource::Create( const videoOptions& options )
+{
+	return new shmSource(options);
+}
+
+
+// Create
+shmSource* shmSource::Create( const char* name, const videoOptions& options )
+{
+	videoOptions opt = options;
+	opt.resource = (strstr(name, "://") != NULL) ? name : (std::string("shm://") + name).c_str();
+	return Create(opt);
+}
+
+
+// connect
+bool shmSource::connect( uint64_t timeout )
+{
+	if( mRing != NULL )
+		return true;
+
+	mRing = shmRing::Connect(mOptions.resource.location.c_str(), timeout);
+
+	if( !mRing )
+		return false;
+
+	mStreaming = true;
+	mEOS = false;
+
+	return true;
+}
+
+
+// disconnect
+void shmSource::disconnect()
+{
+	if( !mRing )
+		return;
+
+	delete mRing;
+	mRing = NULL;
+}
+
+
+// Open
+bool shmSource::Open()
+{
+	if( !connect(0) )
+	{
+		LogVerbose(LOG_VIDEO "shmSource -- shm://%s isn't being streamed yet\n", mOptions.resource.location.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+// Close
+void shmSource::Close()
+{
+	disconnect();
+	mStreaming = false;
+}
+
+
+// Capture
+bool shmSource::Capture( void** output, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
+{
+	if( !output )
+		RETURN_STATUS(ERROR);
+
+	// connect to the producer (which might not have been started yet)
+	if( !connect(timeout) )
+	{
+		recordCapture(mEOS ? EOS : TIMEOUT);
+		RETURN_STATUS(mEOS ? EOS : TIMEOUT);
+	}
+
+	while( true )
+	{
+		if( !mRing->Wait(mLastSequence, timeout) )
+		{
+			const shmRing::State state = mRing->GetState();
+
+			if( state == shmRing::Resized )
+			{
+				// the producer re-created the ring for larger frames
+				disconnect();
+
+				if( !connect(timeout) )
+				{
+					recordCapture(TIMEOUT);
+					RETURN_STATUS(TIMEOUT);
+				}
+
+				continue;
+			}
+			else if( state == shmRing::Closed || !mRing->IsProducerAlive() )
+			{
+				if( state != shmRing::Closed )
+					LogError(LOG_VIDEO "shmSource -- the producer of shm://%s exited\n", mOptions.resource.location.c_str());
+				else
+					LogVerbose(LOG_VIDEO "shmSource -- shm://%s reached end-of-stream (EOS)\n", mOptions.resource.location.c_str());
+
+				disconnect();
+
+				mEOS = true;
+				mStreaming = false;
+
+				RETURN_STATUS(EOS);
+			}
+
+			recordCapture(TIMEOUT);
+			RETURN_STATUS(TIMEOUT);
+		}
+
+		// get the latest frame (if it was already overwritten, wait for the next one)
+		const uint64_t sequence = mRing->GetSequence();
+
+		shmRing::Slot info;
+		const void* data = mRing->Read(sequence, &info);
+
+		if( !data )
+			continue;
+
+		const imageFormat rawFormat = (imageFormat)info.format;
+		const imageFormat outputFormat = (format == IMAGE_UNKNOWN) ? rawFormat : format;
+
+		void* image = (void*)data;
+
+		// copy the frame out of the ring if CUDA can't access it there, or if it would be returned
+		// from the ring but this consumer fell behind and the producer is about to overwrite it
+		const bool overwriting = (sequence + mRing->GetNumSlots() <= mRing->GetSequence() + 2);
+
+		if( !mRing->IsMapped() || (outputFormat == rawFormat && overwriting) )
+		{
+			if( !mBufferRaw.Alloc(mOptions.numBuffers, mRing->GetSlotSize(), RingBuffer::ZeroCopy) )
+			{
+				LogError(LOG_VIDEO "shmSource -- failed to allocate %u buffers (%zu bytes each)\n", mOptions.numBuffers, mRing->GetSlotSize());
+				recordCapture(ERROR);
+				RETURN_STATUS(ERROR);
+			}
+
+			image = mBufferRaw.Next(RingBuffer::Write);
+			memcpy(image, data, info.size);
+		}
+
+		// convert to the requested format
+		if( outputFormat != rawFormat )
+		{
+			const size_t size = imageFormatSize(outputFormat, info.width, info.height);
+
+			if( !mBufferRGB.Alloc(mOptions.numBuffers, size, mOptions.zeroCopy ? RingBuffer::ZeroCopy : 0) )
+			{
+				LogError(LOG_VIDEO "shmSource -- failed to allocate %u buffers (%zu bytes each)\n", mOptions.numBuffers, size);
+				recordCapture(ERROR);
+				RETURN_STATUS(ERROR);
+			}
+
+			void* nextRGB = mBufferRGB.Next(RingBuffer::Write);
+
+			if( CUDA_FAILED(cudaConvertColor(image, rawFormat, nextRGB, outputFormat, info.width, info.height, stream)) )
+			{
+				LogError(LOG_VIDEO "shmSource -- failed to convert %s to %s\n", imageFormatToStr(rawFormat), imageFormatToStr(outputFormat));
+				recordCapture(ERROR);
+				RETURN_STATUS(ERROR);
+			}
+
+			// the conversion needs to finish before checking that the slot wasn't overwritten
+			if( image == data && CUDA_FAILED(cudaStreamSynchronize(stream)) )
+			{
+				recordCapture(ERROR);
+				RETURN_STATUS(ERROR);
+			}
+
+			image = nextRGB;
+		}
+
+		// count the frames that were skipped over
+		if( mLastSequence != shmRing::Empty && sequence > mLastSequence + 1 )
+		{
+			mDropped += sequence - mLastSequence - 1;
+			recordDropped(DROP_SKIPPED, sequence - mLastSequence - 1);
+		}
+
+		recordReceived((mLastSequence != shmRing::Empty && sequence > mLastSequence) ? sequence - mLastSequence : 1);
+		mLastSequence = sequence;
+
+		// if the producer wrapped around while the frame was being read (or before a zeroCopy 
+		// frame gets returned from the ring), it could be torn
+		if( !mRing->Validate(sequence) )
+		{
+			LogVerbose(LOG_VIDEO "shmSource -- frame %" PRIu64 " of shm://%s was overwritten while being read\n", sequence, mOptions.resource.location.c_str());
+			mDropped++;
+			recordDropped(DROP_OVERWRITTEN);
+			continue;
+		}
+
+		mLastTimestamp  = info.timestamp;
+		mRawFormat      = rawFormat;
+		mOptions.width  = info.width;
+		mOptions.height = info.height;
+		mOptions.frameCount++;
+
+		recordCapture(OK, mLastTimestamp);
+
+		*output = image;
+		RETURN_STATUS(OK);
+	}
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SHM_SOURCE_H_
+#define __SHM_SOURCE_H_
+
+
+#include "videoSource.h"
+#include "shmRing.h"
+#include "RingBuffer.h"
+
+
+/**
+ * Receive frames from another process through shared memory (`shm://name`).
+ *
+ * shmSource connects to the ring of an shmOutput producer with the same name (see shmRing),
+ * and maps it read-only.  When the requested format matches the producer's format and CUDA 
+ * is able to map the shared memory, the image returned by Capture() points directly into the
+ * ring without any copies.  Otherwise, the frame gets copied and/or converted first.
+ *
+ * Capture() always returns the latest frame.  The sequence numbers of the frames are used to
+ * count how many frames were skipped (see GetDroppedFrames()), for example because this process 
+ * was too slow to keep up with the producer.  A zeroCopy image is only valid until the producer
+ * wraps around the ring, which happens after `--num-buffers` more frames on the producer side
+ * (nothing detects if it gets overwritten after Capture() returned it).  Capture() checks that
+ * the frame is still intact before returning it, and copies it out of the ring instead if the
+ * producer is about to overwrite it.
+ *
+ * If the producer isn't running yet, Capture() keeps trying to connect and returns TIMEOUT.
+ * If the producer closes the stream, or if the producer process exits or crashes, it returns EOS.
+ *
+ * @note shmSource implements the videoSource interface and is intended to
+ * be used through that as opposed to directly.  videoSource implements
+ * additional command-line parsing of videoOptions to construct instances.
+ *
+ * @see shmOutput
+ * @see videoSource
+ * @ingroup video
+ */
+class shmSource : public videoSource
+{
+public:
+	/**
+	 * Create an shmSource instance from a stream name and optional videoOptions.
+	 */
+	static shmSource* Create( const char* name, const videoOptions& options=videoOptions() );
+
+	/**
+	 * Create an shmSource instance from the provided video options.
+	 */
+	static shmSource* Create( const videoOptions& options );
+
+	/**
+	 * Destructor
+	 */
+	virtual ~shmSource();
+
+	/**
+	 * Capture the latest frame from the producer.
+	 * @see videoSource::Capture()
+	 */
+	virtual bool Capture( void** image, imageFormat format, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
+
+	/**
+	 * Capture the latest frame into a videoFrame.
+	 * @see videoSource::Capture()
+	 */
+	using videoSource::Capture;
+
+	/**
+	 * Connect to the producer.
+	 */
+	virtual bool Open();
+
+	/**
+	 * Disconnect from the producer.
+	 */
+	virtual void Close();
+
+	/**
+	 * Get the sequence number (from the producer) of the last frame that was captured.
+	 */
+	inline uint64_t GetLastSequence() const		{ return mLastSequence; }
+
+	/**
+	 * Get the number of frames from the producer that were skipped over.
+	 */
+	inline uint64_t GetDroppedFrames() const		{ return mDropped; }
+
+	/**
+	 * Return the interface type (shmSource::Type)
+	 */
+	virtual inline uint32_t GetType() const		{ return Type; }
+
+	/**
+	 * Unique type identifier of shmSource class.
+	 */
+	static const uint32_t Type = (1 << 6);
+
+protected:
+	shmSource( const videoOptions& options );
+
+	bool connect( uint64_t timeout );
+	void disconnect();
+
+	shmRing*   mRing;
+	uint64_t   mLastSequence;
+	uint64_t   mDropped;
+	bool       mEOS;
+
+	RingBuffer mBufferRaw;	// frames copied out of the ring (when CUDA can't map it)
+	RingBuffer mBufferRGB;	// frames converted to the requested format
+};
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "videoFrame.h"
+
+#include "cudaMappedMemory.h"
+#include "logging.h"
+
+
+// Create
+videoFramePool* videoFramePool::Create( uint32_t numBuffers, size_t size, bool zeroCopy, uint32_t maxBuffers, uint32_t sourceID )
+{
+	if( size == 0 && numBuffers > 0 )
+	{
+		LogError("videoFramePool -- invalid buffer size of 0 bytes\n");
+		return NULL;
+	}
+
+	if( maxBuffers == 0 )
+		maxBuffers = numBuffers * 2;
+
+	if( maxBuffers < numBuffers )
+		maxBuffers = numBuffers;
+
+	videoFramePool* pool = new videoFramePool(size, zeroCopy, maxBuffers, sourceID);
+
+	for( uint32_t n=0; n < numBuffers; n++ )
+	{
+		Buffer* buffer = pool->allocBuffer();
+
+		if( !buffer )
+		{
+			pool->Release();
+			return NULL;
+		}
+
+		pool->mFree.push_back(buffer);
+	}
+
+	return pool;
+}
+
+
+// constructor
+videoFramePool::videoFramePool( size_t size, bool zeroCopy, uint32_t maxBuffers, uint32_t sourceID )
+{
+	mRefCount   = 1;
+	mBufferSize = size;
+	mNumBuffers = 0;
+	mMaxBuffers = maxBuffers;
+	mSourceID   = sourceID;
+	mSequence   = 0;
+	mZeroCopy   = zeroCopy;
+}
+
+
+// destructor
+videoFramePool::~videoFramePool()
+{
+	for( size_t n=0; n < mBuffers.size(); n++ )
+	{
+		if( mZeroCopy )
+		{
+			CUDA_FREE_HOST(mBuffers[n]->image);
+		}
+		else
+		{
+			CUDA_FREE(mBuffers[n]->image);
+		}
+
+		delete mBuffers[n];
+	}
+}
+
+
+// Release
+void videoFramePool::Release()
+{
+	releasePool();
+}
+
+
+// releasePool
+void videoFramePool::releasePool()
+{
+	if( --mRefCount == 0 )
+		delete this;
+}
+
+
+// allocBuffer
+videoFramePool::Buffer* videoFramePool::allocBuffer()
+{
+	void* image = NULL;
+
+	if( mZeroCopy )
+	{
+		if( !cudaAllocMapped(&image, mBufferSize, false) )
+			return NULL;
+	}
+	else
+	{
+		if( CUDA_FAILED(cudaMalloc(&image, mBufferSize)) )
+			return NULL;
+	}
+
+	Buffer* buffer = new Buffer();
+
+	buffer->image    = image;
+	buffer->size     = mBufferSize;
+	buffer->adopted  = false;
+	buffer->pool     = this;
+	buffer->refCount = 0;
+
+	mBuffers.push_back(buffer);
+	mNumBuffers++;
+
+	return buffer;
+}
+
+
+// initBuffer
+videoFramePool::Buffer* videoFramePool::initBuffer( Buffer* buffer, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp, uint64_t sequence )
+{
+	buffer->width     = width;
+	buffer->height    = height;
+	buffer->format    = format;
+	buffer->timestamp = timestamp;
+	buffer->sequence  = (sequence != UINT64_MAX) ? sequence : mSequence;
+	buffer->refCount  = 1;
+
+	mSequence = buffer->sequence + 1;
+	mRefCount++;	// each frame holds a reference to the pool
+
+	return buffer;
+}
+
+
+// Acquire
+bool videoFramePool::Acquire( videoFrame* frame, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp, uint64_t sequence )
+{
+	if( TryAcquire(frame, width, height, format, timestamp, sequence) )
+		return true;
+
+	if( frame != NULL && imageFormatSize(format, width, height) <= mBufferSize )
+		LogError("videoFramePool -- all %u frames are in use by the application, release some frames\n", mNumBuffers);
+
+	return false;
+}
+
+
+// TryAcquire
+bool videoFramePool::TryAcquire( videoFrame* frame, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp, uint64_t sequence )
+{
+	if( !frame )
+		return false;
+
+	const size_t size = imageFormatSize(format, width, height);
+
+	if( size > mBufferSize )
+	{
+		LogError("videoFramePool -- %ux%u %s image (%zu bytes) is larger than the buffers (%zu bytes)\n", width, height, imageFormatToStr(format), size, mBufferSize);
+		return false;
+	}
+
+	mMutex.Lock();
+
+	Buffer* buffer = NULL;
+
+	if( mFree.size() > 0 )
+	{
+		buffer = mFree.back();
+		mFree.pop_back();
+	}
+	else if( mNumBuffers < mMaxBuffers )
+	{
+		buffer = allocBuffer();
+
+		if( buffer != NULL )
+			LogVerbose("videoFramePool -- all frames are in use, allocated another buffer (%u total)\n", mNumBuffers);
+	}
+
+	if( buffer != NULL )
+		initBuffer(buffer, width, height, format, timestamp, sequence);
+
+	mMutex.Unlock();
+
+	if( !buffer )
+		return false;
+
+	frame->Release();
+	frame->mBuffer = buffer;
+
+	return true;
+}
+
+
+// Adopt
+bool videoFramePool::Adopt( videoFrame* frame, void* image, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp, uint64_t sequence )
+{
+	if( !frame || !image )
+		return false;
+
+	Buffer* buffer = new Buffer();
+
+	buffer->image   = image;
+	buffer->size    = imageFormatSize(format, width, height);
+	buffer->adopted = true;
+	buffer->pool    = this;
+
+	mMutex.Lock();
+	initBuffer(buffer, width, height, format, timestamp, sequence);
+	mMutex.Unlock();
+
+	frame->Release();
+	frame->mBuffer = buffer;
+
+	return true;
+}
+
+
+// releaseBuffer
+void videoFramePool::releaseBuffer( Buffer* buffer )
+{
+	if( buffer->adopted )
+	{
+		CUDA_FREE_HOST(buffer->image);
+		delete buffer;
+	}
+	else
+	{
+		mMutex.Lock();
+		mFree.push_back(buffer);
+		mMutex.Unlock();
+	}
+
+	releasePool();
+}
+
+
+// GetNumFree
+uint32_t videoFramePool::GetNumFree()
+{
+	mMutex.Lock();
+	const uint32_t numFree = mFree.size();
+	mMutex.Unlock();
+	return numFree;
+}
+
+
+// Release
+void videoFrame::Release()
+{
+	if( !mBuffer )
+		return;
+
+	if( --mBuffer->refCount == 0 )
+		mBuffer->pool->releaseBuffer(mBuffer);
+
+	mBuffer = NULL;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VIDEO_FRAME_H_
+#define __VIDEO_FRAME_H_
+
+
+#include "imageFormat.h"
+#include "Mutex.h"
+
+#include <atomic>
+#include <vector>
+
+
+class videoFrame;
+
+
+/**
+ * Pool of image buffers that get handed out as reference-counted videoFrame's.
+ *
+ * A buffer is only reused after the last videoFrame referencing it has been released,
+ * so frames can be held onto (or passed to other threads) for as long as needed without
+ * being overwritten.  If all of the buffers are in use when a new frame is acquired,
+ * the pool grows up to its maximum number of buffers.
+ *
+ * The pool is also reference-counted by its frames, so the owner can Release() it
+ * (e.g. when the video source is closed) while the application still holds frames.
+ *
+ * @ingroup video
+ */
+class videoFramePool
+{
+public:
+	/**
+	 * Create a pool of buffers.
+	 * @param numBuffers the number of buffers to allocate up-front (if 0 along with the size, the pool is only used with Adopt()).
+	 * @param size the size of each buffer (in bytes).
+	 * @param zeroCopy if true, allocate the buffers in mapped CPU/GPU memory (otherwise GPU memory).
+	 * @param maxBuffers the number of buffers the pool can grow to (the default of 0 is twice numBuffers).
+	 * @param sourceID the ID of the videoSource that the frames come from.
+	 */
+	static videoFramePool* Create( uint32_t numBuffers, size_t size, bool zeroCopy=true, uint32_t maxBuffers=0, uint32_t sourceID=0 );
+
+	/**
+	 * Release the owner's reference to the pool.  It gets deleted once the frames from it are released.
+	 */
+	void Release();
+
+	/**
+	 * Acquire an unused buffer and set the frame to reference it.
+	 * The buffer must be large enough for an image of the specified size and format.
+	 * @param sequence the frame's sequence number (by default, the pool numbers the frames in order).
+	 * @returns false if all the buffers are in use and the pool can't grow.
+	 */
+	bool Acquire( videoFrame* frame, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp=0, uint64_t sequence=UINT64_MAX );
+
+	/**
+	 * Like Acquire(), but without logging an error when all the buffers are in use,
+	 * for callers that expect it to happen and have a fallback.
+	 */
+	bool TryAcquire( videoFrame* frame, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp=0, uint64_t sequence=UINT64_MAX );
+
+	/**
+	 * Wrap an image that was allocated with cudaAllocMapped() in a frame, which takes ownership of it.
+	 * The image gets freed with cudaFreeHost() when the last reference to the frame is released.
+	 */
+	bool Adopt( videoFrame* frame, void* image, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp=0, uint64_t sequence=UINT64_MAX );
+
+	/**
+	 * Get the size of each buffer (in bytes).
+	 */
+	inline size_t GetBufferSize() const		{ return mBufferSize; }
+
+	/**
+	 * Get the number of buffers that have been allocated.
+	 */
+	inline uint32_t GetNumBuffers() const		{ return mNumBuffers; }
+
+	/**
+	 * Get the number of buffers that aren't in use.
+	 */
+	uint32_t GetNumFree();
+
+	/**
+	 * Return true if the buffers are in mapped CPU/GPU memory.
+	 */
+	inline bool IsZeroCopy() const			{ return mZeroCopy; }
+
+	/**
+	 * Internal buffer that's shared by videoFrame's.
+	 */
+	struct Buffer
+	{
+		void*       image;
+		size_t      size;
+		uint32_t    width;
+		uint32_t    height;
+		imageFormat format;
+		uint64_t    timestamp;
+		uint64_t    sequence;
+		bool        adopted;
+
+		videoFramePool* pool;
+		std::atomic<uint32_t> refCount;
+	};
+
+protected:
+	friend class videoFrame;
+
+	videoFramePool( size_t size, bool zeroCopy, uint32_t maxBuffers, uint32_t sourceID );
+	~videoFramePool();
+
+	Buffer* allocBuffer();
+	Buffer* initBuffer( Buffer* buffer, uint32_t width, uint32_t height, imageFormat format, uint64_t timestamp, uint64_t sequence );
+	void releaseBuffer( Buffer* buffer );
+	void releasePool();
+
+	std::vector<Buffer*> mBuffers;
+	std::vector<Buffer*> mFree;
+
+	Mutex mMutex;
+	std::atomic<uint32_t> mRefCount;
+
+	size_t   mBufferSize;
+	uint32_t mNumBuffers;
+	uint32_t mMaxBuffers;
+	uint32_t mSourceID;
+	uint64_t mSequence;
+	bool     mZeroCopy;
+};
+
+
+/**
+ * Reference-counted handle to an image captured from a videoSource (see videoSource::Capture()).
+ *
+ * Copies of a videoFrame share the same image, which stays valid until the last copy has been
+ * released (either with Release() or when it's destroyed) and then goes back to its videoFramePool.
+ * This makes it safe to hold onto frames or hand them off to other threads without copying them.
+ *
+ * @ingroup video
+ */
+class videoFrame
+{
+public:
+	/**
+	 * Create an empty frame.
+	 */
+	inline videoFrame() : mBuffer(NULL) {}
+
+	/**
+	 * Copy constructor, which adds a reference to the frame.
+	 */
+	inline videoFrame( const videoFrame& frame ) : mBuffer(frame.mBuffer)	{ if( mBuffer != NULL ) mBuffer->refCount++; }
+
+	/**
+	 * Destructor, which releases this reference to the frame.
+	 */
+	inline ~videoFrame()									{ Release(); }
+
+	/**
+	 * Assignment operator, which releases the old frame and adds a reference to the new one.
+	 */
+	inline videoFrame& operator = ( const videoFrame& frame )		{ if( frame.mBuffer != NULL ) frame.mBuffer->refCount++; Release(); mBuffer = frame.mBuffer; return *this; }
+
+	/**
+	 * Release this reference to the frame, leaving it empty.
+	 */
+	void Release();
+
+	/**
+	 * Return true if the frame references an image.
+	 */
+	inline bool IsValid() const							{ return (mBuffer != NULL); }
+
+	/**
+	 * Get the image.
+	 */
+	inline void* GetImage() const							{ return mBuffer ? mBuffer->image : NULL; }
+
+	/**
+	 * Get the image, cast to the specified type.
+	 */
+	template<typename T> T* GetImage() const				{ return (T*)GetImage(); }
+
+	/**
+	 * Get the width of the image (in pixels).
+	 */
+	inline uint32_t GetWidth() const						{ return mBuffer ? mBuffer->width : 0; }
+
+	/**
+	 * Get the height of the image (in pixels).
+	 */
+	inline uint32_t GetHeight() const						{ return mBuffer ? mBuffer->height : 0; }
+
+	/**
+	 * Get the format of the image.
+	 */
+	inline imageFormat GetFormat() const					{ return mBuffer ? mBuffer->format : IMAGE_UNKNOWN; }
+
+	/**
+	 * Get the size of the image (in bytes).
+	 */
+	inline size_t GetSize() const							{ return mBuffer ? imageFormatSize(mBuffer->format, mBuffer->width, mBuffer->height) : 0; }
+
+	/**
+	 * Get the timestamp of the frame (in nanoseconds).
+	 */
+	inline uint64_t GetTimestamp() const					{ return mBuffer ? mBuffer->timestamp : 0; }
+
+	/**
+	 * Get the sequence number of the frame from its source (gaps indicate dropped frames).
+	 */
+	inline uint64_t GetSequence() const					{ return mBuffer ? mBuffer->sequence : 0; }
+
+	/**
+	 * Get the ID of the videoSource that the frame came from.
+	 */
+	inline uint32_t GetSourceID() const					{ return (mBuffer && mBuffer->pool) ? mBuffer->pool->mSourceID : 0; }
+
+	/**
+	 * Get the number of references to the frame.
+	 */
+	inline uint32_t GetRefCount() const					{ return mBuffer ? mBuffer->refCount.load() : 0; }
+
+protected:
+	friend class videoFramePool;
+
+	videoFramePool::Buffer* mBuffer;
+};
+
+#endif
@@ -39,6 +39,7 @@ videoOptions::videoOptions()
 	loop        = 0;
 	latency     = 10;
 	zeroCopy    = true;
+	retainBuffers = 0;
 	ioType      = INPUT;
 	deviceType  = DEVICE_DEFAULT;
 	flipMethod  = FLIP_DEFAULT;
@@ -87,6 +88,9 @@ void videoOptions::Print( const char* prefix ) const
 	
 	LogInfo("  -- numBuffers: %u\n", numBuffers);
 	LogInfo("  -- zeroCopy:   %s\n", zeroCopy ? "true" : "false");	
+
+	if( ioType == INPUT && retainBuffers > 0 )
+		LogInfo("  -- retain:     %u\n", retainBuffers);
 	
 	if( ioType == INPUT )
 	{
@@ -236,6 +240,10 @@ bool videoOptions::Parse( const char* URI, const commandLine& cmdLine, videoOpti
 	if( type == INPUT )
 		loop = cmdLine.GetInt("input-loop", cmdLine.GetInt("loop", loop));
 
+	// retained GstBuffers
+	if( type == INPUT )
+		retainBuffers = cmdLine.GetUnsignedInt("input-retain", retainBuffers);
+
 	// latency
 	latency = (type == INPUT) ? cmdLine.GetUnsignedInt("input-latency", cmdLine.GetUnsignedInt("input-rtsp-latency", latency))
 						 : cmdLine.GetUnsignedInt("output-latency", latency);
@@ -102,6 +102,17 @@ public:
 	 * @note the default is true (zeroCopy CPU/GPU access enabled).
 	 */
 	bool zeroCopy;
+
+	/**
+	 * The maximum number of upstream GstBuffers that an input stream keeps mapped in its
+	 * ringbuffer instead of copying them (see gstBufferManager).  The retained buffers can't be
+	 * recycled by the upstream element, so this should be less than the size of its buffer pool
+	 * (small pools like v4l2src or decoder output pools stall if all their buffers are held).
+	 * Once that many are retained, the frames get copied until some of them are released.
+	 * This option can be set from the command line using `--input-retain=N`.
+	 * @note by default, retention is disabled (set to `0`) and the frames are copied.
+	 */
+	uint32_t retainBuffers;
 	
 	/**
 	 * Control the number of loops for videoSource disk-based inputs (for example,
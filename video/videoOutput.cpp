@@ -22,6 +22,7 @@
  
 #include "videoOutput.h"
 #include "imageWriter.h"
+#include "shmOutput.h"
 
 #include "glDisplay.h"
 #include "gstEncoder.h"
@@ -111,6 +112,10 @@ videoOutput* videoOutput::Create( const videoOptions& options )
 	{
 		output = glDisplay::Create(options);
 	}
+	else if( uri.protocol == "shm" )
+	{
+		output = shmOutput::Create(options);
+	}
 	else
 	{
 		LogError(LOG_VIDEO "videoOutput -- unsupported protocol (%s)\n", uri.protocol.size() > 0 ? uri.protocol.c_str() : "null");
@@ -239,6 +244,8 @@ const char* videoOutput::TypeToStr( uint32_t type )
 		return "gstEncoder";
 	else if( type == imageWriter::Type )
 		return "imageWriter";
+	else if( type == shmOutput::Type )
+		return "shmOutput";
 
 	LogWarning(LOG_VIDEO "unknown videoOutput type - %u\n", type);
 	return "(unknown)";
@@ -44,6 +44,7 @@
 		  "                             * rtsp://@:8554/my_stream   (RTSP stream)\n"		\
 		  "                             * webrtc://@:1234/my_stream (WebRTC stream)\n"      	\
 		  "                             * display://0               (OpenGL window)\n" 		\
+		  "                             * shm://my_stream           (shared memory stream)\n"	\
 		  "  --output-codec=CODEC   desired codec for compressed output streams:\n"		\
 		  "                            * h264 (default), h265\n"						\
 		  "                            * vp8, vp9\n"									\
@@ -65,7 +66,7 @@
  * The videoOutput API is for rendering and transmitting frames to video input devices such as display windows, 
  * broadcasting RTP network streams to remote hosts over UDP/IP, and saving videos/images/directories to disk. 
  *
- * videoOutput interfaces are implemented by glDisplay, gstEncoder, and imageWriter.  
+ * videoOutput interfaces are implemented by glDisplay, gstEncoder, imageWriter, and shmOutput.  
  * The specific implementation is selected at runtime based on the type of resource URI.
  * An instance can have multiple sub-streams, for example simultaneously outputting to 
  * a display and encoded video on disk or RTP stream.
@@ -98,6 +99,10 @@
  *        encoding include H.264, H.265, VP8, VP9, and MJPEG. Supported image formats for saving 
  *        include JPG, PNG, TGA, and BMP.
  *
+ *     - `shm://my_stream` to share frames with other processes on the same system through shared memory,
+ *        which can receive them with a `shm://my_stream` videoSource.  Any number of processes can connect
+ *        to the stream, and they map the frames without copies (see shmOutput).
+ *
  * @see URI for info about resource URI formats.
  * @see videoOptions for additional options and command-line arguments.
  * @ingroup video
@@ -294,6 +299,7 @@ public:
 	 *    - glDisplay::Type
 	 *    - gstEncoder::Type
 	 *    - imageWriter::Type
+	 *    - shmOutput::Type
 	 */
 	virtual inline uint32_t GetType() const			{ return 0; }
 
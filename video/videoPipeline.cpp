@@ -0,0 +1,580 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "videoPipeline.h"
+
+#include "cudaMappedMemory.h"
+#include "logging.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+
+// constructor
+videoPipeline::videoPipeline( uint32_t numBuffers, uint32_t queueDepth, FrameQueue<Frame*>::Policy policy ) : mFreeBuffers(numBuffers, FrameQueue<Frame*>::Block)
+{
+	mPolicy      = policy;
+	mQueueDepth  = queueDepth;
+	mStop        = false;
+	mActiveNodes = 0;
+	mStarted     = false;
+
+	mStartedNodes = 0;
+
+	for( uint32_t n=0; n < numBuffers; n++ )
+	{
+		Buffer* buffer = new Buffer();
+
+		memset(&buffer->frame, 0, sizeof(Frame));
+		buffer->refCount = 0;
+
+		mBuffers.push_back(buffer);
+		mFreeBuffers.Push(&buffer->frame);
+	}
+}
+
+
+// destructor
+videoPipeline::~videoPipeline()
+{
+	Stop();
+
+	for( size_t n=0; n < mNodes.size(); n++ )
+	{
+		if( mNodes[n]->queue != NULL )
+			delete mNodes[n]->queue;
+
+		if( mNodes[n]->stream != NULL )
+			CUDA(cudaStreamDestroy(mNodes[n]->stream));
+
+		delete mNodes[n];
+	}
+
+	for( size_t n=0; n < mBuffers.size(); n++ )
+		delete mBuffers[n];
+}
+
+
+// addNode
+int videoPipeline::addNode( NodeType type, const char* name )
+{
+	if( mStarted )
+	{
+		LogError(LOG_VIDEO "videoPipeline -- nodes can't be added while the pipeline is running\n");
+		return -1;
+	}
+
+	Node* node = new Node();
+
+	node->pipeline = this;
+	node->type     = type;
+	node->id       = mNodes.size();
+	node->source   = NULL;
+	node->output   = NULL;
+	node->format   = IMAGE_UNKNOWN;
+	node->function = NULL;
+	node->user     = NULL;
+	node->queue    = NULL;
+	node->stream   = NULL;
+
+	node->activeInputs = 0;
+	node->numInputs    = 0;
+
+	node->frames          = 0;
+	node->dropped         = 0;
+	node->rateFrames      = 0;
+	node->latencySum      = 0.0;
+	node->latencyMax      = 0.0;
+	node->totalLatencySum = 0.0;
+	node->latencyFrames   = 0;
+	node->rateTime        = timeMonotonic();
+
+	if( type != NODE_SOURCE )
+		node->queue = new FrameQueue<Frame*>(mQueueDepth, mPolicy);
+
+	if( name != NULL )
+	{
+		node->name = name;
+	}
+	else
+	{
+		char str[32];
+		sprintf(str, "%s%i", (type == NODE_SOURCE) ? "source" : (type == NODE_OUTPUT) ? "output" : "process", node->id);
+		node->name = str;
+	}
+
+	mNodes.push_back(node);
+	return node->id;
+}
+
+
+// AddSource
+int videoPipeline::AddSource( videoSource* source, imageFormat format, const char* name )
+{
+	if( !source )
+	{
+		LogError(LOG_VIDEO "videoPipeline -- AddSource() was passed a NULL videoSource\n");
+		return -1;
+	}
+
+	const int id = addNode(NODE_SOURCE, name);
+
+	if( id < 0 )
+		return -1;
+
+	mNodes[id]->source = source;
+	mNodes[id]->format = format;
+
+	// each source converts frames on its own stream, so it only waits on its own work
+	if( CUDA_FAILED(cudaStreamCreateWithFlags(&mNodes[id]->stream, cudaStreamNonBlocking)) )
+		mNodes[id]->stream = NULL;
+
+	return id;
+}
+
+
+// AddProcess
+int videoPipeline::AddProcess( ProcessFunction function, void* user, const char* name )
+{
+	if( !function )
+	{
+		LogError(LOG_VIDEO "videoPipeline -- AddProcess() was passed a NULL function\n");
+		return -1;
+	}
+
+	const int id = addNode(NODE_PROCESS, name);
+
+	if( id < 0 )
+		return -1;
+
+	mNodes[id]->function = function;
+	mNodes[id]->user     = user;
+
+	return id;
+}
+
+
+// AddOutput
+int videoPipeline::AddOutput( videoOutput* output, const char* name )
+{
+	if( !output )
+	{
+		LogError(LOG_VIDEO "videoPipeline -- AddOutput() was passed a NULL videoOutput\n");
+		return -1;
+	}
+
+	const int id = addNode(NODE_OUTPUT, name);
+
+	if( id < 0 )
+		return -1;
+
+	mNodes[id]->output = output;
+	return id;
+}
+
+
+// Connect
+bool videoPipeline::Connect( int from, int to )
+{
+	if( from < 0 || from >= (int)mNodes.size() || to < 0 || to >= (int)mNodes.size() || from == to )
+	{
+		LogError(LOG_VIDEO "videoPipeline -- invalid node IDs passed to Connect(%i, %i)\n", from, to);
+		return false;
+	}
+
+	if( mStarted )
+	{
+		LogError(LOG_VIDEO "videoPipeline -- nodes can't be connected while the pipeline is running\n");
+		return false;
+	}
+
+	if( mNodes[to]->type == NODE_SOURCE )
+	{
+		LogError(LOG_VIDEO "videoPipeline -- can't connect node '%s' to source node '%s'\n", mNodes[from]->name.c_str(), mNodes[to]->name.c_str());
+		return false;
+	}
+
+	mNodes[from]->downstream.push_back(mNodes[to]);
+	mNodes[to]->numInputs++;
+
+	return true;
+}
+
+
+// Start
+bool videoPipeline::Start()
+{
+	if( mStarted )
+		return true;
+
+	for( size_t n=0; n < mNodes.size(); n++ )
+	{
+		if( mNodes[n]->type != NODE_SOURCE && mNodes[n]->numInputs == 0 )
+		{
+			LogError(LOG_VIDEO "videoPipeline -- node '%s' isn't connected to any inputs\n", mNodes[n]->name.c_str());
+			return false;
+		}
+	}
+
+	mStop = false;
+	mActiveNodes = mNodes.size();
+	mStartedNodes = 0;
+	mStarted = true;
+
+	for( size_t n=0; n < mNodes.size(); n++ )
+	{
+		Node* node = mNodes[n];
+
+		node->activeInputs = node->numInputs;
+		node->rateTime = timeMonotonic();
+
+		if( node->queue != NULL )
+			node->queue->Open();
+	}
+
+	for( size_t n=0; n < mNodes.size(); n++ )
+	{
+		if( !mNodes[n]->thread.Start(&nodeThread, mNodes[n]) )
+		{
+			LogError(LOG_VIDEO "videoPipeline -- failed to start thread for node '%s'\n", mNodes[n]->name.c_str());
+
+			// the nodes that never ran still need to close their downstream queues,
+			// then Stop() only unwinds the nodes that were started
+			for( size_t m=n; m < mNodes.size(); m++ )
+				finish(mNodes[m]);
+
+			Stop();
+			return false;
+		}
+
+		mStartedNodes++;
+	}
+
+	return true;
+}
+
+
+// Stop
+void videoPipeline::Stop()
+{
+	if( !mStarted )
+		return;
+
+	mStop = true;
+
+	// unblock any nodes that are waiting on their queues
+	for( size_t n=0; n < mNodes.size(); n++ )
+	{
+		if( mNodes[n]->queue != NULL )
+			mNodes[n]->queue->Close();
+	}
+
+	for( uint32_t n=0; n < mStartedNodes; n++ )
+		mNodes[n]->thread.Stop(true);
+
+	mStartedNodes = 0;
+
+	// recycle any frames that were left in the queues
+	for( size_t n=0; n < mNodes.size(); n++ )
+	{
+		Frame* frame = NULL;
+
+		while( mNodes[n]->queue != NULL && mNodes[n]->queue->Pop(&frame, 0) )
+			release((Buffer*)frame);
+	}
+
+	mStarted = false;
+}
+
+
+// IsStreaming
+bool videoPipeline::IsStreaming() const
+{
+	return mActiveNodes > 0;
+}
+
+
+// GetNodeName
+const char* videoPipeline::GetNodeName( int node ) const
+{
+	if( node < 0 || node >= (int)mNodes.size() )
+		return NULL;
+
+	return mNodes[node]->name.c_str();
+}
+
+
+// nodeThread
+void* videoPipeline::nodeThread( void* param )
+{
+	Node* node = (Node*)param;
+	videoPipeline* pipeline = node->pipeline;
+
+	if( node->type == NODE_SOURCE )
+	{
+		while( !pipeline->mStop )
+		{
+			if( !pipeline->capture(node) )
+				break;
+		}
+	}
+	else
+	{
+		Frame* frame = NULL;
+
+		while( node->queue->Pop(&frame) )
+		{
+			Buffer* buffer = (Buffer*)frame;
+
+			if( pipeline->mStop )
+			{
+				pipeline->release(buffer);
+				continue;
+			}
+
+			const timespec begin = timeMonotonic();
+
+			if( node->type == NODE_PROCESS )
+			{
+				if( !node->function(frame, node->user) )
+				{
+					node->statsMutex.Lock();
+					node->dropped++;
+					node->statsMutex.Unlock();
+
+					pipeline->release(buffer);
+					continue;
+				}
+			}
+			else if( node->type == NODE_OUTPUT )
+			{
+				if( !node->output->Render(frame->image, frame->width, frame->height, frame->format) )
+					LogVerbose(LOG_VIDEO "videoPipeline -- node '%s' failed to render frame %" PRIu64 "\n", node->name.c_str(), frame->number);
+			}
+
+			pipeline->deliver(node, buffer, begin);
+		}
+	}
+
+	pipeline->finish(node);
+	return NULL;
+}
+
+
+// capture
+bool videoPipeline::capture( Node* node )
+{
+	videoFrame captured;
+	int status = 0;
+
+	if( !node->source->Capture(&captured, node->format, videoSource::DEFAULT_TIMEOUT, &status, node->stream) )
+	{
+		if( status == videoSource::TIMEOUT )
+			return true;
+
+		if( status == videoSource::EOS )
+			LogInfo(LOG_VIDEO "videoPipeline -- node '%s' reached end-of-stream\n", node->name.c_str());
+		else
+			LogError(LOG_VIDEO "videoPipeline -- node '%s' failed to capture video frame\n", node->name.c_str());
+
+		return false;
+	}
+
+	const timespec begin = timeMonotonic();
+
+	// if all the frame buffers are still in flight downstream, drop this frame
+	Frame* frame = NULL;
+
+	if( !mFreeBuffers.Pop(&frame, 0) )
+	{
+		node->statsMutex.Lock();
+		node->dropped++;
+		node->statsMutex.Unlock();
+		return true;
+	}
+
+	Buffer* buffer = (Buffer*)frame;
+
+	// the frame is converted asynchronously, and the other nodes could use it from the CPU
+	if( CUDA_FAILED(cudaStreamSynchronize(node->stream)) )
+	{
+		mFreeBuffers.Push(frame);
+		return false;
+	}
+
+	// the source timestamps frames when they're captured (in the same timebase as timeMonotonic)
+	const uint64_t timestamp = captured.GetTimestamp();
+
+	buffer->captured = captured;
+
+	frame->image     = captured.GetImage();
+	frame->width     = captured.GetWidth();
+	frame->height    = captured.GetHeight();
+	frame->format    = captured.GetFormat();
+	frame->size      = captured.GetSize();
+	frame->number    = node->frames;
+	frame->source    = node->id;
+	frame->timestamp = (timestamp != 0) ? timeNew(timestamp) : begin;
+	frame->user      = NULL;
+
+	buffer->refCount = 1;
+
+	deliver(node, buffer, begin);
+	return true;
+}
+
+
+// deliver
+void videoPipeline::deliver( Node* node, Buffer* buffer, const timespec& begin )
+{
+	const timespec end = timeMonotonic();
+
+	const double latency = timeDouble(timeDiff(begin, end));
+	const double totalLatency = timeDouble(timeDiff(buffer->frame.timestamp, end));
+
+	node->statsMutex.Lock();
+
+	node->frames++;
+	node->latencyFrames++;
+	node->latencySum += latency;
+	node->totalLatencySum += totalLatency;
+
+	if( latency > node->latencyMax )
+		node->latencyMax = latency;
+
+	node->statsMutex.Unlock();
+
+	// pass the frame on to each downstream node (with a reference for each one)
+	const size_t numDownstream = node->downstream.size();
+
+	if( numDownstream == 0 )
+	{
+		release(buffer);
+		return;
+	}
+
+	buffer->refCount += numDownstream - 1;
+
+	for( size_t n=0; n < numDownstream; n++ )
+	{
+		Node* next = node->downstream[n];
+
+		Frame* dropped = NULL;
+		bool wasDropped = false;
+
+		next->queue->Push(&buffer->frame, UINT64_MAX, &dropped, &wasDropped);
+
+		if( wasDropped )
+		{
+			next->statsMutex.Lock();
+			next->dropped++;
+			next->statsMutex.Unlock();
+
+			release((Buffer*)dropped);
+		}
+	}
+}
+
+
+// release
+void videoPipeline::release( Buffer* buffer )
+{
+	if( --buffer->refCount != 0 )
+		return;
+
+	// hand the image back to the source before the buffer can be reused
+	buffer->captured.Release();
+	buffer->frame.image = NULL;
+
+	mFreeBuffers.Push(&buffer->frame);
+}
+
+
+// finish
+void videoPipeline::finish( Node* node )
+{
+	// once all of a node's inputs have finished, it finishes after draining its queue
+	for( size_t n=0; n < node->downstream.size(); n++ )
+	{
+		if( --node->downstream[n]->activeInputs == 0 )
+			node->downstream[n]->queue->Close();
+	}
+
+	mActiveNodes--;
+}
+
+
+// GetStats
+videoPipeline::Stats videoPipeline::GetStats( int id )
+{
+	Stats stats;
+	memset(&stats, 0, sizeof(Stats));
+
+	if( id < 0 || id >= (int)mNodes.size() )
+		return stats;
+
+	Node* node = mNodes[id];
+
+	const timespec now = timeMonotonic();
+
+	node->statsMutex.Lock();
+
+	const double elapsed = timeDouble(timeDiff(node->rateTime, now)) * 0.001;
+
+	stats.frames    = node->frames;
+	stats.dropped   = node->dropped;
+	stats.queued    = (node->queue != NULL) ? node->queue->GetDepth() : 0;
+	stats.frameRate = (elapsed > 0.0) ? (node->frames - node->rateFrames) / elapsed : 0.0f;
+
+	if( node->latencyFrames > 0 )
+	{
+		stats.latency      = node->latencySum / node->latencyFrames;
+		stats.maxLatency   = node->latencyMax;
+		stats.totalLatency = node->totalLatencySum / node->latencyFrames;
+	}
+
+	node->rateTime        = now;
+	node->rateFrames      = node->frames;
+	node->latencySum      = 0.0;
+	node->latencyMax      = 0.0;
+	node->totalLatencySum = 0.0;
+	node->latencyFrames   = 0;
+
+	node->statsMutex.Unlock();
+	return stats;
+}
+
+
+// PrintStats
+void videoPipeline::PrintStats()
+{
+	LogInfo(LOG_VIDEO "videoPipeline -- %zu nodes\n", mNodes.size());
+
+	for( size_t n=0; n < mNodes.size(); n++ )
+	{
+		const Stats stats = GetStats(n);
+
+		LogInfo(LOG_VIDEO "   %-16s  %6.1f FPS  %7.2f ms (max %7.2f ms)  %7.2f ms total  %8" PRIu64 " frames  %6" PRIu64 " dropped  %2u queued\n",
+			   mNodes[n]->name.c_str(), stats.frameRate, stats.latency, stats.maxLatency, stats.totalLatency,
+			   stats.frames, stats.dropped, stats.queued);
+	}
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VIDEO_PIPELINE_H_
+#define __VIDEO_PIPELINE_H_
+
+
+#include "videoSource.h"
+#include "videoOutput.h"
+
+#include "FrameQueue.h"
+#include "Thread.h"
+#include "Mutex.h"
+#include "timespec.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+
+/**
+ * Dataflow graph that runs video sources, processing stages, and video outputs concurrently.
+ *
+ * Each node in the graph runs on its own thread, and the nodes are connected by bounded
+ * FrameQueue's, so that capture, processing (like inference) and encoding/rendering all
+ * overlap instead of running back-to-back in one loop:
+ *
+ * @code
+ *    videoPipeline pipeline;
+ *
+ *    const int camera  = pipeline.AddSource(videoSource::Create("csi://0"));
+ *    const int detect  = pipeline.AddProcess(myDetectFunction, myNetwork);
+ *    const int display = pipeline.AddOutput(videoOutput::Create("display://0"));
+ *
+ *    pipeline.Connect(camera, detect);
+ *    pipeline.Connect(detect, display);
+ *
+ *    pipeline.Start();
+ * @endcode
+ *
+ * Sources capture into reference-counted videoFrame's (see videoSource::Capture(videoFrame*)),
+ * so the images aren't copied, and each one is handed back to its source after the last node is
+ * done with it.  When a node is connected to more than one downstream node, the same frame is
+ * shared by each branch (so processing stages on parallel branches shouldn't modify it).  If all
+ * of the pipeline's frame buffers are in flight, or a node's input queue overflows, frames get
+ * dropped according to the pipeline's FrameQueue::Policy.
+ *
+ * Latency and throughput statistics are kept for each node (see GetStats() and PrintStats()).
+ *
+ * @ingroup video
+ */
+class videoPipeline
+{
+public:
+	/**
+	 * A frame travelling through the pipeline.
+	 */
+	struct Frame
+	{
+		void*       image;		/**< Image in shared CPU/GPU memory (owned by the source's videoFrame) */
+		uint32_t    width;		/**< Width of the image (in pixels) */
+		uint32_t    height;		/**< Height of the image (in pixels) */
+		imageFormat format;		/**< Format of the image */
+		size_t      size;		/**< Size of the image (in bytes) */
+		uint64_t    number;		/**< Frame number from the source (starting at 0) */
+		int         source;		/**< Node ID of the source that captured the frame */
+		timespec    timestamp;	/**< Time that the frame was captured (from videoSource::GetLastTimestamp(), in the timeMonotonic() timebase) */
+		void*       user;		/**< Optional data that processing stages can attach (reset for each new frame) */
+	};
+
+	/**
+	 * User-supplied processing function that's called for each frame.
+	 * @returns true to pass the frame on to the downstream nodes, or false to drop it.
+	 */
+	typedef bool (*ProcessFunction)( Frame* frame, void* user );
+
+	/**
+	 * Node statistics (see GetStats())
+	 */
+	struct Stats
+	{
+		uint64_t frames;		/**< Total number of frames that the node has processed */
+		uint64_t dropped;		/**< Total number of frames that were dropped at the node's input or by the node */
+		uint32_t queued;		/**< Number of frames currently waiting in the node's input queue */
+		float    frameRate;		/**< Frames per second processed since the previous call to GetStats() */
+		float    latency;		/**< Average time (in milliseconds) that the node spent on each frame */
+		float    maxLatency;	/**< Maximum time (in milliseconds) that the node spent on a frame */
+		float    totalLatency;	/**< Average time (in milliseconds) from when frames were captured until the node finished them */
+	};
+
+	/**
+	 * Create an empty pipeline.
+	 * @param numBuffers the number of frames that the sources can have in flight at once.
+	 * @param queueDepth the number of frames each node's input queue can hold.
+	 * @param policy what to do when a node's input queue is full (see FrameQueue::Policy).
+	 *               The default of DropOldest keeps the pipeline running in realtime,
+	 *               while Block applies backpressure to the upstream nodes instead.
+	 */
+	videoPipeline( uint32_t numBuffers=8, uint32_t queueDepth=2, FrameQueue<Frame*>::Policy policy=FrameQueue<Frame*>::DropOldest );
+
+	/**
+	 * Destructor.  Stops the pipeline, but doesn't delete the sources or outputs.
+	 */
+	~videoPipeline();
+
+	/**
+	 * Add a source node that captures frames in the specified format.
+	 * @returns the node ID, or -1 on error.
+	 */
+	int AddSource( videoSource* source, imageFormat format=IMAGE_RGB8, const char* name=NULL );
+
+	/**
+	 * Add a processing node that calls the user-supplied function on each frame.
+	 * @returns the node ID, or -1 on error.
+	 */
+	int AddProcess( ProcessFunction function, void* user=NULL, const char* name=NULL );
+
+	/**
+	 * Add an output node that renders each frame.
+	 * @returns the node ID, or -1 on error.
+	 */
+	int AddOutput( videoOutput* output, const char* name=NULL );
+
+	/**
+	 * Connect the output of one node to the input of another.
+	 * Nodes can be connected to multiple downstream nodes, and receive from multiple upstream nodes.
+	 */
+	bool Connect( int from, int to );
+
+	/**
+	 * Start the threads for each node.
+	 */
+	bool Start();
+
+	/**
+	 * Stop the threads for each node, and wait for them to exit.
+	 */
+	void Stop();
+
+	/**
+	 * Return true if any of the nodes are still running.  This becomes false after Stop(),
+	 * or after all of the sources have reached end-of-stream and the frames have drained.
+	 */
+	bool IsStreaming() const;
+
+	/**
+	 * Get the number of nodes in the pipeline.
+	 */
+	inline uint32_t GetNumNodes() const			{ return mNodes.size(); }
+
+	/**
+	 * Get the name of a node.
+	 */
+	const char* GetNodeName( int node ) const;
+
+	/**
+	 * Get the statistics of a node.  The frame rate is measured over the time since 
+	 * the previous call to GetStats(), and the latencies are averaged over it.
+	 */
+	Stats GetStats( int node );
+
+	/**
+	 * Log the statistics of every node in the pipeline.
+	 */
+	void PrintStats();
+
+protected:
+	enum NodeType
+	{
+		NODE_SOURCE,
+		NODE_PROCESS,
+		NODE_OUTPUT
+	};
+
+	struct Buffer
+	{
+		Frame frame;	// first, so that a Frame* can be cast to its Buffer*
+		videoFrame captured;	// reference to the source's frame, released when the buffer is recycled
+		std::atomic<uint32_t> refCount;
+	};
+
+	struct Node
+	{
+		videoPipeline* pipeline;
+		NodeType type;
+		std::string name;
+		int id;
+
+		videoSource* source;
+		videoOutput* output;
+		imageFormat format;
+
+		ProcessFunction function;
+		void* user;
+
+		FrameQueue<Frame*>* queue;
+		std::vector<Node*> downstream;
+		std::atomic<uint32_t> activeInputs;
+		uint32_t numInputs;
+
+		Thread thread;
+		cudaStream_t stream;	// stream that sources capture on
+
+		Mutex    statsMutex;
+		uint64_t frames;
+		uint64_t dropped;
+		uint64_t rateFrames;
+		double   latencySum;
+		double   latencyMax;
+		double   totalLatencySum;
+		uint64_t latencyFrames;
+		timespec rateTime;
+	};
+
+	int addNode( NodeType type, const char* name );
+	
+	bool capture( Node* node );
+	void deliver( Node* node, Buffer* buffer, const timespec& begin );
+	void release( Buffer* buffer );
+	void finish( Node* node );
+
+	static void* nodeThread( void* param );
+
+	std::vector<Node*>   mNodes;
+	std::vector<Buffer*> mBuffers;
+
+	FrameQueue<Frame*> mFreeBuffers;
+	FrameQueue<Frame*>::Policy mPolicy;
+
+	uint32_t mQueueDepth;
+
+	std::atomic<bool> mStop;
+	std::atomic<uint32_t> mActiveNodes;
+	uint32_t mStartedNodes;	// number of nodes (from the beginning of mNodes) with running threads
+	bool mStarted;
+};
+
+#endif
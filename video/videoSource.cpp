@@ -22,26 +22,91 @@
  
 #include "videoSource.h"
 #include "imageLoader.h"
+#include "shmSource.h"
 
 #include "gstCamera.h"
 #include "gstDecoder.h"
 
+#include "cudaMappedMemory.h"
+#include "timespec.h"
 #include "logging.h"
 
+#include <atomic>
+#include <string.h>
+#include <inttypes.h>
+
+
+// each stream gets a unique ID
+static std::atomic<uint32_t> sourceCount(0);
+
+
+// latencyBin (bins 0-3 are 1us wide, then each octave of microseconds is split into 4 bins)
+static inline uint32_t latencyBin( uint64_t latency )
+{
+	const uint64_t us = latency / 1000;
+
+	if( us < 4 )
+		return us;
+
+	const uint32_t octave = 63 - __builtin_clzll(us);
+	const uint32_t bin = (octave - 1) * 4 + ((us >> (octave - 2)) & 3);
+
+	return (bin < videoSource::LatencyBins) ? bin : videoSource::LatencyBins - 1;
+}
+
+
+// latencyPercentile (the upper edge of the bin that it falls in, clamped to the min/max)
+static uint64_t latencyPercentile( const videoSource::Stats& stats, double percentile )
+{
+	if( stats.latencyCount == 0 )
+		return 0;
+
+	const uint64_t rank = (uint64_t)(percentile * stats.latencyCount + 0.5);
+	uint64_t count = 0;
+
+	for( uint32_t n=0; n < videoSource::LatencyBins; n++ )
+	{
+		count += stats.histogram[n];
+
+		if( count < rank || count == 0 )
+			continue;
+
+		uint64_t min = 0;
+		uint64_t max = 0;
+
+		videoSource::LatencyBinRange(n, &min, &max);
+
+		if( max > stats.latencyMax )
+			return stats.latencyMax;
+
+		return (max > stats.latencyMin) ? max : stats.latencyMin;
+	}
+
+	return stats.latencyMax;
+}
+
 
 // constructor
 videoSource::videoSource( const videoOptions& options ) : mOptions(options)
 {
 	mStreaming = false;
 	mLastTimestamp = 0;
+	mLastPTS = 0;
 	mRawFormat = IMAGE_UNKNOWN;
+	mSourceID = ++sourceCount;
+	mFramePool = NULL;
+
+	memset(&mStats, 0, sizeof(Stats));
+	mLatencyTotal = 0;
 }
 
 
 // destructor
 videoSource::~videoSource()
 {
-
+	// the pool gets freed after the application releases its frames
+	if( mFramePool != NULL )
+		mFramePool->Release();
 }
 
 // Create
@@ -66,6 +131,10 @@ videoSource* videoSource::Create( const videoOptions& options )
 	{
 		src = gstCamera::Create(options);
 	}
+	else if( uri.protocol == "shm" )
+	{
+		src = shmSource::Create(options);
+	}
 	else
 	{
 		LogError(LOG_VIDEO "videoSource -- unsupported protocol (%s)\n", uri.protocol.size() > 0 ? uri.protocol.c_str() : "null");
@@ -117,6 +186,217 @@ videoSource* videoSource::Create( const char* resource, const videoOptions& opti
 	return Create(resource, 0, NULL, -1, options);
 }
 
+#define RETURN_STATUS(code)  { if( status != NULL ) { *status=(code); } return ((code) == videoSource::OK ? true : false); }
+
+
+// Capture
+bool videoSource::Capture( videoFrame* frame, imageFormat format, uint64_t timeout, int* status, cudaStream_t stream )
+{
+	if( !frame )
+		RETURN_STATUS(ERROR);
+
+	void* image = NULL;
+
+	if( !Capture(&image, format, timeout, status, stream) )
+		return false;
+
+	// streams that don't hand out frames themselves get copied into a pool
+	const imageFormat outputFormat = (format == IMAGE_UNKNOWN) ? mRawFormat : format;
+	const size_t size = imageFormatSize(outputFormat, GetWidth(), GetHeight());
+
+	if( !mFramePool || mFramePool->GetBufferSize() < size )
+	{
+		if( mFramePool != NULL )
+			mFramePool->Release();
+
+		mFramePool = videoFramePool::Create(mOptions.numBuffers, size, true, 0, mSourceID);
+
+		if( !mFramePool )
+			RETURN_STATUS(ERROR);
+	}
+
+	if( !mFramePool->Acquire(frame, GetWidth(), GetHeight(), outputFormat, mLastTimestamp) )
+		RETURN_STATUS(ERROR);
+
+	if( CUDA_FAILED(cudaMemcpyAsync(frame->GetImage(), image, size, cudaMemcpyDeviceToDevice, stream)) )
+	{
+		frame->Release();
+		RETURN_STATUS(ERROR);
+	}
+
+	RETURN_STATUS(OK);
+}
+
+
+// GetStats
+videoSource::Stats videoSource::GetStats()
+{
+	mStatsMutex.Lock();
+
+	Stats stats = mStats;
+
+	if( stats.latencyCount > 0 )
+		stats.latencyMean = mLatencyTotal / stats.latencyCount;
+
+	mStatsMutex.Unlock();
+
+	stats.latencyP50 = latencyPercentile(stats, 0.50);
+	stats.latencyP99 = latencyPercentile(stats, 0.99);
+
+	return stats;
+}
+
+
+// ResetStats
+void videoSource::ResetStats()
+{
+	mStatsMutex.Lock();
+
+	memset(&mStats, 0, sizeof(Stats));
+	mLatencyTotal = 0;
+
+	mStatsMutex.Unlock();
+}
+
+
+// PrintStats
+void videoSource::PrintStats()
+{
+	const Stats stats = GetStats();
+
+	LogInfo(LOG_VIDEO "%s stats for %s\n", TypeToStr(), GetResource().string.c_str());
+	LogInfo(LOG_VIDEO "   -- received:   %" PRIu64 "\n", stats.received);
+	LogInfo(LOG_VIDEO "   -- delivered:  %" PRIu64 "\n", stats.delivered);
+	LogInfo(LOG_VIDEO "   -- dropped:    %" PRIu64 " (%" PRIu64 " skipped, %" PRIu64 " overwritten, %" PRIu64 " failed)\n", stats.dropped, stats.droppedSkipped, stats.droppedOverwritten, stats.droppedFailed);
+	LogInfo(LOG_VIDEO "   -- timeouts:   %" PRIu64 "\n", stats.timeouts);
+	LogInfo(LOG_VIDEO "   -- errors:     %" PRIu64 "\n", stats.errors);
+
+	if( stats.latencyCount == 0 )
+		return;
+
+	LogInfo(LOG_VIDEO "   -- latency:    min %.2f ms, mean %.2f ms, max %.2f ms\n", stats.latencyMin / 1000000.0, stats.latencyMean / 1000000.0, stats.latencyMax / 1000000.0);
+	LogInfo(LOG_VIDEO "   -- latency:    p50 %.2f ms, p99 %.2f ms\n", stats.latencyP50 / 1000000.0, stats.latencyP99 / 1000000.0);
+
+	for( uint32_t n=0; n < LatencyBins; n++ )
+	{
+		if( stats.histogram[n] == 0 )
+			continue;
+
+		uint64_t min = 0;
+		uint64_t max = 0;
+
+		LatencyBinRange(n, &min, &max);
+
+		const double percent = stats.histogram[n] * 100.0 / stats.latencyCount;
+
+		if( n == LatencyBins - 1 )
+		{
+			LogInfo(LOG_VIDEO "      >= %8.3f ms           %8" PRIu64 "  (%5.1f%%)\n", min / 1000000.0, stats.histogram[n], percent);
+		}
+		else
+		{
+			LogInfo(LOG_VIDEO "      %8.3f - %8.3f ms  %8" PRIu64 "  (%5.1f%%)\n", min / 1000000.0, max / 1000000.0, stats.histogram[n], percent);
+		}
+	}
+}
+
+
+// LatencyBinRange
+void videoSource::LatencyBinRange( uint32_t bin, uint64_t* min, uint64_t* max )
+{
+	uint64_t low = 0;
+	uint64_t width = 1;
+
+	if( bin < 4 )
+	{
+		low = bin;
+	}
+	else
+	{
+		const uint32_t octave = bin / 4 + 1;
+
+		width = 1ULL << (octave - 2);
+		low = (4 + (bin % 4)) * width;
+	}
+
+	if( min != NULL )
+		*min = low * 1000;
+
+	if( max != NULL )
+		*max = (bin >= LatencyBins - 1) ? UINT64_MAX : (low + width) * 1000;
+}
+
+
+// recordReceived
+void videoSource::recordReceived( uint64_t count )
+{
+	mStatsMutex.Lock();
+	mStats.received += count;
+	mStatsMutex.Unlock();
+}
+
+
+// recordDropped
+void videoSource::recordDropped( DropReason reason, uint64_t count )
+{
+	if( count == 0 )
+		return;
+
+	mStatsMutex.Lock();
+
+	mStats.dropped += count;
+
+	if( reason == DROP_SKIPPED )
+		mStats.droppedSkipped += count;
+	else if( reason == DROP_OVERWRITTEN )
+		mStats.droppedOverwritten += count;
+	else
+		mStats.droppedFailed += count;
+
+	mStatsMutex.Unlock();
+}
+
+
+// recordCapture
+void videoSource::recordCapture( int status, uint64_t timestamp )
+{
+	// frames from the future (from a different clock) aren't counted in the latency
+	const uint64_t now = timeNs();
+
+	mStatsMutex.Lock();
+
+	if( status == OK )
+	{
+		mStats.delivered++;
+
+		if( timestamp > 0 && timestamp <= now )
+		{
+			const uint64_t latency = now - timestamp;
+
+			if( mStats.latencyCount == 0 || latency < mStats.latencyMin )
+				mStats.latencyMin = latency;
+
+			if( latency > mStats.latencyMax )
+				mStats.latencyMax = latency;
+
+			mStats.latencyCount++;
+			mStats.histogram[latencyBin(latency)]++;
+			mLatencyTotal += latency;
+		}
+	}
+	else if( status == TIMEOUT )
+	{
+		mStats.timeouts++;
+	}
+	else if( status == ERROR )
+	{
+		mStats.errors++;
+	}
+
+	mStatsMutex.Unlock();
+}
+
+
 // Open
 bool videoSource::Open()
 {
@@ -139,6 +419,8 @@ const char* videoSource::TypeToStr( uint32_t type )
 		return "gstDecoder";
 	else if( type == imageLoader::Type )
 		return "imageLoader";
+	else if( type == shmSource::Type )
+		return "shmSource";
 
 	return "(unknown)";
 }
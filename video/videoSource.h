@@ -25,9 +25,12 @@
 
 
 #include "videoOptions.h"
+#include "videoFrame.h"
 #include "imageFormat.h"		
 #include "commandLine.h"
 
+#include "Mutex.h"
+
 
 /**
  * Standard command-line options able to be passed to videoSource::Create()
@@ -43,6 +46,7 @@
 		  "                             * file://my_image.jpg       (image file)\n"			\
 		  "                             * file://my_video.mp4       (video file)\n"			\
 		  "                             * file://my_directory/      (directory of images)\n"		\
+		  "                             * shm://my_stream           (shared memory stream)\n"		\
 		  "  --input-width=WIDTH    explicitly request a width of the stream (optional)\n"   	\
 		  "  --input-height=HEIGHT  explicitly request a height of the stream (optional)\n"  	\
 		  "  --input-rate=RATE      explicitly request a framerate of the stream (optional)\n"	\
@@ -68,7 +72,9 @@
 		  "  --input-loop=LOOP      for file-based inputs, the number of loops to run:\n"		\
 		  "                             * -1 = loop forever\n"								\
 		  "                             *  0 = don't loop (default)\n"						\
-		  "                             * >0 = set number of loops\n\n"
+		  "                             * >0 = set number of loops\n"						\
+		  "  --input-retain=N       keep up to N upstream buffers mapped instead of copying\n"	\
+		  "                         them (must be less than the upstream buffer pool size)\n\n"
 
 
 /**
@@ -76,7 +82,7 @@
  * V4L2 cameras, video/images files from disk, directories containing a sequence of images, 
  * and from RTP/RTSP network video streams over UDP/IP.
  *
- * videoSource interfaces are implemented by gstCamera, gstDecoder, and imageLoader.
+ * videoSource interfaces are implemented by gstCamera, gstDecoder, imageLoader, and shmSource.
  * The specific implementation is selected at runtime based on the type of resource URI.
  *
  * videoSource supports the following protocols and resource URI's:
@@ -110,6 +116,10 @@
  *        Supported video formats for loading include MKV, MP4, AVI, and FLV. Supported codecs for 
  *        decoding include H.264, H.265, VP8, VP9, MPEG-2, MPEG-4, and MJPEG. Supported image formats
  *        for loading include JPG, PNG, TGA, BMP, GIF, PSD, HDR, PIC, and PNM (PPM/PGM binary).
+ *
+ *     - `shm://my_stream` to receive frames from another process on the same system that's sharing them 
+ *        with a `shm://my_stream` videoOutput.  The frames are mapped from shared memory without copies
+ *        (see shmSource), so multiple processes can use the same camera or decoded stream.
  *  
  * @see URI for info about resource URI formats.
  * @see videoOptions for additional options and command-line arguments.
@@ -128,6 +138,52 @@ public:
 		TIMEOUT = 0,	/**< a timeout occurred */
 		OK      = 1	/**< frame capture successful */
 	};
+
+	/**
+	 * Reasons that frames get dropped, which are counted in the Stats.
+	 */
+	enum DropReason
+	{
+		DROP_SKIPPED = 0,	/**< a newer frame arrived before Capture() was called, so this one was skipped */
+		DROP_OVERWRITTEN,	/**< the frame was overwritten by the producer while it was being read */
+		DROP_FAILED		/**< the frame was received, but it couldn't be queued or converted */
+	};
+
+	/**
+	 * The number of bins in the latency histogram.
+	 */
+	static const uint32_t LatencyBins = 80;
+
+	/**
+	 * Frame counters and capture latency statistics (see GetStats())
+	 *
+	 * The latency of a frame is from its timestamp (see GetLastTimestamp()) to when Capture() 
+	 * returned it, so for cameras and network streams it includes the time spent in the pipeline.
+	 */
+	struct Stats
+	{
+		uint64_t received;			/**< Number of frames that were received from the device or stream */
+		uint64_t delivered;			/**< Number of frames that were returned from Capture() */
+		uint64_t dropped;			/**< Total number of frames that were dropped (for any reason) */
+		uint64_t droppedSkipped;		/**< Number of frames dropped with DROP_SKIPPED */
+		uint64_t droppedOverwritten;	/**< Number of frames dropped with DROP_OVERWRITTEN */
+		uint64_t droppedFailed;		/**< Number of frames dropped with DROP_FAILED */
+		uint64_t timeouts;			/**< Number of times that Capture() timed out */
+		uint64_t errors;			/**< Number of times that Capture() returned an error */
+		uint64_t latencyCount;		/**< Number of frames with a timestamp that the latency was measured for */
+		uint64_t latencyMin;		/**< Minimum latency (in nanoseconds) */
+		uint64_t latencyMax;		/**< Maximum latency (in nanoseconds) */
+		uint64_t latencyMean;		/**< Average latency (in nanoseconds) */
+		uint64_t latencyP50;		/**< Median latency (in nanoseconds), to within the histogram's resolution */
+		uint64_t latencyP99;		/**< 99th percentile latency (in nanoseconds), to within the histogram's resolution */
+
+		/**
+		 * Number of frames by latency.  Bins 0-3 are 1us wide, then each doubling of the 
+		 * latency is split into 4 bins (see LatencyBinRange()).  The last bin also includes 
+		 * everything that was later than that (~2 seconds).
+		 */
+		uint64_t histogram[LatencyBins];
+	};
 	
 	/**
 	 * Create videoSource interface from a videoOptions struct that's already been filled out.
@@ -262,6 +318,28 @@ public:
 	 * @returns `true` if a frame was captured, `false` if there was an error or a timeout occurred.
 	 */
 	virtual bool Capture( void** image, imageFormat format, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 ) = 0;
+
+	/**
+	 * Capture the next image from the video stream into a reference-counted videoFrame.
+	 *
+	 * Unlike the pointers returned by the other versions of Capture(), the frame's image won't 
+	 * get overwritten by newer frames - its buffer is only reused after every copy of the videoFrame 
+	 * has been released.  So frames can be held onto or handed off to other threads without copying.
+	 * The frame also records the timestamp, sequence number, and source ID (see GetSourceID()).
+	 *
+	 * @param[out] frame the videoFrame that will reference the captured image.  If it already
+	 *                   referenced a frame, that reference gets released.
+	 *
+	 * @param[in] format the image format to capture in (if IMAGE_UNKNOWN, the raw format is used).
+	 *
+	 * @param[in] timeout timeout in milliseconds to wait to capture the image before returning.
+	 *                    The default is 1000ms.  A timeout value of `UINT64_MAX` will wait forever.
+	 *
+	 * @param[out] status optional status code returned (@see videoSource::Status).
+	 *
+	 * @returns `true` if a frame was captured, `false` if there was an error or a timeout occurred.
+	 */
+	virtual bool Capture( videoFrame* frame, imageFormat format=IMAGE_RGB8, uint64_t timeout=DEFAULT_TIMEOUT, int* status=NULL, cudaStream_t stream=0 );
 	
 	/**
 	 * Begin streaming the device.
@@ -314,14 +392,52 @@ public:
 	
 	/**
 	 * Get timestamp of the last captured frame, in nanoseconds.
+	 * This is in the `CLOCK_MONOTONIC` timebase of timeNs(), so it can be compared
+	 * against timeNs() to measure latency (use timeMonotonicToRealtime() for wall-clock).
  	 */
 	uint64_t GetLastTimestamp() const { return mLastTimestamp; }
 
+	/**
+	 * Get the presentation timestamp (PTS) of the last captured frame, in nanoseconds.
+	 * This is the stream time of the media (i.e. the position in a video file), which is
+	 * what to use for seeking or syncing with the media, unlike GetLastTimestamp().
+	 * Only sources that are backed by GStreamer set it, for the others it's 0.
+ 	 */
+	uint64_t GetLastPTS() const { return mLastPTS; }
+
+	/**
+	 * Get a snapshot of the frame counters and latency statistics since the stream 
+	 * was created (or since ResetStats() was called).
+	 */
+	Stats GetStats();
+
+	/**
+	 * Reset the frame counters and latency statistics.
+	 */
+	void ResetStats();
+
+	/**
+	 * Print the frame counters and latency histogram to the log.
+	 */
+	void PrintStats();
+
+	/**
+	 * Get the range of latencies (in nanoseconds) that are counted in a histogram bin.
+	 * @param[out] min the lowest latency in the bin
+	 * @param[out] max the latency that the next bin starts at (or UINT64_MAX for the last bin)
+	 */
+	static void LatencyBinRange( uint32_t bin, uint64_t* min, uint64_t* max );
+
 	/**
 	 * Get raw image format.
  	 */
 	inline imageFormat GetRawFormat() const { return mRawFormat; }
 
+	/**
+	 * Get the unique ID of this stream, which is recorded in its videoFrame's.
+	 */
+	inline uint32_t GetSourceID() const		{ return mSourceID; }
+
 	/**
 	 * Return the resource URI of the stream.
 	 */
@@ -339,6 +455,7 @@ public:
 	 *    - gstCamera::Type
 	 *    - gstDecoder::Type
 	 *    - imageLoader::Type
+	 *    - shmSource::Type
 	 */
 	virtual inline uint32_t GetType() const			{ return 0; }
 
@@ -376,11 +493,23 @@ protected:
 	//videoSource();
 	videoSource( const videoOptions& options );
 
+	void recordReceived( uint64_t count=1 );
+	void recordDropped( DropReason reason, uint64_t count=1 );
+	void recordCapture( int status, uint64_t timestamp=0 );
+
 	bool         mStreaming;
 	videoOptions mOptions;
 
 	uint64_t     mLastTimestamp;
+	uint64_t     mLastPTS;
 	imageFormat  mRawFormat;
+
+	uint32_t        mSourceID;
+	videoFramePool* mFramePool;
+
+	Mutex    mStatsMutex;
+	Stats    mStats;
+	uint64_t mLatencyTotal;
 };
 
 #endif